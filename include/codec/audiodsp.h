@@ -0,0 +1,87 @@
+/*
+ * audiodsp.h
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Small fixed point DSP kernels for 16 bit linear PCM.
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#ifndef OPAL_CODEC_AUDIODSP_H
+#define OPAL_CODEC_AUDIODSP_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal_config.h>
+
+
+/**Per frame signal processing shared by the echo canceller, silence
+   detector and audio mixer. All are integer only, and use SSE2 or NEON
+   where the compiler target allows. For the absolute value based measures
+   a sample of -32768 is treated as 32767.
+  */
+namespace OpalAudioDSP
+{
+  /**Remove DC offset from a frame.
+     The offset is tracked as a running mean with a time constant of about
+     1024 samples, updated once per frame and subtracted from the next,
+     with saturation. The \p dst and \p src may be the same buffer.
+    */
+  void RemoveDC(
+    short * dst,          ///< Output samples
+    const short * src,    ///< Input samples
+    unsigned samples,     ///< Number of samples
+    int & state           ///< Running mean, initialise to zero for a new stream
+  );
+
+  /**Calculate the average absolute sample value of the frame.
+     This is the measure used by OpalPCM16SilenceDetector.
+    */
+  unsigned AverageLevel(
+    const short * pcm,    ///< Input samples
+    unsigned samples      ///< Number of samples
+  );
+
+  /**Calculate the largest absolute sample value of the frame.
+    */
+  unsigned PeakLevel(
+    const short * pcm,    ///< Input samples
+    unsigned samples      ///< Number of samples
+  );
+
+  /**Calculate the root mean square sample value of the frame.
+    */
+  unsigned RMSLevel(
+    const short * pcm,    ///< Input samples
+    unsigned samples      ///< Number of samples
+  );
+};
+
+
+#endif // OPAL_CODEC_AUDIODSP_H
+
+
+/////////////////////////////////////////////////////////////////////////////
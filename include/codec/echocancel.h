@@ -39,15 +39,10 @@
 #if OPAL_AEC
 
 #include <rtp/rtp.h>
-#include <ptclib/qchannel.h>
 
-#ifndef SPEEX_ECHO_H
-struct SpeexEchoState;
-#endif
 
-#ifndef SPEEX_PREPROCESS_H
-struct SpeexPreprocessState;
-#endif 
+class OpalMediaFormat;
+
 
 ///////////////////////////////////////////////////////////////////////////////
 class OpalEchoCanceler : public PObject
@@ -93,27 +88,59 @@ public:
       const int clockRate     ///> Clock Rate for the preprocessor
     );
 
+    /**Set the media format the canceler is filtering.
+       This sets the clock rate and predicts the frame size from the frame
+       time and frames per packet, so the canceler state is allocated here
+       rather than on the media threads. If the frames turn out to be a
+       different size, the receive thread builds state for that size once
+       and keeps it, along with a few others, for when the size changes back.
+     */
+    void SetMediaFormat(
+      const OpalMediaFormat & mediaFormat, ///> Format the captured audio is encoded to
+      int rawClockRate = 0                 ///> Clock rate of the filtered audio, zero for that of mediaFormat
+    );
+
+    /**Get the current estimate of how far, in samples, the reference
+       signal used for cancellation lags the most recently played audio.
+     */
+    unsigned GetEchoDelay() const { return echoDelay; }
+  //@}
+
 protected:
   PDECLARE_NOTIFIER(RTP_DataFrame, OpalEchoCanceler, ReceivedPacket);
   PDECLARE_NOTIFIER(RTP_DataFrame, OpalEchoCanceler, SentPacket);
 
+  void BuildState();
+
   PNotifier receiveHandler;
   PNotifier sendHandler;
 
-  Params param;
-
-  double mean;
-  int clockRate;
-  PQueueChannel *echo_chan;
-  PMutex stateMutex;
-  SpeexEchoState *echoState;
-  SpeexPreprocessState *preprocessState;
-
-  // the following types are all void * to avoid including Speex header files
-  void * ref_buf;
-  void * echo_buf;
-  void * e_buf;
-  void * noise;
+  // Configuration, only changed with stateMutex held and never on the media path
+  Params   param;
+  int      clockRate;
+  unsigned frameSamples;
+  PMutex   stateMutex;
+
+  /* The Speex state and work buffers for a frame size. The receive thread
+     owns activeState, a short most recently used list of one per frame size
+     seen, SetParameters() and friends build pendingState, and the receive
+     thread swaps them when it can get stateMutex without waiting. */
+  struct State;
+  State * activeState;
+  State * pendingState;
+  atomic<bool> stateChanged;
+
+  /* Single producer (SentPacket), single consumer (ReceivedPacket) ring of
+     the far end audio, positioned by RTP timestamp. */
+  class ReferenceRing;
+  ReferenceRing * reference;
+
+  atomic<bool>     enabled;
+  atomic<bool>     closing;
+  atomic<unsigned> busy;      // Notifiers in progress plus one for us, see ~OpalEchoCanceler()
+  PSyncPoint       idle;      // Signalled by the last notifier out once closing
+  atomic<unsigned> echoDelay;
+  int mean; // Running DC offset, see OpalAudioDSP::RemoveDC()
 };
 
 
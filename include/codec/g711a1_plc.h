@@ -103,6 +103,7 @@ class OpalG711_PLC
     void addtohistory(short *s, int size);       /**< add a good frame to history buffer */
     int getAlgDelay() const { return pitch_overlapmax; };  /**< return the algorithmic delay of the algorithm [samples] */
     void drop(short *s, int size);               /**< the previous frame has to be dropped and the playout is increased */
+    void reset();                                /**< return to the state just after construction, for re-use */
 
    private:
     void scalespeech(short *inout, int c, int sz, bool decay=true) const;
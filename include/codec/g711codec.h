@@ -46,6 +46,10 @@ class Opal_G711_PCM : public OpalStreamedTranscoder {
   public:
     Opal_G711_PCM(const OpalMediaFormat & inputMediaFormat);
 
+#if OPAL_G711PLC 
+    virtual bool Reset();
+#endif
+
 #if OPAL_G711PLC 
    virtual PBoolean Convert(
       const RTP_DataFrame & input,  ///<  Input data
@@ -65,6 +69,7 @@ class Opal_G711_uLaw_PCM : public Opal_G711_PCM {
   public:
     Opal_G711_uLaw_PCM();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const;
     static int ConvertSample(int sample);
 };
 
@@ -75,6 +80,7 @@ class Opal_PCM_G711_uLaw : public OpalStreamedTranscoder {
   public:
     Opal_PCM_G711_uLaw();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const;
     static int ConvertSample(int sample);
 };
 
@@ -85,6 +91,7 @@ class Opal_G711_ALaw_PCM : public Opal_G711_PCM {
   public:
     Opal_G711_ALaw_PCM();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const;
     static int ConvertSample(int sample);
 };
 
@@ -95,6 +102,7 @@ class Opal_PCM_G711_ALaw : public OpalStreamedTranscoder {
   public:
     Opal_PCM_G711_ALaw();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const;
     static int ConvertSample(int sample);
 };
 
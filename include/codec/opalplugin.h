@@ -90,8 +90,9 @@ extern "C" {
 #define  PLUGIN_CODEC_VERSION_OPTIONS   5    // added options handling
 #define  PLUGIN_CODEC_VERSION_INTERSECT 6    // added media option intersection merge functionality
 #define  PLUGIN_CODEC_VERSION_H245_DEF_GEN_PARAM 7 // added suppression of H.245 generic parameters via default
+#define  PLUGIN_CODEC_VERSION_BATCH     8    // added batch conversion control
 
-#define  PLUGIN_CODEC_VERSION PLUGIN_CODEC_VERSION_H245_DEF_GEN_PARAM // Always latest version
+#define  PLUGIN_CODEC_VERSION PLUGIN_CODEC_VERSION_BATCH // Always latest version
 
 #define PLUGIN_CODEC_API_VER_FN       PWLibPlugin_GetAPIVersion
 #define PLUGIN_CODEC_API_VER_FN_STR   "PWLibPlugin_GetAPIVersion"
@@ -231,6 +232,8 @@ struct PluginCodec_Definition;
 #define PLUGINCODEC_CONTROL_SET_LOG_FUNCTION      "set_log_function"
 #define PLUGINCODEC_CONTROL_GET_STATISTICS        "get_statistics"
 #define PLUGINCODEC_CONTROL_TERMINATE_CODEC       "terminate_codec"
+#define PLUGINCODEC_CONTROL_RESET_CODEC           "reset_codec"
+#define PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION    "get_batch_function"
 
 
 /* Log function, plug in gets a pointer to this function which allows
@@ -245,6 +248,30 @@ typedef int (*PluginCodec_LogFunction)(unsigned level,
                                        const char * log);
 
 
+/* Batch conversion, plug in returns a pointer to this function via the
+   PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION control, parm points to a
+   PluginCodec_BatchFunction and *parmLen must be sizeof(PluginCodec_BatchFunction).
+   Each entry is converted exactly as the codecFunction would with the same
+   arguments, in array order. As frames are passed as a whole, a codec should
+   only provide this if every frame is exactly bytesPerFrame (encoded) or
+   samplesPerFrame*2 (PCM) in size. The context may differ between entries,
+   allowing stateless codecs to convert for several instances in one call.
+   The function returns the number of entries converted, stopping at the
+   first failure, or -1 if nothing could be done at all. */
+struct PluginCodec_BatchFrame {
+  void       * context;
+  const void * from;
+  unsigned     fromLen;
+  void       * to;
+  unsigned     toLen;
+  unsigned     flags;
+};
+
+typedef int (*PluginCodec_BatchFunction)(const struct PluginCodec_Definition * codec,
+                                         struct PluginCodec_BatchFrame * frames,
+                                         unsigned count);
+
+
 struct PluginCodec_ControlDefn {
   const char * name;
   int (*control)(const struct PluginCodec_Definition * codec, void * context,
@@ -670,6 +670,17 @@ class PluginCodec : public PluginCodec_Utilities
     }
 
 
+    /** Reset the codec to the state it was in just after construction.
+        This allows OPAL to keep the instance and re-use it for a new stream
+        rather than destroy and create it again. If it returns false, which
+        is the default, the instance is always destroyed.
+      */
+    virtual bool Reset()
+    {
+      return false;
+    }
+
+
     /// Convert from one media format to another.
     virtual bool Transcode(const void * fromPtr,
                              unsigned & fromLen,
@@ -982,26 +993,71 @@ class PluginCodec : public PluginCodec_Utilities
       return codec != NULL && codec->Terminate();
     }
 
+    static int Reset_s(const PluginCodec_Definition *, void * context, const char *, void *, unsigned *)
+    {
+      PluginCodec * codec = (PluginCodec *)context;
+      return codec != NULL && codec->Reset();
+    }
+
+    static int Batch_s(const PluginCodec_Definition * defn, PluginCodec_BatchFrame * frames, unsigned count)
+    {
+      for (unsigned i = 0; i < count; ++i) {
+        if (!Transcode_s(defn, frames[i].context,
+                         frames[i].from, &frames[i].fromLen,
+                         frames[i].to, &frames[i].toLen, &frames[i].flags))
+          return i > 0 ? (int)i : -1;
+      }
+      return count;
+    }
+
+    static int GetBatchFunction_s(const PluginCodec_Definition *, void *, const char *, void * parm, unsigned * len)
+    {
+      if (parm == NULL || len == NULL || *len != sizeof(PluginCodec_BatchFunction))
+        return false;
+
+      *(PluginCodec_BatchFunction *)parm = PluginCodec::Batch_s;
+      return true;
+    }
+
+#define PLUGINCODEC_CONTROLS_COMMON \
+        { PLUGINCODEC_CONTROL_GET_OUTPUT_DATA_SIZE,  PluginCodec::GetOutputDataSize_s }, \
+        { PLUGINCODEC_CONTROL_TO_NORMALISED_OPTIONS, PluginCodec::ToNormalised_s }, \
+        { PLUGINCODEC_CONTROL_TO_CUSTOMISED_OPTIONS, PluginCodec::ToCustomised_s }, \
+        { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS,     PluginCodec::SetOptions_s }, \
+        { PLUGINCODEC_CONTROL_GET_ACTIVE_OPTIONS,    PluginCodec::GetActiveOptions_s }, \
+        { PLUGINCODEC_CONTROL_GET_CODEC_OPTIONS,     PluginCodec::GetOptions_s }, \
+        { PLUGINCODEC_CONTROL_FREE_CODEC_OPTIONS,    PluginCodec::FreeOptions_s }, \
+        { PLUGINCODEC_CONTROL_VALID_FOR_PROTOCOL,    PluginCodec::ValidForProtocol_s }, \
+        { PLUGINCODEC_CONTROL_SET_INSTANCE_ID,       PluginCodec::SetInstanceID_s }, \
+        { PLUGINCODEC_CONTROL_GET_STATISTICS,        PluginCodec::GetStatistics_s }, \
+        { PLUGINCODEC_CONTROL_TERMINATE_CODEC,       PluginCodec::Terminate_s }, \
+        { PLUGINCODEC_CONTROL_RESET_CODEC,           PluginCodec::Reset_s }, \
+        PLUGINCODEC_CONTROL_LOG_FUNCTION_INC
+
     static struct PluginCodec_ControlDefn * GetControls()
     {
       static PluginCodec_ControlDefn ControlsTable[] = {
-        { PLUGINCODEC_CONTROL_GET_OUTPUT_DATA_SIZE,  PluginCodec::GetOutputDataSize_s },
-        { PLUGINCODEC_CONTROL_TO_NORMALISED_OPTIONS, PluginCodec::ToNormalised_s },
-        { PLUGINCODEC_CONTROL_TO_CUSTOMISED_OPTIONS, PluginCodec::ToCustomised_s },
-        { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS,     PluginCodec::SetOptions_s },
-        { PLUGINCODEC_CONTROL_GET_ACTIVE_OPTIONS,    PluginCodec::GetActiveOptions_s },
-        { PLUGINCODEC_CONTROL_GET_CODEC_OPTIONS,     PluginCodec::GetOptions_s },
-        { PLUGINCODEC_CONTROL_FREE_CODEC_OPTIONS,    PluginCodec::FreeOptions_s },
-        { PLUGINCODEC_CONTROL_VALID_FOR_PROTOCOL,    PluginCodec::ValidForProtocol_s },
-        { PLUGINCODEC_CONTROL_SET_INSTANCE_ID,       PluginCodec::SetInstanceID_s },
-        { PLUGINCODEC_CONTROL_GET_STATISTICS,        PluginCodec::GetStatistics_s },
-        { PLUGINCODEC_CONTROL_TERMINATE_CODEC,       PluginCodec::Terminate_s },
-        PLUGINCODEC_CONTROL_LOG_FUNCTION_INC
+        PLUGINCODEC_CONTROLS_COMMON
         { NULL }
       };
       return ControlsTable;
     }
 
+    /* As GetControls() but also advertises batch conversion. Only use this
+       for codecs whose frames are always a fixed size, see
+       PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION. */
+    static struct PluginCodec_ControlDefn * GetBatchControls()
+    {
+      static PluginCodec_ControlDefn ControlsTable[] = {
+        PLUGINCODEC_CONTROLS_COMMON
+        { PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION,    PluginCodec::GetBatchFunction_s },
+        { NULL }
+      };
+      return ControlsTable;
+    }
+
+#undef PLUGINCODEC_CONTROLS_COMMON
+
   protected:
     const PluginCodec_Definition * m_definition;
 
@@ -221,6 +221,7 @@ class OpalPluginTranscoder
 
     bool UpdateOptions(OpalMediaFormat & fmt);
     bool ExecuteCommand(const OpalMediaCommand & command);
+    bool ResetCodec();
     bool Transcode(const void * from, unsigned * fromLen, void * to, unsigned * toLen, unsigned * flags) const
     {
       return codecDef != NULL && codecDef->codecFunction != NULL &&
@@ -237,6 +238,7 @@ class OpalPluginTranscoder
     OpalPluginControl freeOptionsControl;
     OpalPluginControl getOutputDataSizeControl;
     OpalPluginControl getCodecStatistics;
+    OpalPluginControl resetCodecControl;
 #if PTRACING
     bool m_firstLoggedUpdateOptions[2];
 #endif
@@ -273,11 +275,15 @@ class OpalPluginFramedAudioTranscoder : public OpalFramedTranscoder, public Opal
     bool UpdateMediaFormats(const OpalMediaFormat & input, const OpalMediaFormat & output);
     PBoolean ExecuteCommand(const OpalMediaCommand & command);
     void GetStatistics(OpalMediaStatistics & statistics) const;
+    virtual PBoolean Convert(const RTP_DataFrame & input, RTP_DataFrame & output);
     PBoolean ConvertFrame(const BYTE * input, PINDEX & consumed, BYTE * output, PINDEX & created);
     virtual PBoolean ConvertSilentFrame(BYTE * buffer);
+    virtual bool Reset();
     virtual bool AcceptComfortNoise() const { return comfortNoise; }
   protected:
     bool comfortNoise;
+    PluginCodec_BatchFunction batchFunction;
+    std::vector<PluginCodec_BatchFrame> batchFrames;
 };
 
 
@@ -290,6 +296,7 @@ class OpalPluginStreamedAudioTranscoder : public OpalStreamedTranscoder, public
     PBoolean ExecuteCommand(const OpalMediaCommand & command);
     virtual bool AcceptComfortNoise() const { return comfortNoise; }
     virtual int ConvertOne(int from) const;
+    virtual bool Reset();
   protected:
     bool comfortNoise;
 };
@@ -329,6 +336,7 @@ class OpalPluginVideoTranscoder : public OpalVideoTranscoder, public OpalPluginT
     PBoolean ConvertFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList);
     bool UpdateMediaFormats(const OpalMediaFormat & input, const OpalMediaFormat & output);
     PBoolean ExecuteCommand(const OpalMediaCommand & command);
+    virtual bool Reset();
 
   protected:
     bool EncodeFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList);
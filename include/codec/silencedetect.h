@@ -199,6 +199,14 @@ class OpalPCM16SilenceDetector : public OpalSilenceDetector
       PINDEX size           ///<  Size of payload buffer
     );
   //@}
+
+    /**Calculate the average absolute signal level of PCM-16 samples.
+       This is the same measure used by GetAverageSignalLevel().
+      */
+    static unsigned CalculateAverageLevel(
+      const short * pcm,    ///<  PCM-16 samples
+      PINDEX samples        ///<  Number of samples
+    );
 };
 
 
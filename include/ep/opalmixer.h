@@ -250,6 +250,60 @@ class OpalAudioMixer : public OpalBaseMixer
       const OpalJitterBuffer::Init & init   ///< Initialisation information
     );
 
+    /**Set the maximum number of simultaneous talkers that are mixed.
+       If there are more input streams than this, they are ranked by their
+       recent average signal level, and only the loudest are summed into the
+       mix. Zero means all streams are mixed.
+      */
+    void SetMaxTalkers(
+      unsigned max    ///< Maximum talkers, 0 is unlimited
+    ) { m_maxTalkers = max; }
+
+    /**Get the maximum number of simultaneous talkers that are mixed.
+      */
+    unsigned GetMaxTalkers() const { return m_maxTalkers; }
+
+    /**Low level mixing kernels.
+       The best available for the CPU is selected at run time, all produce
+       identical output to the scalar version.
+      */
+    enum MixKernel {
+      MixKernelScalar,
+      MixKernelSSE2,
+      MixKernelAVX2,
+      MixKernelNEON,
+      NumMixKernels
+    };
+
+    /// Get the mixing kernel in use.
+    static MixKernel GetMixKernel();
+
+    /// Set the mixing kernel to use, returns false if CPU does not support it.
+    static bool SetMixKernel(MixKernel kernel);
+
+    /// Get the best mixing kernel the CPU supports.
+    static MixKernel GetBestMixKernel();
+
+    /**Sum \p samples PCM-16 values from each of \p streamCount buffers into
+       \p mixed.
+      */
+    static void AccumulateSamples(
+      int * mixed,
+      const short * const * buffers,
+      size_t streamCount,
+      unsigned samples
+    );
+
+    /**Subtract \p subtract (which may be NULL) from \p mixed and saturate
+       to PCM-16 into \p dst.
+      */
+    static void SubtractAndSaturate(
+      short * dst,
+      const int * mixed,
+      const short * subtract,
+      unsigned samples
+    );
+
   protected:
     struct AudioStream : public Stream
     {
@@ -264,6 +318,9 @@ class OpalAudioMixer : public OpalBaseMixer
       unsigned           m_nextTimestamp;
       PShortArray        m_cacheSamples;
       size_t             m_samplesUsed;
+      bool               m_contributed; // Last GetAudioDataPtr() had some audio, not all silence
+      unsigned           m_level;       // Smoothed average signal level
+      bool               m_mixed;       // Was included in last PreMixStreams()
     };
 
     virtual Stream * CreateStream();
@@ -281,6 +338,10 @@ class OpalAudioMixer : public OpalBaseMixer
     AudioStream    * m_left;
     AudioStream    * m_right;
     std::vector<int> m_mixedAudio;
+    unsigned         m_maxTalkers;
+
+    typedef std::vector< std::pair<unsigned, AudioStream *> > TalkerRanking;
+    TalkerRanking    m_talkerRanking;
 };
 
 
@@ -357,6 +418,47 @@ class OpalVideoMixer : public OpalBaseMixer
       unsigned height   ///< new height
     );
 
+    /**Low level scaling kernels.
+       The best available for the CPU is selected at run time, all produce
+       identical output to the scalar version.
+      */
+    enum ScaleKernel {
+      ScaleKernelScalar,
+      ScaleKernelSSE4,
+      ScaleKernelAVX2,
+      ScaleKernelNEON,
+      NumScaleKernels
+    };
+
+    /// Get the scaling kernel in use.
+    static ScaleKernel GetScaleKernel();
+
+    /// Set the scaling kernel to use, returns false if CPU does not support it.
+    static bool SetScaleKernel(ScaleKernel kernel);
+
+    /// Get the best scaling kernel the CPU supports.
+    static ScaleKernel GetBestScaleKernel();
+
+    /**Copy the YUV420P image \p src into the rectangle \p x, \p y,
+       \p width, \p height of the YUV420P image \p dst, scaling as required.
+       Straight copies and area averaged downscales by 2, 3 or 4 use the
+       vectorised kernels, cropping the few pixels left over when the tile
+       size was rounded down. Anything else is passed on to
+       PColourConverter::CopyYUV420P().
+      */
+    static void ScaleYUV420P(
+      unsigned srcWidth,    ///< Width of source image
+      unsigned srcHeight,   ///< Height of source image
+      const BYTE * src,     ///< Source image
+      unsigned x,           ///< Left of destination rectangle
+      unsigned y,           ///< Top of destination rectangle
+      unsigned width,       ///< Width of destination rectangle
+      unsigned height,      ///< Height of destination rectangle
+      unsigned dstWidth,    ///< Width of destination image
+      unsigned dstHeight,   ///< Height of destination image
+      BYTE * dst            ///< Destination image
+    );
+
   protected:
     struct VideoStream : public Stream
     {
@@ -365,9 +467,18 @@ class OpalVideoMixer : public OpalBaseMixer
       void InsertVideoFrame(unsigned x, unsigned y, unsigned w, unsigned h);
 
       OpalVideoMixer & m_mixer;
+
+      /* Cache of the last input frame scaled to the tile size, so it can be
+         redrawn after the frame store is cleared without scaling it again. */
+      RTP_DataFrame m_lastFrame;
+      PBYTEArray    m_tile;
+      unsigned      m_tileWidth, m_tileHeight;
+      unsigned      m_tileX, m_tileY;
+      unsigned      m_tileGeneration;
     };
 
     friend struct VideoStream;
+    friend class OpalVideoMixWork;
 
     virtual Stream * CreateStream();
     virtual bool MixStreams(RTP_DataFrame & frame);
@@ -385,6 +496,7 @@ class OpalVideoMixer : public OpalBaseMixer
 
     PBYTEArray m_frameStore;
     size_t     m_lastStreamCount;
+    unsigned   m_layoutGeneration; // Incremented when m_frameStore background is refilled
 };
 
 #endif // OPAL_VIDEO
@@ -404,6 +516,7 @@ struct OpalMixerNodeInfo
     , m_closeOnEmpty(false)
     , m_listenOnly(false)
     , m_sampleRate(OpalMediaFormat::AudioClockRate)
+    , m_maxAudioTalkers(0)
 #if OPAL_VIDEO
     , m_audioOnly(false)
     , m_style(OpalVideoMixer::eGrid)
@@ -422,6 +535,7 @@ struct OpalMixerNodeInfo
   bool     m_closeOnEmpty;        ///< Mixer node is removed when last participant exits
   bool     m_listenOnly;          ///< Mixer only transmits data to "listeners"
   unsigned m_sampleRate;          ///< Audio sample rate, usually 8000
+  unsigned m_maxAudioTalkers;     ///< Maximum loudest talkers mixed, 0 is all
 #if OPAL_VIDEO
   bool     m_audioOnly;           ///< No video is to be allowed.
   OpalVideoMixer::Styles m_style; ///< Method for mixing video
@@ -1026,17 +1140,25 @@ class OpalMixerMediaStream : public OpalMediaStream
 
 #if OPAL_VIDEO
     bool CheckMixedVideoSize(unsigned width, unsigned height);
+
+    /**Check for, and clear, a key frame request from the remote.
+      */
+    bool CheckKeyFrameRequest();
 #endif
 
   protected:
     virtual void InternalClose();
     virtual bool InternalSetJitterBuffer(const OpalJitterBuffer::Init & init);
+#if OPAL_VIDEO
+    virtual bool InternalExecuteCommand(const OpalMediaCommand & command);
+#endif
 
     PSafePtr<OpalMixerNode> m_node;
     bool m_listenOnly;
 #if OPAL_VIDEO
     unsigned m_mixedVideoWidth;
     unsigned m_mixedVideoHeight;
+    atomic<bool> m_keyFrameRequested;
 #endif
 };
 
@@ -1077,15 +1199,25 @@ class OpalAudioStreamMixer : public OpalAudioMixer, public OpalMediaStreamMixer
       RTP_DataFrame    m_raw;
       RTP_DataFrame    m_encoded;
       OpalTranscoder * m_transcoder;
+      bool             m_usingShared;  // Full participant is using the listen only cache
+      bool             m_subtracting;  // m_subtract is valid for this mix period
+      std::vector<short> m_subtract;   // Copy of participants own audio for this mix period
+      std::vector< PSafePtr<OpalMixerMediaStream> > m_streams; // Streams to push to this period
+      std::vector< PSafePtr<OpalMixerMediaStream> > m_failed;  // Streams to close after this period
     };
     std::map<PString, CachedAudio> m_cache;
 
+    void MixAndPush(
+      CachedAudio & cache
+    );
     void PushOne(
       PSafePtr<OpalMixerMediaStream> & stream,
       CachedAudio & cache,
-      const short * audioToSubtract
+      bool first
     );
 
+    friend class OpalAudioMixWork;
+
 #ifdef OPAL_MIXER_AUDIO_DEBUG
     class PAudioMixerDebug * m_audioDebug;
 #endif
@@ -1110,9 +1242,32 @@ class OpalVideoStreamMixer : public OpalVideoMixer, public OpalMediaStreamMixer
     virtual bool SetFrameRate(unsigned rate);
     virtual bool OnMixed(RTP_DataFrame * & output);
 
+    /**Get the key used to share an encoder between output streams.
+       Streams with the same key receive identical packets, so this must
+       include everything that may change the encoder output. The default
+       uses the format name, frame size, bit rates, maximum packet size and
+       all options that appear in the FMTP, e.g. profile and level.
+      */
+    virtual PString GetEncoderKey(
+      const OpalMediaFormat & mediaFormat,  ///< Format for output stream
+      unsigned width,                       ///< Width of output stream
+      unsigned height                       ///< Height of output stream
+    ) const;
+
   protected:
     typedef PDictionary<PString, OpalTranscoder> TranscoderMap;
     TranscoderMap m_transcoders;
+
+    struct EncoderGroup
+    {
+      EncoderGroup() : m_width(0), m_height(0), m_keyFrame(false) { }
+
+      OpalMediaFormat m_mediaFormat;
+      unsigned        m_width;
+      unsigned        m_height;
+      bool            m_keyFrame; // A member has asked for a key frame
+      std::vector< PSafePtr<OpalMixerMediaStream> > m_streams;
+    };
 };
 #endif // OPAL_VIDEO
 
@@ -1773,16 +1773,52 @@ class H323GatekeeperServer : public H323TransactionServer
 
     PSafeDictionary<PString, H323RegisteredEndPoint> m_byIdentifier;
 
-    class StringMap : public PString {
-        PCLASSINFO(StringMap, PString);
+    // Digit trie for longest prefix match of voice prefixes
+    class PrefixTrie
+    {
       public:
-        StringMap(const PString & from, const PString & id)
-          : PString(from), identifier(id) { }
-        PString identifier;
+        PrefixTrie() { }
+        ~PrefixTrie() { RemoveAll(); }
+
+        void Add(const PString & prefix, const PString & identifier);
+        void Remove(const PString & prefix, const PString & identifier);
+        void RemoveAll();
+        bool IsEmpty() const { return m_root.m_children.empty(); }
+        PString FindLongest(const PString & number) const;
+
+      protected:
+        struct Node
+        {
+          ~Node();
+          Node * Find(char c) const;
+          void RemoveChild(Node * child);
+
+          std::vector< std::pair<char, Node *> > m_children;
+          std::vector<PString>                   m_identifiers;
+        };
+        Node m_root;
+
+      private:
+        PrefixTrie(const PrefixTrie &) { }
+        void operator=(const PrefixTrie &) { }
     };
-    PSortedStringList m_byAddress;
-    PSortedStringList m_byAlias;
-    PSortedStringList m_byVoicePrefix;
+
+    // Keys each endpoint was indexed under, for removal
+    struct IndexedKeys
+    {
+      std::vector<PString> m_addresses;
+      std::vector<PString> m_aliases;
+      std::vector<PString> m_prefixes;
+    };
+
+    void RemoveIndexes(const PString & identifier);
+
+    typedef std::multimap<PString, PString> IdentifierIndex;
+    IdentifierIndex                 m_byAddress;
+    IdentifierIndex                 m_byAlias;
+    PrefixTrie                      m_byVoicePrefix;
+    std::map<PString, IndexedKeys>  m_indexedKeys;
+    PReadWriteMutex                 m_indexMutex;
 
     PSafeSortedList<H323GatekeeperCall> m_activeCalls;
 
@@ -392,6 +392,26 @@ class H323Connection : public OpalRTPConnection
      */
     virtual void HandleSignallingChannel();
 
+    /**Handle the result of one read from the signalling channel.
+       This is called by HandleSignallingChannel() for each PDU, timeout or
+       error, or from the endpoint thread pool when the signalling reactor is
+       reading the channel. The \p pdu is NULL if the read failed.
+
+       Returns false if the channel is not to be read any more, the caller
+       should then call EndHandleSignallingChannel().
+
+       This is an internal function and is unlikely to be used by applications.
+     */
+    bool HandleSignallingRead(
+      H323SignalPDU * pdu,  ///<  PDU read, NULL if read failed
+      bool timedOut         ///<  Read failed due to timeout
+    );
+
+    /**Clean up after the signalling channel is no longer being read.
+       This is an internal function and is unlikely to be used by applications.
+     */
+    void EndHandleSignallingChannel();
+
     /**Handle PDU from the signalling channel.
        This is an internal function and is unlikely to be used by applications.
      */
@@ -1050,6 +1070,26 @@ class H323Connection : public OpalRTPConnection
      */
     virtual void HandleControlChannel();
 
+    /**Prepare for reading the control channel.
+       Returns false if the control channel is not to be read.
+       This is an internal function and is unlikely to be used by applications.
+     */
+    bool BeginHandleControlChannel();
+
+    /**Handle the result of one read from the control channel, from the
+       endpoint thread pool when the signalling reactor is reading the
+       channel. The \p pdu is NULL if the read failed.
+
+       Returns false if the channel is not to be read any more, the caller
+       should then call EndHandleControlChannel().
+
+       This is an internal function and is unlikely to be used by applications.
+     */
+    bool HandleControlRead(
+      const PBYTEArray * pdu, ///<  PDU read, NULL if read failed
+      bool timedOut           ///<  Read failed due to timeout
+    );
+
     /**Handle incoming data on the control channel.
        This decodes the data stream into a PDU and calls HandleControlPDU().
 
@@ -2132,6 +2172,9 @@ class H323Connection : public OpalRTPConnection
     void MonitorCallStatus();
     PDECLARE_NOTIFIER(PThread, H323Connection, NewOutgoingControlChannel);
     PDECLARE_AcceptHandlerNotifier(H323Connection, NewIncomingControlChannel);
+#if OPAL_H323_REACTOR
+    bool InternalAddControlChannelToReactor();
+#endif
 
     H323EndPoint & endpoint;
 
@@ -52,6 +52,7 @@
 #include <h323/gkclient.h>
 #include <asn/h225.h>
 #include <h460/h4601.h>
+#include <ptclib/threadpool.h>
 
 
 class H225_EndpointType;
@@ -62,6 +63,7 @@ class H225_FeatureSet;
 
 class H235SecurityInfo;
 
+class H323EndPoint;
 class H323Gatekeeper;
 class H323SignalPDU;
 class H323ServiceControlSession;
@@ -69,6 +71,142 @@ class H323ServiceControlSession;
 class H46019Server;
 
 
+/////////////////////////////////////////////////////////////////////////
+// Thread pooling stuff
+
+/**Work item for the H.323 endpoint thread pool.
+   Work items queued with the same token, usually a connection token, are
+   executed in order, one at a time.
+  */
+class H323WorkItem : public PObject
+{
+    PCLASSINFO(H323WorkItem, PObject);
+  public:
+    H323WorkItem(H323EndPoint & ep, const PString & token)
+      : m_endpoint(ep)
+      , m_token(token)
+    {
+    }
+
+    virtual void Work() = 0;
+
+    const PString & GetToken() const { return m_token; }
+
+  protected:
+    H323EndPoint & m_endpoint;
+    PString        m_token;
+};
+
+
+class H323ThreadPool : public PQueuedThreadPool<H323WorkItem>
+{
+    typedef PQueuedThreadPool<H323WorkItem> BaseClass;
+    PCLASSINFO(H323ThreadPool, BaseClass);
+  public:
+    H323ThreadPool(unsigned maxWorkers, const char * threadName)
+      : BaseClass(maxWorkers, 0, threadName, PThread::HighPriority)
+    {
+    }
+};
+
+
+#if OPAL_H323_REACTOR
+/** Class for reading many H.225 signalling and H.245 control channels from a
+    small, fixed, pool of I/O threads rather than a thread for every channel.
+    Each I/O thread multiplexes its sockets with epoll and reassembles the TPKT
+    framed PDUs, which are then handled by the endpoint thread pool, grouped
+    by connection token so a connections PDUs are handled in order.
+  */
+class H323SignallingReactor : public PObject
+{
+    PCLASSINFO(H323SignallingReactor, PObject);
+  public:
+    /// What the PDUs read from a channel are for.
+    P_DECLARE_TRACED_ENUM(Channels,
+      IncomingChannel,   /**< New TCP connection, awaiting a SETUP. */
+      MaintainedChannel, /**< Maintained TCP connection, awaiting a SETUP. */
+      SignallingChannel, /**< H.225 channel of a connection. */
+      ControlChannel     /**< H.245 channel of a connection. */
+    );
+
+    H323SignallingReactor(
+      H323EndPoint & endpoint,   ///< Endpoint whose thread pool handles PDUs
+      unsigned threadCount = 0   ///< Number of I/O threads, zero is one per processor core
+    );
+    ~H323SignallingReactor();
+
+    /**Add the transport to the reactor.
+       If the transport is already in the reactor, its channel type and token
+       are changed, retaining any partially received PDU.
+
+       Returns false if it could not be added, e.g. it is TLS, the caller
+       should then fall back to a dedicated read thread.
+      */
+    bool Add(
+      OpalTransport & transport, ///< Transport to read
+      Channels channel,          ///< What the PDUs are for
+      const PString & token,     ///< Connection token, or other unique key
+      bool hold = false          ///< Do not read until Resume() is called
+    );
+
+    /**Resume reading from the transport.
+       Reading is held after each PDU read from an incoming or maintained
+       channel, until it has been handled, as subsequent PDUs will usually
+       be for a different token.
+
+       Returns false if the transport is not in the reactor, or is no longer
+       being held for \p heldToken.
+      */
+    bool Resume(
+      OpalTransport & transport, ///< Transport to read
+      const PString & heldToken, ///< Token transport was held for
+      Channels channel,          ///< What the PDUs are now for
+      const PString & token      ///< Connection token, or other unique key
+    );
+
+    /**Queue the start of a held control channel to the thread pool.
+       This calls H323Connection::BeginHandleControlChannel() and then
+       resumes, or removes, the transport.
+      */
+    void QueueStartControlChannel(
+      OpalTransport & transport, ///< Transport to read
+      const PString & token      ///< Connection token
+    );
+
+    /**Stop the I/O threads, so nothing more is queued to the thread pool.
+       Transports may still be added, resumed or removed, which is needed by
+       work items already in the pool, but will not be read.
+      */
+    void Close();
+
+    /**Remove the transport from the reactor.
+       On return, no further PDUs will be queued for the transport, though
+       some may still be in the thread pool.
+
+       Returns false if the transport was not in the reactor, or if \p token
+       is not empty and the transport is now being read for another token.
+      */
+    bool Remove(
+      OpalTransport & transport, ///< Transport being read
+      const PString & token = PString::Empty()  ///< Only remove if for this token
+    );
+
+    /**Get the number of I/O threads in the reactor.
+      */
+    unsigned GetThreadCount() const { return m_workers.size(); }
+
+  protected:
+    class Worker;
+    H323EndPoint        & m_endpoint;
+    std::vector<Worker *> m_workers;
+
+  private:
+    H323SignallingReactor(const H323SignallingReactor & other) : PObject(other), m_endpoint(other.m_endpoint) { }
+    void operator=(const H323SignallingReactor &) { }
+};
+#endif // OPAL_H323_REACTOR
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /**This class manages the H323 endpoint.
@@ -97,7 +235,8 @@ class H323EndPoint : public OpalRTPEndPoint
     /**Create a new endpoint.
      */
     H323EndPoint(
-      OpalManager & manager
+      OpalManager & manager,
+      unsigned maxThreads = 15  ///< Maximum threads in each of the PDU and RAS pools
     );
 
     /**Destroy endpoint.
@@ -411,6 +550,76 @@ class H323EndPoint : public OpalRTPEndPoint
       bool reused = false
     );
 
+    /**Handle the SETUP PDU that is first on an incoming signalling channel.
+       Returns the connection created for the call, or NULL if none could be,
+       in which case a RELEASE COMPLETE has been sent.
+       This is an internal function and is unlikely to be used by applications.
+      */
+    PSafePtr<H323Connection> InternalHandleFirstSignalPDU(
+      const OpalTransportPtr & transport,  ///< Transport connection came in on
+      H323SignalPDU & setupPDU,            ///< First PDU
+      bool reused                          ///< Transport was maintained from previous call
+    );
+
+    /**Handle failure to get a SETUP PDU on an incoming signalling channel.
+       This is an internal function and is unlikely to be used by applications.
+      */
+    void InternalFirstSignalPDUFailed(
+      OpalTransport & transport,  ///< Transport connection came in on
+      bool reused                 ///< Transport was maintained from previous call
+    );
+
+    /// How H.225 signalling and H.245 control channels are read.
+    P_DECLARE_TRACED_ENUM(SignallingThreadingModel,
+      SignallingThreadPerChannel, /**< Each signalling and control channel has
+                                       its own read thread. */
+      SignallingThreadReactor     /**< TCP signalling and control channels are
+                                       read by a small pool of I/O threads
+                                       using epoll, where supported by the
+                                       platform, with the PDUs handled by the
+                                       endpoint thread pool. */
+    );
+
+    /**Get the threading model used for reading signalling channels.
+       Defaults to SignallingThreadPerChannel.
+      */
+    SignallingThreadingModel GetSignallingThreadingModel() const { return m_signallingThreadingModel; }
+
+    /**Set the threading model used for reading signalling channels.
+       This only affects channels opened after the call.
+
+       The \p threadCount is the number of I/O threads used by the reactor,
+       zero indicates one per processor core. This is only used the first
+       time the reactor model is selected.
+
+       Returns false if the model is not supported on this platform.
+      */
+    bool SetSignallingThreadingModel(
+      SignallingThreadingModel model,
+      unsigned threadCount = 0
+    );
+
+#if OPAL_H323_REACTOR
+    /**Get the shared signalling channel reactor.
+       If \p forNewChannels is true, returns NULL if the threading model is
+       not SignallingThreadReactor. Otherwise returns the reactor if it has
+       ever been created, as channels already in it must still be removed.
+      */
+    H323SignallingReactor * GetSignallingReactor(
+      bool forNewChannels = true
+    ) const;
+#endif
+
+    /**Get the thread pool handling PDUs from the signalling reactor.
+      */
+    H323ThreadPool & GetThreadPool() { return *m_threadPool; }
+
+    /**Get the thread pool handling slow RAS transactions.
+       This is separate so a gatekeeper with many slow transactions cannot
+       delay the handling of signalling PDUs, or vice versa.
+      */
+    H323ThreadPool & GetRasThreadPool() { return *m_rasThreadPool; }
+
     /**Create a connection that uses the specified call.
       */
     virtual H323Connection * CreateConnection(
@@ -1432,6 +1641,14 @@ class H323EndPoint : public OpalRTPEndPoint
     std::set<OpalTransportPtr> m_reusableTransports;
     PMutex                     m_reusableTransportMutex;
 
+    H323ThreadPool           * m_threadPool;
+    H323ThreadPool           * m_rasThreadPool;
+    SignallingThreadingModel   m_signallingThreadingModel;
+#if OPAL_H323_REACTOR
+    H323SignallingReactor    * m_signallingReactor;
+    mutable PMutex             m_signallingReactorMutex;
+#endif
+
     H323Capabilities m_capabilities;
 
     typedef PDictionary<PString, H323Gatekeeper> GatekeeperByAlias;
@@ -175,6 +175,13 @@ class H323SignalPDU : public H225_H323_UserInformation
       H323Transport & transport   ///<  Transport to read from
     );
 
+    /**Decode the PDU from the raw data read from a transport, without TPKT
+       header, e.g. by the endpoint signalling reactor.
+      */
+    bool ProcessReadData(
+      const PBYTEArray & rawData  ///<  Q.931 PDU
+    );
+
     /**Write the PDU to the transport.
       */
     PBoolean Write(
@@ -369,7 +369,8 @@ class H323Transaction : public PObject
 
   protected:
     virtual Response OnHandlePDU() = 0;
-    PDECLARE_NOTIFIER(PThread, H323Transaction, SlowHandler);
+    void SlowHandler();
+    friend class H323TransactionWork;
 
     H323Transactor         & transactor;
     unsigned                 requestSequenceNumber;
@@ -60,6 +60,9 @@
 class OpalEndPoint;
 class OpalMediaPatch;
 class OpalLocalConnection;
+class OpalMediaTransportReactor;
+class OpalMediaPatchScheduler;
+class OpalTimerWheel;
 class PSSLCertificate;
 class PSSLPrivateKey;
 
@@ -1696,6 +1699,78 @@ class OpalManager : public PObject
     void SetMaxRtpPacketSize(
       PINDEX size
     ) { rtpPacketSizeMax = size; }
+
+    /// How media transports are read.
+    P_DECLARE_TRACED_ENUM(MediaThreadingModel,
+      MediaThreadPerChannel, /**< Each media transport sub-channel, e.g. RTP
+                                  and RTCP, has its own read thread. */
+      MediaThreadReactor     /**< All UDP media transports are read by a small
+                                  pool of I/O threads using epoll/recvmmsg,
+                                  where supported by the platform. */
+    );
+
+    /**Get the threading model used for reading media transports.
+       Defaults to MediaThreadPerChannel.
+      */
+    MediaThreadingModel GetMediaThreadingModel() const { return m_mediaThreadingModel; }
+
+    /**Set the threading model used for reading media transports.
+       This only affects media transports opened after the call.
+
+       The \p threadCount is the number of I/O threads used by the reactor,
+       zero indicates one per processor core. This is only used the first
+       time the reactor model is selected.
+
+       Returns false if the model is not supported on this platform.
+      */
+    bool SetMediaThreadingModel(
+      MediaThreadingModel model,
+      unsigned threadCount = 0
+    );
+
+#if OPAL_MEDIA_REACTOR
+    /**Get the shared media transport reactor.
+       Returns NULL if the threading model is not MediaThreadReactor.
+      */
+    OpalMediaTransportReactor * GetMediaTransportReactor() const;
+#endif
+
+    /// How media patches are driven.
+    P_DECLARE_TRACED_ENUM(MediaPatchThreadingModel,
+      MediaPatchThreadPerPatch, /**< Each media patch has its own thread. */
+      MediaPatchScheduled       /**< Media patches whose source can be read
+                                     without blocking are serviced by a small
+                                     pool of media worker threads, others
+                                     still have their own thread. */
+    );
+
+    /**Get the threading model used for media patches.
+       Defaults to MediaPatchThreadPerPatch.
+      */
+    MediaPatchThreadingModel GetMediaPatchThreadingModel() const { return m_mediaPatchThreadingModel; }
+
+    /**Set the threading model used for media patches.
+       This only affects media patches started after the call.
+
+       The \p threadCount is the number of worker threads used by the
+       scheduler, zero indicates one per processor core. This is only used the
+       first time the scheduled model is selected.
+      */
+    void SetMediaPatchThreadingModel(
+      MediaPatchThreadingModel model,
+      unsigned threadCount = 0
+    );
+
+    /**Get the shared media patch scheduler.
+       Returns NULL if the threading model is not MediaPatchScheduled.
+      */
+    OpalMediaPatchScheduler * GetMediaPatchScheduler() const;
+
+    /**Get the shared timer wheel.
+       This is used for high volume timers such as RTCP reports and SIP
+       transaction retries.
+      */
+    OpalTimerWheel & GetTimerWheel() const { return *m_timerWheel; }
   //@}
 
 
@@ -2087,6 +2162,15 @@ class OpalManager : public PObject
 
     PINDEX        rtpPayloadSizeMax;
     PINDEX        rtpPacketSizeMax;
+    MediaThreadingModel m_mediaThreadingModel;
+#if OPAL_MEDIA_REACTOR
+    OpalMediaTransportReactor * m_mediaTransportReactor;
+    mutable PMutex              m_mediaTransportReactorMutex;
+#endif
+    MediaPatchThreadingModel  m_mediaPatchThreadingModel;
+    OpalMediaPatchScheduler * m_mediaPatchScheduler;
+    mutable PMutex            m_mediaPatchSchedulerMutex;
+    OpalTimerWheel          * m_timerWheel;
     OpalJitterBuffer::Params m_jitterParams;
     PStringArray  mediaFormatOrder;
     PStringArray  mediaFormatMask;
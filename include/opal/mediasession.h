@@ -50,6 +50,7 @@ class OpalMediaCryptoSuite;
 class H235SecurityCapability;
 class H323Capability;
 class PSTUNClient;
+class OpalMediaTransportReactor;
 
 
 /**String option key to an integer indicating the time in seconds to
@@ -94,6 +95,8 @@ struct OpalNetworkStatistics
   PTime    m_lastReportTime;
   unsigned m_targetBitRate;    // As configured, not actual, which is calculated from m_totalBytes
   float    m_targetFrameRate;  // As configured, not actual, which is calculated from m_totalFrames
+  uint64_t m_framePoolHits;    // RTP_DataFramePool, process wide
+  uint64_t m_framePoolMisses;  // RTP_DataFramePool, process wide
 };
 
 struct OpalVideoStatistics
@@ -454,6 +457,12 @@ public:
     virtual void InternalClose();
     virtual void InternalStop();
 
+    /**Indicate the subchannel may be read by the shared media reactor.
+       Transports that wrap the raw socket (e.g. ICE, DTLS) or need to do
+       blocking work in InternalOnStart() must return false.
+      */
+    virtual bool InternalCanUseReactor(SubChannels subchannel) const;
+
     PString       m_name;
     bool          m_remoteBehindNAT;
     bool          m_remoteAddressSet;
@@ -463,6 +472,7 @@ public:
     PTimeInterval m_maxNoTransmitTime;
     atomic<bool>  m_opened;
     bool          m_started;
+    OpalMediaTransportReactor * m_reactor;
 
     struct Transport
     {
@@ -481,12 +491,16 @@ public:
       SubChannels          m_subchannel;
       PChannel           * m_channel;
       PThread            * m_thread;
+      OpalMediaTransportReactor * m_reactor;
+      bool                 m_onStartCalled;
+      PIPSocketAddressAndPort m_reactorReceiveAddress;
       unsigned             m_consecutiveUnavailableErrors;
       PSimpleTimer         m_timeForUnavailableErrors;
 
       PTRACE_THROTTLE(m_throttleReadPacket,4,60000);
     };
     friend struct Transport;
+    friend class OpalMediaTransportReactor;
     vector<Transport> m_subchannels;
     virtual void InternalOnStart(SubChannels subchannel);
     virtual void InternalRxData(SubChannels subchannel, const PBYTEArray & data);
@@ -524,6 +538,7 @@ class OpalUDPMediaTransport : public OpalMediaTransport
     PUDPSocket * GetSubChannelAsSocket(SubChannels subchannel = e_Media) const;
 
   protected:
+    virtual bool InternalCanUseReactor(SubChannels subchannel) const;
     virtual void InternalRxData(SubChannels subchannel, const PBYTEArray & data);
     virtual bool InternalSetRemoteAddress(const PIPSocket::AddressAndPort & ap, SubChannels subchannel, bool dontOverride PTRACE_PARAM(, const char * source));
 
@@ -531,6 +546,68 @@ class OpalUDPMediaTransport : public OpalMediaTransport
 };
 
 
+#if OPAL_MEDIA_REACTOR
+/** Class for reading many media transports from a small, fixed, pool of I/O
+    threads rather than a thread for every sub-channel.
+    Each I/O thread multiplexes its sockets with epoll and drains them with
+    recvmmsg batches, packets are then dispatched via the usual
+    OpalMediaTransport::ReadNotifier chain.
+  */
+class OpalMediaTransportReactor : public PObject, public OpalMediaTransportChannelTypes
+{
+    PCLASSINFO(OpalMediaTransportReactor, PObject);
+  public:
+    OpalMediaTransportReactor(
+      unsigned threadCount = 0,  ///< Number of I/O threads, zero is one per processor core
+      unsigned batchSize = 16    ///< Maximum number of datagrams read per system call
+    );
+    ~OpalMediaTransportReactor();
+
+    /**Add the media transport subchannel to the reactor.
+       Returns false if it could not be added, the caller should then fall
+       back to a dedicated read thread.
+      */
+    bool Add(
+      OpalMediaTransport & transport,
+      SubChannels subchannel
+    );
+
+    /**Remove the media transport subchannel from the reactor.
+       On return, no further reads will be dispatched for the subchannel.
+       Returns false if the subchannel was not in the reactor.
+      */
+    bool Remove(
+      OpalMediaTransport & transport,
+      SubChannels subchannel
+    );
+
+    /**Wait for any read currently being dispatched to the subchannel to
+       complete. Does not wait if called from within that dispatch.
+      */
+    void WaitForDispatch(
+      OpalMediaTransport & transport,
+      SubChannels subchannel
+    );
+
+    /**Get the number of I/O threads in the reactor.
+      */
+    unsigned GetThreadCount() const { return m_workers.size(); }
+
+    /**Indicate the current thread is one of the reactor I/O threads.
+      */
+    bool IsReactorThread() const;
+
+  protected:
+    class Worker;
+    std::vector<Worker *> m_workers;
+
+  private:
+    OpalMediaTransportReactor(const OpalMediaTransportReactor &) { }
+    void operator=(const OpalMediaTransportReactor &) { }
+};
+#endif // OPAL_MEDIA_REACTOR
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /** Class for carrying media session information
@@ -338,6 +338,23 @@ class OpalMediaStream : public PSafeObject
        The default behaviour does nothing and returns false.
       */
     virtual bool EnableJitterBuffer(bool enab = true);
+
+    /// How a source stream may be read by the media patch scheduler.
+    enum ScheduledReadMode {
+      e_ScheduledReadBlocks,  ///< ReadPacket() may block, a dedicated patch thread is needed
+      e_ScheduledReadOnTick,  ///< ReadPacket() does not block, call it once per packet time
+      e_ScheduledReadOnReady  ///< ReadPacket() does not block, call it for each OpalMediaPatch::OnReadReady()
+    };
+
+    /**Enable reading of the source stream by the media patch scheduler.
+       When enabled, and the mode returned is not e_ScheduledReadBlocks, the
+       ReadPacket() function must not block. For e_ScheduledReadOnReady the
+       stream must also call OpalMediaPatch::OnReadReady() for every packet
+       that becomes available.
+
+       The default behaviour does nothing and returns e_ScheduledReadBlocks.
+      */
+    virtual ScheduledReadMode EnableScheduledRead(bool enab = true);
   //@}
 
   /**@name Member variable access */
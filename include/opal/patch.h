@@ -46,6 +46,58 @@
 #include <list>
 
 class OpalTranscoder;
+class OpalMediaPatch;
+
+
+/** Class for driving many media patches from a small, fixed, pool of media
+    worker threads rather than a thread for every patch.
+    Patches are serviced on packet time ticks, or when their source stream
+    indicates a packet is ready, depending on the source stream capabilities,
+    see OpalMediaStream::EnableScheduledRead().
+  */
+class OpalMediaPatchScheduler : public PObject
+{
+    PCLASSINFO(OpalMediaPatchScheduler, PObject);
+  public:
+    OpalMediaPatchScheduler(
+      unsigned threadCount = 0  ///< Number of worker threads, zero is one per processor core
+    );
+    ~OpalMediaPatchScheduler();
+
+    /**Add the media patch to the scheduler.
+       Returns false if it could not be added, the caller should then fall
+       back to a dedicated patch thread.
+      */
+    bool Add(
+      OpalMediaPatch & patch
+    );
+
+    /**Remove the media patch from the scheduler.
+       On return, the patch will not be serviced again.
+       Returns false if the patch was not in the scheduler.
+      */
+    bool Remove(
+      OpalMediaPatch & patch
+    );
+
+    /**Get the number of worker threads in the scheduler.
+      */
+    unsigned GetThreadCount() const { return m_workers.size(); }
+
+    /**Indicate the current thread is one of the scheduler worker threads.
+      */
+    bool IsWorkerThread() const;
+
+    class Worker;
+
+  protected:
+    std::vector<Worker *> m_workers;
+
+  private:
+    OpalMediaPatchScheduler(const OpalMediaPatchScheduler &) { }
+    void operator=(const OpalMediaPatchScheduler &) { }
+};
+
 
 /**Media stream "patch cord".
    This class is the thread of control that transfers data from one
@@ -234,6 +286,13 @@ class OpalMediaPatch : public PSafeObject
     virtual bool ResetTranscoders();
     bool EnableJitterBuffer(bool enab = true);
 
+    /**Indicate the source stream has a packet ready to be read.
+       This is called by a source stream for each received packet, when the
+       patch is driven by the OpalMediaPatchScheduler in
+       OpalMediaStream::e_ScheduledReadOnReady mode.
+      */
+    void OnReadReady();
+
 #if OPAL_STATISTICS
     virtual void GetStatistics(OpalMediaStatistics & statistics, bool fromSink) const;
 #endif
@@ -249,6 +308,13 @@ class OpalMediaPatch : public PSafeObject
     virtual void Main();
     void StopThread();
     bool DispatchFrame(RTP_DataFrame & frame);
+    void InternalPatchEnded();
+
+    bool CanSchedule();
+    /**Called from a scheduler worker thread, returns false if the patch has ended */
+    bool OnScheduledService(bool onTick, PTimeInterval & nextTick);
+    bool InternalScheduledRead(bool onTick);
+    bool InternalEndScheduled();
 
     OpalMediaStream & m_source;
 
@@ -308,6 +374,18 @@ class OpalMediaPatch : public PSafeObject
     PThreadIdentifier m_patchThreadId;
 #endif
 
+    friend class OpalMediaPatchScheduler;
+    friend class OpalMediaPatchScheduler::Worker;
+    OpalMediaPatchScheduler          * m_scheduler;
+    OpalMediaPatchScheduler::Worker  * m_schedulerWorker;
+    enum { e_ScheduleIdle, e_ScheduleRunning, e_ScheduleEnded };
+    atomic<int>                        m_scheduledState;
+    OpalMediaStream::ScheduledReadMode m_scheduledReadMode;
+    PTimeInterval                      m_scheduledPeriod;
+    RTP_DataFrame                      m_scheduledFrame;
+    unsigned                           m_readReadyCount;  // Protected by worker mutex
+    bool                               m_readReadyQueued; // Protected by worker mutex
+
 
     bool m_transcoderChanged;
 
@@ -0,0 +1,208 @@
+/*
+ * timerwheel.h
+ *
+ * Hierarchical timer wheel
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (c) 2016 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#ifndef OPAL_OPAL_TIMERWHEEL_H
+#define OPAL_OPAL_TIMERWHEEL_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal_config.h>
+
+#include <ptlib/notifier.h>
+
+
+class OpalWheelTimer;
+
+
+/**Hierarchical timer wheel.
+   This is an alternative to PTimer for the large numbers of short lived or
+   frequently re-armed timers, e.g. RTCP reports and SIP transaction
+   retries, that are present at high call densities. Starting and stopping
+   a timer is O(1), and expiry is driven by one tick thread per processor
+   core, each with its own wheel.
+
+   Timers fire on the tick thread, so the notifier should not block for
+   long. If the work is lengthy, queue it to a thread pool.
+  */
+class OpalTimerWheel : public PObject
+{
+    PCLASSINFO(OpalTimerWheel, PObject);
+  public:
+    OpalTimerWheel(
+      unsigned threadCount = 0,  ///< Number of tick threads, zero is one per processor core
+      unsigned resolution = 10   ///< Time for one tick of the wheel in milliseconds
+    );
+    ~OpalTimerWheel();
+
+    /**Get the number of tick threads.
+      */
+    unsigned GetThreadCount() const { return m_shards.size(); }
+
+    /**Get the tick resolution in milliseconds.
+      */
+    unsigned GetResolution() const { return m_resolution; }
+
+    /// Histogram of the lag between when timers were due, and when they fired.
+    struct LagHistogram : public PObject
+    {
+      PCLASSINFO(LagHistogram, PObject);
+      public:
+        enum { NumBuckets = 8 };
+        static const unsigned BucketLimits[NumBuckets-1]; ///< Upper bound, in milliseconds, of all but the last bucket
+
+        LagHistogram();
+        void Merge(const LagHistogram & other);
+        void Add(unsigned lag);
+        virtual void PrintOn(ostream & strm) const;
+
+        uint64_t m_buckets[NumBuckets];
+        uint64_t m_total;
+        unsigned m_maximum;
+    };
+
+    /**Get the scheduling lag histogram across all tick threads.
+      */
+    void GetLagHistogram(
+      LagHistogram & histogram
+    ) const;
+
+    struct Link
+    {
+      Link() : m_prev(this), m_next(this) { }
+      bool IsLinked() const { return m_next != this; }
+      void Unlink() { m_prev->m_next = m_next; m_next->m_prev = m_prev; m_prev = m_next = this; }
+      void InsertBefore(Link & other) { m_prev = other.m_prev; m_next = &other; other.m_prev->m_next = this; other.m_prev = this; }
+
+      Link * m_prev;
+      Link * m_next;
+    };
+
+    class Shard;
+
+  protected:
+    friend class OpalWheelTimer;
+    Shard & SelectShard();
+
+    unsigned              m_resolution;
+    std::vector<Shard *>  m_shards;
+    atomic<unsigned>      m_nextShard;
+
+  private:
+    OpalTimerWheel(const OpalTimerWheel &) { }
+    void operator=(const OpalTimerWheel &) { }
+};
+
+
+/**Timer driven by an OpalTimerWheel.
+   This has a similar interface to PTimer, the notifier is called with this
+   object as the first argument.
+  */
+class OpalWheelTimer : public PObject, protected OpalTimerWheel::Link
+{
+    PCLASSINFO(OpalWheelTimer, PObject);
+  public:
+    OpalWheelTimer(
+      OpalTimerWheel & wheel,
+      const PNotifier & notifier = PNotifier()
+    );
+    ~OpalWheelTimer();
+
+    virtual void PrintOn(ostream & strm) const;
+
+    /**Set the notifier called when the timer expires.
+      */
+    void SetNotifier(const PNotifier & notifier);
+
+    /**Start a one shot timer.
+       A zero interval stops the timer.
+      */
+    void SetInterval(
+      const PTimeInterval & interval
+    );
+    void SetInterval(
+      PInt64 milliseconds,
+      long seconds = 0,
+      long minutes = 0,
+      long hours = 0,
+      int days = 0
+    ) { SetInterval(PTimeInterval(milliseconds, seconds, minutes, hours, days)); }
+
+    OpalWheelTimer & operator=(const PTimeInterval & interval) { SetInterval(interval); return *this; }
+
+    /**Start a timer that repeats every \p interval.
+      */
+    void RunContinuous(
+      const PTimeInterval & interval
+    );
+
+    /**Stop the timer.
+       If \p wait is true, and the notifier is executing in another thread,
+       then this waits for it to complete.
+      */
+    void Stop(
+      bool wait = true
+    );
+
+    /**Indicate the timer is running.
+      */
+    bool IsRunning() const;
+
+    /**Get the interval the timer was last started with.
+      */
+    const PTimeInterval & GetResetTime() const { return m_resetTime; }
+
+  protected:
+    /**Called on the tick thread when the timer expires.
+       The default behaviour calls the notifier.
+      */
+    virtual void OnTimeout();
+
+    friend class OpalTimerWheel::Shard;
+
+    OpalTimerWheel        & m_wheel;
+    OpalTimerWheel::Shard * m_shard;
+    PNotifier               m_notifier;
+    PTimeInterval           m_resetTime;
+    bool                    m_continuous;
+    PInt64                  m_dueTick;
+    unsigned                m_generation;
+
+  private:
+    OpalWheelTimer(const OpalWheelTimer & other) : PObject(other), OpalTimerWheel::Link(), m_wheel(other.m_wheel) { }
+    void operator=(const OpalWheelTimer &) { }
+};
+
+
+#endif // OPAL_OPAL_TIMERWHEEL_H
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -228,6 +228,65 @@ class OpalTranscoder : public OpalMediaFormatPair
       unsigned instanceLen = 0            ///<  Length of instance identifier
     );
 
+    /**Acquire an instance of a media conversion function from the pool.
+       Instances previously returned with Release() are kept, keyed by the
+       two format names and a hash of their options, so a warm instance
+       that was configured the same way is re-used in preference to calling
+       Create() and paying the codec initialisation again.
+
+       The transcoder should be given back with Release() and not deleted.
+
+       Returns NULL if there is no registered media transcoder between the two
+       named formats.
+      */
+    static OpalTranscoder * Acquire(
+      const OpalMediaFormat & srcFormat,  ///<  Name of source format
+      const OpalMediaFormat & dstFormat,  ///<  Name of destination format
+      const BYTE * instance = NULL,       ///<  Unique instance identifier for transcoder
+      unsigned instanceLen = 0            ///<  Length of instance identifier
+    );
+
+    /**Give back a transcoder obtained via Acquire().
+       If the transcoder can be Reset(), and the pool is not full, it is kept
+       for re-use, otherwise it is deleted. A NULL pointer is ignored.
+      */
+    static void Release(
+      OpalTranscoder * transcoder         ///<  Transcoder to return
+    );
+
+    struct PoolStatistics
+    {
+      PoolStatistics();
+
+      uint64_t m_hits;      ///< Acquire() calls satisfied from the pool
+      uint64_t m_misses;    ///< Acquire() calls that had to Create()
+      uint64_t m_returned;  ///< Release() calls that kept the instance
+      uint64_t m_discarded; ///< Release() calls that deleted the instance
+      unsigned m_pooled;    ///< Instances currently held in the pool
+      unsigned m_maxPerKey; ///< Current limit for each format pair/options
+      unsigned m_maxTotal;  ///< Current limit for the whole pool
+
+      friend ostream & operator<<(ostream & strm, const PoolStatistics & stats);
+    };
+
+    /**Get the statistics for the transcoder pool, so it may be sized.
+      */
+    static void GetPoolStatistics(
+      PoolStatistics & statistics
+    );
+
+    /**Set the limits on the transcoder pool. A limit of zero disables pooling.
+       Default is 4 instances for each format pair/options and 64 in total.
+      */
+    static void SetPoolLimits(
+      unsigned maxPerKey,
+      unsigned maxTotal
+    );
+
+    /**Delete all transcoders held in the pool.
+      */
+    static void ClearPool();
+
     /**Find media format(s) for transcoders.
        This function attempts to find and intermediate media format that will
        allow two transcoders to be used to get data from the source format to
@@ -340,6 +399,13 @@ class OpalTranscoder : public OpalMediaFormatPair
     virtual bool AcceptEmptyPayload() const  { return acceptEmptyPayload; }
     virtual bool AcceptOtherPayloads() const { return acceptOtherPayloads; }
 
+    /**Reset the transcoder to the state it was in just after construction,
+       so it may be re-used by Acquire() for a new stream.
+
+       The default behaviour returns false, indicating it cannot be reset.
+      */
+    virtual bool Reset();
+
 #if OPAL_STATISTICS
     virtual void GetStatistics(OpalMediaStatistics & statistics) const;
 #endif
@@ -361,6 +427,8 @@ class OpalTranscoder : public OpalMediaFormatPair
 
     RTP_DataFrame::PayloadTypes m_lastPayloadType;
     unsigned                    m_consecutivePayloadTypeMismatches;
+
+    PString m_poolKey;
 };
 
 
@@ -506,6 +574,24 @@ class OpalStreamedTranscoder : public OpalTranscoder
        Returns converted value.
       */
     virtual int ConvertOne(int sample) const = 0;
+
+    /**Convert a block of samples from one format to another.
+       This is called by Convert() for the whole payload, before falling back
+       to calling ConvertOne() on every sample. A descendant may override it
+       to use lookup tables or operations the compiler can vectorise.
+
+       Returns false if block conversion is not supported, the default.
+      */
+    virtual bool ConvertBlock(
+      const BYTE * input,   ///<  Input samples
+      BYTE * output,        ///<  Output samples
+      PINDEX samples        ///<  Number of samples to convert
+    ) const;
+
+    /**Reset the transcoder to the state it was in just after construction.
+       Streamed transcoders are stateless, so this returns true.
+      */
+    virtual bool Reset();
   //@}
 
   protected:
@@ -520,6 +606,7 @@ class Opal_Linear16Mono_PCM : public OpalStreamedTranscoder {
   public:
     Opal_Linear16Mono_PCM();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const;
 };
 
 
@@ -529,6 +616,7 @@ class Opal_PCM_Linear16Mono : public OpalStreamedTranscoder {
   public:
     Opal_PCM_Linear16Mono();
     virtual int ConvertOne(int sample) const;
+    virtual bool ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const;
 };
 
 
@@ -93,6 +93,7 @@ class OpalDTLSMediaTransport : public OpalDTLSMediaTransportParent
     };
 
   protected:
+    virtual bool InternalCanUseReactor(SubChannels subchannel) const;
     virtual void InternalOnStart(SubChannels subchannel);
     virtual DTLSChannel * CreateDTLSChannel();
     PDECLARE_SSLVerifyNotifier(OpalDTLSMediaTransport, OnVerify);
@@ -327,8 +327,50 @@ class OpalAudioJitterBuffer : public OpalJitterBuffer
       e_SynchronisationDone
     } m_synchronisationState;
 
-    typedef std::map<RTP_Timestamp, RTP_DataFrame> FrameMap;
-    FrameMap   m_frames;
+    /**Circular buffer of frames, indexed by sequence number modulo the
+       capacity. All slots are allocated up front, so inserting, finding the
+       oldest and removing a frame are O(1) with no per-packet allocation.
+      */
+    class FrameRing
+    {
+      public:
+        enum { Capacity = 256 }; // Must be power of two
+
+        FrameRing();
+
+        enum InsertResult {
+          e_Inserted,
+          e_Duplicate,
+          e_TooOld,   ///< More than Capacity packets behind newest
+          e_TooNew    ///< More than Capacity packets ahead of oldest
+        };
+        InsertResult Insert(const RTP_DataFrame & frame);
+
+        bool IsEmpty() const { return m_count == 0; }
+        PINDEX GetSize() const { return m_count; }
+
+        /// Timestamp of oldest frame, must not be empty
+        RTP_Timestamp GetOldestTimestamp() const { return m_slots[m_oldest & (Capacity-1)].m_timestamp; }
+
+        /// Remove oldest frame, must not be empty
+        void RemoveOldest(RTP_DataFrame * frame = NULL);
+
+        void RemoveAll();
+
+      protected:
+        struct Slot {
+          Slot() : m_timestamp(0), m_used(false) { }
+          RTP_DataFrame m_frame;
+          RTP_Timestamp m_timestamp;
+          bool          m_used;
+        };
+        std::vector<Slot>  m_slots;
+        RTP_DataFrame      m_emptyFrame; // Shared by unused slots, releasing packet buffer
+        RTP_SequenceNumber m_oldest;
+        RTP_SequenceNumber m_newest;
+        PINDEX             m_count;
+    };
+    FrameRing  m_frames;
     PDECLARE_MUTEX(m_bufferMutex);
     PSemaphore m_frameCount;
 
@@ -112,6 +112,14 @@ class RTP_ControlFrame : public PBYTEArray
     PayloadTypes GetPayloadType() const { return (PayloadTypes)(BYTE)theArray[m_compoundOffset+1]; }
     void         SetPayloadType(PayloadTypes pt);
 
+    /**Determine if the raw packet is RTCP, as per RFC5761 demultiplexing,
+       without needing to construct a frame object.
+      */
+    static bool IsControlPacket(const BYTE * data, PINDEX size)
+    {
+      return size > 1 && data[1] >= e_FirstValidPayloadType && data[1] <= e_LastValidPayloadType;
+    }
+
     PINDEX GetPayloadSize() const { return 4*(*(PUInt16b *)&theArray[m_compoundOffset+2]); }
     bool   SetPayloadSize(PINDEX sz);
 
@@ -505,6 +513,19 @@ class RTP_DataFrame : public PBYTEArray
     RTP_DataFrame(PINDEX payloadSize = 0, PINDEX bufferSize = 0);
     RTP_DataFrame(const BYTE * data, PINDEX len, bool dynamic = true);
 
+    /**Construct a frame referencing the memory of received data.
+       No allocation or copy is made, the frame shares the buffer of \p data
+       so it may be passed on (e.g. to a jitter buffer) without reallocation.
+       Note SetPacketSize() is not called, the header is not yet parsed.
+      */
+    explicit RTP_DataFrame(const PBYTEArray & data);
+
+    /**Destroy the frame.
+       If this is the last reference to the buffer, it is returned to the
+       RTP_DataFramePool for re-use.
+      */
+    ~RTP_DataFrame();
+
     enum {
       ProtocolVersion = 2,
       MinHeaderSize = 12,
@@ -703,6 +724,58 @@ class RTP_DataFrame : public PBYTEArray
 PLIST(RTP_DataFrameList, RTP_DataFrame);
 
 
+/**Pool of buffers for RTP_DataFrame.
+   Buffers are kept in a small number of size classes, and are returned
+   to the pool when the last RTP_DataFrame referencing them is destroyed.
+   The free lists are sharded by thread identifier, so media threads rarely
+   contend with each other, and the lock for a shard is only held for the
+   push or pop of a single buffer.
+  */
+class RTP_DataFramePool
+{
+  public:
+    enum {
+      NumSizeClasses = 7,
+      MinClassSize = 256,   // Classes are 256, 512, ... 16384 bytes
+      NumShards = 16,
+      MaxFreePerClass = 64  // Per shard
+    };
+
+    /**Get a buffer of exactly \p size bytes, all zero.
+       Returns false if \p size is too big for the pool, or the pool has been
+       destroyed, in which case \p buffer is not changed.
+      */
+    static bool Allocate(PBYTEArray & buffer, PINDEX size);
+
+    /**Return a buffer to the pool.
+       The buffer is filed under the smallest size class that holds it, and
+       is only taken if the caller holds the only reference to it.
+      */
+    static void Release(PBYTEArray & buffer);
+
+    /// Get total pool hits and misses, across all threads.
+    static void GetStatistics(uint64_t & hits, uint64_t & misses);
+
+  protected:
+    RTP_DataFramePool();
+    ~RTP_DataFramePool();
+
+    static RTP_DataFramePool * GetInstance();
+    static int GetSizeClass(PINDEX size);
+
+    struct Shard {
+      Shard() : m_hits(0), m_misses(0) { }
+      PCriticalSection        m_mutex;
+      std::vector<PBYTEArray> m_free[NumSizeClasses];
+      uint64_t                m_hits;
+      uint64_t                m_misses;
+    };
+    Shard & GetShard();
+
+    Shard m_shards[NumShards];
+};
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 /** Information for RFC 5285 header extensions.
@@ -44,6 +44,7 @@
 #include <rtp/jitter.h>
 #include <opal/mediasession.h>
 #include <opal/mediafmt.h>
+#include <opal/timerwheel.h>
 #include <ptlib/sockets.h>
 #include <ptlib/safecoll.h>
 #include <ptlib/notifier_ext.h>
@@ -288,6 +289,18 @@ class OpalRTPSession : public OpalMediaSession
     };
     struct FecData
     {
+      FecData()
+        : m_timestamp(0)
+        , m_pRecovery(false)
+        , m_xRecovery(false)
+        , m_ccRecovery(0)
+        , m_mRecovery(false)
+        , m_ptRecovery(0)
+        , m_snBase(0)
+        , m_tsRecovery(0)
+        , m_lenRecovery(0)
+      { }
+
       RTP_Timestamp    m_timestamp;
       bool             m_pRecovery;
       bool             m_xRecovery;
@@ -315,8 +328,17 @@ class OpalRTPSession : public OpalMediaSession
     /// Get the RFC 5109 transmit level (number of packets that can be lost)
     unsigned GetUlpFecSendLevel() const { return m_ulpFecSendLevel; }
 
-    /// Set the RFC 2198 redundent data payload type
+    /**Set the RFC 5109 transmit level (number of packets that can be lost).
+       This many XOR parity blocks are generated for each group, interleaved
+       so a burst of up to \p level consecutive lost packets can be recovered.
+      */
     void SetUlpFecSendLevel(unsigned level) { m_ulpFecSendLevel = level; }
+
+    /// Get the RFC 5109 group size (number of media packets protected together)
+    unsigned GetUlpFecGroupSize() const { return m_ulpFecGroupSize; }
+
+    /// Set the RFC 5109 group size (number of media packets protected together)
+    void SetUlpFecGroupSize(unsigned size) { m_ulpFecGroupSize = size; }
 #endif // OPAL_RTP_FEC
 
     /**Get the canonical name for the RTP session.
@@ -622,6 +644,7 @@ class OpalRTPSession : public OpalMediaSession
     RTP_DataFrame::PayloadTypes m_redundencyPayloadType;
     RTP_DataFrame::PayloadTypes m_ulpFecPayloadType;
     unsigned                    m_ulpFecSendLevel;
+    unsigned                    m_ulpFecGroupSize;
 #endif // OPAL_RTP_FEC
 
     class NotifierMap : public std::multimap<unsigned, DataNotifier>
@@ -655,7 +678,11 @@ class OpalRTPSession : public OpalMediaSession
       virtual SendReceiveStatus OnReceiveRedundantData(RTP_DataFrame & primary, RTP_DataFrame::PayloadTypes payloadType, unsigned timestamp, const BYTE * data, PINDEX size);
       virtual SendReceiveStatus OnSendFEC(RTP_DataFrame & primary, FecData & fec);
       virtual SendReceiveStatus OnReceiveFEC(RTP_DataFrame & primary, const FecData & fec);
+      virtual SendReceiveStatus OnRecoveredFEC(RTP_DataFrame & frame);
+      virtual void AddFecHistory(const RTP_DataFrame & frame);
+      const RTP_DataFrame * FindFecHistory(RTP_SequenceNumber sequenceNumber) const;
 #endif // OPAL_RTP_FEC
+      virtual SendReceiveStatus NotifyReceivedData(RTP_DataFrame & frame);
 
 
       void CalculateRTT(const PTime & reportTime, const PTimeInterval & reportDelay);
@@ -698,6 +725,18 @@ class OpalRTPSession : public OpalMediaSession
       PTimeInterval      m_lateOutOfOrderAdaptPeriod;
       RTP_DataFrameList  m_pendingPackets;
 
+#if OPAL_RTP_FEC
+      // For e_Sender, XOR accumulators for the group being built, and completed
+      // parity blocks waiting to be piggy-backed on the next media packets.
+      // For e_Receiver, recently received media packets used for recovery.
+      vector<FecData>    m_fecAccumulators;
+      unsigned           m_fecGroupCount;
+      RTP_SequenceNumber m_fecGroupBase;
+      std::list<FecData> m_fecPending;
+      RTP_DataFrameList  m_fecHistory;
+      unsigned           m_fecRecovered;
+#endif
+
       // Generating real time stamping in RTP packets
       // For e_Receive, times are from last received Sender Report, or Receiver Reference Time Report
       // For e_Sender, times are from RTP_DataFrame, or synthesized from local real time.
@@ -783,8 +822,8 @@ public:
     unsigned m_rtcpPacketsReceived;
     int      m_roundTripTime;
 
-    PTimer m_reportTimer;
-    PDECLARE_NOTIFIER(PTimer, OpalRTPSession, TimedSendReport);
+    OpalWheelTimer m_reportTimer;
+    PDECLARE_NOTIFIER(OpalWheelTimer, OpalRTPSession, TimedSendReport);
 
     PIPSocket::QoS m_qos;
     unsigned       m_packetOverhead;
@@ -141,6 +141,13 @@ class OpalRTPMediaStream : public OpalMediaStream
       */
     virtual PBoolean RequiresPatchThread() const;
 
+    /**Enable reading of the source stream by the media patch scheduler.
+       Reads from the jitter buffer are made non-blocking. If the jitter
+       buffer has a delay it is read every packet time, otherwise it is read
+       each time a packet is received.
+      */
+    virtual ScheduledReadMode EnableScheduledRead(bool enab = true);
+
     /**Set the patch thread that is using this stream.
       */
     virtual PBoolean SetPatch(
@@ -207,6 +214,7 @@ protected:
     OpalMediaStreamPtr  m_passThruStream;
     OpalJitterBuffer  * m_jitterBuffer;
     PTimeInterval       m_readTimeout;
+    bool                m_readReadyNotify;
 
 #if OPAL_VIDEO
     bool          m_forceIntraFrameFlag;
@@ -71,6 +71,8 @@ namespace OpalFEC
 #endif
 
   const PString & MediaTypeOption();
+  const PString & GroupSizeOption();       ///< ULP-FEC media packets per group
+  const PString & ProtectionLevelOption(); ///< ULP-FEC parity blocks per group
 };
 #endif // OPAL_RTP_FEC
 
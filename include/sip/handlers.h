@@ -68,6 +68,19 @@ class SIPHandlerBase : public PSafeObject
     std::pair<IndexMap::iterator, bool> m_byAuthIdAndRealm;
     std::pair<IndexMap::iterator, bool> m_byAorUserAndRealm;
 
+    typedef std::multimap<PString, PSafePtr<SIPHandler> > IndexMultiMap;
+    std::pair<IndexMultiMap::iterator, bool> m_byRealm;
+    std::pair<IndexMultiMap::iterator, bool> m_byDomain;
+
+    /* AOR as a numeric address for FindSIPHandlerByDomain(), only valid
+       while the timer runs, and reset whenever the handler (re)registers. */
+    PDECLARE_MUTEX(m_resolvedAORMutex);
+    OpalTransportAddress m_resolvedAOR;
+    PSimpleTimer         m_resolvedAORTimer;
+
+    void ResetResolvedAOR()
+      { PWaitAndSignal lock(m_resolvedAORMutex); m_resolvedAORTimer = PTimeInterval(); }
+
   friend class SIPHandlersList;
 };
 
@@ -421,9 +434,14 @@ class SIPHandlersList
     typedef SIPHandler::IndexMap IndexMap;
     PSafePtr<SIPHandler> FindBy(IndexMap & by, const PString & key, PSafetyMode m);
 
+    typedef SIPHandler::IndexMultiMap IndexMultiMap;
+    PSafePtr<SIPHandler> FindFirstBy(IndexMultiMap & by, const PString & key, PSafetyMode m, bool skipUnsubscribed);
+
     IndexMap m_byAorAndPackage;
     IndexMap m_byAuthIdAndRealm;
     IndexMap m_byAorUserAndRealm;
+    IndexMultiMap m_byRealm;  // Only handlers with credentials
+    IndexMultiMap m_byDomain;
 };
 
 
@@ -46,6 +46,7 @@
 #include <ptclib/pxml.h>
 #include <ptclib/threadpool.h>
 #include <opal/transports.h>
+#include <opal/timerwheel.h>
 #include <im/im.h>
 #include <rtp/rtpconn.h>
 
@@ -487,6 +488,24 @@ class SIPMIMEInfo : public PMIMEInfo
 
     /// Encode using compact form
     bool compactForm;
+
+    /* The Via list, split on first use. The raw string shares the
+       dictionary's buffer until the field is changed, so a differing
+       pointer means the split values are stale. */
+    class ViaCache {
+      public:
+        ViaCache() { }
+        ViaCache(const ViaCache &) { }
+        ViaCache & operator=(const ViaCache &) { return *this; }
+
+        PDECLARE_MUTEX(m_mutex);
+        PString     m_raw;
+        PString     m_first;
+        PStringList m_list;
+    };
+    mutable ViaCache m_viaCache;
+
+    void InternalUpdateViaCache() const;
 };
 
 
@@ -679,10 +698,30 @@ class SIP_PDU : public PSafeObject
       bool truncated
     );
 
+    /**Parse PDU directly from a received datagram.
+       This is equivalent to the istream version, but scans the buffer in
+       place rather than copying it to a stream and reading line by line.
+      */
+    StatusCodes Parse(
+      const char * data,  ///< Datagram contents
+      PINDEX length,      ///< Length of datagram
+      bool truncated      ///< Datagram was truncated by transport
+    );
+
     /**Write the PDU to the transport.
       */
     virtual bool Send();
 
+    /**Write the PDU to the transport exactly as it was last sent.
+       This is only for retransmissions of the same PDU, the wire format built
+       by the last Send() is reused without being rebuilt from the headers and
+       body. Every new PDU, including each new request within a dialog, is
+       still built in full by Send(). If the PDU has not been sent yet, this
+       is the same as Send(). Do not use if the PDU has been altered since it
+       was last sent.
+      */
+    bool Resend();
+
     /**Write PDU as a response to a request.
     */
     bool SendResponse(
@@ -723,6 +762,14 @@ class SIP_PDU : public PSafeObject
   protected:
     void CalculateVia();
     StatusCodes InternalSend(bool canDoTCP);
+    StatusCodes InternalResend();
+    StatusCodes InternalParseStartLine(const PString & cmd);
+    bool InternalGetContentLength(int & contentLength) const;
+    StatusCodes InternalParseComplete(const PString & cmd, bool truncated, int contentLength);
+    void InternalAddHeader(const PCaselessString * canonical,
+                           const char * nameStart, const char * nameEnd,
+                           const char * valueStart, const char * valueEnd,
+                           const PString * folded);
 
     Methods     m_method;                 // Request type, ==NumMethods for Response
     StatusCodes m_statusCode;
@@ -733,6 +780,7 @@ class SIP_PDU : public PSafeObject
     SIPMIMEInfo m_mime;
     PString     m_entityBody;
     PString     m_transactionID;
+    PString     m_wireBuffer;             // As last sent, for retransmissions
 
     SDPSessionDescription * m_SDP;
 
@@ -954,6 +1002,45 @@ class SIPPoolTimer : public PPoolTimerArg3<SIPTimeoutWorkItem<Target_T>,
 };
 
 
+/**Timer on the managers OpalTimerWheel that queues a SIPTimeoutWorkItem to
+   the SIP thread pool on expiry. This is used for high volume timers, e.g.
+   transaction retries, as starting and stopping is much cheaper than
+   SIPPoolTimer.
+  */
+template <class Target_T>
+class SIPWheelTimer : public OpalWheelTimer
+{
+    typedef SIPTimeoutWorkItem<Target_T> Work_T;
+    PCLASSINFO(SIPWheelTimer, OpalWheelTimer);
+  public:
+    typedef void (Target_T::* Callback)();
+
+    SIPWheelTimer(OpalTimerWheel & wheel, SIPThreadPool & pool, SIPEndPoint & ep, const PString & token, Callback callback)
+      : OpalWheelTimer(wheel)
+      , m_pool(pool)
+      , m_endpoint(ep)
+      , m_token(token)
+      , m_callback(callback)
+    {
+    }
+
+    ~SIPWheelTimer() { Stop(); }
+
+    SIPWheelTimer & operator=(const PTimeInterval & interval) { SetInterval(interval); return *this; }
+
+  protected:
+    virtual void OnTimeout()
+    {
+      m_pool.AddWork(new Work_T(m_endpoint, m_token, m_callback), m_token);
+    }
+
+    SIPThreadPool & m_pool;
+    SIPEndPoint   & m_endpoint;
+    PString         m_token;
+    Callback        m_callback;
+};
+
+
 /////////////////////////////////////////////////////////////////////////
 // SIPTransaction
 
@@ -1089,7 +1176,7 @@ class SIPTransaction : public SIPTransactionBase
     bool ResendCANCEL();
     void SetParameters(const SIPParameters & params);
 
-    typedef SIPPoolTimer<SIPTransaction> PoolTimer;
+    typedef SIPWheelTimer<SIPTransaction> PoolTimer;
 
     void OnRetry();
     void OnTimeout();
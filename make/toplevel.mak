@@ -133,6 +133,7 @@ SOURCES += $(OPAL_SRCDIR)/opal/manager.cxx \
            $(OPAL_SRCDIR)/opal/patch.cxx \
            $(OPAL_SRCDIR)/opal/transcoders.cxx \
            $(OPAL_SRCDIR)/opal/transports.cxx \
+           $(OPAL_SRCDIR)/opal/timerwheel.cxx \
            $(OPAL_SRCDIR)/opal/guid.cxx \
            $(OPAL_SRCDIR)/rtp/rtp.cxx \
            $(OPAL_SRCDIR)/rtp/rtp_session.cxx \
@@ -426,6 +427,7 @@ SOURCES += $(OPAL_SRCDIR)/codec/g711codec.cxx \
            $(OPAL_SRCDIR)/codec/rfc2833.cxx \
            $(OPAL_SRCDIR)/codec/opalwavfile.cxx \
            $(OPAL_SRCDIR)/codec/silencedetect.cxx \
+           $(OPAL_SRCDIR)/codec/audiodsp.cxx \
            $(OPAL_SRCDIR)/codec/opalpluginmgr.cxx \
            $(OPAL_SRCDIR)/codec/ratectl.cxx 
 
@@ -66,18 +66,54 @@
 #pragma warning(disable:4100)
 #endif
 
-static void * create_codec(const struct PluginCodec_Definition * codec)
+/* The context is a pointer to the gsm handle, rather than the handle itself,
+   so reset_codec can replace the handle without OPAL seeing a new context. */
+
+static gsm create_state(const struct PluginCodec_Definition * codec)
 {
   int opt = codec->userData != 0;
-  struct gsm_state * context = gsm_create();
-  gsm_option(context, GSM_OPT_WAV49, &opt);
+  gsm state = gsm_create();
+  if (state != NULL)
+    gsm_option(state, GSM_OPT_WAV49, &opt);
+  return state;
+}
+
+static void * create_codec(const struct PluginCodec_Definition * codec)
+{
+  gsm * context = (gsm *)malloc(sizeof(gsm));
+  if (context == NULL)
+    return NULL;
+
+  if ((*context = create_state(codec)) == NULL) {
+    free(context);
+    return NULL;
+  }
+
   return context;
 }
 
 static void destroy_codec(const struct PluginCodec_Definition * codec, void * _context)
 {
-  struct gsm_state * context = (struct gsm_state *)_context;
-  gsm_destroy(context);
+  gsm * context = (gsm *)_context;
+  gsm_destroy(*context);
+  free(context);
+}
+
+static int reset_codec(const struct PluginCodec_Definition * codec,
+                                                      void * _context,
+                                                const char * key,
+                                                      void * parm,
+                                                  unsigned * parmLen)
+{
+  gsm * context = (gsm *)_context;
+  gsm state;
+
+  if (context == NULL || (state = create_state(codec)) == NULL)
+    return 0;
+
+  gsm_destroy(*context);
+  *context = state;
+  return 1;
 }
 
 static int codec_encoder(const struct PluginCodec_Definition * codec, 
@@ -88,7 +124,7 @@ static int codec_encoder(const struct PluginCodec_Definition * codec,
                                        unsigned * toLen,
                                    unsigned int * flag)
 {
-  struct gsm_state * context = (struct gsm_state *)_context;
+  gsm context = *(gsm *)_context;
   int frames;
 
   if (*toLen < BYTES_PER_FRAME)
@@ -122,7 +158,7 @@ static int codec_decoder(const struct PluginCodec_Definition * codec,
                                        unsigned * toLen,
                                    unsigned int * flag)
 {
-  gsm context = (gsm)_context;
+  gsm context = *(gsm *)_context;
 
   if (*fromLen < BYTES_PER_FRAME)
     return 0;
@@ -183,7 +219,7 @@ static int codec_msgsm_encoder(const struct PluginCodec_Definition * codec,
                                        unsigned * toLen,
                                    unsigned int * flag)
 {
-  struct gsm_state * context = (struct gsm_state *)_context;
+  gsm context = *(gsm *)_context;
 
   if (*fromLen < (MSGSM_SAMPLES_PER_FRAME*2) || *toLen < MSGSM_BYTES_PER_FRAME) 
     return 0;
@@ -204,7 +240,7 @@ static int codec_msgsm_decoder(const struct PluginCodec_Definition * codec,
                                        unsigned * toLen,
                                    unsigned int * flag)
 {
-  struct gsm_state * context = (struct gsm_state *)_context;
+  gsm context = *(gsm *)_context;
   if (*fromLen < MSGSM_BYTES_PER_FRAME || *toLen < (MSGSM_SAMPLES_PER_FRAME*2)) 
     return 0;
 
@@ -340,10 +376,47 @@ static int valid_for_h323(
           STRCMPI((const char *)parm, "h323") == 0) ? 1 : 0;
 }
 
+/* Frames are always a fixed size, so OPAL may convert several in one call */
+static int codec_batch(const struct PluginCodec_Definition * codec,
+                             struct PluginCodec_BatchFrame * frames,
+                                                  unsigned   count)
+{
+  unsigned i;
+  for (i = 0; i < count; ++i) {
+    if (!codec->codecFunction(codec, frames[i].context,
+                              frames[i].from, &frames[i].fromLen,
+                              frames[i].to, &frames[i].toLen, &frames[i].flags))
+      return i > 0 ? (int)i : -1;
+  }
+  return (int)count;
+}
+
+
+static int get_batch_function(const struct PluginCodec_Definition * codec,
+                                                             void * context,
+                                                       const char * name,
+                                                             void * parm,
+                                                         unsigned * parmLen)
+{
+  if (parm == NULL || parmLen == NULL || *parmLen != sizeof(PluginCodec_BatchFunction))
+    return 0;
+
+  *(PluginCodec_BatchFunction *)parm = codec_batch;
+  return 1;
+}
+
+static struct PluginCodec_ControlDefn coderControls[] = {
+  { PLUGINCODEC_CONTROL_RESET_CODEC, reset_codec },
+  { PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION, get_batch_function },
+  { NULL }
+};
+
 static struct PluginCodec_ControlDefn h323CoderControls[] = {
   { "valid_for_protocol",       valid_for_h323 },
   //{ "get_codec_options",      coder_get_sip_options },
   //{ "set_codec_options",      encoder_set_options },
+  { PLUGINCODEC_CONTROL_RESET_CODEC, reset_codec },
+  { PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION, get_batch_function },
   { NULL }
 };
 
@@ -383,7 +456,7 @@ static struct PluginCodec_Definition gsmCodecDefn[4] =
     create_codec,                       // create codec function
     destroy_codec,                      // destroy codec
     codec_encoder,                      // encode/decode
-    NULL,                               // codec controls
+    coderControls,                      // codec controls
 
     PluginCodec_H323AudioCodec_gsmFullRate,  // h323CapabilityType 
     &gsmCaps                             // h323CapabilityData
@@ -420,7 +493,7 @@ static struct PluginCodec_Definition gsmCodecDefn[4] =
     create_codec,                       // create codec function
     destroy_codec,                      // destroy codec
     codec_decoder,                      // encode/decode
-    NULL,                               // codec controls
+    coderControls,                      // codec controls
 
     PluginCodec_H323AudioCodec_gsmFullRate,  // h323CapabilityType 
     &gsmCaps                             // h323CapabilityData
@@ -300,6 +300,13 @@ class OpusPluginEncoder : public OpusPluginCodec
     }
 
 
+    virtual bool Reset()
+    {
+      // Keeps the options set via opus_encoder_ctl()
+      return m_encoder != NULL && opus_encoder_ctl(m_encoder, OPUS_RESET_STATE) == OPUS_OK;
+    }
+
+
     virtual bool SetOption(const char * optionName, const char * optionValue)
     {
       if (strcasecmp(optionName, DynamicPacketLoss.m_name) == 0) {
@@ -389,6 +396,12 @@ class OpusPluginDecoder : public OpusPluginCodec
     }
 
 
+    virtual bool Reset()
+    {
+      return m_decoder != NULL && opus_decoder_ctl(m_decoder, OPUS_RESET_STATE) == OPUS_OK;
+    }
+
+
     virtual bool Transcode(const void * fromPtr,
                              unsigned & fromLen,
                                  void * toPtr,
@@ -208,6 +208,18 @@ class MyEncoder : public PluginCodec<MY_CODEC>
     }
 
 
+    virtual bool Reset()
+    {
+      // Init overwrites the control structure, but we want to keep the options
+      SKP_SILK_SDK_EncControlStruct control = m_control;
+      if (m_state == NULL || SKP_Silk_SDK_InitEncoder(m_state, &m_control) != 0)
+        return false;
+
+      m_control = control;
+      return true;
+    }
+
+
     virtual bool SetOption(const char * optionName, const char * optionValue)
     {
       if (strcasecmp(optionName, UseInBandFEC.m_name) == 0)
@@ -275,6 +287,7 @@ class MyDecoder : public PluginCodec<MY_CODEC>
   public:
     MyDecoder(const PluginCodec_Definition * defn)
       : PluginCodec<MY_CODEC>(defn)
+      , m_state(NULL)
     {
     }
 
@@ -300,6 +313,12 @@ class MyDecoder : public PluginCodec<MY_CODEC>
     }
 
 
+    virtual bool Reset()
+    {
+      return m_state != NULL && SKP_Silk_SDK_InitDecoder(m_state) == 0;
+    }
+
+
     virtual bool Transcode(const void * fromPtr,
                              unsigned & fromLen,
                                  void * toPtr,
@@ -60,7 +60,7 @@ static int decoderInUse = 0;
 #define MICROSECONDSPERFRAME 10000
 #define BITS_PER_SECOND      8000
 
-#define MY_VERSION PLUGIN_CODEC_VERSION_OPTIONS
+#define MY_VERSION PLUGIN_CODEC_VERSION_BATCH
 
 static struct PluginCodec_information licenseInfo = {
   1073619586,                              // timestamp = Fri 09 Jan 2004 03:39:46 AM UTC = 
@@ -295,6 +295,63 @@ static int get_codec_options(const struct PluginCodec_Definition * defn,
 }
 
 
+static int reset_codec(const struct PluginCodec_Definition * defn,
+                                                      void * context,
+                                                const char * name,
+                                                      void * parm,
+                                                  unsigned * parmLen)
+{
+  int isDecoder = defn->destFormat == L16Desc;
+
+  if (context == NULL)
+    return 0;
+
+#ifdef _WIN32_WCE
+  return (isDecoder ? D_IF_g729ab_init(context) : E_IF_g729ab_init(context)) == 0;
+#else
+  if (isDecoder)
+    va_g729a_init_decoder();
+  else
+    va_g729a_init_encoder();
+  return 1;
+#endif
+}
+
+
+#if !SUPPORT_VAD
+/* Without VAD there are no SID frames, so all frames are the same size and
+   OPAL may convert several in one call */
+static int codec_batch(const struct PluginCodec_Definition * codec,
+                             struct PluginCodec_BatchFrame * frames,
+                                                  unsigned   count)
+{
+  unsigned i;
+  for (i = 0; i < count; ++i) {
+    if (!codec->codecFunction(codec, frames[i].context,
+                              frames[i].from, &frames[i].fromLen,
+                              frames[i].to, &frames[i].toLen, &frames[i].flags))
+      return i > 0 ? (int)i : -1;
+  }
+  return (int)count;
+}
+
+
+static int get_batch_function(const struct PluginCodec_Definition * codec,
+                                                             void * context,
+                                                       const char * name,
+                                                             void * parm,
+                                                         unsigned * parmLen)
+{
+  if (parm == NULL || parmLen == NULL || *parmLen != sizeof(PluginCodec_BatchFunction))
+    return 0;
+
+  *(PluginCodec_BatchFunction *)parm = codec_batch;
+  return 1;
+}
+
+#endif // !SUPPORT_VAD
+
+
 #if SUPPORT_VAD
 static int set_codec_options(const struct PluginCodec_Definition * defn,
                                                             void * context,
@@ -324,6 +381,10 @@ static struct PluginCodec_ControlDefn controlDefn[] = {
   { PLUGINCODEC_CONTROL_GET_CODEC_OPTIONS, get_codec_options },
 #if SUPPORT_VAD
   { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS, set_codec_options },
+#endif
+  { PLUGINCODEC_CONTROL_RESET_CODEC,       reset_codec },
+#if !SUPPORT_VAD
+  { PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION, get_batch_function },
 #endif
   { NULL }
 };
@@ -614,6 +675,6 @@ static struct PluginCodec_Definition CodecDefn[] =
 };
 
 
-PLUGIN_CODEC_IMPLEMENT_ALL(VoiceAgeG729, CodecDefn, MY_VERSION)
+PLUGIN_CODEC_IMPLEMENT_ALL(VoiceAgeG729, CodecDefn, PLUGIN_CODEC_VERSION_OPTIONS)
 
 /////////////////////////////////////////////////////////////////////////////
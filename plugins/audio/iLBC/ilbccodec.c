@@ -70,7 +70,8 @@
 static void * create_encoder(const struct PluginCodec_Definition * codec)
 {
   struct iLBC_Enc_Inst_t_ * context = (struct iLBC_Enc_Inst_t_ *)malloc((unsigned)sizeof(struct iLBC_Enc_Inst_t_));
-  initEncode(context, codec->bitsPerSec != BITRATE_30MS ? 20 : 30); 
+  if (context != NULL)
+    initEncode(context, codec->bitsPerSec != BITRATE_30MS ? 20 : 30); 
   return context;
 }
 
@@ -78,11 +79,30 @@ static void * create_encoder(const struct PluginCodec_Definition * codec)
 static void * create_decoder(const struct PluginCodec_Definition * codec)
 {
   struct iLBC_Dec_Inst_t_ * context = (struct iLBC_Dec_Inst_t_ *)malloc((unsigned)sizeof(struct iLBC_Dec_Inst_t_));
-  initDecode(context, codec->bitsPerSec != BITRATE_30MS ? 20 : 30, 0); 
+  if (context != NULL)
+    initDecode(context, codec->bitsPerSec != BITRATE_30MS ? 20 : 30, 0); 
   return context;
 }
 
 
+static int reset_codec(const struct PluginCodec_Definition * codec,
+                                                      void * context,
+                                                const char * name,
+                                                      void * parm,
+                                                  unsigned * parmLen)
+{
+  if (context == NULL)
+    return 0;
+
+  // Same as just created, options are set again before it is re-used
+  if (codec->destFormat[0] == 'L')
+    initDecode(context, codec->bitsPerSec != BITRATE_30MS ? 20 : 30, 0);
+  else
+    initEncode(context, codec->bitsPerSec != BITRATE_30MS ? 20 : 30);
+  return 1;
+}
+
+
 static void destroy_context(const struct PluginCodec_Definition * codec, void * context)
 {
   free(context);
@@ -387,9 +407,40 @@ static int free_codec_options(const struct PluginCodec_Definition * defn,
 }
 
 
+/* Frames are always a fixed size, so OPAL may convert several in one call */
+static int codec_batch(const struct PluginCodec_Definition * codec,
+                             struct PluginCodec_BatchFrame * frames,
+                                                  unsigned   count)
+{
+  unsigned i;
+  for (i = 0; i < count; ++i) {
+    if (!codec->codecFunction(codec, frames[i].context,
+                              frames[i].from, &frames[i].fromLen,
+                              frames[i].to, &frames[i].toLen, &frames[i].flags))
+      return i > 0 ? (int)i : -1;
+  }
+  return (int)count;
+}
+
+
+static int get_batch_function(const struct PluginCodec_Definition * codec,
+                                                             void * context,
+                                                       const char * name,
+                                                             void * parm,
+                                                         unsigned * parmLen)
+{
+  if (parm == NULL || parmLen == NULL || *parmLen != sizeof(PluginCodec_BatchFunction))
+    return 0;
+
+  *(PluginCodec_BatchFunction *)parm = codec_batch;
+  return 1;
+}
+
 static struct PluginCodec_ControlDefn h323CoderControls[] = {
   { PLUGINCODEC_CONTROL_VALID_FOR_PROTOCOL, valid_for_h323 },
   { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS,  set_codec_options },
+  { PLUGINCODEC_CONTROL_RESET_CODEC,        reset_codec },
+  { PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION, get_batch_function },
   { NULL }
 };
 
@@ -399,6 +450,8 @@ static struct PluginCodec_ControlDefn h323AndSIPCoderControls[] = {
   { PLUGINCODEC_CONTROL_SET_CODEC_OPTIONS,     set_codec_options },
   { PLUGINCODEC_CONTROL_GET_CODEC_OPTIONS,     get_codec_options },
   { PLUGINCODEC_CONTROL_GET_ACTIVE_OPTIONS,    get_active_options },
+  { PLUGINCODEC_CONTROL_RESET_CODEC,           reset_codec },
+  { PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION,    get_batch_function },
   { NULL }
 };
 
@@ -471,7 +524,7 @@ static struct PluginCodec_Definition iLBCCodecDefn[] =
 {
   { 
     // encoder for SIP and H.323 via H.245 Annex S
-    PLUGIN_CODEC_VERSION_OPTIONS,       // codec API version
+    PLUGIN_CODEC_VERSION_BATCH,         // codec API version
     &licenseInfo,                       // license information
 
     PluginCodec_MediaTypeAudio |        // audio codec
@@ -509,7 +562,7 @@ static struct PluginCodec_Definition iLBCCodecDefn[] =
 
   { 
     // decoder for SIP and H.323 via H.245 Annex S
-    PLUGIN_CODEC_VERSION_OPTIONS,       // codec API version
+    PLUGIN_CODEC_VERSION_BATCH,         // codec API version
     &licenseInfo,                       // license information
 
     PluginCodec_MediaTypeAudio |        // audio codec
@@ -547,7 +600,7 @@ static struct PluginCodec_Definition iLBCCodecDefn[] =
 
   { 
     // encoder for H.323 only using OpenH323 legacy capability at 13k3
-    PLUGIN_CODEC_VERSION_OPTIONS,       // codec API version
+    PLUGIN_CODEC_VERSION_BATCH,         // codec API version
     &licenseInfo,                       // license information
 
     PluginCodec_MediaTypeAudio |        // audio codec
@@ -585,7 +638,7 @@ static struct PluginCodec_Definition iLBCCodecDefn[] =
 
   { 
     // decoder for H.323 only using OpenH323 legacy capability at 13k3
-    PLUGIN_CODEC_VERSION_OPTIONS,       // codec API version
+    PLUGIN_CODEC_VERSION_BATCH,         // codec API version
     &licenseInfo,                       // license information
 
     PluginCodec_MediaTypeAudio |        // audio codec
@@ -623,7 +676,7 @@ static struct PluginCodec_Definition iLBCCodecDefn[] =
 
   { 
     // encoder for H.323 only using OpenH323 legacy capability at 15k2
-    PLUGIN_CODEC_VERSION_OPTIONS,       // codec API version
+    PLUGIN_CODEC_VERSION_BATCH,         // codec API version
     &licenseInfo,                       // license information
 
     PluginCodec_MediaTypeAudio |        // audio codec
@@ -661,7 +714,7 @@ static struct PluginCodec_Definition iLBCCodecDefn[] =
 
   { 
     // decoder for H.323 only using OpenH323 legacy capability at 15k2
-    PLUGIN_CODEC_VERSION_OPTIONS,       // codec API version
+    PLUGIN_CODEC_VERSION_BATCH,         // codec API version
     &licenseInfo,                       // license information
 
     PluginCodec_MediaTypeAudio |        // audio codec
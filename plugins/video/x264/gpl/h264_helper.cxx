@@ -119,10 +119,15 @@ void WritePipe(LPCVOID data, unsigned bytes)
 
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 int downLink;
 int upLink;
 
+int sharedFd = -1;
+unsigned char * shared;
+size_t sharedSize;
+
 void OpenPipe(const char * dl, const char * ul)
 {
   if ((downLink = open(dl, O_RDONLY)) < 0) {
@@ -160,6 +165,25 @@ void WritePipe(const void * data, unsigned bytes)
 }
 
 
+void MapShared(size_t size)
+{
+  if (size == sharedSize)
+    return;
+
+  if (shared != NULL)
+    munmap(shared, sharedSize);
+
+  void * mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, sharedFd, 0);
+  if (mem == MAP_FAILED) {
+    PTRACE(1, HelperTraceName, "Could not map " << size << " bytes of shared memory - " << strerror(errno));
+    exit(1);
+  }
+
+  shared = (unsigned char *)mem;
+  sharedSize = size;
+}
+
+
 #endif // WIN32
 
 
@@ -208,6 +232,11 @@ int main(int argc, char *argv[])
 
   OpenPipe(argv[1], argv[2]);
 
+#ifndef WIN32
+  if (argc > 3)
+    sharedFd = atoi(argv[3]);
+#endif
+
   PTRACE(5, HelperTraceName, "GPL executable ready");
 
   rtpSize = 1500;
@@ -287,6 +316,38 @@ int main(int argc, char *argv[])
           WritePipe(&ret, sizeof(ret));
         }
         break;
+#ifndef WIN32
+      case ENCODE_FRAMES_SHARED:
+          ReadPipe(&val, sizeof(val));
+          MapShared(val);
+          ReadPipe(&srcLen, sizeof(srcLen));
+          ReadPipe(&headerLen, sizeof(headerLen));
+          ResizeBuffer(0);
+          ReadPipe(buffer, headerLen);
+          ReadPipe(&flags, sizeof(flags));
+      case ENCODE_FRAMES_SHARED_BUFFERED:
+        {
+          // Encode all the packets for the frame that fit after the raw frame
+          unsigned count = 0;
+          size_t offset = H264_SHARED_ALIGN(srcLen);
+          while (offset + sizeof(H264SharedPacket) + rtpSize <= sharedSize) {
+            H264SharedPacket * packet = (H264SharedPacket *)(shared + offset);
+            unsigned char * data = (unsigned char *)(packet+1);
+            memcpy(data, buffer, headerLen);
+            unsigned dstLen = rtpSize;
+            packet->m_result = x264.EncodeFrames(shared, srcLen, data, dstLen, headerLen, flags);
+            packet->m_length = packet->m_result != 0 ? dstLen : 0;
+            packet->m_flags = flags;
+            offset += H264_SHARED_ALIGN(sizeof(H264SharedPacket) + packet->m_length);
+            ++count;
+            if (packet->m_result == 0 || (flags & 1) != 0)
+              break;
+          }
+          WritePipe(&msg, sizeof(msg));
+          WritePipe(&count, sizeof(count));
+        }
+        break;
+#endif // WIN32
       case SET_MAX_PAYLOAD_SIZE:
           ReadPipe(&val, sizeof(val));
           x264.SetMaxRTPPayloadSize(val);
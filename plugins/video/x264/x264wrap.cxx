@@ -594,6 +594,14 @@ bool H264Encoder::WritePipe(const void * ptr, size_t len)
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#endif
 
 
 static const char DefaultPluginDirs[] = "." DIR_TOKENISER
@@ -607,10 +615,45 @@ static bool IsExecutable(const char * path)
 }
 
 
+static bool SetCloseOnExec(int fd, bool on)
+{
+  int flags = fcntl(fd, F_GETFD);
+  if (flags < 0)
+    return false;
+  return fcntl(fd, F_SETFD, on ? (flags | FD_CLOEXEC) : (flags & ~FD_CLOEXEC)) == 0;
+}
+
+
+/* Anonymous shared memory, never visible in the file system to anyone else.
+   Created close on exec, the helper is the only process to be given it. */
+static int CreateSharedMemory(void * instance)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+  (void)instance;
+  return syscall(SYS_memfd_create, "x264-shm", MFD_CLOEXEC);
+#else
+  char name[100];
+  snprintf(name, sizeof(name), "/x264-%d-%p", getpid(), instance);
+  int fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR);
+  if (fd >= 0) {
+    shm_unlink(name);
+    SetCloseOnExec(fd, true);
+  }
+  return fd;
+#endif
+}
+
+
 H264Encoder::H264Encoder()
   : m_loaded(false)
   , m_pipeToProcess(-1)
   , m_pipeFromProcess(-1)
+  , m_sharedFd(-1)
+  , m_sharedMemory(NULL)
+  , m_sharedSize(0)
+  , m_sharedOutput(0)
+  , m_sharedOffset(0)
+  , m_sharedPackets(0)
   , m_startNewFrame(true)
 {
 }
@@ -628,6 +671,12 @@ H264Encoder::~H264Encoder()
     m_pipeFromProcess = -1;
   }
 
+  if (m_sharedMemory != NULL)
+    munmap(m_sharedMemory, m_sharedSize);
+
+  if (m_sharedFd >= 0)
+    close(m_sharedFd);
+
   if (remove(m_ulName) == -1) {
     PTRACE(1, PipeTraceName, "Error when trying to remove UL named pipe - " << strerror(errno));
   }
@@ -670,6 +719,15 @@ bool H264Encoder::OpenPipeAndExecute(void * instance, const char * executablePat
   }
 #endif /* HAVE_MKFIFO */
 
+  // Shared memory for the helper, if not available, the pipes are used.
+  m_sharedFd = CreateSharedMemory(instance);
+  if (m_sharedFd < 0) {
+    PTRACE(2, PipeTraceName, "Could not create shared memory, using pipes - " << strerror(errno));
+  }
+
+  char sharedFd[20];
+  snprintf(sharedFd, sizeof(sharedFd), "%d", m_sharedFd);
+
   m_pid = fork();
   if (m_pid < 0) {
     PTRACE(1, PipeTraceName, "Error when trying to fork");
@@ -677,8 +735,12 @@ bool H264Encoder::OpenPipeAndExecute(void * instance, const char * executablePat
   }
 
   if (m_pid == 0) {
+    // Only this helper inherits the shared memory, not any other we start
+    if (m_sharedFd >= 0)
+      SetCloseOnExec(m_sharedFd, false);
+
     // If succeeds, does not return
-    execl(executablePath, executablePath, m_dlName, m_ulName, NULL);
+    execl(executablePath, executablePath, m_dlName, m_ulName, m_sharedFd < 0 ? NULL : sharedFd, NULL);
     PTRACE(1, PipeTraceName, "Error when trying to execute GPL process  " << executablePath << " - " << strerror(errno));
     return false;
   }
@@ -688,12 +750,14 @@ bool H264Encoder::OpenPipeAndExecute(void * instance, const char * executablePat
     PTRACE(1, PipeTraceName, "Error when opening DL named pipe - " << strerror(errno));
     return false;
   }
+  SetCloseOnExec(m_pipeToProcess, true);
 
   m_pipeFromProcess = open(m_ulName, O_RDONLY);
   if (m_pipeFromProcess < 0) { 
     PTRACE(1, PipeTraceName, "Error when opening UL named pipe - " << strerror(errno));
     return false;
   }
+  SetCloseOnExec(m_pipeFromProcess, true);
 
   PTRACE(4, PipeTraceName, "Started GPL process id " << m_pid << " using " << executablePath);
   return true;
@@ -730,6 +794,101 @@ bool H264Encoder::WritePipe(const void * ptr, size_t len)
 }
 
 
+bool H264Encoder::ResizeSharedMemory(size_t size)
+{
+  if (size <= m_sharedSize)
+    return true;
+
+  // Grow in big steps, usually only happens once for the first frame
+  size = H264_SHARED_ALIGN(size + size/2);
+
+  if (m_sharedMemory != NULL) {
+    munmap(m_sharedMemory, m_sharedSize);
+    m_sharedMemory = NULL;
+    m_sharedSize = 0;
+  }
+
+  if (ftruncate(m_sharedFd, size) < 0) {
+    PTRACE(1, PipeTraceName, "Could not resize shared memory to " << size << " - " << strerror(errno));
+    return false;
+  }
+
+  void * mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, m_sharedFd, 0);
+  if (mem == MAP_FAILED) {
+    PTRACE(1, PipeTraceName, "Could not map shared memory of " << size << " bytes - " << strerror(errno));
+    return false;
+  }
+
+  PTRACE(4, PipeTraceName, "Shared memory resized to " << size << " bytes");
+  m_sharedMemory = (unsigned char *)mem;
+  m_sharedSize = size;
+  return true;
+}
+
+
+bool H264Encoder::EncodeFramesShared(const unsigned char * src, unsigned & srcLen,
+                                     unsigned char * dst, unsigned & dstLen,
+                                     unsigned headerLen, unsigned int & flags)
+{
+  /* The helper encodes all the packets for the frame into shared memory in
+     one round trip, subsequent calls for the frame are satisfied from there. */
+  if (m_sharedPackets == 0) {
+    unsigned msg;
+    if (m_startNewFrame) {
+      // Allow as much again for the encoded output, plus a packets worth
+      m_sharedOutput = H264_SHARED_ALIGN(srcLen);
+      if (!ResizeSharedMemory(m_sharedOutput + srcLen + 2048))
+        return false;
+
+      memcpy(m_sharedMemory, src, srcLen);
+
+      msg = ENCODE_FRAMES_SHARED;
+      unsigned sharedSize = (unsigned)m_sharedSize;
+      if (!WritePipe(&msg, sizeof(msg)) ||
+          !WritePipe(&sharedSize, sizeof(sharedSize)) ||
+          !WritePipe(&srcLen, sizeof(srcLen)) ||
+          !WritePipe(&headerLen, sizeof(headerLen)) ||
+          !WritePipe(dst, headerLen) ||
+          !WritePipe(&flags, sizeof(flags)))
+        return false;
+    }
+    else {
+      // Ran out of room last time
+      msg = ENCODE_FRAMES_SHARED_BUFFERED;
+      if (!WritePipe(&msg, sizeof(msg)))
+        return false;
+    }
+
+    if (!ReadPipe(&msg, sizeof(msg)) || !ReadPipe(&m_sharedPackets, sizeof(m_sharedPackets)))
+      return false;
+
+    if (m_sharedPackets == 0) {
+      PTRACE(1, PipeTraceName, "GPL process returned no packets");
+      return false;
+    }
+
+    m_sharedOffset = m_sharedOutput;
+  }
+
+  const H264SharedPacket * packet = (const H264SharedPacket *)(m_sharedMemory + m_sharedOffset);
+  if (m_sharedOffset + sizeof(H264SharedPacket) + packet->m_length > m_sharedSize || packet->m_length > dstLen) {
+    PTRACE(1, PipeTraceName, "Invalid packet length " << packet->m_length << " from GPL process");
+    m_sharedPackets = 0;
+    return false;
+  }
+
+  memcpy(dst, packet+1, packet->m_length);
+  dstLen = packet->m_length;
+  flags = packet->m_flags;
+
+  m_sharedOffset += H264_SHARED_ALIGN(sizeof(H264SharedPacket) + packet->m_length);
+  --m_sharedPackets;
+
+  m_startNewFrame = (flags & 1) != 0;
+  return packet->m_result != 0;
+}
+
+
 #endif // WIN32
 
 
@@ -881,6 +1040,11 @@ bool H264Encoder::EncodeFrames(const unsigned char * src, unsigned & srcLen,
                                unsigned char * dst, unsigned & dstLen,
                                unsigned headerLen, unsigned int & flags)
 {
+#if !WIN32
+  if (m_sharedFd >= 0)
+    return EncodeFramesShared(src, srcLen, dst, dstLen, headerLen, flags);
+#endif
+
   unsigned msg;
   if (m_startNewFrame) {
     msg = ENCODE_FRAMES;
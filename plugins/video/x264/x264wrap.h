@@ -69,6 +69,22 @@ extern "C" {
 #define SET_PROFILE_LEVEL         13
 #define SET_MAX_NALU_SIZE         14
 #define SET_RATE_CONTROL_PERIOD   15
+#define ENCODE_FRAMES_SHARED      16
+#define ENCODE_FRAMES_SHARED_BUFFERED 17
+
+
+/* Shared memory between plugin and helper has the raw frame at the start,
+   then as many encoded packets as fit. Each packet is this header followed
+   by the RTP data, aligned by H264_SHARED_ALIGN. */
+struct H264SharedPacket
+{
+  unsigned m_length;
+  unsigned m_flags;
+  unsigned m_result;
+  unsigned m_reserved;
+};
+
+#define H264_SHARED_ALIGN(n) (((n)+15)&~(size_t)15)
 
 
 class H264Encoder
@@ -134,6 +150,23 @@ class H264Encoder
     int   m_pipeToProcess;
     int   m_pipeFromProcess;
     pid_t m_pid;
+
+    bool ResizeSharedMemory(size_t size);
+    bool EncodeFramesShared(
+      const unsigned char * src,
+      unsigned & srcLen,
+      unsigned char * dst,
+      unsigned & dstLen,
+      unsigned headerLen,
+      unsigned int & flags
+    );
+
+    int             m_sharedFd;
+    unsigned char * m_sharedMemory;
+    size_t          m_sharedSize;
+    size_t          m_sharedOutput;
+    size_t          m_sharedOffset;
+    unsigned        m_sharedPackets;
   #endif // WIN32
 
     bool m_startNewFrame;
@@ -0,0 +1,186 @@
+/*
+ * main.cxx
+ *
+ * OPAL audio codec batch conversion test
+ *
+ * Copyright (c) 2016 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <opal/transcoders.h>
+
+
+class CodecBatch : public PProcess
+{
+    PCLASSINFO(CodecBatch, PProcess)
+  public:
+    CodecBatch();
+
+    virtual void Main();
+
+  protected:
+    bool Compare(const char * name, OpalTranscoder * batched, OpalTranscoder * single, const RTP_DataFrame & input, RTP_DataFrame & output);
+
+    unsigned m_iterations;
+};
+
+
+PCREATE_PROCESS(CodecBatch);
+
+
+CodecBatch::CodecBatch()
+  : PProcess("Open Phone Abstraction Library", "Codec Batch Test", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_iterations(0)
+{
+}
+
+
+void CodecBatch::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "i-iterations: Number of packets to process, default 10000\n"
+             "F-frames: Codec frames per packet, default 3\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h') || args.GetCount() == 0) {
+    args.Usage(cerr, "[ options ] format ...");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_iterations = args.GetOptionString('i', "10000").AsUnsigned();
+  unsigned framesPerPacket = args.GetOptionString('F', "3").AsUnsigned();
+  if (m_iterations == 0 || framesPerPacket < 2) {
+    cerr << "Invalid iterations or frames per packet, must be at least two frames" << endl;
+    return;
+  }
+
+  for (PINDEX arg = 0; arg < args.GetCount(); ++arg) {
+    OpalMediaFormat mediaFormat = args[arg];
+    if (!mediaFormat.IsTransportable() || mediaFormat.GetMediaType() != OpalMediaType::Audio()) {
+      cerr << "Not an encoded audio format \"" << args[arg] << '"' << endl;
+      continue;
+    }
+
+    OpalMediaFormatList rawFormats = OpalTranscoder::GetDestinationFormats(mediaFormat);
+    if (rawFormats.IsEmpty()) {
+      cerr << "No transcoders for format \"" << mediaFormat << '"' << endl;
+      continue;
+    }
+    OpalMediaFormat rawFormat = rawFormats[0];
+
+    mediaFormat.SetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), framesPerPacket);
+    mediaFormat.ToCustomisedOptions();
+
+    /* Two of each, with identical input a stateful codec produces identical
+       output, so the batch path can be compared byte for byte with the one
+       frame at a time path of the base class. */
+    std::auto_ptr<OpalTranscoder> batchEncoder(OpalTranscoder::Create(rawFormat, mediaFormat));
+    std::auto_ptr<OpalTranscoder> singleEncoder(OpalTranscoder::Create(rawFormat, mediaFormat));
+    std::auto_ptr<OpalTranscoder> batchDecoder(OpalTranscoder::Create(mediaFormat, rawFormat));
+    std::auto_ptr<OpalTranscoder> singleDecoder(OpalTranscoder::Create(mediaFormat, rawFormat));
+    if (batchEncoder.get() == NULL || singleEncoder.get() == NULL || batchDecoder.get() == NULL || singleDecoder.get() == NULL) {
+      cerr << "Could not create transcoders for \"" << mediaFormat << '"' << endl;
+      continue;
+    }
+
+    // Speech like levels
+    RTP_DataFrame pcm(batchEncoder->GetOptimalDataFrameSize(true));
+    PRandom random(pcm.GetPayloadSize());
+    short * samples = (short *)pcm.GetPayloadPtr();
+    for (PINDEX s = 0; s < pcm.GetPayloadSize()/2; ++s)
+      samples[s] = (short)((int)(random.Generate() % 16001) - 8000);
+
+    cout << mediaFormat << ", " << framesPerPacket << " frames per packet, "
+         << pcm.GetPayloadSize() << " PCM bytes per packet, " << m_iterations << " packets" << endl;
+
+    RTP_DataFrame encoded;
+    if (!Compare("encode", batchEncoder.get(), singleEncoder.get(), pcm, encoded))
+      continue;
+
+    RTP_DataFrame decoded;
+    if (!Compare("decode", batchDecoder.get(), singleDecoder.get(), encoded, decoded))
+      continue;
+
+    if (decoded.GetPayloadSize() != pcm.GetPayloadSize())
+      cout << "  DECODED SIZE MISMATCH: " << decoded.GetPayloadSize() << " != " << pcm.GetPayloadSize() << endl;
+    cout << endl;
+  }
+}
+
+
+bool CodecBatch::Compare(const char * name,
+                         OpalTranscoder * batched,
+                         OpalTranscoder * single,
+                         const RTP_DataFrame & input,
+                         RTP_DataFrame & output)
+{
+  OpalFramedTranscoder * framed = dynamic_cast<OpalFramedTranscoder *>(single);
+  if (framed == NULL) {
+    cout << "  " << name << ": not a framed transcoder, nothing to compare" << endl;
+    return false;
+  }
+
+  RTP_DataFrame singleOutput;
+  PTimeInterval batchTime, singleTime;
+
+  for (unsigned i = 0; i < m_iterations; ++i) {
+    PTimeInterval start = PTimer::Tick();
+    if (!batched->Convert(input, output)) {
+      cout << "  " << name << ": batch conversion failed on packet " << i << endl;
+      return false;
+    }
+    batchTime += PTimer::Tick() - start;
+
+    // Explicitly qualified, so never uses the plug in batch function
+    start = PTimer::Tick();
+    if (!framed->OpalFramedTranscoder::Convert(input, singleOutput)) {
+      cout << "  " << name << ": single frame conversion failed on packet " << i << endl;
+      return false;
+    }
+    singleTime += PTimer::Tick() - start;
+
+    if (output.GetPayloadSize() != singleOutput.GetPayloadSize() ||
+        memcmp(output.GetPayloadPtr(), singleOutput.GetPayloadPtr(), output.GetPayloadSize()) != 0) {
+      cout << "  " << name << ": OUTPUT MISMATCH on packet " << i << ", "
+           << output.GetPayloadSize() << " bytes batched, " << singleOutput.GetPayloadSize() << " bytes single" << endl;
+      return false;
+    }
+  }
+
+  cout << "  " << setw(6) << left << name << right << ": "
+       << output.GetPayloadSize() << " bytes out, batched " << batchTime.GetMilliSeconds() << "ms, single "
+       << singleTime.GetMilliSeconds() << "ms";
+  if (batchTime > 0)
+    cout << ", speedup " << fixed << setprecision(2) << ((double)singleTime.GetMilliSeconds()/batchTime.GetMilliSeconds()) << 'x';
+  cout << endl;
+  return true;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,181 @@
+/*
+ * main.cxx
+ *
+ * OPAL audio DSP kernel benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <codec/audiodsp.h>
+
+
+class DSPBench : public PProcess
+{
+    PCLASSINFO(DSPBench, PProcess)
+  public:
+    DSPBench();
+
+    virtual void Main();
+
+  protected:
+    void Report(const char * name, const PTimeInterval & elapsed, const PTimeInterval & baseline);
+
+    unsigned m_iterations;
+};
+
+
+PCREATE_PROCESS(DSPBench);
+
+
+DSPBench::DSPBench()
+  : PProcess("Open Phone Abstraction Library", "DSP Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_iterations(0)
+{
+}
+
+
+// The per sample double precision filter OpalEchoCanceler used to have
+static void OldRemoveDC(short * dst, const short * src, unsigned samples, double & mean)
+{
+  for (unsigned i = 0; i < samples; ++i) {
+    mean = 0.999*mean + 0.001*src[i];
+    dst[i] = src[i] - (short)mean;
+  }
+}
+
+
+// The branch per sample sum OpalPCM16SilenceDetector used to have
+static unsigned OldAverageLevel(const short * pcm, unsigned samples)
+{
+  int sum = 0;
+  const short * end = pcm + samples;
+  while (pcm != end) {
+    if (*pcm < 0)
+      sum -= *pcm++;
+    else
+      sum += *pcm++;
+  }
+  return sum/samples;
+}
+
+
+void DSPBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "i-iterations: Number of frames to process, default 1000000\n"
+             "r-rate: Sample rate, default 8000\n"
+             "p-period: Frame period in milliseconds, default 20\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_iterations = args.GetOptionString('i', "1000000").AsUnsigned();
+  unsigned samples = args.GetOptionString('r', "8000").AsUnsigned()*args.GetOptionString('p', "20").AsUnsigned()/1000;
+  if (m_iterations == 0 || samples == 0) {
+    cerr << "Invalid iterations, rate or period" << endl;
+    return;
+  }
+
+  // Speech like levels with a DC offset, as from a cheap sound card
+  PRandom random(samples);
+  std::vector<short> input(samples), output(samples);
+  for (unsigned s = 0; s < samples; ++s)
+    input[s] = (short)((int)(random.Generate() % 16001) - 8000 + 500);
+
+  cout << samples << " samples per frame, " << m_iterations << " frames\n" << endl;
+
+  // Results are accumulated so the compiler cannot discard the work
+  PUInt64 sink = 0;
+  PTimeInterval start, baseline;
+
+  double oldMean = 0;
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < m_iterations; ++i) {
+    OldRemoveDC(&output[0], &input[0], samples, oldMean);
+    sink += output[i%samples];
+  }
+  baseline = PTimer::Tick() - start;
+  Report("DC removal, double IIR", baseline, 0);
+
+  int newMean = 0;
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < m_iterations; ++i) {
+    OpalAudioDSP::RemoveDC(&output[0], &input[0], samples, newMean);
+    sink += output[i%samples];
+  }
+  Report("DC removal, OpalAudioDSP", PTimer::Tick() - start, baseline);
+  cout << "  settled offset: old " << (int)oldMean << ", new " << (newMean/256) << '\n' << endl;
+
+  unsigned oldLevel = 0;
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < m_iterations; ++i)
+    sink += oldLevel = OldAverageLevel(&input[0], samples);
+  baseline = PTimer::Tick() - start;
+  Report("Average level, branching", baseline, 0);
+
+  unsigned newLevel = 0;
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < m_iterations; ++i)
+    sink += newLevel = OpalAudioDSP::AverageLevel(&input[0], samples);
+  Report("Average level, OpalAudioDSP", PTimer::Tick() - start, baseline);
+  cout << "  level: old " << oldLevel << ", new " << newLevel;
+  if (oldLevel != newLevel)
+    cout << ", OUTPUT MISMATCH";
+  cout << '\n' << endl;
+
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < m_iterations; ++i)
+    sink += OpalAudioDSP::PeakLevel(&input[0], samples);
+  Report("Peak level, OpalAudioDSP", PTimer::Tick() - start, 0);
+
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < m_iterations; ++i)
+    sink += OpalAudioDSP::RMSLevel(&input[0], samples);
+  Report("RMS level, OpalAudioDSP", PTimer::Tick() - start, 0);
+
+  PTRACE(5, "Checksum " << sink);
+}
+
+
+void DSPBench::Report(const char * name, const PTimeInterval & elapsed, const PTimeInterval & baseline)
+{
+  cout << setw(28) << left << name << right << ": "
+       << setw(6) << elapsed.GetMilliSeconds() << "ms, "
+       << fixed << setprecision(1) << (elapsed.GetMilliSeconds()*1000000.0/m_iterations) << "ns/frame";
+  if (baseline > 0 && elapsed > 0)
+    cout << ", speedup " << setprecision(2) << ((double)baseline.GetMilliSeconds()/elapsed.GetMilliSeconds()) << 'x';
+  cout << endl;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
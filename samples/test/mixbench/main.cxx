@@ -0,0 +1,158 @@
+/*
+ * main.cxx
+ *
+ * OPAL audio mixer kernel benchmark
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <ep/opalmixer.h>
+
+
+static const char * const KernelNames[OpalAudioMixer::NumMixKernels] = { "Scalar", "SSE2", "AVX2", "NEON" };
+
+
+class MixBench : public PProcess
+{
+    PCLASSINFO(MixBench, PProcess)
+  public:
+    MixBench();
+
+    virtual void Main();
+
+  protected:
+    PTimeInterval Run(unsigned participants, unsigned samples, unsigned iterations, std::vector<short> & output);
+};
+
+
+PCREATE_PROCESS(MixBench);
+
+
+MixBench::MixBench()
+  : PProcess("Open Phone Abstraction Library", "Mixer Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+{
+}
+
+
+void MixBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "i-iterations: Number of mix periods to run, default 10000\n"
+             "r-rate: Sample rate, default 8000\n"
+             "p-period: Mix period in milliseconds, default 10\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ] [ participants ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned iterations = args.GetOptionString('i', "10000").AsUnsigned();
+  unsigned samples = args.GetOptionString('r', "8000").AsUnsigned()*args.GetOptionString('p', "10").AsUnsigned()/1000;
+  if (iterations == 0 || samples == 0) {
+    cerr << "Invalid iterations, rate or period" << endl;
+    return;
+  }
+
+  std::vector<unsigned> rooms;
+  for (PINDEX arg = 0; arg < args.GetCount(); ++arg)
+    rooms.push_back(args[arg].AsUnsigned());
+  if (rooms.empty()) {
+    rooms.push_back(8);
+    rooms.push_back(32);
+    rooms.push_back(128);
+  }
+
+  cout << "Best kernel: " << KernelNames[OpalAudioMixer::GetBestMixKernel()] << ", "
+       << samples << " samples per period, " << iterations << " periods\n" << endl;
+
+  for (std::vector<unsigned>::iterator room = rooms.begin(); room != rooms.end(); ++room) {
+    if (*room == 0)
+      continue;
+
+    std::vector<short> reference, output;
+    PTimeInterval scalarTime;
+
+    for (int kernel = 0; kernel < OpalAudioMixer::NumMixKernels; ++kernel) {
+      if (!OpalAudioMixer::SetMixKernel((OpalAudioMixer::MixKernel)kernel))
+        continue;
+
+      PTimeInterval elapsed = Run(*room, samples, iterations, kernel == OpalAudioMixer::MixKernelScalar ? reference : output);
+      cout << setw(4) << *room << " participants, " << setw(6) << KernelNames[kernel] << ": "
+           << setw(6) << elapsed.GetMilliSeconds() << "ms, "
+           << fixed << setprecision(2) << (elapsed.GetMilliSeconds()*1000.0/iterations) << "us/period";
+
+      if (kernel == OpalAudioMixer::MixKernelScalar)
+        scalarTime = elapsed;
+      else {
+        if (elapsed > 0)
+          cout << ", speedup " << setprecision(2) << ((double)scalarTime.GetMilliSeconds()/elapsed.GetMilliSeconds()) << 'x';
+        if (output != reference)
+          cout << ", OUTPUT MISMATCH";
+      }
+      cout << endl;
+    }
+  }
+
+  OpalAudioMixer::SetMixKernel(OpalAudioMixer::GetBestMixKernel());
+}
+
+
+PTimeInterval MixBench::Run(unsigned participants, unsigned samples, unsigned iterations, std::vector<short> & output)
+{
+  // Use the same pseudo random audio for each kernel so results can be compared
+  PRandom random(participants);
+
+  std::vector< std::vector<short> > audio(participants, std::vector<short>(samples));
+  std::vector<const short *> buffers(participants);
+  for (unsigned p = 0; p < participants; ++p) {
+    for (unsigned s = 0; s < samples; ++s)
+      audio[p][s] = (short)(random.Generate() & 0xffff);
+    buffers[p] = &audio[p][0];
+  }
+
+  std::vector<int> mixed(samples);
+  output.resize(participants*samples);
+
+  PTimeInterval start = PTimer::Tick();
+
+  for (unsigned i = 0; i < iterations; ++i) {
+    OpalAudioMixer::AccumulateSamples(&mixed[0], &buffers[0], participants, samples);
+
+    // Each participant gets everyone but themselves
+    for (unsigned p = 0; p < participants; ++p)
+      OpalAudioMixer::SubtractAndSaturate(&output[p*samples], &mixed[0], buffers[p], samples);
+  }
+
+  return PTimer::Tick() - start;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
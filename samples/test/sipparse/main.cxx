@@ -0,0 +1,196 @@
+/*
+ * main.cxx
+ *
+ * OPAL SIP message parser benchmark
+ *
+ * Copyright (c) 2016 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <sip/sippdu.h>
+
+
+static const char * const Corpus[] = {
+  "INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;rport\r\n"
+  "Max-Forwards: 70\r\n"
+  "From: Alice <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+  "To: Bob <sip:bob@biloxi.example.com>\r\n"
+  "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+  "CSeq: 1 INVITE\r\n"
+  "Contact: <sip:alice@client.atlanta.example.com;transport=udp>\r\n"
+  "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO\r\n"
+  "Supported: replaces, timer\r\n"
+  "User-Agent: Example Softphone/1.2.3\r\n"
+  "Session-Expires: 1800\r\n"
+  "Content-Type: application/sdp\r\n"
+  "Content-Length: 234\r\n"
+  "\r\n"
+  "v=0\r\n"
+  "o=alice 2890844526 2890844526 IN IP4 client.atlanta.example.com\r\n"
+  "s=-\r\n"
+  "c=IN IP4 192.0.2.101\r\n"
+  "t=0 0\r\n"
+  "m=audio 49172 RTP/AVP 0 8 101\r\n"
+  "a=rtpmap:0 PCMU/8000\r\n"
+  "a=rtpmap:8 PCMA/8000\r\n"
+  "a=rtpmap:101 telephone-event/8000\r\n"
+  "a=sendrecv\r\n",
+
+  "REGISTER sip:registrar.biloxi.example.com SIP/2.0\r\n"
+  "v: SIP/2.0/UDP bobspc.biloxi.example.com:5060;branch=z9hG4bKnashds7\r\n"
+  "Max-Forwards: 70\r\n"
+  "t: Bob <sip:bob@biloxi.example.com>\r\n"
+  "f: Bob <sip:bob@biloxi.example.com>;tag=456248\r\n"
+  "i: 843817637684230@998sdasdh09\r\n"
+  "CSeq: 1826 REGISTER\r\n"
+  "m: <sip:bob@192.0.2.4>\r\n"
+  "Expires: 7200\r\n"
+  "Authorization: Digest username=\"bob\", realm=\"biloxi.example.com\",\r\n"
+  " nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", uri=\"sip:registrar.biloxi.example.com\",\r\n"
+  " response=\"6629fae49393a05397450978507c4ef1\", algorithm=MD5\r\n"
+  "l: 0\r\n"
+  "\r\n",
+
+  "NOTIFY sip:alice@client.atlanta.example.com SIP/2.0\r\n"
+  "Via: SIP/2.0/UDP pres.example.com:5060;branch=z9hG4bK4cd42a\r\n"
+  "Via: SIP/2.0/UDP proxy.example.com:5060;branch=z9hG4bK77ef4c2312983.1\r\n"
+  "Max-Forwards: 69\r\n"
+  "From: <sip:bob@biloxi.example.com>;tag=ffd2\r\n"
+  "To: <sip:alice@atlanta.example.com>;tag=xfg9\r\n"
+  "Call-ID: 2010@client.atlanta.example.com\r\n"
+  "CSeq: 2 NOTIFY\r\n"
+  "Event: presence\r\n"
+  "Subscription-State: active;expires=3599\r\n"
+  "Contact: <sip:pres.example.com>\r\n"
+  "X-Custom-Header: something\r\n"
+  "Content-Type: application/pidf+xml\r\n"
+  "Content-Length: 185\r\n"
+  "\r\n"
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+  "<presence xmlns=\"urn:ietf:params:xml:ns:pidf\" entity=\"sip:bob@biloxi.example.com\">\r\n"
+  "<tuple id=\"a1\"><status><basic>open</basic></status></tuple>\r\n"
+  "</presence>",
+
+  "SIP/2.0 200 OK\r\n"
+  "Via: SIP/2.0/UDP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101;rport=5060\r\n"
+  "From: Alice <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+  "To: Bob <sip:bob@biloxi.example.com>;tag=8321234356\r\n"
+  "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+  "CSeq: 1 INVITE\r\n"
+  "Contact: <sip:bob@client.biloxi.example.com>\r\n"
+  "Content-Length: 0\r\n"
+  "\r\n"
+};
+
+
+class SIPParseBench : public PProcess
+{
+    PCLASSINFO(SIPParseBench, PProcess)
+  public:
+    SIPParseBench();
+
+    virtual void Main();
+};
+
+
+PCREATE_PROCESS(SIPParseBench);
+
+
+SIPParseBench::SIPParseBench()
+  : PProcess("Open Phone Abstraction Library", "SIP Parser Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+{
+}
+
+
+static bool SamePDU(const SIP_PDU & a, const SIP_PDU & b)
+{
+  PStringStream mimeA, mimeB;
+  mimeA << a.GetMIME();
+  mimeB << b.GetMIME();
+
+  return a.GetMethod() == b.GetMethod() &&
+         a.GetStatusCode() == b.GetStatusCode() &&
+         a.GetURI() == b.GetURI() &&
+         mimeA == mimeB &&
+         a.GetEntityBody() == b.GetEntityBody() &&
+         a.GetTransactionID() == b.GetTransactionID();
+}
+
+
+void SIPParseBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "i-iterations: Number of times to parse each message, default 100000\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned iterations = args.GetOptionString('i', "100000").AsUnsigned();
+  if (iterations == 0) {
+    cerr << "Invalid iterations" << endl;
+    return;
+  }
+
+  for (PINDEX msg = 0; msg < PARRAYSIZE(Corpus); ++msg) {
+    PString datagram(Corpus[msg]);
+
+    SIP_PDU streamPDU, bufferPDU;
+    SIP_PDU::StatusCodes streamStatus, bufferStatus;
+
+    PTimeInterval start = PTimer::Tick();
+    for (unsigned i = 0; i < iterations; ++i) {
+      // This is what SIP_PDU::Read() used to do with each datagram
+      PStringStream strm;
+      strm = datagram;
+      streamStatus = streamPDU.Parse(strm, false);
+    }
+    PTimeInterval streamTime = PTimer::Tick() - start;
+
+    start = PTimer::Tick();
+    for (unsigned i = 0; i < iterations; ++i)
+      bufferStatus = bufferPDU.Parse(datagram, datagram.GetLength(), false);
+    PTimeInterval bufferTime = PTimer::Tick() - start;
+
+    cout << setw(20) << datagram.Left(datagram.Find(' ')) << ' '
+         << setw(4) << datagram.GetLength() << " bytes: "
+         << "stream " << fixed << setprecision(2) << (streamTime.GetMilliSeconds()*1000.0/iterations) << "us, "
+         << "buffer " << (bufferTime.GetMilliSeconds()*1000.0/iterations) << "us";
+    if (bufferTime > 0)
+      cout << ", speedup " << ((double)streamTime.GetMilliSeconds()/bufferTime.GetMilliSeconds()) << 'x';
+    if (streamStatus != bufferStatus || !SamePDU(streamPDU, bufferPDU))
+      cout << ", RESULT MISMATCH";
+    cout << endl;
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,349 @@
+/*
+ * audiodsp.cxx
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Small fixed point DSP kernels for 16 bit linear PCM.
+ *
+ * Copyright (c) 2014 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "audiodsp.h"
+#endif
+#include <opal_config.h>
+
+#include <codec/audiodsp.h>
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define OPAL_DSP_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+  #define OPAL_DSP_NEON 1
+#endif
+
+#define new PNEW
+
+
+// Log2 of the DC removal time constant in samples
+#define DC_TIME_CONSTANT_SHIFT 10
+
+// Running mean is kept with this many fraction bits
+#define DC_FRACTION_BITS 8
+
+/* Per lane accumulators are 32 bit, so longer buffers are done in pieces
+   that cannot overflow them, even with every sample at full scale. */
+#define MAX_CHUNK 32768
+
+
+static __inline int AbsSample(int sample)
+{
+  int value = sample < 0 ? -sample : sample;
+  return value - (value >> 15); // -32768 becomes 32767, as the vector versions
+}
+
+
+#if OPAL_DSP_SSE2
+
+static __inline unsigned SumLanes(__m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+  return (unsigned)_mm_cvtsi128_si32(v);
+}
+
+
+static __inline __m128i AbsLanes(__m128i x)
+{
+  return _mm_max_epi16(x, _mm_subs_epi16(_mm_setzero_si128(), x));
+}
+
+
+static int SumAndSubtract(short * dst, const short * src, unsigned samples, short offset)
+{
+  const __m128i ones = _mm_set1_epi16(1);
+  const __m128i sub = _mm_set1_epi16(offset);
+  __m128i acc = _mm_setzero_si128();
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(src+i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(x, ones));
+    _mm_storeu_si128((__m128i *)(dst+i), _mm_subs_epi16(x, sub));
+  }
+
+  int sum = (int)SumLanes(acc);
+  for (; i < samples; ++i) {
+    int value = src[i];
+    sum += value;
+    value -= offset;
+    dst[i] = (short)(value < -32768 ? -32768 : (value > 32767 ? 32767 : value));
+  }
+  return sum;
+}
+
+
+static unsigned SumAbsolute(const short * pcm, unsigned samples)
+{
+  const __m128i ones = _mm_set1_epi16(1);
+  __m128i acc = _mm_setzero_si128();
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8)
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(AbsLanes(_mm_loadu_si128((const __m128i *)(pcm+i))), ones));
+
+  unsigned sum = SumLanes(acc);
+  for (; i < samples; ++i)
+    sum += AbsSample(pcm[i]);
+  return sum;
+}
+
+
+static unsigned MaxAbsolute(const short * pcm, unsigned samples)
+{
+  __m128i peak = _mm_setzero_si128();
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8)
+    peak = _mm_max_epi16(peak, AbsLanes(_mm_loadu_si128((const __m128i *)(pcm+i))));
+
+  peak = _mm_max_epi16(peak, _mm_shuffle_epi32(peak, 0x4e));
+  peak = _mm_max_epi16(peak, _mm_shuffle_epi32(peak, 0xb1));
+  peak = _mm_max_epi16(peak, _mm_shufflelo_epi16(peak, 0xb1));
+  int result = (short)_mm_cvtsi128_si32(peak);
+
+  for (; i < samples; ++i) {
+    int value = AbsSample(pcm[i]);
+    if (result < value)
+      result = value;
+  }
+  return result;
+}
+
+
+static PUInt64 SumSquares(const short * pcm, unsigned samples)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(pcm+i));
+    // Pairs of squares can reach 2^31, so treat as unsigned and widen to 64 bits
+    __m128i sq = _mm_madd_epi16(x, x);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+  }
+
+  PUInt64 lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, acc);
+  PUInt64 sum = lanes[0] + lanes[1];
+  for (; i < samples; ++i)
+    sum += pcm[i]*pcm[i];
+  return sum;
+}
+
+#elif OPAL_DSP_NEON
+
+static int SumAndSubtract(short * dst, const short * src, unsigned samples, short offset)
+{
+  const int16x8_t sub = vdupq_n_s16(offset);
+  int32x4_t acc = vdupq_n_s32(0);
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8) {
+    int16x8_t x = vld1q_s16(src+i);
+    acc = vpadalq_s16(acc, x);
+    vst1q_s16(dst+i, vqsubq_s16(x, sub));
+  }
+
+  int sum = vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+  for (; i < samples; ++i) {
+    int value = src[i];
+    sum += value;
+    value -= offset;
+    dst[i] = (short)(value < -32768 ? -32768 : (value > 32767 ? 32767 : value));
+  }
+  return sum;
+}
+
+
+static unsigned SumAbsolute(const short * pcm, unsigned samples)
+{
+  uint32x4_t acc = vdupq_n_u32(0);
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8)
+    acc = vpadalq_u16(acc, vreinterpretq_u16_s16(vqabsq_s16(vld1q_s16(pcm+i))));
+
+  unsigned sum = vgetq_lane_u32(acc, 0) + vgetq_lane_u32(acc, 1) + vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+  for (; i < samples; ++i)
+    sum += AbsSample(pcm[i]);
+  return sum;
+}
+
+
+static unsigned MaxAbsolute(const short * pcm, unsigned samples)
+{
+  int16x8_t peak = vdupq_n_s16(0);
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8)
+    peak = vmaxq_s16(peak, vqabsq_s16(vld1q_s16(pcm+i)));
+
+  int16x4_t half = vpmax_s16(vget_low_s16(peak), vget_high_s16(peak));
+  half = vpmax_s16(half, half);
+  half = vpmax_s16(half, half);
+  int result = vget_lane_s16(half, 0);
+
+  for (; i < samples; ++i) {
+    int value = AbsSample(pcm[i]);
+    if (result < value)
+      result = value;
+  }
+  return result;
+}
+
+
+static PUInt64 SumSquares(const short * pcm, unsigned samples)
+{
+  uint64x2_t acc = vdupq_n_u64(0);
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8) {
+    int16x8_t x = vld1q_s16(pcm+i);
+    acc = vpadalq_u32(acc, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(x), vget_low_s16(x))));
+    acc = vpadalq_u32(acc, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(x), vget_high_s16(x))));
+  }
+
+  PUInt64 sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+  for (; i < samples; ++i)
+    sum += pcm[i]*pcm[i];
+  return sum;
+}
+
+#else // No vector unit
+
+static int SumAndSubtract(short * dst, const short * src, unsigned samples, short offset)
+{
+  int sum = 0;
+  for (unsigned i = 0; i < samples; ++i) {
+    int value = src[i];
+    sum += value;
+    value -= offset;
+    dst[i] = (short)(value < -32768 ? -32768 : (value > 32767 ? 32767 : value));
+  }
+  return sum;
+}
+
+
+static unsigned SumAbsolute(const short * pcm, unsigned samples)
+{
+  unsigned sum = 0;
+  for (unsigned i = 0; i < samples; ++i)
+    sum += AbsSample(pcm[i]);
+  return sum;
+}
+
+
+static unsigned MaxAbsolute(const short * pcm, unsigned samples)
+{
+  int result = 0;
+  for (unsigned i = 0; i < samples; ++i) {
+    int value = AbsSample(pcm[i]);
+    if (result < value)
+      result = value;
+  }
+  return result;
+}
+
+
+static PUInt64 SumSquares(const short * pcm, unsigned samples)
+{
+  PUInt64 sum = 0;
+  for (unsigned i = 0; i < samples; ++i)
+    sum += pcm[i]*pcm[i];
+  return sum;
+}
+
+#endif
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+void OpalAudioDSP::RemoveDC(short * dst, const short * src, unsigned samples, int & state)
+{
+  if (samples == 0)
+    return;
+
+  short offset = (short)((state + (1 << (DC_FRACTION_BITS-1))) >> DC_FRACTION_BITS);
+
+  PInt64 sum = 0;
+  for (unsigned done = 0; done < samples; done += MAX_CHUNK) {
+    unsigned count = std::min(samples - done, (unsigned)MAX_CHUNK);
+    sum += SumAndSubtract(dst+done, src+done, count, offset);
+  }
+
+  // Move toward this frames mean in proportion to its length, which is
+  // the per sample exponential average collapsed to one step per frame.
+  PInt64 frameMean = (sum << DC_FRACTION_BITS)/(PInt64)samples;
+  PInt64 weight = std::min(samples, 1U << DC_TIME_CONSTANT_SHIFT);
+  state += (int)(((frameMean - state)*weight) >> DC_TIME_CONSTANT_SHIFT);
+}
+
+
+unsigned OpalAudioDSP::AverageLevel(const short * pcm, unsigned samples)
+{
+  if (samples == 0)
+    return 0;
+
+  PUInt64 sum = 0;
+  for (unsigned done = 0; done < samples; done += MAX_CHUNK)
+    sum += SumAbsolute(pcm+done, std::min(samples - done, (unsigned)MAX_CHUNK));
+
+  return (unsigned)(sum/samples);
+}
+
+
+unsigned OpalAudioDSP::PeakLevel(const short * pcm, unsigned samples)
+{
+  return MaxAbsolute(pcm, samples);
+}
+
+
+unsigned OpalAudioDSP::RMSLevel(const short * pcm, unsigned samples)
+{
+  if (samples == 0)
+    return 0;
+
+  return (unsigned)sqrt((double)SumSquares(pcm, samples)/samples);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -48,159 +48,415 @@ extern "C" {
 };
 
 #include <codec/echocancel.h>
+#include <codec/audiodsp.h>
+#include <opal/mediafmt.h>
+
+#include <algorithm>
+
+#define new PNEW
 
 
 ///////////////////////////////////////////////////////////////////////////////
 
-OpalEchoCanceler::OpalEchoCanceler()
-  : receiveHandler(PCREATE_NOTIFIER(ReceivedPacket))
-  , sendHandler(PCREATE_NOTIFIER(SentPacket))
+struct OpalEchoCanceler::State
 {
-  echoState = NULL;
-  preprocessState = NULL;
+  enum { MaxFrameSizes = 4 };
+
+  State(unsigned frameSamples, unsigned clockRate, unsigned duration)
+    : m_next(NULL)
+    , m_frameSamples(frameSamples)
+    , m_clockRate(clockRate)
+    , m_duration(duration)
+    , m_echoState(speex_echo_state_init(frameSamples, duration))
+    , m_preprocessState(speex_preprocess_state_init(frameSamples, clockRate))
+    , m_ref(frameSamples)
+    , m_echo(frameSamples)
+    , m_out(frameSamples)
+    , m_noise(frameSamples+1)
+  {
+    int dummy = 0;
+    speex_preprocess_ctl(m_preprocessState, SPEEX_PREPROCESS_SET_DENOISE, &dummy);
+  }
+
+  ~State()
+  {
+    speex_echo_state_destroy(m_echoState);
+    speex_preprocess_state_destroy(m_preprocessState);
+    delete m_next;
+  }
+
+  // Find state for the frame size, moving it to the front of the list
+  static State * Select(State * head, unsigned frameSamples)
+  {
+    if (head->m_frameSamples == frameSamples)
+      return head;
+
+    State * prev = head;
+    unsigned count = 1;
+    for (State * state = head->m_next; state != NULL; prev = state, state = state->m_next, ++count) {
+      if (state->m_frameSamples == frameSamples) {
+        prev->m_next = state->m_next;
+        state->m_next = head;
+        return state;
+      }
+    }
+
+    // Not seen before, so have to allocate here, but only the once per size
+    PTRACE(3, "Echo Canceler\tFrame size " << frameSamples << " not the expected " << head->m_frameSamples);
+    State * state = new State(frameSamples, head->m_clockRate, head->m_duration);
+    state->m_next = head;
+
+    // Drop the least recently used if too many
+    if (count >= MaxFrameSizes) {
+      for (prev = head; prev->m_next->m_next != NULL; prev = prev->m_next)
+        ;
+      delete prev->m_next;
+      prev->m_next = NULL;
+    }
+
+    return state;
+  }
+
+  State  * m_next;
+  unsigned m_frameSamples;
+  unsigned m_clockRate;
+  unsigned m_duration;
+  SpeexEchoState * m_echoState;
+  SpeexPreprocessState * m_preprocessState;
+  std::vector<spx_int16_t> m_ref;
+  std::vector<spx_int16_t> m_echo;
+  std::vector<spx_int16_t> m_out;
+#if OPAL_SPEEX_FLOAT_NOISE
+  std::vector<float> m_noise;
+#else
+  std::vector<spx_int32_t> m_noise;
+#endif
+};
 
-  e_buf = NULL;
-  echo_buf = NULL;
-  ref_buf = NULL;
-  noise = NULL;
 
-  echo_chan = new PQueueChannel();
-  echo_chan->Open(10000);
-  echo_chan->SetReadTimeout(10);
-  echo_chan->SetWriteTimeout(10);
+///////////////////////////////////////////////////////////////////////////////
 
-  mean = 0;
-  clockRate = 8000;
+/* The write and read positions are free running sample counts. Only the
+   producer changes m_write and only the consumer changes m_read, so each
+   side just needs to see the other's latest value. */
+class OpalEchoCanceler::ReferenceRing
+{
+  public:
+    enum {
+      Size = 65536, // Over a second at 48kHz, must be a power of two
+      Mask = Size-1
+    };
+
+    ReferenceRing()
+      : m_write(0)
+      , m_read(0)
+      , m_nextTimestamp(0)
+      , m_writeSynced(false)
+      , m_readSynced(false)
+      , m_minLag(UINT_MAX)
+      , m_windowSamples(0)
+      , m_delay(0)
+    {
+    }
+
+
+    // Producer, called from SentPacket()
+    void Write(const short * samples, unsigned count, RTP_Timestamp timestamp)
+    {
+      unsigned write = m_write;
+
+      /* Keep the ring aligned with the play out timeline, so gaps from
+         silence suppression or lost packets become silence rather than
+         pulling later audio earlier. */
+      if (m_writeSynced && timestamp != m_nextTimestamp) {
+        int gap = (int)(timestamp - m_nextTimestamp);
+        if (gap > 0 && gap < Size/4)
+          write = Copy(write, NULL, gap);
+        else
+          PTRACE(4, "Echo Canceler\tReference resynchronised, timestamp jump of " << gap);
+      }
+
+      m_writeSynced = true;
+      m_nextTimestamp = timestamp + count;
+      m_write = Copy(write, samples, count);
+    }
+
+
+    // Consumer, called from ReceivedPacket()
+    bool Read(short * samples, unsigned count, unsigned clockRate)
+    {
+      unsigned write = m_write;
+      unsigned read = m_read;
+
+      // Start with the most recent audio, nothing older is relevant
+      if (!m_readSynced) {
+        m_readSynced = true;
+        read = write;
+      }
+
+      unsigned lag = write - read;
+      if (lag > Size) {
+        PTRACE(4, "Echo Canceler\tReference overrun by " << (lag - Size) << " samples");
+        read = write;
+        lag = 0;
+      }
+
+      /* The smallest backlog over about a second is buffering we do not
+         need, the play out side jitter accounts for the rest. Drop all but
+         a frame of it so clock drift between the two sides cannot build up
+         and push the reference outside the echo tail. */
+      if (lag < m_minLag)
+        m_minLag = lag;
+      m_windowSamples += count;
+      if (m_windowSamples >= clockRate) {
+        if (m_minLag > 2*count) {
+          PTRACE(4, "Echo Canceler\tReference skipping " << (m_minLag - count) << " samples");
+          read += m_minLag - count;
+          lag -= m_minLag - count;
+        }
+        m_delay = lag;
+        m_minLag = UINT_MAX;
+        m_windowSamples = 0;
+      }
+
+      if (lag < count) {
+        m_read = read;
+        return false;
+      }
+
+      unsigned offset = read & Mask;
+      unsigned first = std::min(count, (unsigned)Size - offset);
+      memcpy(samples, &m_buffer[offset], first*sizeof(short));
+      memcpy(samples+first, &m_buffer[0], (count-first)*sizeof(short));
+      m_read = read + count;
+      return true;
+    }
+
+
+    void Restart()
+    {
+      m_readSynced = false;
+    }
+
+
+    unsigned GetDelay() const { return m_delay; }
+
+
+  protected:
+    unsigned Copy(unsigned write, const short * samples, unsigned count)
+    {
+      // Do not overwrite what the consumer has not had yet, it will resynchronise
+      if (write - m_read + count > Size)
+        return write;
+
+      unsigned offset = write & Mask;
+      unsigned first = std::min(count, (unsigned)Size - offset);
+      if (samples != NULL) {
+        memcpy(&m_buffer[offset], samples, first*sizeof(short));
+        memcpy(&m_buffer[0], samples+first, (count-first)*sizeof(short));
+      }
+      else {
+        memset(&m_buffer[offset], 0, first*sizeof(short));
+        memset(&m_buffer[0], 0, (count-first)*sizeof(short));
+      }
+      return write + count;
+    }
+
+    short m_buffer[Size];
+
+    atomic<unsigned> m_write;
+    atomic<unsigned> m_read;
+
+    // Producer only
+    RTP_Timestamp m_nextTimestamp;
+    bool          m_writeSynced;
+
+    // Consumer only
+    bool     m_readSynced;
+    unsigned m_minLag;
+    unsigned m_windowSamples;
+    unsigned m_delay;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
 
+OpalEchoCanceler::OpalEchoCanceler()
+  : receiveHandler(PCREATE_NOTIFIER(ReceivedPacket))
+  , sendHandler(PCREATE_NOTIFIER(SentPacket))
+  , clockRate(8000)
+  , frameSamples(160)
+  , activeState(NULL)
+  , pendingState(NULL)
+  , stateChanged(false)
+  , reference(new ReferenceRing)
+  , enabled(false)
+  , closing(false)
+  , busy(1)
+  , echoDelay(0)
+  , mean(0)
+{
   PTRACE(4, "Echo Canceler\tHandler created");
 }
 
 
 OpalEchoCanceler::~OpalEchoCanceler()
 {
-  PWaitAndSignal m(stateMutex);
-  if (echoState) {
-    speex_echo_state_destroy(echoState);
-    echoState = NULL;
-  }
-  
-  if (preprocessState) {
-    speex_preprocess_state_destroy(preprocessState);
-    preprocessState = NULL;
-  }
+  /* The filters should be removed from the patches by now, but a media
+     thread may still be in a notifier, so wait for it to leave. Any that
+     arrive after this will see closing and not touch anything else. */
+  closing = true;
+  if (--busy != 0)
+    idle.Wait();
 
-  if (ref_buf)
-    free(ref_buf);
-  if (e_buf)
-    free(e_buf);
-  if (echo_buf)
-    free(echo_buf);
-  if (noise)
-    free(noise);
-  
-  echo_chan->Close();
-  delete(echo_chan);
+  PWaitAndSignal m(stateMutex);
+  delete activeState;
+  delete pendingState;
+  delete reference;
 }
 
 
 void OpalEchoCanceler::SetParameters(const Params& newParam)
 {
   PWaitAndSignal m(stateMutex);
-  param = newParam;
 
-  if (echoState) {
-    speex_echo_state_destroy(echoState);
-    echoState = NULL;
-  }
-  
-  if (preprocessState) {
-    speex_preprocess_state_destroy(preprocessState);
-    preprocessState = NULL;
-  }
+  // Called for both patches, do not lose what has been learned if nothing changed
+  if (newParam.m_enabled == param.m_enabled && newParam.m_duration == param.m_duration)
+    return;
+
+  param = newParam;
+  BuildState();
 }
 
 
 void OpalEchoCanceler::SetClockRate(const int rate)
 {
+  PWaitAndSignal m(stateMutex);
+
+  if (clockRate == rate)
+    return;
+
+  frameSamples = frameSamples*rate/clockRate;
   clockRate = rate;
+  BuildState();
 }
 
 
+void OpalEchoCanceler::SetMediaFormat(const OpalMediaFormat & mediaFormat, int rawClockRate)
+{
+  // Encoded clock rate may not be the real one, e.g. G.722
+  int codecRate = std::max((int)mediaFormat.GetClockRate(), 1);
+  int rate = rawClockRate > 0 ? rawClockRate : codecRate;
+  unsigned frameTime = std::max(mediaFormat.GetFrameTime()*rate/codecRate, 1U);
+  unsigned samples = frameTime*std::max(mediaFormat.GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), 1), 1);
+
+  // OpalAudioMediaStream never reads less than 10ms at a time
+  unsigned minimum = rate/100;
+  if (samples < minimum)
+    samples = (minimum+frameTime-1)/frameTime*frameTime;
+
+  PWaitAndSignal m(stateMutex);
+
+  if (clockRate == rate && frameSamples == samples)
+    return;
+
+  clockRate = rate;
+  frameSamples = samples;
+  BuildState();
+}
+
+
+void OpalEchoCanceler::BuildState()
+{
+  // Note stateMutex should already be locked at this point.
+
+  delete pendingState; // Either never handed over, or the one ReceivedPacket() swapped out
+  pendingState = param.m_enabled ? new State(frameSamples, clockRate, param.m_duration) : NULL;
+  stateChanged = true;
+  enabled = param.m_enabled;
+
+  PTRACE(4, "Echo Canceler\t" << (param.m_enabled ? "Enabled" : "Disabled") << ", "
+            "clock=" << clockRate << ", frame=" << frameSamples << ", tail=" << param.m_duration);
+}
+
+
+/* Counts a notifier in progress. The count includes one for the canceler
+   itself, which only the destructor removes, so it can only get to zero
+   here once the destructor is waiting, and then the last one out wakes it. */
+class OpalEchoCancelerBusy
+{
+  public:
+    OpalEchoCancelerBusy(atomic<unsigned> & busy, PSyncPoint & idle) : m_busy(busy), m_idle(idle) { ++m_busy; }
+    ~OpalEchoCancelerBusy() { if (--m_busy == 0) m_idle.Signal(); }
+  protected:
+    atomic<unsigned> & m_busy;
+    PSyncPoint       & m_idle;
+};
+
+
 void OpalEchoCanceler::SentPacket(RTP_DataFrame& echo_frame, P_INT_PTR)
 {
-  /* Write to the soundcard, and write the frame to the PQueueChannel */
-  if (param.m_enabled && echo_frame.GetPayloadSize() > 0)
-    echo_chan->Write(echo_frame.GetPayloadPtr(), echo_frame.GetPayloadSize());
+  OpalEchoCancelerBusy inUse(busy, idle);
+
+  /* Write the played frame into the reference ring */
+  if (!closing && enabled && echo_frame.GetPayloadSize() > 0)
+    reference->Write((const short *)echo_frame.GetPayloadPtr(),
+                     echo_frame.GetPayloadSize()/sizeof(short),
+                     echo_frame.GetTimestamp());
 }
 
 
 void OpalEchoCanceler::ReceivedPacket(RTP_DataFrame& input_frame, P_INT_PTR)
 {
-  if (!param.m_enabled || input_frame.GetPayloadSize() == 0)
+  OpalEchoCancelerBusy inUse(busy, idle);
+
+  if (closing || !enabled || input_frame.GetPayloadSize() == 0)
     return;
 
-  size_t inputSize = input_frame.GetPayloadSize(); // Size is in bytes
+  /* Pick up new state built by SetParameters() etc. Never wait for the
+     mutex here, if busy we will get it on a later frame. */
+  if (stateChanged && stateMutex.Try()) {
+    std::swap(activeState, pendingState);
+    stateChanged = false;
+    stateMutex.Signal();
+    reference->Restart();
+  }
 
-  PWaitAndSignal m(stateMutex);
+  if (activeState == NULL)
+    return;
 
-  if (echoState == NULL) 
-    echoState = speex_echo_state_init(inputSize/sizeof(short), param.m_duration);
+  size_t inputSize = input_frame.GetPayloadSize(); // Size is in bytes
+  unsigned samples = inputSize/sizeof(short);
 
-  if (preprocessState == NULL) { 
-    preprocessState = speex_preprocess_state_init(inputSize/sizeof(short), clockRate);
-    int dummy = 0;
-    speex_preprocess_ctl(preprocessState, SPEEX_PREPROCESS_SET_DENOISE, &dummy);
-  }
+  // Media format may not have predicted the frame size, or it may change
+  activeState = State::Select(activeState, samples);
 
-  if (echo_buf == NULL)
-    echo_buf = (spx_int16_t *) malloc(inputSize);
-  if (noise == NULL)
-#if OPAL_SPEEX_FLOAT_NOISE
-    noise = malloc((inputSize/sizeof(short)+1)*sizeof(float));
-#else
-    noise = malloc((inputSize/sizeof(short)+1)*sizeof(spx_int32_t));
-#endif
-  if (e_buf == NULL)
-    e_buf = (spx_int16_t *) malloc(inputSize);
-  if (ref_buf == NULL)
-    ref_buf = (spx_int16_t *) malloc(inputSize);
+  State & state = *activeState;
 
   /* Remove the DC offset */
-  short *j = (short *) input_frame.GetPayloadPtr();
-  for (size_t i = 0 ; i < inputSize/sizeof(short) ; i++) {
-    mean = 0.999*mean + 0.001*j[i];
-    ((spx_int16_t *)ref_buf)[i] = j[i] - (short) mean;
-  }
-  
-  /* Read from the PQueueChannel a reference echo frame of the size
-   * of the captured frame. */
-  if (!echo_chan->Read((short *) echo_buf, input_frame.GetPayloadSize())) {
-    
+  OpalAudioDSP::RemoveDC(&state.m_ref[0], (const short *)input_frame.GetPayloadPtr(), samples, mean);
+
+  /* Get the reference echo frame of the size of the captured frame. */
+  bool haveReference = reference->Read(&state.m_echo[0], samples, state.m_clockRate);
+  echoDelay = reference->GetDelay();
+
+  if (!haveReference) {
     /* Nothing to read from the speaker signal, only suppress the noise
      * and return.
      */
-    speex_preprocess(preprocessState, (spx_int16_t *)ref_buf, NULL);
-    memcpy(input_frame.GetPayloadPtr(), (spx_int16_t *)ref_buf, input_frame.GetPayloadSize());
-
+    speex_preprocess(state.m_preprocessState, &state.m_ref[0], NULL);
+    memcpy(input_frame.GetPayloadPtr(), &state.m_ref[0], inputSize);
     return;
   }
-   
+
   /* Cancel the echo in this frame */
-#if OPAL_SPEEX_FLOAT_NOISE
-  speex_echo_cancel(echoState, (short *)ref_buf, (short *)echo_buf, (short *)e_buf, (float *)noise);
-#else
-  speex_echo_cancel(echoState, (short *)ref_buf, (short *)echo_buf, (short *)e_buf, (spx_int32_t *)noise);
-#endif
-  
+  speex_echo_cancel(state.m_echoState, &state.m_ref[0], &state.m_echo[0], &state.m_out[0], &state.m_noise[0]);
+
   /* Suppress the noise */
-#if OPAL_SPEEX_FLOAT_NOISE
-  speex_preprocess(preprocessState, (spx_int16_t *)e_buf, (float *)noise);
-#else
-  speex_preprocess(preprocessState, (spx_int16_t *)e_buf, (spx_int32_t *)noise);
-#endif
+  speex_preprocess(state.m_preprocessState, &state.m_out[0], &state.m_noise[0]);
 
   /* Use the result of the echo cancelation as capture frame */
-  memcpy(input_frame.GetPayloadPtr(), e_buf, input_frame.GetPayloadSize());
+  memcpy(input_frame.GetPayloadPtr(), &state.m_out[0], inputSize);
 }
 
 
@@ -124,6 +124,15 @@ OpalG711_PLC::OpalG711_PLC(int rate, int channels, double pitch_low, double pitc
   memset(hist_buf, 0, hist_len * channels);
 }
 
+/** Reset concealment state, as though just constructed.
+*/
+
+void OpalG711_PLC::reset()
+{
+  memset(channel, 0, channels * sizeof(channel_counters));
+  memset(hist_buf, 0, hist_len * channels * sizeof(short));
+}
+
 /** concealment destructor.
 * This function frees the memory.
 * @see OpalG711_PLC::construct
@@ -47,6 +47,38 @@ extern "C" {
 };
 
 
+/* The G.711 conversions are a segment search per sample, so precalculate
+   everything. Decode is a 256 entry table each, encode is indexed by the
+   16 bit sample, though A-law ignores the bottom three bits so is smaller. */
+struct OpalG711Tables
+{
+  short m_uLawToLinear[256];
+  short m_aLawToLinear[256];
+  BYTE  m_linearToULaw[65536];
+  BYTE  m_linearToALaw[65536>>3];
+
+  OpalG711Tables()
+  {
+    for (int i = 0; i < 256; ++i) {
+      m_uLawToLinear[i] = (short)ulaw2linear(i);
+      m_aLawToLinear[i] = (short)alaw2linear(i);
+    }
+
+    for (int i = -32768; i < 32768; ++i)
+      m_linearToULaw[(uint16_t)i] = (BYTE)linear2ulaw(i);
+
+    for (int i = -32768; i < 32768; i += 8)
+      m_linearToALaw[(uint16_t)i >> 3] = (BYTE)linear2alaw(i);
+  }
+};
+
+static const OpalG711Tables & GetG711Tables()
+{
+  static const OpalG711Tables tables;
+  return tables;
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -61,6 +93,14 @@ Opal_G711_PCM::Opal_G711_PCM(const OpalMediaFormat & inputMediaFormat)
 
 
 #if OPAL_G711PLC 
+bool Opal_G711_PCM::Reset()
+{
+  plc.reset();
+  lastPayloadSize = 0;
+  return OpalStreamedTranscoder::Reset();
+}
+
+
 PBoolean Opal_G711_PCM::Convert(const RTP_DataFrame & input, RTP_DataFrame & output)
 {
   PTRACE(7, "G.711\tPLC in_psz=" << input.GetPayloadSize()
@@ -109,6 +149,16 @@ int Opal_G711_uLaw_PCM::ConvertSample(int sample)
 }
 
 
+bool Opal_G711_uLaw_PCM::ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const
+{
+  const short * table = GetG711Tables().m_uLawToLinear;
+  short * out = (short *)output;
+  for (PINDEX i = 0; i < samples; ++i)
+    out[i] = table[input[i]];
+  return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 Opal_PCM_G711_uLaw::Opal_PCM_G711_uLaw()
@@ -130,6 +180,16 @@ int Opal_PCM_G711_uLaw::ConvertSample(int sample)
 }
 
 
+bool Opal_PCM_G711_uLaw::ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const
+{
+  const BYTE * table = GetG711Tables().m_linearToULaw;
+  const uint16_t * in = (const uint16_t *)input;
+  for (PINDEX i = 0; i < samples; ++i)
+    output[i] = table[in[i]];
+  return true;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 Opal_G711_ALaw_PCM::Opal_G711_ALaw_PCM()
@@ -150,6 +210,16 @@ int Opal_G711_ALaw_PCM::ConvertSample(int sample)
   return alaw2linear(sample);
 }
 
+
+bool Opal_G711_ALaw_PCM::ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const
+{
+  const short * table = GetG711Tables().m_aLawToLinear;
+  short * out = (short *)output;
+  for (PINDEX i = 0; i < samples; ++i)
+    out[i] = table[input[i]];
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 Opal_PCM_G711_ALaw::Opal_PCM_G711_ALaw()
@@ -171,4 +241,14 @@ int Opal_PCM_G711_ALaw::ConvertSample(int sample)
 }
 
 
+bool Opal_PCM_G711_ALaw::ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const
+{
+  const BYTE * table = GetG711Tables().m_linearToALaw;
+  const uint16_t * in = (const uint16_t *)input;
+  for (PINDEX i = 0; i < samples; ++i)
+    output[i] = table[in[i] >> 3];
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
@@ -594,6 +594,7 @@ OpalPluginTranscoder::OpalPluginTranscoder(const PluginCodec_Definition * defn,
   , freeOptionsControl(defn, PLUGINCODEC_CONTROL_FREE_CODEC_OPTIONS)
   , getOutputDataSizeControl(defn, PLUGINCODEC_CONTROL_GET_OUTPUT_DATA_SIZE)
   , getCodecStatistics(defn, PLUGINCODEC_CONTROL_GET_STATISTICS)
+  , resetCodecControl(defn, PLUGINCODEC_CONTROL_RESET_CODEC)
 {
 #if PTRACING
   m_firstLoggedUpdateOptions[true] = m_firstLoggedUpdateOptions[false] = true;
@@ -615,6 +616,13 @@ OpalPluginTranscoder::~OpalPluginTranscoder()
 }
 
 
+bool OpalPluginTranscoder::ResetCodec()
+{
+  // Plug ins without the control, or which fail it, cannot be re-used
+  return context != NULL && resetCodecControl.Exists() && resetCodecControl.Call(NULL, NULL, context) > 0;
+}
+
+
 bool OpalPluginTranscoder::UpdateOptions(OpalMediaFormat & fmt)
 {
   if (context == NULL)
@@ -700,12 +708,22 @@ OpalPluginFramedAudioTranscoder::OpalPluginFramedAudioTranscoder(const OpalTrans
                                                                  bool isEncoder)
   : OpalFramedTranscoder(key.first, key.second)
   , OpalPluginTranscoder(codecDefn, isEncoder)
+  , batchFunction(NULL)
 { 
   inputIsRTP          = (codecDef->flags & PluginCodec_InputTypeMask)  == PluginCodec_InputTypeRTP;
   outputIsRTP         = (codecDef->flags & PluginCodec_OutputTypeMask) == PluginCodec_OutputTypeRTP;
   comfortNoise        = (codecDef->flags & PluginCodec_ComfortNoiseMask) == PluginCodec_ComfortNoise;
   acceptEmptyPayload  = (codecDef->flags & PluginCodec_EmptyPayloadMask) == PluginCodec_EmptyPayload;
   acceptOtherPayloads = (codecDef->flags & PluginCodec_OtherPayloadMask) == PluginCodec_OtherPayload;
+
+  // Older plug ins do not have the control, so just convert a frame at a time
+  if (codecDef->version >= PLUGIN_CODEC_VERSION_BATCH) {
+    OpalPluginControl getBatchFunction(codecDef, PLUGINCODEC_CONTROL_GET_BATCH_FUNCTION);
+    unsigned len = sizeof(batchFunction);
+    if (getBatchFunction.Call(&batchFunction, &len, context) <= 0 || len != sizeof(batchFunction))
+      batchFunction = NULL;
+    PTRACE_IF(4, batchFunction != NULL, "OpalPlugin\tUsing batch conversion for \"" << codecDef->descr << '"');
+  }
 }
 
 
@@ -754,6 +772,75 @@ void OpalPluginFramedAudioTranscoder::GetStatistics(OpalMediaStatistics & statis
 #endif // OPAL_STATISTICS
 
 
+PBoolean OpalPluginFramedAudioTranscoder::Convert(const RTP_DataFrame & input, RTP_DataFrame & output)
+{
+  // Note updateMutex should already be locked at this point.
+
+  if (batchFunction == NULL || context == NULL || inputIsRTP || outputIsRTP)
+    return OpalFramedTranscoder::Convert(input, output);
+
+  /* Each batch entry is a single codec frame, not the inputBytesPerFrame
+     chunk which covers all the frames in a packet. */
+  PINDEX pcmBytesPerFrame = codecDef->parm.audio.samplesPerFrame*2;
+  PINDEX codedBytesPerFrame = codecDef->parm.audio.bytesPerFrame;
+  PINDEX inBytes  = isEncoder ? pcmBytesPerFrame : codedBytesPerFrame;
+  PINDEX outBytes = isEncoder ? codedBytesPerFrame : pcmBytesPerFrame;
+  if (inBytes == 0 || outBytes == 0)
+    return OpalFramedTranscoder::Convert(input, output);
+
+  // Only worth it, and only safe, when the payload is a whole number of frames
+  PINDEX inputLength = input.GetPayloadSize();
+  PINDEX frameCount = inputLength/inBytes;
+  if (frameCount < 2 || frameCount*inBytes != inputLength || frameCount*outBytes > maxOutputDataSize)
+    return OpalFramedTranscoder::Convert(input, output);
+
+  if (!output.SetPayloadSize(frameCount*outBytes))
+    return false;
+
+  const BYTE * inputPtr = input.GetPayloadPtr();
+  BYTE * outputPtr = output.GetPayloadPtr();
+
+  batchFrames.resize(frameCount);
+  PluginCodec_BatchFrame * frames = &batchFrames[0];
+  for (PINDEX i = 0; i < frameCount; ++i) {
+    frames[i].context = context;
+    frames[i].from    = inputPtr + i*inBytes;
+    frames[i].fromLen = inBytes;
+    frames[i].to      = outputPtr + i*outBytes;
+    frames[i].toLen   = outBytes;
+    frames[i].flags   = 0;
+  }
+
+  /* The plug in stops at the first frame that fails, and may have updated
+     the codec state with it, so it cannot be retried, the same as when a
+     single ConvertFrame() fails the whole packet. */
+  int converted = (*batchFunction)(codecDef, frames, frameCount);
+  if (converted != frameCount) {
+    PTRACE(4, "OpalPlugin\tBatch conversion failed at frame " << converted << " of " << frameCount);
+    return false;
+  }
+
+  // A plug in that did not take the whole frame has broken the batch contract
+  for (PINDEX i = 0; i < frameCount; ++i) {
+    if (frames[i].fromLen != (unsigned)inBytes) {
+      PTRACE(2, "OpalPlugin\tBatch conversion consumed " << frames[i].fromLen << " of " << inBytes << " bytes in frame " << i);
+      return false;
+    }
+  }
+
+  // Close up gaps left by frames that produced less than the maximum
+  PINDEX outLen = 0;
+  for (PINDEX i = 0; i < frameCount; ++i) {
+    if (frames[i].toLen > 0 && frames[i].to != outputPtr + outLen)
+      memmove(outputPtr + outLen, frames[i].to, frames[i].toLen);
+    outLen += frames[i].toLen;
+  }
+
+  output.SetPayloadSize(outLen);
+  return true;
+}
+
+
 PBoolean OpalPluginFramedAudioTranscoder::ConvertFrame(const BYTE * input,
                                                    PINDEX & consumed,
                                                    BYTE * output,
@@ -809,6 +896,13 @@ PBoolean OpalPluginFramedAudioTranscoder::ConvertSilentFrame(BYTE * buffer)
 }
 
 
+bool OpalPluginFramedAudioTranscoder::Reset()
+{
+  PWaitAndSignal mutex(updateMutex);
+  return ResetCodec();
+}
+
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Plugin streamed audio codec classes
@@ -858,6 +952,13 @@ int OpalPluginStreamedAudioTranscoder::ConvertOne(int from) const
 }
 
 
+bool OpalPluginStreamedAudioTranscoder::Reset()
+{
+  PWaitAndSignal mutex(updateMutex);
+  return OpalStreamedTranscoder::Reset() && ResetCodec();
+}
+
+
 #if OPAL_VIDEO
 
 /////////////////////////////////////////////////////////////////////////////
@@ -917,6 +1018,29 @@ PBoolean OpalPluginVideoTranscoder::ExecuteCommand(const OpalMediaCommand & comm
 }
 
 
+bool OpalPluginVideoTranscoder::Reset()
+{
+  PWaitAndSignal mutex(updateMutex);
+
+  if (!ResetCodec())
+    return false;
+
+  delete m_bufferRTP;
+  m_bufferRTP = NULL;
+  m_lastDecodedTimestamp = UINT_MAX;
+  m_lastMarkerTimestamp = UINT_MAX;
+  m_consecutiveMarkers = 0;
+  m_badMarkers = false;
+  m_totalFrames = 0;
+#if PTRACING
+  m_consecutiveIntraFrames = 0;
+#endif
+  m_frozenTillIFrame = false;
+  m_lastFrameWasIFrame = false;
+  return true;
+}
+
+
 PBoolean OpalPluginVideoTranscoder::ConvertFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList)
 {
   if (context == NULL)
@@ -35,6 +35,7 @@
 #include <opal_config.h>
 
 #include <codec/silencedetect.h>
+#include <codec/audiodsp.h>
 #include <opal/patch.h>
 
 #define new PNEW
@@ -313,18 +314,16 @@ void OpalSilenceDetector::ReceivedPacket(RTP_DataFrame & frame, P_INT_PTR)
 unsigned OpalPCM16SilenceDetector::GetAverageSignalLevel(const BYTE * buffer, PINDEX size)
 {
   // Calculate the average signal level of this frame
-  int sum = 0;
-  PINDEX samples = size/2;
-  const short * pcm = (const short *)buffer;
-  const short * end = pcm + samples;
-  while (pcm != end) {
-    if (*pcm < 0)
-      sum -= *pcm++;
-    else
-      sum += *pcm++;
-  }
+  return CalculateAverageLevel((const short *)buffer, size/2);
+}
+
+
+unsigned OpalPCM16SilenceDetector::CalculateAverageLevel(const short * pcm, PINDEX samples)
+{
+  if (samples <= 0)
+    return 0;
 
-  return sum/samples;
+  return OpalAudioDSP::AverageLevel(pcm, samples);
 }
 
 
@@ -39,8 +39,10 @@
 #include <opal/patch.h>
 #include <rtp/rtp.h>
 #include <rtp/jitter.h>
+#include <codec/audiodsp.h>
 #include <ptlib/vconvert.h>
 #include <ptclib/pwavfile.h>
+#include <ptclib/threadpool.h>
 #include <sip/handlers.h>
 #include <sip/sipcon.h>
 
@@ -257,6 +259,291 @@ bool OpalBaseMixer::OnMixed(RTP_DataFrame * & /*mixed*/)
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+#define MIX_SATURATE_LIMIT 32765
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #include <immintrin.h>
+  #define OPAL_MIX_SSE2 1
+  #define OPAL_MIX_AVX2 1
+  #define OPAL_MIX_TARGET(t) __attribute__((target(t)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+  #include <emmintrin.h>
+  #define OPAL_MIX_SSE2 1
+  #define OPAL_MIX_TARGET(t)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #include <arm_neon.h>
+  #define OPAL_MIX_NEON 1
+#endif
+
+
+static void AccumulateScalar(int * mixed, const short * const * buffers, size_t streamCount, unsigned samples)
+{
+  for (unsigned samp = 0; samp < samples; ++samp) {
+    int value = 0;
+    for (size_t strm = 0; strm < streamCount; ++strm)
+      value += buffers[strm][samp];
+    mixed[samp] = value;
+  }
+}
+
+
+static void SaturateScalar(short * dst, const int * mixed, const short * subtract, unsigned samples)
+{
+  for (unsigned i = 0; i < samples; ++i) {
+    int value = mixed[i];
+    if (subtract != NULL)
+      value -= subtract[i];
+    if (value < -MIX_SATURATE_LIMIT)
+      value = -MIX_SATURATE_LIMIT;
+    else if (value > MIX_SATURATE_LIMIT)
+      value = MIX_SATURATE_LIMIT;
+    dst[i] = (short)value;
+  }
+}
+
+
+#if OPAL_MIX_SSE2
+OPAL_MIX_TARGET("sse2")
+static void AccumulateSSE2(int * mixed, const short * const * buffers, size_t streamCount, unsigned samples)
+{
+  unsigned samp = 0;
+  for (; samp+8 <= samples; samp += 8) {
+    __m128i lo = _mm_setzero_si128();
+    __m128i hi = _mm_setzero_si128();
+    for (size_t strm = 0; strm < streamCount; ++strm) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(buffers[strm]+samp));
+      lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+      hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+    }
+    _mm_storeu_si128((__m128i *)(mixed+samp), lo);
+    _mm_storeu_si128((__m128i *)(mixed+samp+4), hi);
+  }
+
+  if (samp < samples) {
+    const short ** tail = (const short **)alloca(streamCount*sizeof(short *));
+    for (size_t strm = 0; strm < streamCount; ++strm)
+      tail[strm] = buffers[strm]+samp;
+    AccumulateScalar(mixed+samp, tail, streamCount, samples-samp);
+  }
+}
+
+
+OPAL_MIX_TARGET("sse2")
+static void SaturateSSE2(short * dst, const int * mixed, const short * subtract, unsigned samples)
+{
+  const __m128i maxLimit = _mm_set1_epi16(MIX_SATURATE_LIMIT);
+  const __m128i minLimit = _mm_set1_epi16(-MIX_SATURATE_LIMIT);
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)(mixed+i));
+    __m128i hi = _mm_loadu_si128((const __m128i *)(mixed+i+4));
+    if (subtract != NULL) {
+      __m128i x = _mm_loadu_si128((const __m128i *)(subtract+i));
+      lo = _mm_sub_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+      hi = _mm_sub_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+    }
+    // Pack saturates to +/-32767, then clamp further to our limit
+    __m128i result = _mm_packs_epi32(lo, hi);
+    result = _mm_min_epi16(_mm_max_epi16(result, minLimit), maxLimit);
+    _mm_storeu_si128((__m128i *)(dst+i), result);
+  }
+
+  SaturateScalar(dst+i, mixed+i, subtract != NULL ? subtract+i : NULL, samples-i);
+}
+#endif // OPAL_MIX_SSE2
+
+
+#if OPAL_MIX_AVX2
+OPAL_MIX_TARGET("avx2")
+static void AccumulateAVX2(int * mixed, const short * const * buffers, size_t streamCount, unsigned samples)
+{
+  unsigned samp = 0;
+  for (; samp+16 <= samples; samp += 16) {
+    __m256i lo = _mm256_setzero_si256();
+    __m256i hi = _mm256_setzero_si256();
+    for (size_t strm = 0; strm < streamCount; ++strm) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(buffers[strm]+samp));
+      lo = _mm256_add_epi32(lo, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+      hi = _mm256_add_epi32(hi, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+    }
+    _mm256_storeu_si256((__m256i *)(mixed+samp), lo);
+    _mm256_storeu_si256((__m256i *)(mixed+samp+8), hi);
+  }
+
+  if (samp < samples) {
+    const short ** tail = (const short **)alloca(streamCount*sizeof(short *));
+    for (size_t strm = 0; strm < streamCount; ++strm)
+      tail[strm] = buffers[strm]+samp;
+    AccumulateSSE2(mixed+samp, tail, streamCount, samples-samp);
+  }
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static void SaturateAVX2(short * dst, const int * mixed, const short * subtract, unsigned samples)
+{
+  const __m256i maxLimit = _mm256_set1_epi16(MIX_SATURATE_LIMIT);
+  const __m256i minLimit = _mm256_set1_epi16(-MIX_SATURATE_LIMIT);
+
+  unsigned i = 0;
+  for (; i+16 <= samples; i += 16) {
+    __m256i lo = _mm256_loadu_si256((const __m256i *)(mixed+i));
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(mixed+i+8));
+    if (subtract != NULL) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(subtract+i));
+      lo = _mm256_sub_epi32(lo, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x)));
+      hi = _mm256_sub_epi32(hi, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1)));
+    }
+    // Pack works within 128 bit lanes, so need to put the quad words back in order
+    __m256i result = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8);
+    result = _mm256_min_epi16(_mm256_max_epi16(result, minLimit), maxLimit);
+    _mm256_storeu_si256((__m256i *)(dst+i), result);
+  }
+
+  SaturateSSE2(dst+i, mixed+i, subtract != NULL ? subtract+i : NULL, samples-i);
+}
+#endif // OPAL_MIX_AVX2
+
+
+#if OPAL_MIX_NEON
+static void AccumulateNEON(int * mixed, const short * const * buffers, size_t streamCount, unsigned samples)
+{
+  unsigned samp = 0;
+  for (; samp+8 <= samples; samp += 8) {
+    int32x4_t lo = vdupq_n_s32(0);
+    int32x4_t hi = vdupq_n_s32(0);
+    for (size_t strm = 0; strm < streamCount; ++strm) {
+      int16x8_t x = vld1q_s16(buffers[strm]+samp);
+      lo = vaddw_s16(lo, vget_low_s16(x));
+      hi = vaddw_s16(hi, vget_high_s16(x));
+    }
+    vst1q_s32(mixed+samp, lo);
+    vst1q_s32(mixed+samp+4, hi);
+  }
+
+  if (samp < samples) {
+    const short ** tail = (const short **)alloca(streamCount*sizeof(short *));
+    for (size_t strm = 0; strm < streamCount; ++strm)
+      tail[strm] = buffers[strm]+samp;
+    AccumulateScalar(mixed+samp, tail, streamCount, samples-samp);
+  }
+}
+
+
+static void SaturateNEON(short * dst, const int * mixed, const short * subtract, unsigned samples)
+{
+  const int16x8_t maxLimit = vdupq_n_s16(MIX_SATURATE_LIMIT);
+  const int16x8_t minLimit = vdupq_n_s16(-MIX_SATURATE_LIMIT);
+
+  unsigned i = 0;
+  for (; i+8 <= samples; i += 8) {
+    int32x4_t lo = vld1q_s32(mixed+i);
+    int32x4_t hi = vld1q_s32(mixed+i+4);
+    if (subtract != NULL) {
+      int16x8_t x = vld1q_s16(subtract+i);
+      lo = vsubw_s16(lo, vget_low_s16(x));
+      hi = vsubw_s16(hi, vget_high_s16(x));
+    }
+    int16x8_t result = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+    vst1q_s16(dst+i, vminq_s16(vmaxq_s16(result, minLimit), maxLimit));
+  }
+
+  SaturateScalar(dst+i, mixed+i, subtract != NULL ? subtract+i : NULL, samples-i);
+}
+#endif // OPAL_MIX_NEON
+
+
+struct OpalMixKernelFunctions
+{
+  void (*m_accumulate)(int * mixed, const short * const * buffers, size_t streamCount, unsigned samples);
+  void (*m_saturate)(short * dst, const int * mixed, const short * subtract, unsigned samples);
+};
+
+static const OpalMixKernelFunctions MixKernelFunctions[OpalAudioMixer::NumMixKernels] = {
+  { AccumulateScalar, SaturateScalar },
+#if OPAL_MIX_SSE2
+  { AccumulateSSE2, SaturateSSE2 },
+#else
+  { NULL, NULL },
+#endif
+#if OPAL_MIX_AVX2
+  { AccumulateAVX2, SaturateAVX2 },
+#else
+  { NULL, NULL },
+#endif
+#if OPAL_MIX_NEON
+  { AccumulateNEON, SaturateNEON }
+#else
+  { NULL, NULL }
+#endif
+};
+
+
+static bool IsMixKernelSupported(OpalAudioMixer::MixKernel kernel)
+{
+  if (kernel < 0 || kernel >= OpalAudioMixer::NumMixKernels || MixKernelFunctions[kernel].m_accumulate == NULL)
+    return false;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init(); // May be called during static initialisation
+  switch (kernel) {
+    case OpalAudioMixer::MixKernelSSE2 :
+      return __builtin_cpu_supports("sse2");
+    case OpalAudioMixer::MixKernelAVX2 :
+      return __builtin_cpu_supports("avx2");
+    default :
+      break;
+  }
+#endif
+
+  return true;
+}
+
+
+OpalAudioMixer::MixKernel OpalAudioMixer::GetBestMixKernel()
+{
+  static const MixKernel Preferred[] = { MixKernelAVX2, MixKernelNEON, MixKernelSSE2 };
+  for (PINDEX i = 0; i < PARRAYSIZE(Preferred); ++i) {
+    if (IsMixKernelSupported(Preferred[i]))
+      return Preferred[i];
+  }
+  return MixKernelScalar;
+}
+
+
+static OpalAudioMixer::MixKernel CurrentMixKernel = OpalAudioMixer::GetBestMixKernel();
+
+OpalAudioMixer::MixKernel OpalAudioMixer::GetMixKernel()
+{
+  return CurrentMixKernel;
+}
+
+
+bool OpalAudioMixer::SetMixKernel(MixKernel kernel)
+{
+  if (!IsMixKernelSupported(kernel))
+    return false;
+
+  CurrentMixKernel = kernel;
+  return true;
+}
+
+
+void OpalAudioMixer::AccumulateSamples(int * mixed, const short * const * buffers, size_t streamCount, unsigned samples)
+{
+  MixKernelFunctions[CurrentMixKernel].m_accumulate(mixed, buffers, streamCount, samples);
+}
+
+
+void OpalAudioMixer::SubtractAndSaturate(short * dst, const int * mixed, const short * subtract, unsigned samples)
+{
+  MixKernelFunctions[CurrentMixKernel].m_saturate(dst, mixed, subtract, samples);
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalAudioMixer::OpalAudioMixer(bool stereo,
@@ -268,6 +555,7 @@ OpalAudioMixer::OpalAudioMixer(bool stereo,
   , m_sampleRate(sampleRate)
   , m_left(NULL)
   , m_right(NULL)
+  , m_maxTalkers(0)
 {
   m_mixedAudio.resize(m_periodTS);
 }
@@ -376,15 +664,47 @@ void OpalAudioMixer::PreMixStreams()
   size_t streamCount = m_inputStreams.size();
   const short ** buffers = (const short **)alloca(streamCount*sizeof(short *));
 
+  if (m_maxTalkers == 0 || streamCount <= m_maxTalkers) {
+    size_t i = 0;
+    for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter, ++i) {
+      AudioStream * stream = (AudioStream *)iter->second;
+      buffers[i] = stream->GetAudioDataPtr();
+      stream->m_mixed = true;
+    }
+    AccumulateSamples(&m_mixedAudio[0], buffers, streamCount, m_periodTS);
+    return;
+  }
+
+  /* More streams than talkers allowed, so rank them by level. All streams
+     still need to be read, to keep their jitter buffers moving and their
+     levels up to date. Silent streams have a level of zero and so are never
+     picked over someone talking. */
+  m_talkerRanking.resize(streamCount);
   size_t i = 0;
-  for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter, ++i)
-    buffers[i] = ((AudioStream *)iter->second)->GetAudioDataPtr();
+  for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter, ++i) {
+    AudioStream * stream = (AudioStream *)iter->second;
+    const short * audio = stream->GetAudioDataPtr();
+    unsigned level = stream->m_contributed ? OpalAudioDSP::AverageLevel(audio, m_periodTS) : 0;
+    stream->m_level = (stream->m_level*3 + level)/4; // Smooth so talkers do not flicker in and out
+    stream->m_mixed = false;
+    m_talkerRanking[i] = TalkerRanking::value_type(stream->m_level, stream);
+  }
 
-  for (unsigned samp = 0; samp < m_periodTS; ++samp) {
-    m_mixedAudio[samp] = 0;
-    for (size_t strm = 0; strm < streamCount; ++strm)
-      m_mixedAudio[samp] += *(buffers[strm])++;
+  std::nth_element(m_talkerRanking.begin(),
+                   m_talkerRanking.begin()+m_maxTalkers,
+                   m_talkerRanking.end(),
+                   std::greater<TalkerRanking::value_type>());
+
+  size_t talkers = 0;
+  for (i = 0; i < m_maxTalkers; ++i) {
+    AudioStream * stream = m_talkerRanking[i].second;
+    if (m_talkerRanking[i].first > 0) {
+      buffers[talkers++] = stream->m_cacheSamples;
+      stream->m_mixed = true;
+    }
   }
+
+  AccumulateSamples(&m_mixedAudio[0], buffers, talkers, m_periodTS);
 }
 
 
@@ -439,17 +759,7 @@ void OpalAudioMixer::MixAdditive(RTP_DataFrame & frame, const short * audioToSub
   if (size == 0)
     frame.SetTimestamp(m_outputTimestamp);
 
-  short * dst = (short *)(frame.GetPayloadPtr()+size);
-  for (unsigned i = 0; i < m_periodTS; ++i) {
-    int value = m_mixedAudio[i];
-    if (audioToSubtract != NULL)
-      value -= *audioToSubtract++;
-    if (value < -32765)
-      value = -32765;
-    else if (value > 32765)
-      value = 32765;
-    *dst++ = (short)value;
-  }
+  SubtractAndSaturate((short *)(frame.GetPayloadPtr()+size), &m_mixedAudio[0], audioToSubtract, m_periodTS);
 }
 
 
@@ -465,6 +775,9 @@ OpalAudioMixer::AudioStream::AudioStream(OpalAudioMixer & mixer)
   , m_nextTimestamp(0)
   , m_cacheSamples(mixer.GetPeriodTS())
   , m_samplesUsed(0)
+  , m_contributed(false)
+  , m_level(0)
+  , m_mixed(false)
 {
 }
 
@@ -519,6 +832,8 @@ const short * OpalAudioMixer::AudioStream::GetAudioDataPtr()
     }
   }
 
+  m_contributed = samplesLeft < m_mixer.GetPeriodTS();
+
   if (samplesLeft > 0) {
     memset(cachePtr, 0, samplesLeft*sizeof(short)); // Silence
     m_nextTimestamp += samplesLeft;
@@ -532,6 +847,379 @@ const short * OpalAudioMixer::AudioStream::GetAudioDataPtr()
 
 #if OPAL_VIDEO
 
+#if OPAL_MIX_AVX2
+  #define OPAL_SCALE_SSE4 1
+#endif
+
+
+/* Area averaging of a FxF block is done as a multiply by a 16 bit
+   reciprocal and taking the high word, which is exact for all the sums we can
+   get and maps directly onto the SIMD "multiply high" instructions. */
+#define SCALE_RECIPROCAL(factor) ((65536+(factor)*(factor)-1)/((factor)*(factor)))
+#define SCALE_AVERAGE(sum, factor) (BYTE)((((sum)+(factor)*(factor)/2)*SCALE_RECIPROCAL(factor)) >> 16)
+
+typedef void (*DownscaleFunction)(BYTE * dst, const BYTE * src, unsigned stride, unsigned width);
+
+template <unsigned Factor>
+static void DownscaleScalar(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  for (unsigned x = 0; x < width; ++x, src += Factor) {
+    unsigned sum = 0;
+    for (unsigned row = 0; row < Factor; ++row) {
+      for (unsigned col = 0; col < Factor; ++col)
+        sum += src[row*stride+col];
+    }
+    dst[x] = SCALE_AVERAGE(sum, Factor);
+  }
+}
+
+
+#if OPAL_SCALE_SSE4
+OPAL_MIX_TARGET("sse4.1")
+static void StoreAverageSSE4(BYTE * dst, __m128i sum, unsigned factor)
+{
+  sum = _mm_add_epi16(sum, _mm_set1_epi16((short)(factor*factor/2)));
+  sum = _mm_mulhi_epu16(sum, _mm_set1_epi16((short)SCALE_RECIPROCAL(factor)));
+  _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(sum, sum));
+}
+
+
+OPAL_MIX_TARGET("sse4.1")
+static __m128i HorizontalSum2SSE4(const BYTE * src)
+{
+  return _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *)src), _mm_set1_epi8(1));
+}
+
+
+OPAL_MIX_TARGET("sse4.1")
+static __m128i HorizontalSum3SSE4(const BYTE * src)
+{
+  // Gather pixels 3n and 3n+1 as byte pairs to add, and 3n+2 as words
+  const __m128i v0 = _mm_loadu_si128((const __m128i *)src);
+  const __m128i v1 = _mm_loadu_si128((const __m128i *)(src+8));
+  __m128i pairs = _mm_or_si128(_mm_shuffle_epi8(v0, _mm_setr_epi8(0, 1, 3, 4, 6, 7, 9, 10, 12, 13, -1, -1, -1, -1, -1, -1)),
+                               _mm_shuffle_epi8(v1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 7, 8, 10, 11, 13, 14)));
+  __m128i third = _mm_or_si128(_mm_shuffle_epi8(v0, _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1)),
+                               _mm_shuffle_epi8(v1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, -1, 12, -1, 15, -1)));
+  return _mm_add_epi16(_mm_maddubs_epi16(pairs, _mm_set1_epi8(1)), third);
+}
+
+
+OPAL_MIX_TARGET("sse4.1")
+static __m128i HorizontalSum4SSE4(const BYTE * src)
+{
+  return _mm_hadd_epi16(HorizontalSum2SSE4(src), HorizontalSum2SSE4(src+16));
+}
+
+
+OPAL_MIX_TARGET("sse4.1")
+static void Downscale2SSE4(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+8 <= width; x += 8, src += 16)
+    StoreAverageSSE4(dst+x, _mm_add_epi16(HorizontalSum2SSE4(src), HorizontalSum2SSE4(src+stride)), 2);
+  DownscaleScalar<2>(dst+x, src, stride, width-x);
+}
+
+
+OPAL_MIX_TARGET("sse4.1")
+static void Downscale3SSE4(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+8 <= width; x += 8, src += 24)
+    StoreAverageSSE4(dst+x, _mm_add_epi16(_mm_add_epi16(HorizontalSum3SSE4(src),
+                                                        HorizontalSum3SSE4(src+stride)),
+                                                        HorizontalSum3SSE4(src+stride*2)), 3);
+  DownscaleScalar<3>(dst+x, src, stride, width-x);
+}
+
+
+OPAL_MIX_TARGET("sse4.1")
+static void Downscale4SSE4(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+8 <= width; x += 8, src += 32)
+    StoreAverageSSE4(dst+x, _mm_add_epi16(_mm_add_epi16(HorizontalSum4SSE4(src),          HorizontalSum4SSE4(src+stride)),
+                                          _mm_add_epi16(HorizontalSum4SSE4(src+stride*2), HorizontalSum4SSE4(src+stride*3))), 4);
+  DownscaleScalar<4>(dst+x, src, stride, width-x);
+}
+#endif // OPAL_SCALE_SSE4
+
+
+#if OPAL_MIX_AVX2
+OPAL_MIX_TARGET("avx2")
+static void StoreAverageAVX2(BYTE * dst, __m256i sum, unsigned factor)
+{
+  sum = _mm256_add_epi16(sum, _mm256_set1_epi16((short)(factor*factor/2)));
+  sum = _mm256_mulhi_epu16(sum, _mm256_set1_epi16((short)SCALE_RECIPROCAL(factor)));
+  // Pack works within 128 bit lanes, so need to bring the two results together
+  __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+  _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(packed));
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static __m256i HorizontalSum2AVX2(const BYTE * src)
+{
+  return _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)src), _mm256_set1_epi8(1));
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static __m256i HorizontalSum3AVX2(const BYTE * src)
+{
+  // As for SSE4, with the upper lane doing the next eight output pixels
+  const __m256i v0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)src)),
+                                             _mm_loadu_si128((const __m128i *)(src+24)), 1);
+  const __m256i v1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src+8))),
+                                             _mm_loadu_si128((const __m128i *)(src+32)), 1);
+  __m256i pairs = _mm256_or_si256(_mm256_shuffle_epi8(v0, _mm256_setr_epi8(0, 1, 3, 4, 6, 7, 9, 10, 12, 13, -1, -1, -1, -1, -1, -1,
+                                                                           0, 1, 3, 4, 6, 7, 9, 10, 12, 13, -1, -1, -1, -1, -1, -1)),
+                                  _mm256_shuffle_epi8(v1, _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 7, 8, 10, 11, 13, 14,
+                                                                           -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 7, 8, 10, 11, 13, 14)));
+  __m256i third = _mm256_or_si256(_mm256_shuffle_epi8(v0, _mm256_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1,
+                                                                           2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1)),
+                                  _mm256_shuffle_epi8(v1, _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, -1, 12, -1, 15, -1,
+                                                                           -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 9, -1, 12, -1, 15, -1)));
+  return _mm256_add_epi16(_mm256_maddubs_epi16(pairs, _mm256_set1_epi8(1)), third);
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static __m256i HorizontalSum4AVX2(const BYTE * src)
+{
+  // Horizontal add works within 128 bit lanes, so need to put the quad words back in order
+  return _mm256_permute4x64_epi64(_mm256_hadd_epi16(HorizontalSum2AVX2(src), HorizontalSum2AVX2(src+32)), 0xd8);
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static void Downscale2AVX2(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+16 <= width; x += 16, src += 32)
+    StoreAverageAVX2(dst+x, _mm256_add_epi16(HorizontalSum2AVX2(src), HorizontalSum2AVX2(src+stride)), 2);
+  Downscale2SSE4(dst+x, src, stride, width-x);
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static void Downscale3AVX2(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+16 <= width; x += 16, src += 48)
+    StoreAverageAVX2(dst+x, _mm256_add_epi16(_mm256_add_epi16(HorizontalSum3AVX2(src),
+                                                              HorizontalSum3AVX2(src+stride)),
+                                                              HorizontalSum3AVX2(src+stride*2)), 3);
+  Downscale3SSE4(dst+x, src, stride, width-x);
+}
+
+
+OPAL_MIX_TARGET("avx2")
+static void Downscale4AVX2(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+16 <= width; x += 16, src += 64)
+    StoreAverageAVX2(dst+x, _mm256_add_epi16(_mm256_add_epi16(HorizontalSum4AVX2(src),          HorizontalSum4AVX2(src+stride)),
+                                             _mm256_add_epi16(HorizontalSum4AVX2(src+stride*2), HorizontalSum4AVX2(src+stride*3))), 4);
+  Downscale4SSE4(dst+x, src, stride, width-x);
+}
+#endif // OPAL_MIX_AVX2
+
+
+#if OPAL_MIX_NEON
+static void StoreAverageNEON(BYTE * dst, uint16x8_t sum, unsigned factor)
+{
+  const uint16x4_t reciprocal = vdup_n_u16(SCALE_RECIPROCAL(factor));
+  sum = vaddq_u16(sum, vdupq_n_u16(factor*factor/2));
+  uint16x4_t lo = vshrn_n_u32(vmull_u16(vget_low_u16(sum), reciprocal), 16);
+  uint16x4_t hi = vshrn_n_u32(vmull_u16(vget_high_u16(sum), reciprocal), 16);
+  vst1_u8(dst, vmovn_u16(vcombine_u16(lo, hi)));
+}
+
+
+static uint16x8_t HorizontalSum2NEON(const BYTE * src)
+{
+  uint8x8x2_t v = vld2_u8(src);
+  return vaddl_u8(v.val[0], v.val[1]);
+}
+
+
+static uint16x8_t HorizontalSum3NEON(const BYTE * src)
+{
+  uint8x8x3_t v = vld3_u8(src);
+  return vaddw_u8(vaddl_u8(v.val[0], v.val[1]), v.val[2]);
+}
+
+
+static uint16x8_t HorizontalSum4NEON(const BYTE * src)
+{
+  uint8x8x4_t v = vld4_u8(src);
+  return vaddq_u16(vaddl_u8(v.val[0], v.val[1]), vaddl_u8(v.val[2], v.val[3]));
+}
+
+
+static void Downscale2NEON(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+8 <= width; x += 8, src += 16)
+    StoreAverageNEON(dst+x, vaddq_u16(HorizontalSum2NEON(src), HorizontalSum2NEON(src+stride)), 2);
+  DownscaleScalar<2>(dst+x, src, stride, width-x);
+}
+
+
+static void Downscale3NEON(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+8 <= width; x += 8, src += 24)
+    StoreAverageNEON(dst+x, vaddq_u16(vaddq_u16(HorizontalSum3NEON(src),
+                                                HorizontalSum3NEON(src+stride)),
+                                                HorizontalSum3NEON(src+stride*2)), 3);
+  DownscaleScalar<3>(dst+x, src, stride, width-x);
+}
+
+
+static void Downscale4NEON(BYTE * dst, const BYTE * src, unsigned stride, unsigned width)
+{
+  unsigned x = 0;
+  for (; x+8 <= width; x += 8, src += 32)
+    StoreAverageNEON(dst+x, vaddq_u16(vaddq_u16(HorizontalSum4NEON(src),          HorizontalSum4NEON(src+stride)),
+                                      vaddq_u16(HorizontalSum4NEON(src+stride*2), HorizontalSum4NEON(src+stride*3))), 4);
+  DownscaleScalar<4>(dst+x, src, stride, width-x);
+}
+#endif // OPAL_MIX_NEON
+
+
+struct OpalScaleKernelFunctions
+{
+  DownscaleFunction m_downscale[3]; // Factors 2, 3 and 4
+};
+
+static const OpalScaleKernelFunctions ScaleKernelFunctions[OpalVideoMixer::NumScaleKernels] = {
+  { { DownscaleScalar<2>, DownscaleScalar<3>, DownscaleScalar<4> } },
+#if OPAL_SCALE_SSE4
+  { { Downscale2SSE4, Downscale3SSE4, Downscale4SSE4 } },
+#else
+  { { NULL, NULL, NULL } },
+#endif
+#if OPAL_MIX_AVX2
+  { { Downscale2AVX2, Downscale3AVX2, Downscale4AVX2 } },
+#else
+  { { NULL, NULL, NULL } },
+#endif
+#if OPAL_MIX_NEON
+  { { Downscale2NEON, Downscale3NEON, Downscale4NEON } }
+#else
+  { { NULL, NULL, NULL } }
+#endif
+};
+
+
+static bool IsScaleKernelSupported(OpalVideoMixer::ScaleKernel kernel)
+{
+  if (kernel < 0 || kernel >= OpalVideoMixer::NumScaleKernels || ScaleKernelFunctions[kernel].m_downscale[0] == NULL)
+    return false;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init(); // May be called during static initialisation
+  switch (kernel) {
+    case OpalVideoMixer::ScaleKernelSSE4 :
+      return __builtin_cpu_supports("sse4.1");
+    case OpalVideoMixer::ScaleKernelAVX2 :
+      return __builtin_cpu_supports("avx2");
+    default :
+      break;
+  }
+#endif
+
+  return true;
+}
+
+
+OpalVideoMixer::ScaleKernel OpalVideoMixer::GetBestScaleKernel()
+{
+  static const ScaleKernel Preferred[] = { ScaleKernelAVX2, ScaleKernelNEON, ScaleKernelSSE4 };
+  for (PINDEX i = 0; i < PARRAYSIZE(Preferred); ++i) {
+    if (IsScaleKernelSupported(Preferred[i]))
+      return Preferred[i];
+  }
+  return ScaleKernelScalar;
+}
+
+
+static OpalVideoMixer::ScaleKernel CurrentScaleKernel = OpalVideoMixer::GetBestScaleKernel();
+
+OpalVideoMixer::ScaleKernel OpalVideoMixer::GetScaleKernel()
+{
+  return CurrentScaleKernel;
+}
+
+
+bool OpalVideoMixer::SetScaleKernel(ScaleKernel kernel)
+{
+  if (!IsScaleKernelSupported(kernel))
+    return false;
+
+  CurrentScaleKernel = kernel;
+  return true;
+}
+
+
+static void ScalePlane(const BYTE * src, unsigned srcStride,
+                       BYTE * dst, unsigned dstStride,
+                       unsigned width, unsigned height, unsigned factor)
+{
+  if (factor == 1) {
+    for (unsigned row = 0; row < height; ++row, src += srcStride, dst += dstStride)
+      memcpy(dst, src, width);
+    return;
+  }
+
+  DownscaleFunction downscale = ScaleKernelFunctions[CurrentScaleKernel].m_downscale[factor-2];
+  for (unsigned row = 0; row < height; ++row, src += srcStride*factor, dst += dstStride)
+    downscale(dst, src, srcStride, width);
+}
+
+
+void OpalVideoMixer::ScaleYUV420P(unsigned srcWidth, unsigned srcHeight, const BYTE * src,
+                                  unsigned x, unsigned y, unsigned width, unsigned height,
+                                  unsigned dstWidth, unsigned dstHeight, BYTE * dst)
+{
+  /* Use our kernels if the scale is an integer, ignoring the few pixels lost
+     when the tile size was rounded down to a multiple of four. */
+  unsigned factor = width > 0 && height > 0 ? srcWidth/width : 0;
+  if (factor < 1 || factor > 4 || srcHeight/height != factor ||
+      srcWidth - width*factor >= factor*4 || srcHeight - height*factor >= factor*4 ||
+      ((srcWidth | srcHeight | x | y | width | height | dstWidth | dstHeight) & 1) != 0 ||
+      x + width > dstWidth || y + height > dstHeight) {
+    PColourConverter::CopyYUV420P(0, 0, srcWidth, srcHeight,
+                                  srcWidth, srcHeight, src,
+                                  x, y, width, height,
+                                  dstWidth, dstHeight, dst,
+                                  PVideoFrameInfo::eScale);
+    return;
+  }
+
+  // Crop evenly from both sides, keeping to even pixels for the chroma planes
+  unsigned cropX = ((srcWidth - width*factor)/2) & ~1;
+  unsigned cropY = ((srcHeight - height*factor)/2) & ~1;
+
+  const BYTE * srcU = src + srcWidth*srcHeight;
+  const BYTE * srcV = srcU + srcWidth*srcHeight/4;
+  BYTE * dstU = dst + dstWidth*dstHeight;
+  BYTE * dstV = dstU + dstWidth*dstHeight/4;
+
+  ScalePlane(src + cropY*srcWidth + cropX, srcWidth,
+             dst + y*dstWidth + x, dstWidth,
+             width, height, factor);
+
+  unsigned srcOffset = (cropY/2)*(srcWidth/2) + cropX/2;
+  unsigned dstOffset = (y/2)*(dstWidth/2) + x/2;
+  ScalePlane(srcU + srcOffset, srcWidth/2, dstU + dstOffset, dstWidth/2, width/2, height/2, factor);
+  ScalePlane(srcV + srcOffset, srcWidth/2, dstV + dstOffset, dstWidth/2, width/2, height/2, factor);
+}
+
+
 OpalVideoMixer::OpalVideoMixer(Styles style, unsigned width, unsigned height, unsigned rate, bool pushThread)
   : OpalBaseMixer(pushThread, 1000/rate, OpalMediaFormat::VideoClockRate/rate)
   , m_style(style)
@@ -539,6 +1227,7 @@ OpalVideoMixer::OpalVideoMixer(Styles style, unsigned width, unsigned height, un
   , m_bgFillGreen(0)
   , m_bgFillBlue(0)
   , m_lastStreamCount(0)
+  , m_layoutGeneration(0)
 {
   SetFrameSize(width, height);
 }
@@ -568,6 +1257,7 @@ bool OpalVideoMixer::SetFrameSize(unsigned width, unsigned height)
   PColourConverter::FillYUV420P(0, 0, m_width, m_height, m_width, m_height,
                                 m_frameStore.GetPointer(m_width*m_height*3/2),
                                 m_bgFillRed, m_bgFillGreen, m_bgFillBlue);
+  ++m_layoutGeneration;
 
   m_mutex.Signal();
   return true;
@@ -595,8 +1285,53 @@ bool OpalVideoMixer::MixStreams(RTP_DataFrame & frame)
 }
 
 
+/* Threshold of tiles in a mixed frame before the work is spread across the
+   video mix worker pool. Below this the hand off costs more than it saves. */
+#define VIDEO_PARALLEL_THRESHOLD 4
+
+class OpalVideoMixWork
+{
+  public:
+    OpalVideoMixWork(OpalVideoMixer & mixer,
+                     const OpalVideoMixer::StreamMap_T::iterator & stream,
+                     unsigned x, unsigned y, unsigned w, unsigned h,
+                     PSemaphore & done)
+      : m_mixer(mixer)
+      , m_stream(stream)
+      , m_x(x)
+      , m_y(y)
+      , m_w(w)
+      , m_h(h)
+      , m_done(done)
+    {
+    }
+
+    void Work()
+    {
+      m_mixer.InsertVideoFrame(m_stream, m_x, m_y, m_w, m_h);
+      m_done.Signal();
+    }
+
+  protected:
+    OpalVideoMixer                      & m_mixer;
+    OpalVideoMixer::StreamMap_T::iterator m_stream;
+    unsigned                              m_x, m_y, m_w, m_h;
+    PSemaphore                          & m_done;
+};
+
+
+static PQueuedThreadPool<OpalVideoMixWork> & GetVideoMixPool()
+{
+  // Shared by all video mixers, one worker per core
+  static PQueuedThreadPool<OpalVideoMixWork> pool(PThread::GetNumProcessors(), 0, "VideoMix", PThread::HighestPriority);
+  return pool;
+}
+
+
 bool OpalVideoMixer::MixVideo()
 {
+  // Expected to already be mutexed
+
   // create output frame
   unsigned x, y, w, h, left;
   if (!StartMix(x, y, w, h, left))
@@ -607,12 +1342,45 @@ bool OpalVideoMixer::MixVideo()
   w &= 0xfffffffc;
   h &= 0xfffffffc;
 
-  for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter) {
-    InsertVideoFrame(iter, x, y, w, h);
+  size_t tileCount = m_inputStreams.size();
+  if (tileCount < VIDEO_PARALLEL_THRESHOLD || PThread::GetNumProcessors() < 2) {
+    for (StreamMap_T::iterator iter = m_inputStreams.begin(); iter != m_inputStreams.end(); ++iter) {
+      InsertVideoFrame(iter, x, y, w, h);
+      if (!NextMix(x, y, w, h, left))
+        break;
+    }
+    return true;
+  }
+
+  /* Tiles are separate regions of the frame store, so can be scaled and
+     copied concurrently. Make sure the store is not shared first, so
+     GetPointer() in the workers does not reallocate it. The last tile is
+     done on this thread, then wait for the rest before the frame goes to
+     the encoders. As m_mutex is held throughout, the input queues cannot
+     change underneath the workers. */
+  m_frameStore.MakeUnique();
+
+  PSemaphore done(0, INT_MAX);
+  PQueuedThreadPool<OpalVideoMixWork> & pool = GetVideoMixPool();
+  size_t queued = 0;
+  StreamMap_T::iterator iter = m_inputStreams.begin();
+  for (;;) {
+    StreamMap_T::iterator tile = iter++;
+    if (iter == m_inputStreams.end()) {
+      InsertVideoFrame(tile, x, y, w, h);
+      break;
+    }
+
+    pool.AddWork(new OpalVideoMixWork(*this, tile, x, y, w, h, done));
+    ++queued;
+
     if (!NextMix(x, y, w, h, left))
       break;
   }
 
+  while (queued-- > 0)
+    done.Wait();
+
   return true;
 }
 
@@ -656,6 +1424,7 @@ bool OpalVideoMixer::StartMix(unsigned & x, unsigned & y, unsigned & w, unsigned
                                       m_frameStore.GetPointer(),
                                       m_bgFillRed, m_bgFillGreen, m_bgFillBlue);
         m_lastStreamCount = m_inputStreams.size();
+        ++m_layoutGeneration;
       }
       switch (m_lastStreamCount) {
         case 0:
@@ -726,6 +1495,11 @@ size_t OpalVideoMixer::GetOutputSize() const
 
 OpalVideoMixer::VideoStream::VideoStream(OpalVideoMixer & mixer)
   : m_mixer(mixer)
+  , m_tileWidth(0)
+  , m_tileHeight(0)
+  , m_tileX(0)
+  , m_tileY(0)
+  , m_tileGeneration(0)
 {
 }
 
@@ -738,26 +1512,41 @@ void OpalVideoMixer::VideoStream::QueuePacket(const RTP_DataFrame & rtp)
 
 void OpalVideoMixer::VideoStream::InsertVideoFrame(unsigned x, unsigned y, unsigned w, unsigned h)
 {
-  if (m_queue.empty())
+  if (!m_queue.empty()) {
+    m_lastFrame = m_queue.front();
+    m_tileWidth = m_tileHeight = 0; // Need to rescale
+
+    /* To avoid continual build up of frames in queue if input frame rate
+       greater than mixer frame, we flush the queue, but keep one to allow for
+       slight mismatches in timing when frame rates are identical. */
+    do {
+      m_queue.pop();
+    } while (m_queue.size() > 1);
+  }
+  else if (m_tileWidth == w && m_tileHeight == h && m_tileX == x && m_tileY == y && m_tileGeneration == m_mixer.m_layoutGeneration)
+    return; // Frame store already has this tile
+
+  if (m_lastFrame.GetPayloadSize() < (PINDEX)sizeof(PluginCodec_Video_FrameHeader))
     return;
 
-  PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)m_queue.front().GetPayloadPtr();
+  if (m_tileWidth != w || m_tileHeight != h) {
+    const PluginCodec_Video_FrameHeader * header = (const PluginCodec_Video_FrameHeader *)m_lastFrame.GetPayloadPtr();
 
-  PTRACE(DETAIL_LOG_LEVEL, "Copying video: " << header->width << 'x' << header->height
-         << " -> " << x << ',' << y << '/' << w << 'x' << h);
+    PTRACE(DETAIL_LOG_LEVEL, "Scaling video: " << header->width << 'x' << header->height << " -> " << w << 'x' << h);
 
-  PColourConverter::CopyYUV420P(0, 0, header->width, header->height,
-                                header->width, header->height, OPAL_VIDEO_FRAME_DATA_PTR(header),
-                                x, y, w, h,
-                                m_mixer.m_width, m_mixer.m_height, m_mixer.m_frameStore.GetPointer(),
-                                PVideoFrameInfo::eScale);
+    OpalVideoMixer::ScaleYUV420P(header->width, header->height, OPAL_VIDEO_FRAME_DATA_PTR(header),
+                                 0, 0, w, h, w, h, m_tile.GetPointer(w*h*3/2));
+    m_tileWidth = w;
+    m_tileHeight = h;
+  }
+
+  PTRACE(DETAIL_LOG_LEVEL, "Copying video: " << w << 'x' << h << " -> " << x << ',' << y);
 
-  /* To avoid continual build up of frames in queue if input frame rate
-     greater than mixer frame, we flush the queue, but keep one to allow for
-     slight mismatches in timing when frame rates are identical. */
-  do {
-    m_queue.pop();
-  } while (m_queue.size() > 1);
+  OpalVideoMixer::ScaleYUV420P(w, h, m_tile, x, y, w, h,
+                               m_mixer.m_width, m_mixer.m_height, m_mixer.m_frameStore.GetPointer());
+  m_tileX = x;
+  m_tileY = y;
+  m_tileGeneration = m_mixer.m_layoutGeneration;
 }
 
 
@@ -1125,6 +1914,7 @@ OpalMixerMediaStream::OpalMixerMediaStream(OpalConnection & conn,
 #if OPAL_VIDEO
   , m_mixedVideoWidth(0)
   , m_mixedVideoHeight(0)
+  , m_keyFrameRequested(false)
 #endif
 {
   /* We are a bit sneaky here. OpalCall::OpenSourceMediaStream will have
@@ -1221,6 +2011,31 @@ bool OpalMixerMediaStream::CheckMixedVideoSize(unsigned width, unsigned height)
   m_mixedVideoHeight = height;
   return different;
 }
+
+
+bool OpalMixerMediaStream::CheckKeyFrameRequest()
+{
+  if (!m_keyFrameRequested)
+    return false;
+
+  /* A request arriving between the check and the reset is satisfied by the
+     key frame the caller is about to send. */
+  m_keyFrameRequested = false;
+  return true;
+}
+
+
+bool OpalMixerMediaStream::InternalExecuteCommand(const OpalMediaCommand & command)
+{
+  if (IsSource() && PIsDescendant(&command, OpalVideoUpdatePicture)) {
+    PTRACE_IF(3, !m_keyFrameRequested, "Key frame requested for mixer stream " << *this);
+    m_keyFrameRequested = true; // Reset when the encoder for the stream is told
+    OpalMediaStream::InternalExecuteCommand(command);
+    return true;
+  }
+
+  return OpalMediaStream::InternalExecuteCommand(command);
+}
 #endif
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1705,6 +2520,7 @@ OpalAudioStreamMixer::OpalAudioStreamMixer(const OpalMixerNodeInfo & info)
   , m_audioDebug(new PAudioMixerDebug(info.m_name))
 #endif
 {
+  SetMaxTalkers(info.m_maxAudioTalkers);
 }
 
 
@@ -1714,34 +2530,87 @@ OpalAudioStreamMixer::~OpalAudioStreamMixer()
 }
 
 
-void OpalAudioStreamMixer::PushOne(PSafePtr<OpalMixerMediaStream> & stream,
-                                   CachedAudio & cache,
-                                   const short * audioToSubtract)
+/* Threshold of distinct encodes in a mix period before the work is spread
+   across the mix worker pool. Below this the hand off costs more than it
+   saves. */
+#define MIX_PARALLEL_THRESHOLD 8
+
+class OpalAudioMixWork
+{
+  public:
+    OpalAudioMixWork(OpalAudioStreamMixer & mixer, OpalAudioStreamMixer::CachedAudio & cache, PSemaphore & done)
+      : m_mixer(mixer)
+      , m_cache(cache)
+      , m_done(done)
+    {
+    }
+
+    void Work()
+    {
+      m_mixer.MixAndPush(m_cache);
+      m_done.Signal();
+    }
+
+  protected:
+    OpalAudioStreamMixer              & m_mixer;
+    OpalAudioStreamMixer::CachedAudio & m_cache;
+    PSemaphore                        & m_done;
+};
+
+
+static PQueuedThreadPool<OpalAudioMixWork> & GetAudioMixPool()
+{
+  // Shared by all audio mixers, one worker per core
+  static PQueuedThreadPool<OpalAudioMixWork> pool(PThread::GetNumProcessors(), 0, "AudioMix", PThread::HighestPriority);
+  return pool;
+}
+
+
+void OpalAudioStreamMixer::MixAndPush(CachedAudio & cache)
+{
+  // Called without m_mutex, everything needed is in the cache entry
+
+  MixAdditive(cache.m_raw, cache.m_subtracting ? &cache.m_subtract[0] : NULL);
+  cache.m_state = CachedAudio::Collected;
+
+  for (std::vector< PSafePtr<OpalMixerMediaStream> >::iterator it = cache.m_streams.begin(); it != cache.m_streams.end(); ++it) {
+    if (it->SetSafetyMode(PSafeReadOnly))
+      PushOne(*it, cache, it == cache.m_streams.begin());
+  }
+
+  cache.m_streams.clear();
+}
+
+
+void OpalAudioStreamMixer::PushOne(PSafePtr<OpalMixerMediaStream> & stream, CachedAudio & cache, bool first)
 {
   MIXER_DEBUG_OUT(stream->GetID() << ',');
 
   switch (cache.m_state) {
     case CachedAudio::Collecting :
-      MixAdditive(cache.m_raw, audioToSubtract);
-      cache.m_state = CachedAudio::Collected;
-      m_mutex.Signal();
-      break;
+      PAssertAlways(PLogicError); // MixAndPush() should have collected
+      return;
 
     case CachedAudio::Collected :
-      m_mutex.Signal();
+      if (first)
+        break;
+      // First stream sharing this cache did not have enough audio to send yet
       MIXER_DEBUG_OUT(",,,");
       return;
 
     case CachedAudio::Completed :
-      m_mutex.Signal();
-      MIXER_DEBUG_OUT(cache.m_encoded.GetPayloadType() << ','
-          << cache.m_encoded.GetTimestamp() << ','
-          << cache.m_encoded.GetPayloadSize() << ',');
-      stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
-      PTRACE(6, "Pushing cached encoded packet: pt=" << cache.m_encoded.GetPayloadType()
-             << " ts=" << cache.m_encoded.GetTimestamp() << " sz=" << cache.m_encoded.GetPayloadSize());
-      stream->PushPacket(cache.m_encoded);
-      stream.SetSafetyMode(PSafeReadOnly); // restore lock
+      {
+        // No transcoder means raw PCM-16 was pushed
+        const RTP_DataFrame & packet = cache.m_transcoder != NULL ? cache.m_encoded : cache.m_raw;
+        MIXER_DEBUG_OUT(packet.GetPayloadType() << ','
+            << packet.GetTimestamp() << ','
+            << packet.GetPayloadSize() << ',');
+        stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
+        PTRACE(6, "Pushing cached packet: pt=" << packet.GetPayloadType()
+               << " ts=" << packet.GetTimestamp() << " sz=" << packet.GetPayloadSize());
+        stream->PushPacket(packet);
+        stream.SetSafetyMode(PSafeReadOnly); // restore lock
+      }
       return;
   }
 
@@ -1766,16 +2635,9 @@ void OpalAudioStreamMixer::PushOne(PSafePtr<OpalMixerMediaStream> & stream,
     return;
   }
 
-  if (cache.m_transcoder == NULL) {
-    cache.m_transcoder = OpalTranscoder::Create(OpalPCM16, mediaFormat);
-    if (cache.m_transcoder == NULL) {
-      PTRACE(2, "Could not create transcoder to "
-             << mediaFormat << " for stream id " << stream->GetID());
-      CloseOne(stream);
-      return;
-    }
-    PTRACE(3, "Created transcoder to " << mediaFormat << " for stream id " << stream->GetID());
-  }
+  // Created by OnPush() under m_mutex, streams it could not create for are not here
+  if (!PAssert(cache.m_transcoder != NULL, PLogicError))
+    return;
 
   if (cache.m_raw.GetPayloadSize() < cache.m_transcoder->GetOptimalDataFrameSize(true)) {
     MIXER_DEBUG_OUT(','
@@ -1801,7 +2663,9 @@ void OpalAudioStreamMixer::PushOne(PSafePtr<OpalMixerMediaStream> & stream,
   }
   else {
     PTRACE(2, "Could not convert audio to " << mediaFormat << " for stream id " << stream->GetID());
-    CloseOne(stream);
+    // Closed by OnPush() under m_mutex after the mix is done
+    cache.m_failed.push_back(stream);
+    cache.m_failed.back().SetSafetyMode(PSafeReference);
   }
 }
 
@@ -1810,23 +2674,88 @@ bool OpalAudioStreamMixer::OnPush()
 {
   MIXER_DEBUG_OUT(PTimer::Tick().GetMilliSeconds() << ',' << m_outputTimestamp << ',');
 
+  std::vector<CachedAudio *> caches;
+
   m_mutex.Wait();
+
   PreMixStreams();
-  m_mutex.Signal();
 
-  for (PSafePtr<OpalMixerMediaStream> stream(m_outputStreams, PSafeReadOnly); stream != NULL; ++stream) {
-    m_mutex.Wait(); // Signal() call for this mutex is inside PushOne()
+  // Work out which cache entry, and thus encoder, each stream uses
+  for (PSafePtr<OpalMixerMediaStream> stream(m_outputStreams, PSafeReference); stream != NULL; ++stream) {
+    PString encodedFrameKey = stream->GetMediaFormat();
+    encodedFrameKey.sprintf(":%u", stream->GetDataSize());
+    CachedAudio * cache = &m_cache[encodedFrameKey];
 
     // Check for full participant, so can subtract their signal
     StreamMap_T::iterator inputStream = m_inputStreams.find(stream->GetID());
-    if (inputStream != m_inputStreams.end())
-      PushOne(stream, m_cache[stream->GetID()], ((AudioStream *)inputStream->second)->m_cacheSamples);
-    else {
-      // Listen only participant, can use cached encoded audio
-      PString encodedFrameKey = stream->GetMediaFormat();
-      encodedFrameKey.sprintf(":%u", stream->GetDataSize());
-      PushOne(stream, m_cache[encodedFrameKey], NULL);
+    if (inputStream != m_inputStreams.end()) {
+      AudioStream & audio = *(AudioStream *)inputStream->second;
+      CachedAudio & own = m_cache[stream->GetID()];
+
+      /* If they contributed nothing, their mix is identical to the listen
+         only mix, so can share that encode. Only switch on a frame boundary
+         for both caches so packets are not split between encoders. */
+      bool inMix = audio.m_contributed && audio.m_mixed;
+      if (own.m_usingShared)
+        own.m_usingShared = !inMix || cache->m_raw.GetPayloadSize() > 0;
+      else
+        own.m_usingShared = !inMix && own.m_raw.GetPayloadSize() == 0 && cache->m_raw.GetPayloadSize() == 0;
+
+      if (!own.m_usingShared) {
+        cache = &own;
+        cache->m_subtracting = audio.m_mixed; // Not in the mix, so nothing to subtract
+        if (cache->m_subtracting)
+          cache->m_subtract.assign((const short *)audio.m_cacheSamples, (const short *)audio.m_cacheSamples + m_periodTS);
+      }
     }
+
+    // Create encoder here, as changes shared state, mixing threads only use it
+    if (cache->m_transcoder == NULL) {
+      OpalMediaFormat mediaFormat = stream->GetMediaFormat();
+      if (mediaFormat != OpalPCM16) {
+        cache->m_transcoder = OpalTranscoder::Create(OpalPCM16, mediaFormat);
+        if (cache->m_transcoder == NULL) {
+          PTRACE(2, "Could not create transcoder to "
+                 << mediaFormat << " for stream id " << stream->GetID());
+          CloseOne(stream);
+          continue;
+        }
+        PTRACE(3, "Created transcoder to " << mediaFormat << " for stream id " << stream->GetID());
+      }
+    }
+
+    if (cache->m_streams.empty())
+      caches.push_back(cache);
+    cache->m_streams.push_back(stream);
+  }
+
+  m_mutex.Signal();
+
+  /* Now do the subtract, encode and push for each cache entry, spreading
+     them over the worker pool if there are enough to be worth it. The last
+     one is always done on this thread. */
+  size_t queued = 0;
+#ifndef OPAL_MIXER_AUDIO_DEBUG
+  if (caches.size() >= MIX_PARALLEL_THRESHOLD && PThread::GetNumProcessors() > 1) {
+    PSemaphore done(0, INT_MAX);
+    PQueuedThreadPool<OpalAudioMixWork> & pool = GetAudioMixPool();
+    for (queued = 0; queued < caches.size()-1; ++queued)
+      pool.AddWork(new OpalAudioMixWork(*this, *caches[queued], done));
+    MixAndPush(*caches.back());
+    for (size_t i = 0; i < queued; ++i)
+      done.Wait();
+    ++queued;
+  }
+#endif
+  for (; queued < caches.size(); ++queued)
+    MixAndPush(*caches[queued]);
+
+  m_mutex.Wait();
+
+  for (size_t i = 0; i < caches.size(); ++i) {
+    for (size_t f = 0; f < caches[i]->m_failed.size(); ++f)
+      CloseOne(caches[i]->m_failed[f]);
+    caches[i]->m_failed.clear();
   }
 
   for (std::map<PString, CachedAudio>::iterator iterCache = m_cache.begin(); iterCache != m_cache.end(); ++iterCache) {
@@ -1845,6 +2774,7 @@ bool OpalAudioStreamMixer::OnPush()
         break;
     }
   }
+  m_mutex.Signal();
 
   MIXER_DEBUG_OUT(endl);
 
@@ -1857,6 +2787,8 @@ bool OpalAudioStreamMixer::OnPush()
 OpalAudioStreamMixer::CachedAudio::CachedAudio()
   : m_state(Collecting)
   , m_transcoder(NULL)
+  , m_usingShared(false)
+  , m_subtracting(false)
 {
 }
 
@@ -1896,13 +2828,32 @@ bool OpalVideoStreamMixer::SetFrameRate(unsigned rate)
 }
 
 
+PString OpalVideoStreamMixer::GetEncoderKey(const OpalMediaFormat & mediaFormat, unsigned width, unsigned height) const
+{
+  PStringStream key;
+  key << mediaFormat << ' ' << width << 'x' << height
+      << ' ' << mediaFormat.GetOptionInteger(OpalMediaFormat::TargetBitRateOption())
+      << '/' << mediaFormat.GetOptionInteger(OpalMediaFormat::MaxBitRateOption())
+      << ' ' << mediaFormat.GetOptionInteger(OpalMediaFormat::MaxTxPacketSizeOption());
+
+  for (PINDEX i = 0; i < mediaFormat.GetOptionCount(); ++i) {
+    const OpalMediaOption & option = mediaFormat.GetOption(i);
+    if (!option.GetFMTPName().IsEmpty())
+      key << ' ' << option.GetName() << '=' << option.AsString();
+  }
+
+  return key;
+}
+
+
 bool OpalVideoStreamMixer::OnMixed(RTP_DataFrame * & output)
 {
-  typedef std::map<PString, RTP_DataFrameList> CachedPackets;
-  CachedPackets cachedPackets;
-  typedef std::map<unsigned, RTP_DataFrame> CachedFrameStore;
-  CachedFrameStore cachedFrameStore;
+  typedef std::map<PString, EncoderGroup> EncoderGroups;
+  EncoderGroups groups;
+
+  const OpalVideoTranscoder::FrameHeader * header = (const OpalVideoTranscoder::FrameHeader *)output->GetPayloadPtr();
 
+  // Sort the output streams into groups that can share the one encoder
   for (PSafePtr<OpalMixerMediaStream> stream(m_outputStreams, PSafeReadOnly); stream != NULL; ++stream) {
     if (stream->IsPaused())
       continue;
@@ -1912,93 +2863,107 @@ bool OpalVideoStreamMixer::OnMixed(RTP_DataFrame * & output)
       stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
       stream->PushPacket(*output);
       stream.SetSafetyMode(PSafeReadOnly); // restore lock
+      continue;
     }
-    else {
-      unsigned width, height;
-      const OpalVideoTranscoder::FrameHeader * header = (const OpalVideoTranscoder::FrameHeader *)output->GetPayloadPtr();
-      if (stream->CheckMixedVideoSize(header->width, header->height)) {
-        // Try and set outgoing video to same size as mixed frame store
-        mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption(), header->width);
-        mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption(), header->height);
-        if (!stream->UpdateMediaFormat(mediaFormat, true)) {
-          PTRACE(2, "Could not adjust media format to " << header->width << 'x' << header->height);
-          continue;
-        }
-        mediaFormat = stream->GetMediaFormat();
-        width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
-        height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
-        PTRACE(4, "Output of " << mediaFormat << " started at " << width << 'x' << height
-               << " (" << header->width << 'x' << header->height << ")"
-                  " to stream id " << stream->GetID());
-      }
-      else {
-        width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
-        height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
+
+    unsigned width, height;
+    if (stream->CheckMixedVideoSize(header->width, header->height)) {
+      // Try and set outgoing video to same size as mixed frame store
+      mediaFormat.SetOptionInteger(OpalVideoFormat::FrameWidthOption(), header->width);
+      mediaFormat.SetOptionInteger(OpalVideoFormat::FrameHeightOption(), header->height);
+      if (!stream->UpdateMediaFormat(mediaFormat, true)) {
+        PTRACE(2, "Could not adjust media format to " << header->width << 'x' << header->height);
+        continue;
       }
+      mediaFormat = stream->GetMediaFormat();
+      width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
+      height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
+      PTRACE(4, "Output of " << mediaFormat << " started at " << width << 'x' << height
+             << " (" << header->width << 'x' << header->height << ")"
+                " to stream id " << stream->GetID());
+    }
+    else {
+      width = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption());
+      height = mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption());
+    }
 
-      PStringStream keyPackets;
-      keyPackets << mediaFormat << ' ' << width << 'x' << height;
-
-      CachedPackets::iterator itPackets = cachedPackets.find(keyPackets);
-      if (itPackets == cachedPackets.end()) {
-        OpalTranscoder * transcoder = m_transcoders.GetAt(keyPackets);
-        if (transcoder == NULL) {
-          mediaFormat.SetOptionInteger(OpalMediaFormat::FrameTimeOption(), m_periodTS);
-          transcoder = OpalTranscoder::Create(OpalYUV420P, mediaFormat);
-          if (transcoder == NULL) {
-            PTRACE(2, "Could not create transcoder to " << mediaFormat << " for stream id " << stream->GetID());
-            CloseOne(stream);
-            continue;
-          }
-          PTRACE(3, "Created transcoder to " << mediaFormat << ' '
-                 << width << 'x' << height << " for stream id " << stream->GetID());
-          m_transcoders.SetAt(keyPackets, transcoder);
-        }
+    EncoderGroup & group = groups[GetEncoderKey(mediaFormat, width, height)];
+    if (group.m_streams.empty()) {
+      group.m_mediaFormat = mediaFormat;
+      group.m_width = width;
+      group.m_height = height;
+    }
+    if (stream->CheckKeyFrameRequest())
+      group.m_keyFrame = true;
+    group.m_streams.push_back(stream);
+    group.m_streams.back().SetSafetyMode(PSafeReference);
+  }
 
-        RTP_DataFrame * rawRTP;
-        if (header->width == width && header->height == height) {
-          PTRACE(5, "Using mixer video frame: " << width << 'x' << height);
-          rawRTP = output;
-        }
-        else {
-          unsigned frameStoreKey = width + height*65536;
-          CachedFrameStore::iterator itFrameStore = cachedFrameStore.find(frameStoreKey);
-          if (itFrameStore != cachedFrameStore.end()) {
-            PTRACE(5, "Using cached video frame: " << header->width << 'x' << header->height << " to " << width << 'x' << height);
-            rawRTP = &itFrameStore->second;
-          }
-          else {
-            PTRACE(5, "Scaling video frame: " << header->width << 'x' << header->height << " to " << width << 'x' << height);
-            rawRTP = &cachedFrameStore[frameStoreKey];
-            rawRTP->CopyHeader(*output);
-            rawRTP->SetPayloadSize(width*height*3/2+sizeof(OpalVideoTranscoder::FrameHeader));
-            OpalVideoTranscoder::FrameHeader * resized = (OpalVideoTranscoder::FrameHeader *)rawRTP->GetPayloadPtr();
-            resized->width = width;
-            resized->height = height;
-            PColourConverter::CopyYUV420P(0, 0, header->width, header->height,
-                                          header->width, header->height, OPAL_VIDEO_FRAME_DATA_PTR(header),
-                                          0, 0, width, height,
-                                          width, height, OPAL_VIDEO_FRAME_DATA_PTR(resized),
-                                          PVideoFrameInfo::eScale);
-          }
-        }
+  // Now encode once for each group, and send the result to all its members
+  typedef std::map<unsigned, RTP_DataFrame> CachedFrameStore;
+  CachedFrameStore cachedFrameStore;
 
-        RTP_DataFrameList packets;
-        if (!transcoder->ConvertFrames(*rawRTP, packets)) {
-          PTRACE(2, "Could not convert video to " << mediaFormat << " for stream id " << stream->GetID());
-          CloseOne(stream);
-          continue;
-        }
+  for (EncoderGroups::iterator itGroup = groups.begin(); itGroup != groups.end(); ++itGroup) {
+    const PString & key = itGroup->first;
+    EncoderGroup & group = itGroup->second;
+
+    OpalTranscoder * transcoder = m_transcoders.GetAt(key);
+    if (transcoder == NULL) {
+      OpalMediaFormat mediaFormat = group.m_mediaFormat;
+      mediaFormat.SetOptionInteger(OpalMediaFormat::FrameTimeOption(), m_periodTS);
+      transcoder = OpalTranscoder::Create(OpalYUV420P, mediaFormat);
+      if (transcoder == NULL) {
+        PTRACE(2, "Could not create transcoder to " << mediaFormat << " for " << group.m_streams.size() << " streams");
+        for (std::vector< PSafePtr<OpalMixerMediaStream> >::iterator it = group.m_streams.begin(); it != group.m_streams.end(); ++it)
+          CloseOne(*it);
+        continue;
+      }
+      PTRACE(3, "Created transcoder to " << mediaFormat << ' ' << group.m_width << 'x' << group.m_height);
+      m_transcoders.SetAt(key, transcoder);
+    }
 
-        itPackets = cachedPackets.insert(CachedPackets::value_type(keyPackets, packets)).first;
+    RTP_DataFrame * rawRTP;
+    if (header->width == group.m_width && header->height == group.m_height) {
+      PTRACE(5, "Using mixer video frame: " << group.m_width << 'x' << group.m_height);
+      rawRTP = output;
+    }
+    else {
+      unsigned frameStoreKey = group.m_width + group.m_height*65536;
+      CachedFrameStore::iterator itFrameStore = cachedFrameStore.find(frameStoreKey);
+      if (itFrameStore != cachedFrameStore.end()) {
+        PTRACE(5, "Using cached video frame: " << header->width << 'x' << header->height << " to " << group.m_width << 'x' << group.m_height);
+        rawRTP = &itFrameStore->second;
+      }
+      else {
+        PTRACE(5, "Scaling video frame: " << header->width << 'x' << header->height << " to " << group.m_width << 'x' << group.m_height);
+        rawRTP = &cachedFrameStore[frameStoreKey];
+        rawRTP->CopyHeader(*output);
+        rawRTP->SetPayloadSize(group.m_width*group.m_height*3/2+sizeof(OpalVideoTranscoder::FrameHeader));
+        OpalVideoTranscoder::FrameHeader * resized = (OpalVideoTranscoder::FrameHeader *)rawRTP->GetPayloadPtr();
+        resized->width = group.m_width;
+        resized->height = group.m_height;
+        ScaleYUV420P(header->width, header->height, OPAL_VIDEO_FRAME_DATA_PTR(header),
+                     0, 0, group.m_width, group.m_height, group.m_width, group.m_height, OPAL_VIDEO_FRAME_DATA_PTR(resized));
       }
+    }
 
-      stream.SetSafetyMode(PSafeReference); // OpalMediaStream::PushPacket might block
+    if (group.m_keyFrame) {
+      PTRACE(4, "Forcing key frame for " << group.m_mediaFormat << " to " << group.m_streams.size() << " streams");
+      transcoder->ExecuteCommand(OpalVideoUpdatePicture());
+    }
 
-      for (RTP_DataFrameList::iterator frame = itPackets->second.begin(); frame != itPackets->second.end(); ++frame)
-        stream->PushPacket(*frame);
+    RTP_DataFrameList packets;
+    if (!transcoder->ConvertFrames(*rawRTP, packets)) {
+      PTRACE(2, "Could not convert video to " << group.m_mediaFormat << " for " << group.m_streams.size() << " streams");
+      for (std::vector< PSafePtr<OpalMixerMediaStream> >::iterator it = group.m_streams.begin(); it != group.m_streams.end(); ++it)
+        CloseOne(*it);
+      continue;
+    }
 
-      stream.SetSafetyMode(PSafeReadOnly); // restore lock
+    // Streams are in PSafeReference mode, as OpalMediaStream::PushPacket might block
+    for (std::vector< PSafePtr<OpalMixerMediaStream> >::iterator it = group.m_streams.begin(); it != group.m_streams.end(); ++it) {
+      for (RTP_DataFrameList::iterator frame = packets.begin(); frame != packets.end(); ++frame)
+        (*it)->PushPacket(*frame);
     }
   }
 
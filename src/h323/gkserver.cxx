@@ -46,6 +46,8 @@
 #include <h323/h323pdu.h>
 #include <h323/peclient.h>
 
+#include <algorithm>
+
 
 const char AnswerCallStr[] = "-Answer";
 const char OriginateCallStr[] = "-Originate";
@@ -2996,21 +2998,68 @@ void H323GatekeeperServer::AddEndPoint(H323RegisteredEndPoint * ep)
     m_totalRegistrations++;
   }
 
-  for (i = 0; i < ep->GetSignalAddressCount(); i++)
-    m_byAddress.Append(new StringMap(ep->GetSignalAddress(i), ep->GetIdentifier()));
+  {
+    PWriteWaitAndSignal lock(m_indexMutex);
 
-  for (i = 0; i < ep->GetAliasCount(); i++) {
-    PString alias = ep->GetAlias(i);
-    m_byAlias.Append(new StringMap(ep->GetAlias(i), ep->GetIdentifier()));
-  }
+    // A heavy RRQ may have changed everything, so start again
+    const PString & identifier = ep->GetIdentifier();
+    RemoveIndexes(identifier);
+    IndexedKeys & keys = m_indexedKeys[identifier];
 
-  for (i = 0; i < ep->GetPrefixCount(); i++)
-    m_byVoicePrefix.Append(new StringMap(ep->GetPrefix(i), ep->GetIdentifier()));
+    for (i = 0; i < ep->GetSignalAddressCount(); i++) {
+      keys.m_addresses.push_back(ep->GetSignalAddress(i));
+      m_byAddress.insert(IdentifierIndex::value_type(keys.m_addresses.back(), identifier));
+    }
+
+    for (i = 0; i < ep->GetAliasCount(); i++) {
+      keys.m_aliases.push_back(ep->GetAlias(i));
+      m_byAlias.insert(IdentifierIndex::value_type(keys.m_aliases.back(), identifier));
+    }
+
+    for (i = 0; i < ep->GetPrefixCount(); i++) {
+      keys.m_prefixes.push_back(ep->GetPrefix(i));
+      m_byVoicePrefix.Add(keys.m_prefixes.back(), identifier);
+    }
+  }
 
   mutex.Signal();
 }
 
 
+static void RemoveFromIndex(std::multimap<PString, PString> & index, const PString & key, const PString & identifier)
+{
+  std::pair<std::multimap<PString, PString>::iterator, std::multimap<PString, PString>::iterator> range = index.equal_range(key);
+  while (range.first != range.second) {
+    if (range.first->second == identifier)
+      index.erase(range.first++);
+    else
+      ++range.first;
+  }
+}
+
+
+void H323GatekeeperServer::RemoveIndexes(const PString & identifier)
+{
+  std::map<PString, IndexedKeys>::iterator it = m_indexedKeys.find(identifier);
+  if (it == m_indexedKeys.end())
+    return;
+
+  IndexedKeys & keys = it->second;
+  std::vector<PString>::iterator key;
+
+  for (key = keys.m_addresses.begin(); key != keys.m_addresses.end(); ++key)
+    RemoveFromIndex(m_byAddress, *key, identifier);
+
+  for (key = keys.m_aliases.begin(); key != keys.m_aliases.end(); ++key)
+    RemoveFromIndex(m_byAlias, *key, identifier);
+
+  for (key = keys.m_prefixes.begin(); key != keys.m_prefixes.end(); ++key)
+    m_byVoicePrefix.Remove(*key, identifier);
+
+  m_indexedKeys.erase(it);
+}
+
+
 PBoolean H323GatekeeperServer::RemoveEndPoint(H323RegisteredEndPoint * ep)
 {
   PTRACE(3, "RAS\tRemoving registered endpoint: " << *ep);
@@ -3025,27 +3074,10 @@ PBoolean H323GatekeeperServer::RemoveEndPoint(H323RegisteredEndPoint * ep)
 
   PWaitAndSignal wait(mutex);
 
-  PINDEX i;
-
-  // remove prefixes belonging to this endpoint
-  for (i = 0; i < m_byVoicePrefix.GetSize(); i++) {
-    StringMap & prefixMap = (StringMap &)*m_byVoicePrefix.GetAt(i);
-    if (prefixMap.identifier == ep->GetIdentifier())
-      m_byVoicePrefix.RemoveAt(i);
-  }
-
-  // remove aliases belonging to this endpoint
-  for (i = 0; i < m_byAlias.GetSize(); i++) {
-    StringMap & aliasMap = (StringMap &)*m_byAlias.GetAt(i);
-    if (aliasMap.identifier == ep->GetIdentifier())
-      m_byAlias.RemoveAt(i);
-  }
-
-  // remove call signalling addresses
-  for (i = 0; i < m_byAddress.GetSize(); i++) {
-    StringMap & aliasMap = (StringMap &)*m_byAddress.GetAt(i);
-    if (aliasMap.identifier == ep->GetIdentifier())
-      m_byAddress.RemoveAt(i);
+  // remove prefixes, aliases and call signalling addresses belonging to this endpoint
+  {
+    PWriteWaitAndSignal lock(m_indexMutex);
+    RemoveIndexes(ep->GetIdentifier());
   }
 
 #if OPAL_H501
@@ -3067,18 +3099,15 @@ void H323GatekeeperServer::RemoveAlias(H323RegisteredEndPoint & ep,
 
   mutex.Wait();
 
-  PINDEX pos = m_byAlias.GetValuesIndex(alias);
-  if (pos != P_MAX_INDEX) {
-    // Allow for possible multiple aliases
-    while (pos < m_byAlias.GetSize()) {
-      StringMap & aliasMap = (StringMap &)m_byAlias[pos];
-      if (aliasMap != alias)
-        break;
+  {
+    PWriteWaitAndSignal lock(m_indexMutex);
 
-      if (aliasMap.identifier == ep.GetIdentifier())
-        m_byAlias.RemoveAt(pos);
-      else
-        pos++;
+    RemoveFromIndex(m_byAlias, alias, ep.GetIdentifier());
+
+    std::map<PString, IndexedKeys>::iterator it = m_indexedKeys.find(ep.GetIdentifier());
+    if (it != m_indexedKeys.end()) {
+      std::vector<PString> & aliases = it->second.m_aliases;
+      aliases.erase(std::remove(aliases.begin(), aliases.end(), alias), aliases.end());
     }
   }
 
@@ -3114,28 +3143,41 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByIdentifier(
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointBySignalAddresses(
                             const H225_ArrayOf_TransportAddress & addresses, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
+  PString identifier;
+  {
+    PReadWaitAndSignal lock(m_indexMutex);
 
-  for (PINDEX i = 0; i < addresses.GetSize(); i++) {
-    PINDEX pos = m_byAddress.GetValuesIndex(H323TransportAddress(addresses[i]));
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)m_byAddress[pos]).identifier, mode);
+    for (PINDEX i = 0; i < addresses.GetSize(); i++) {
+      IdentifierIndex::const_iterator it = m_byAddress.find(H323TransportAddress(addresses[i]));
+      if (it != m_byAddress.end()) {
+        identifier = it->second;
+        break;
+      }
+    }
   }
 
-  return (H323RegisteredEndPoint *)NULL;
+  if (identifier.IsEmpty())
+    return (H323RegisteredEndPoint *)NULL;
+
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointBySignalAddress(
                                      const H323TransportAddress & address, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
+  PString identifier;
+  {
+    PReadWaitAndSignal lock(m_indexMutex);
 
-  PINDEX pos = m_byAddress.GetValuesIndex(address);
-  if (pos != P_MAX_INDEX)
-    return FindEndPointByIdentifier(((StringMap &)m_byAddress[pos]).identifier, mode);
+    IdentifierIndex::const_iterator it = m_byAddress.find(address);
+    if (it == m_byAddress.end())
+      return (H323RegisteredEndPoint *)NULL;
 
-  return (H323RegisteredEndPoint *)NULL;
+    identifier = it->second;
+  }
+
+  return FindEndPointByIdentifier(identifier, mode);
 }
 
 
@@ -3149,14 +3191,18 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasAddres
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasString(
                                                   const PString & alias, PSafetyMode mode)
 {
+  PString identifier;
   {
-    PWaitAndSignal wait(mutex);
-    PINDEX pos = m_byAlias.GetValuesIndex(alias);
+    PReadWaitAndSignal lock(m_indexMutex);
 
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)m_byAlias[pos]).identifier, mode);
+    IdentifierIndex::const_iterator it = m_byAlias.find(alias);
+    if (it != m_byAlias.end())
+      identifier = it->second;
   }
 
+  if (!identifier.IsEmpty())
+    return FindEndPointByIdentifier(identifier, mode);
+
   return FindEndPointByPrefixString(alias, mode);
 }
 
@@ -3164,18 +3210,21 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByAliasString
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPartialAlias(
                                                   const PString & alias, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
-  PINDEX pos = m_byAlias.GetNextStringsIndex(alias);
+  PString identifier;
+  {
+    PReadWaitAndSignal lock(m_indexMutex);
 
-  if (pos != P_MAX_INDEX) {
-    StringMap & possible = (StringMap &)m_byAlias[pos];
-    if (possible.NumCompare(alias) == EqualTo) {
+    IdentifierIndex::const_iterator it = m_byAlias.lower_bound(alias);
+    if (it != m_byAlias.end() && it->first.NumCompare(alias) == EqualTo) {
       PTRACE(4, "RAS\tPartial endpoint search for "
-                "\"" << alias << "\" found \"" << possible << '"');
-      return FindEndPointByIdentifier(possible.identifier, mode);
+                "\"" << alias << "\" found \"" << it->first << '"');
+      identifier = it->second;
     }
   }
 
+  if (!identifier.IsEmpty())
+    return FindEndPointByIdentifier(identifier, mode);
+
   PTRACE(4, "RAS\tPartial endpoint search for \"" << alias << "\" failed");
   return (H323RegisteredEndPoint *)NULL;
 }
@@ -3184,18 +3233,116 @@ PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPartialAlia
 PSafePtr<H323RegisteredEndPoint> H323GatekeeperServer::FindEndPointByPrefixString(
                                                   const PString & prefix, PSafetyMode mode)
 {
-  PWaitAndSignal wait(mutex);
+  PString identifier;
+  {
+    PReadWaitAndSignal lock(m_indexMutex);
+
+    if (m_byVoicePrefix.IsEmpty())
+      return (H323RegisteredEndPoint *)NULL;
 
-  if (m_byVoicePrefix.IsEmpty())
+    identifier = m_byVoicePrefix.FindLongest(prefix);
+  }
+
+  if (identifier.IsEmpty())
     return (H323RegisteredEndPoint *)NULL;
 
-  for (PINDEX len = prefix.GetLength(); len > 0; len--) {
-    PINDEX pos = m_byVoicePrefix.GetValuesIndex(prefix.Left(len));
-    if (pos != P_MAX_INDEX)
-      return FindEndPointByIdentifier(((StringMap &)m_byVoicePrefix[pos]).identifier, mode);
+  return FindEndPointByIdentifier(identifier, mode);
+}
+
+
+H323GatekeeperServer::PrefixTrie::Node::~Node()
+{
+  for (std::vector< std::pair<char, Node *> >::iterator it = m_children.begin(); it != m_children.end(); ++it)
+    delete it->second;
+}
+
+
+H323GatekeeperServer::PrefixTrie::Node * H323GatekeeperServer::PrefixTrie::Node::Find(char c) const
+{
+  // Rarely more than a dozen children (digits, '*' and '#'), so linear search is fine
+  for (std::vector< std::pair<char, Node *> >::const_iterator it = m_children.begin(); it != m_children.end(); ++it) {
+    if (it->first == c)
+      return it->second;
   }
+  return NULL;
+}
 
-  return (H323RegisteredEndPoint *)NULL;
+
+void H323GatekeeperServer::PrefixTrie::Node::RemoveChild(Node * child)
+{
+  for (std::vector< std::pair<char, Node *> >::iterator it = m_children.begin(); it != m_children.end(); ++it) {
+    if (it->second == child) {
+      m_children.erase(it);
+      delete child;
+      return;
+    }
+  }
+}
+
+
+void H323GatekeeperServer::PrefixTrie::Add(const PString & prefix, const PString & identifier)
+{
+  if (prefix.IsEmpty())
+    return; // Never matched
+
+  Node * node = &m_root;
+  for (const char * ptr = prefix; *ptr != '\0'; ++ptr) {
+    Node * child = node->Find(*ptr);
+    if (child == NULL) {
+      child = new Node;
+      node->m_children.push_back(std::make_pair(*ptr, child));
+    }
+    node = child;
+  }
+
+  node->m_identifiers.push_back(identifier);
+}
+
+
+void H323GatekeeperServer::PrefixTrie::Remove(const PString & prefix, const PString & identifier)
+{
+  std::vector<Node *> path;
+  path.push_back(&m_root);
+  for (const char * ptr = prefix; *ptr != '\0'; ++ptr) {
+    Node * child = path.back()->Find(*ptr);
+    if (child == NULL)
+      return;
+    path.push_back(child);
+  }
+
+  std::vector<PString> & identifiers = path.back()->m_identifiers;
+  std::vector<PString>::iterator it = std::find(identifiers.begin(), identifiers.end(), identifier);
+  if (it == identifiers.end())
+    return;
+  identifiers.erase(it);
+
+  // Prune nodes that no longer lead anywhere
+  while (path.size() > 1 && path.back()->m_identifiers.empty() && path.back()->m_children.empty()) {
+    Node * leaf = path.back();
+    path.pop_back();
+    path.back()->RemoveChild(leaf);
+  }
+}
+
+
+void H323GatekeeperServer::PrefixTrie::RemoveAll()
+{
+  for (std::vector< std::pair<char, Node *> >::iterator it = m_root.m_children.begin(); it != m_root.m_children.end(); ++it)
+    delete it->second;
+  m_root.m_children.clear();
+}
+
+
+PString H323GatekeeperServer::PrefixTrie::FindLongest(const PString & number) const
+{
+  const Node * node = &m_root;
+  const Node * longest = NULL;
+  for (const char * ptr = number; *ptr != '\0' && (node = node->Find(*ptr)) != NULL; ++ptr) {
+    if (!node->m_identifiers.empty())
+      longest = node;
+  }
+
+  return longest != NULL ? longest->m_identifiers.front() : PString::Empty();
 }
 
 
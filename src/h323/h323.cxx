@@ -350,19 +350,33 @@ void H323Connection::OnReleased()
     }
   }
 
+#if OPAL_H323_REACTOR
+  H323SignallingReactor * reactor = endpoint.GetSignallingReactor(false);
+#endif
+
   // Wait for control channel to be cleaned up (thread ended).
-  if (m_controlChannel != NULL)
+  if (m_controlChannel != NULL) {
+#if OPAL_H323_REACTOR
+    if (reactor != NULL)
+      reactor->Remove(*m_controlChannel);
+#endif
     m_controlChannel->CloseWait();
+  }
 
   // Do not close m_signallingChannel as H323Endpoint can take it back for possible re-use
   if (m_signallingChannel != NULL) {
     if (m_maintainConnection) {
+      // If in the reactor, the endpoint changes it to await the next SETUP
       PTRACE(4, "H323\tMaintaining signalling channel.");
       m_signallingChannel->SetReadTimeout(MonitorCallStartTime);
       m_signallingChannel->AttachThread(NULL);
     }
     else {
       PTRACE(4, "H323\tClosing signalling channel.");
+#if OPAL_H323_REACTOR
+      if (reactor != NULL)
+        reactor->Remove(*m_signallingChannel);
+#endif
       m_signallingChannel->CloseWait();
       m_signallingChannel.SetNULL();
     }
@@ -460,43 +474,58 @@ void H323Connection::HandleSignallingChannel()
 
   while (m_signallingChannel->IsOpen()) {
     H323SignalPDU pdu;
-    if (pdu.Read(*m_signallingChannel)) {
-      if (!HandleSignalPDU(pdu)) {
-        Release(EndedByTransportFail);
-        break;
-      }
-    }
-    else if (m_signallingChannel->GetErrorCode() != PChannel::Timeout) {
-      if (m_controlChannel == NULL || !m_controlChannel->IsOpen())
-        Release(EndedByTransportFail);
+    bool ok = pdu.Read(*m_signallingChannel);
+    if (!HandleSignallingRead(ok ? &pdu : NULL, !ok && m_signallingChannel->GetErrorCode() == PChannel::Timeout))
       break;
-    }
-    else {
-      // On way out already, just exit thread on timeout
-      if (IsReleased())
-        break;
+  }
 
-      switch (connectionState) {
-        case AwaitingSignalConnect :
-          // Had time out waiting for remote to send a CONNECT
-          ClearCall(EndedByNoAnswer);
-          break;
-        case HasExecutedSignalConnect :
-          // Have had minimum MonitorCallStartTime delay since CONNECT but
-          // still no media to move it to EstablishedConnection state. Must
-          // thus not have any common codecs to use!
-          PTRACE(1, "H225\tTook too long to start media");
-          ClearCall(EndedByCapabilityExchange);
-          break;
-        default :
-          break;
-      }
+  EndHandleSignallingChannel();
+}
+
+
+bool H323Connection::HandleSignallingRead(H323SignalPDU * pdu, bool timedOut)
+{
+  if (pdu != NULL) {
+    if (!HandleSignalPDU(*pdu)) {
+      Release(EndedByTransportFail);
+      return false;
     }
+  }
+  else if (!timedOut) {
+    if (m_controlChannel == NULL || !m_controlChannel->IsOpen())
+      Release(EndedByTransportFail);
+    return false;
+  }
+  else {
+    // On way out already, just stop reading on timeout
+    if (IsReleased())
+      return false;
 
-    if (m_controlChannel == NULL)
-      MonitorCallStatus();
+    switch (connectionState) {
+      case AwaitingSignalConnect :
+        // Had time out waiting for remote to send a CONNECT
+        ClearCall(EndedByNoAnswer);
+        break;
+      case HasExecutedSignalConnect :
+        // Have had minimum MonitorCallStartTime delay since CONNECT but
+        // still no media to move it to EstablishedConnection state. Must
+        // thus not have any common codecs to use!
+        PTRACE(1, "H225\tTook too long to start media");
+        ClearCall(EndedByCapabilityExchange);
+        break;
+      default :
+        break;
+    }
   }
 
+  if (m_controlChannel == NULL)
+    MonitorCallStatus();
+  return true;
+}
+
+
+void H323Connection::EndHandleSignallingChannel()
+{
   // If we are the only link to the far end then indicate that we have
   // received endSession even if we hadn't, because we are now never going
   // to get one so there is no point in having CleanUpOnCallEnd wait.
@@ -1517,6 +1546,11 @@ PBoolean H323Connection::OnReceivedFacility(const H323SignalPDU & pdu)
 
       if (myBuffer < otherBuffer) {
         PTRACE(2, "H225\tSimultaneous start of H.245 channel, connecting to remote.");
+#if OPAL_H323_REACTOR
+        H323SignallingReactor * reactor = endpoint.GetSignallingReactor(false);
+        if (reactor != NULL)
+          reactor->Remove(*m_controlChannel);
+#endif
         m_controlChannel->CloseWait();
         m_controlChannel.SetNULL();
       }
@@ -1775,6 +1809,12 @@ PBoolean H323Connection::SetUpConnection()
     return false;
   }
 
+#if OPAL_H323_REACTOR
+  H323SignallingReactor * reactor = endpoint.GetSignallingReactor();
+  if (reactor != NULL && reactor->Add(*m_signallingChannel, H323SignallingReactor::SignallingChannel, GetToken()))
+    return true;
+#endif
+
   m_signallingChannel->AttachThread(new PThread1Arg< PSafePtr<H323Connection> >(this, &StartHandleSignallingChannel, false, "H225 Caller"));
   return true;
 }
@@ -2657,6 +2697,11 @@ PBoolean H323Connection::CreateOutgoingControlChannel(const PASN_Sequence & encl
     return false;
   }
 
+#if OPAL_H323_REACTOR
+  if (InternalAddControlChannelToReactor())
+    return true;
+#endif
+
   m_controlChannel->AttachThread(PThread::Create(PCREATE_NOTIFIER(NewOutgoingControlChannel), "H.245 Handler"));
   return true;
 }
@@ -2747,11 +2792,35 @@ void H323Connection::NewIncomingControlChannel(OpalListener & listener, const Op
     return;
 
   m_controlChannel = transport;
-  HandleControlChannel();
+
+#if OPAL_H323_REACTOR
+  // Listener thread was handed off to us, it just ends
+  if (!InternalAddControlChannelToReactor())
+#endif
+    HandleControlChannel();
+
   SafeDereference();
 }
 
 
+#if OPAL_H323_REACTOR
+bool H323Connection::InternalAddControlChannelToReactor()
+{
+  H323SignallingReactor * reactor = endpoint.GetSignallingReactor();
+  if (reactor == NULL)
+    return false;
+
+  /* Held until started by the thread pool, so starting is not done in
+     the middle of handling a signalling PDU, as the thread model. */
+  if (!reactor->Add(*m_controlChannel, H323SignallingReactor::ControlChannel, GetToken(), true))
+    return false;
+
+  reactor->QueueStartControlChannel(*m_controlChannel, GetToken());
+  return true;
+}
+#endif
+
+
 PBoolean H323Connection::WriteControlPDU(const H323ControlPDU & pdu)
 {
   PPER_Stream strm;
@@ -2926,10 +2995,7 @@ void H323Connection::HandleControlChannel()
 {
   PTRACE_CONTEXT_ID_PUSH_THREAD(this);
 
-  // If have started separate H.245 channel then don't tunnel any more
-  h245Tunneling = FALSE;
-
-  if (!OnStartHandleControlChannel())
+  if (!BeginHandleControlChannel())
     return;
 
   PBoolean ok = TRUE;
@@ -2946,6 +3012,33 @@ void H323Connection::HandleControlChannel()
 }
 
 
+bool H323Connection::BeginHandleControlChannel()
+{
+  // If have started separate H.245 channel then don't tunnel any more
+  h245Tunneling = FALSE;
+
+  return OnStartHandleControlChannel();
+}
+
+
+bool H323Connection::HandleControlRead(const PBYTEArray * pdu, bool timedOut)
+{
+  if (pdu == NULL && timedOut) {
+    PTRACE(4, "H245\tRead timeout");
+  }
+  else {
+    PPER_Stream strm;
+    if (pdu != NULL)
+      strm = *pdu;
+    if (!HandleReceivedControlPDU(pdu != NULL, strm))
+      return false;
+  }
+
+  MonitorCallStatus();
+  return true;
+}
+
+
 bool H323Connection::InternalEndSessionCheck(PPER_Stream & strm)
 {
   H323ControlPDU pdu;
@@ -51,13 +51,19 @@
 #include <ptclib/enum.h>
 #include <ptclib/pils.h>
 
+#if OPAL_H323_REACTOR
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/socket.h>
+#endif
+
 
 #define new PNEW
 
 
 /////////////////////////////////////////////////////////////////////////////
 
-H323EndPoint::H323EndPoint(OpalManager & manager)
+H323EndPoint::H323EndPoint(OpalManager & manager, unsigned maxThreads)
   : OpalRTPEndPoint(manager, "h323", IsNetworkEndPoint | SupportsE164)
   , autoCallForward(true)
   , disableFastStart(false)
@@ -102,6 +108,12 @@ H323EndPoint::H323EndPoint(OpalManager & manager)
   , callIntrusionT4(0,30)                  // Seconds
   , callIntrusionT5(0,10)                  // Seconds
   , callIntrusionT6(0,10)                  // Seconds
+  , m_threadPool(new H323ThreadPool(maxThreads, "H323 Pool"))
+  , m_rasThreadPool(new H323ThreadPool(maxThreads, "H323 RAS"))
+  , m_signallingThreadingModel(SignallingThreadPerChannel)
+#if OPAL_H323_REACTOR
+  , m_signallingReactor(NULL)
+#endif
   , m_gatekeeperAliasLimit(MaxGatekeeperAliasLimit)
   , m_gatekeeperSimulatePattern(false)
   , m_gatekeeperRasRedirect(true)
@@ -151,6 +163,27 @@ H323EndPoint::H323EndPoint(OpalManager & manager)
 
 H323EndPoint::~H323EndPoint()
 {
+#if OPAL_H323_REACTOR
+  /* All connections are gone now, so can stop the I/O threads. Work items
+     already in the pool may still be using the reactor, so it is only
+     closed here, and deleted after the pool has finished with it. Items
+     that start after this find no reactor and do nothing. */
+  m_signallingReactorMutex.Wait();
+  H323SignallingReactor * reactor = m_signallingReactor;
+  m_signallingReactor = NULL;
+  m_signallingReactorMutex.Signal();
+  if (reactor != NULL)
+    reactor->Close();
+#endif
+
+  // Waits for work in progress, before anything it might use is destroyed
+  delete m_threadPool;
+  delete m_rasThreadPool;
+
+#if OPAL_H323_REACTOR
+  delete reactor;
+#endif
+
 #if OPAL_H460
   delete m_features;
 #endif
@@ -165,8 +198,16 @@ void H323EndPoint::ShutDown()
   m_reusableTransportMutex.Signal();
 
   PTRACE(4, "H323\tShutting down: " << reusedTransports.size() << " maintained transports");
-  for (set<OpalTransportPtr>::iterator it = reusedTransports.begin(); it != reusedTransports.end(); ++it)
+#if OPAL_H323_REACTOR
+  H323SignallingReactor * reactor = GetSignallingReactor(false);
+#endif
+  for (set<OpalTransportPtr>::iterator it = reusedTransports.begin(); it != reusedTransports.end(); ++it) {
+#if OPAL_H323_REACTOR
+    if (reactor != NULL)
+      reactor->Remove(**it);
+#endif
     (*it)->CloseWait();
+  }
 
   /* Unregister request needs/depends OpalEndpoint listeners object, so shut
      down the gatekeeper (if there was one) before cleaning up the OpalEndpoint
@@ -795,8 +836,16 @@ void H323EndPoint::OnReleased(OpalConnection & connection)
     m_reusableTransportMutex.Wait();
     m_reusableTransports.insert(signallingChannel);
     m_reusableTransportMutex.Signal();
-    signallingChannel->AttachThread(new PThreadObj2Arg<H323EndPoint, OpalTransportPtr, bool>(*this,
-                signallingChannel, true, &H323EndPoint::InternalNewIncomingConnection, false, "H225 Maintain"));
+#if OPAL_H323_REACTOR
+    H323SignallingReactor * reactor = GetSignallingReactor();
+    if (reactor != NULL) {
+      PTRACE(4, "H225\tAwaiting first PDU on reused connection " << *signallingChannel);
+      signallingChannel->SetReadTimeout(GetFirstSignalPduTimeout());
+    }
+    if (reactor == NULL || !reactor->Add(*signallingChannel, H323SignallingReactor::MaintainedChannel, signallingChannel->GetRemoteAddress()))
+#endif
+      signallingChannel->AttachThread(new PThreadObj2Arg<H323EndPoint, OpalTransportPtr, bool>(*this,
+                  signallingChannel, true, &H323EndPoint::InternalNewIncomingConnection, false, "H225 Maintain"));
   }
 
   OpalRTPEndPoint::OnReleased(connection);
@@ -818,20 +867,44 @@ void H323EndPoint::InternalNewIncomingConnection(OpalTransportPtr transport, boo
   PTRACE(4, "H225\tAwaiting first PDU on " << (reused ? "reused" : "initial") << " connection " << *transport);
   transport->SetReadTimeout(GetFirstSignalPduTimeout());
 
+#if OPAL_H323_REACTOR
+  H323SignallingReactor * reactor = GetSignallingReactor();
+  if (reactor != NULL && reactor->Add(*transport,
+                                      reused ? H323SignallingReactor::MaintainedChannel : H323SignallingReactor::IncomingChannel,
+                                      transport->GetRemoteAddress()))
+    return;
+#endif
+
   H323SignalPDU pdu;
   do {
     if (!pdu.Read(*transport)) {
-      if (reused) {
-        PTRACE(3, "H225\tReusable TCP connection not reused.");
-        transport->Close();
-        return;
-      }
-
-      PTRACE(2, "H225\tFailed to get initial Q.931 PDU, connection not started.");
+      InternalFirstSignalPDUFailed(*transport, reused);
       return;
     }
   } while (pdu.GetQ931().GetMessageType() != Q931::SetupMsg);
 
+  PSafePtr<H323Connection> connection = InternalHandleFirstSignalPDU(transport, pdu, reused);
+  if (connection != NULL)
+    connection->HandleSignallingChannel();
+}
+
+
+void H323EndPoint::InternalFirstSignalPDUFailed(OpalTransport & transport, bool reused)
+{
+  if (reused) {
+    PTRACE(3, "H225\tReusable TCP connection not reused.");
+    transport.Close();
+    return;
+  }
+
+  PTRACE(2, "H225\tFailed to get initial Q.931 PDU, connection not started.");
+}
+
+
+PSafePtr<H323Connection> H323EndPoint::InternalHandleFirstSignalPDU(const OpalTransportPtr & transport,
+                                                                    H323SignalPDU & pdu,
+                                                                    bool reused)
+{
   unsigned callReference = pdu.GetQ931().GetCallReference();
   PTRACE(3, "H225\tIncoming call, first PDU: callReference=" << callReference
          << " on " << (reused ? "reused" : "initial") << " connection " << *transport);
@@ -866,8 +939,7 @@ void H323EndPoint::InternalNewIncomingConnection(OpalTransportPtr transport, boo
     m_connectionsByCallId.SetAt(connection->GetIdentifier(), connection);
     // All subsequent PDU's should wait forever
     transport->SetReadTimeout(PMaxTimeInterval);
-    connection->HandleSignallingChannel();
-    return;
+    return connection;
   }
 
   PTRACE(1, "H225\tEndpoint could not create connection, "
@@ -892,9 +964,50 @@ void H323EndPoint::InternalNewIncomingConnection(OpalTransportPtr transport, boo
 
   // Send the PDU
   releaseComplete.Write(*transport);
+  return NULL;
+}
+
+
+bool H323EndPoint::SetSignallingThreadingModel(SignallingThreadingModel model, unsigned threadCount)
+{
+#if OPAL_H323_REACTOR
+  if (model == SignallingThreadReactor) {
+    PWaitAndSignal mutex(m_signallingReactorMutex);
+    if (m_signallingReactor == NULL)
+      m_signallingReactor = new H323SignallingReactor(*this, threadCount);
+    else if (threadCount != 0 && threadCount != m_signallingReactor->GetThreadCount()) {
+      PTRACE(2, "H323\tCannot change signalling reactor thread count from " << m_signallingReactor->GetThreadCount());
+    }
+
+    if (m_signallingReactor->GetThreadCount() == 0) {
+      PTRACE(2, "H323\tSignalling reactor has no I/O threads, using thread per channel");
+      return false;
+    }
+  }
+#else
+  if (model == SignallingThreadReactor) {
+    PTRACE(2, "H323\tSignalling reactor not supported on this platform");
+    return false;
+  }
+#endif
+
+  /* Note, if going back to thread per channel, we keep the reactor until
+     destruction as existing channels may still be using it. */
+  m_signallingThreadingModel = model;
+  PTRACE(3, "H323\tSignalling threading model set to " << model);
+  return true;
 }
 
 
+#if OPAL_H323_REACTOR
+H323SignallingReactor * H323EndPoint::GetSignallingReactor(bool forNewChannels) const
+{
+  PWaitAndSignal mutex(m_signallingReactorMutex);
+  return !forNewChannels || m_signallingThreadingModel == SignallingThreadReactor ? m_signallingReactor : NULL;
+}
+#endif
+
+
 H323Connection * H323EndPoint::CreateConnection(OpalCall & call,
                                                 const PString & token,
                                                 void * /*userData*/,
@@ -1923,4 +2036,717 @@ bool H323EndPoint::HasCompatibilityIssue(H323Connection::CompatibilityIssues iss
             "regex=\"" << (it != m_compatibility.end() ? it->second.GetPattern() : PString::Empty()) << '"');
   return found;
 }
+
+/////////////////////////////////////////////////////////////////////////////
+
+#if OPAL_H323_REACTOR
+
+/* Work item queued by the reactor I/O threads to the endpoint thread pool,
+   grouped by token, for each PDU, read timeout or error on a channel. */
+class H323SignallingWork : public H323WorkItem
+{
+    PCLASSINFO(H323SignallingWork, H323WorkItem);
+  public:
+    enum Events {
+      PDUReceived,
+      ReadTimeout,
+      ReadError,
+      StartControl
+    };
+
+    H323SignallingWork(H323EndPoint & ep,
+                       const PString & token,
+                       OpalTransport & transport,
+                       H323SignallingReactor::Channels channel,
+                       Events event,
+                       const PBYTEArray & pdu = PBYTEArray())
+      : H323WorkItem(ep, token)
+      , m_transport(&transport, PSafeReference)
+      , m_channel(channel)
+      , m_event(event)
+      , m_pdu(pdu)
+    {
+    }
+
+    virtual void Work();
+
+  protected:
+    void WorkIncoming(H323SignallingReactor & reactor);
+    void WorkSignalling(H323SignallingReactor & reactor, H323Connection & connection);
+    void WorkControl(H323SignallingReactor & reactor, H323Connection & connection);
+
+    OpalTransportPtr                m_transport;
+    H323SignallingReactor::Channels m_channel;
+    Events                          m_event;
+    PBYTEArray                      m_pdu;
+};
+
+
+void H323SignallingWork::Work()
+{
+  H323SignallingReactor * reactor = m_endpoint.GetSignallingReactor(false);
+  if (reactor == NULL || m_transport == NULL)
+    return; // Shutting down
+
+  if (m_channel == H323SignallingReactor::IncomingChannel || m_channel == H323SignallingReactor::MaintainedChannel) {
+    WorkIncoming(*reactor);
+    return;
+  }
+
+  PSafePtr<H323Connection> connection = PSafePtrCast<OpalConnection, H323Connection>(m_endpoint.GetConnectionWithLock(m_token, PSafeReference));
+  if (connection == NULL) {
+    PTRACE(4, "H323\tNo connection for " << m_channel << " using token=" << m_token);
+    reactor->Remove(*m_transport, m_token);
+    return;
+  }
+
+  PTRACE_CONTEXT_ID_PUSH_THREAD(connection);
+
+  if (m_channel == H323SignallingReactor::SignallingChannel)
+    WorkSignalling(*reactor, *connection);
+  else
+    WorkControl(*reactor, *connection);
+}
+
+
+void H323SignallingWork::WorkIncoming(H323SignallingReactor & reactor)
+{
+  bool reused = m_channel == H323SignallingReactor::MaintainedChannel;
+
+  H323SignalPDU pdu;
+  if (m_event != PDUReceived || !pdu.ProcessReadData(m_pdu)) {
+    if (reactor.Remove(*m_transport, m_token))
+      m_endpoint.InternalFirstSignalPDUFailed(*m_transport, reused);
+    return;
+  }
+
+  // Ignore anything before the SETUP, as the thread model
+  if (pdu.GetQ931().GetMessageType() != Q931::SetupMsg) {
+    reactor.Resume(*m_transport, m_token, m_channel, m_token);
+    return;
+  }
+
+  PSafePtr<H323Connection> connection = m_endpoint.InternalHandleFirstSignalPDU(m_transport, pdu, reused);
+  if (connection == NULL)
+    reactor.Remove(*m_transport, m_token);
+  else if (reactor.Resume(*m_transport, m_token, H323SignallingReactor::SignallingChannel, connection->GetToken())) {
+    PTRACE(3, "H225\tReading PDUs: callRef=" << pdu.GetQ931().GetCallReference());
+  }
+}
+
+
+void H323SignallingWork::WorkSignalling(H323SignallingReactor & reactor, H323Connection & connection)
+{
+  bool reading;
+  if (m_event == PDUReceived) {
+    H323SignalPDU pdu;
+    reading = connection.HandleSignallingRead(pdu.ProcessReadData(m_pdu) ? &pdu : NULL, false);
+  }
+  else
+    reading = connection.HandleSignallingRead(NULL, m_event == ReadTimeout);
+
+  // A PDU queued before the channel was removed must not end it twice
+  if (!reading && reactor.Remove(*m_transport, m_token))
+    connection.EndHandleSignallingChannel();
+}
+
+
+void H323SignallingWork::WorkControl(H323SignallingReactor & reactor, H323Connection & connection)
+{
+  // Make sure not for a control channel since replaced, or closed
+  bool current;
+  {
+    PSafeLockReadOnly lock(connection);
+    current = lock.IsLocked() && &connection.GetControlChannel() == &*m_transport;
+  }
+  if (!current) {
+    PTRACE(4, "H245\tIgnoring " << m_event << " on old control channel " << *m_transport);
+    reactor.Remove(*m_transport, m_token);
+    return;
+  }
+
+  if (m_event == StartControl) {
+    if (!connection.BeginHandleControlChannel())
+      reactor.Remove(*m_transport, m_token);
+    else if (reactor.Resume(*m_transport, m_token, m_channel, m_token)) {
+      PTRACE(3, "H245\tReading PDUs: " << *m_transport);
+    }
+    return;
+  }
+
+  if (connection.HandleControlRead(m_event == PDUReceived ? &m_pdu : NULL, m_event == ReadTimeout))
+    return;
+
+  if (reactor.Remove(*m_transport, m_token)) {
+    connection.EndHandleControlChannel();
+    PTRACE(2, "H245\tControl channel closed.");
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+class H323SignallingReactor::Worker : public PObject
+{
+    PCLASSINFO(H323SignallingReactor::Worker, PObject);
+  public:
+    Worker(H323EndPoint & endpoint, unsigned index);
+    ~Worker();
+
+    enum Result {
+      NotFound,
+      Changed,
+      Failed
+    };
+
+    bool IsOpen() const { return m_thread != NULL; }
+    void Close();
+    bool Add(OpalTransport & transport, int fd, Channels channel, const PString & token, bool hold);
+    Result Change(OpalTransport & transport, const PString * heldToken, Channels channel, const PString & token, bool hold);
+    bool Remove(OpalTransport & transport, const PString & token);
+    void Queue(OpalTransport & transport, const PString & token, H323SignallingWork::Events event);
+    size_t GetCount() const;
+
+  protected:
+    struct Entry {
+      Entry(OpalTransport & transport, int fd, PUInt64 id)
+        : m_transport(&transport, PSafeReference)
+        , m_fd(fd)
+        , m_id(id)
+        , m_channel(SignallingChannel)
+        , m_held(true)
+        , m_failed(false)
+      {
+      }
+
+      OpalTransportPtr m_transport;
+      int              m_fd;
+      PUInt64          m_id;
+      Channels         m_channel;
+      PString          m_token;
+      bool             m_held;
+      bool             m_failed;
+      PBYTEArray       m_partial;   // Incomplete TPKT from previous reads
+      PTimeInterval    m_lastRead;
+    };
+
+    void ThreadMain();
+    void Dispatch(PUInt64 id);
+    void Read(Entry & entry);
+    bool Extract(Entry & entry, const BYTE * data, PINDEX length);
+    void Arm(Entry & entry);
+    void Fail(Entry & entry, PChannel::Errors error, int osError);
+    void CheckTimeouts();
+    void Queue(Entry & entry, H323SignallingWork::Events event, const PBYTEArray & pdu = PBYTEArray());
+
+    H323EndPoint & m_endpoint;
+
+    typedef std::map<OpalTransport *, Entry *> EntryMap;
+    typedef std::map<PUInt64, Entry *> EntryByIdMap;
+    EntryMap     m_entries;
+    EntryByIdMap m_entriesById;
+    PUInt64      m_lastId;
+    PDECLARE_MUTEX(m_mutex);
+
+    int           m_epollFd;
+    int           m_wakeFd;
+    atomic<bool>  m_running;
+    PThread     * m_thread;
+    PBYTEArray    m_readBuffer;
+};
+
+
+H323SignallingReactor::Worker::Worker(H323EndPoint & endpoint, unsigned index)
+  : m_endpoint(endpoint)
+  , m_lastId(0)
+  , m_epollFd(epoll_create1(EPOLL_CLOEXEC))
+  , m_wakeFd(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC))
+  , m_running(true)
+  , m_thread(NULL)
+  , m_readBuffer(65536)
+{
+  if (m_epollFd < 0 || m_wakeFd < 0) {
+    PTRACE(1, "H323\tCould not create epoll/eventfd for signalling reactor: " << strerror(errno));
+    return;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = 0; // Indicates wake up event
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) < 0) {
+    PTRACE(1, "H323\tCould not add eventfd to signalling reactor: " << strerror(errno));
+    return;
+  }
+
+  m_thread = new PThreadObj<Worker>(*this, &Worker::ThreadMain, false, PSTRSTRM("H323IO:" << index), PThread::HighPriority);
+}
+
+
+void H323SignallingReactor::Worker::Close()
+{
+  m_running = false;
+
+  if (m_thread != NULL) {
+    static const uint64_t wake = 1;
+    if (write(m_wakeFd, &wake, sizeof(wake)) < 0) {
+      PTRACE(2, "H323\tCould not wake signalling reactor thread: " << strerror(errno));
+    }
+    PThread::WaitAndDelete(m_thread);
+    m_thread = NULL;
+  }
+}
+
+
+H323SignallingReactor::Worker::~Worker()
+{
+  Close();
+
+  if (m_wakeFd >= 0)
+    close(m_wakeFd);
+  if (m_epollFd >= 0)
+    close(m_epollFd);
+
+  // Anything left was maintained, or is being closed by its connection
+  for (EntryMap::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+    delete it->second;
+}
+
+
+bool H323SignallingReactor::Worker::Add(OpalTransport & transport, int fd, Channels channel, const PString & token, bool hold)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  Entry * entry = new Entry(transport, fd, ++m_lastId);
+  entry->m_channel = channel;
+  entry->m_token = token;
+  entry->m_held = hold;
+  entry->m_lastRead = PTimer::Tick();
+
+  /* Always one shot, so a channel is only being read by one thread, and
+     does not fire again while held for the thread pool. */
+  struct epoll_event ev;
+  ev.events = hold ? EPOLLONESHOT : (EPOLLIN|EPOLLONESHOT);
+  ev.data.u64 = entry->m_id;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    PTRACE(2, "H323\tCould not add fd " << fd << " to signalling reactor: " << strerror(errno));
+    delete entry;
+    return false;
+  }
+
+  m_entries[&transport] = entry;
+  m_entriesById[entry->m_id] = entry;
+  return true;
+}
+
+
+H323SignallingReactor::Worker::Result
+     H323SignallingReactor::Worker::Change(OpalTransport & transport,
+                                           const PString * heldToken,
+                                           Channels channel,
+                                           const PString & token,
+                                           bool hold)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  EntryMap::iterator it = m_entries.find(&transport);
+  if (it == m_entries.end())
+    return NotFound;
+
+  Entry & entry = *it->second;
+  if (entry.m_failed || (heldToken != NULL && (!entry.m_held || entry.m_token != *heldToken)))
+    return Failed;
+
+  entry.m_channel = channel;
+  entry.m_token = token;
+  entry.m_held = hold;
+  entry.m_lastRead = PTimer::Tick();
+
+  if (!hold && !entry.m_partial.IsEmpty()) {
+    // Already have the next PDU(s), may hold again
+    PBYTEArray partial = entry.m_partial;
+    entry.m_partial.SetSize(0);
+    if (!Extract(entry, partial, partial.GetSize()))
+      return Changed;
+  }
+
+  if (!entry.m_held)
+    Arm(entry);
+  return Changed;
+}
+
+
+bool H323SignallingReactor::Worker::Remove(OpalTransport & transport, const PString & token)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  EntryMap::iterator it = m_entries.find(&transport);
+  if (it == m_entries.end())
+    return false;
+
+  Entry * entry = it->second;
+  if (!token.IsEmpty() && entry->m_token != token)
+    return false;
+
+  // If closed, the fd may have been reused, and closing removed it anyway
+  PChannel * channel = entry->m_transport->GetChannel();
+  if (channel != NULL && channel->GetHandle() == entry->m_fd)
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, entry->m_fd, NULL);
+
+  m_entriesById.erase(entry->m_id);
+  m_entries.erase(it);
+  delete entry;
+  return true;
+}
+
+
+void H323SignallingReactor::Worker::Queue(OpalTransport & transport, const PString & token, H323SignallingWork::Events event)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  EntryMap::iterator it = m_entries.find(&transport);
+  if (it != m_entries.end() && it->second->m_token == token)
+    Queue(*it->second, event);
+}
+
+
+size_t H323SignallingReactor::Worker::GetCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_entries.size();
+}
+
+
+void H323SignallingReactor::Worker::ThreadMain()
+{
+  PTRACE(4, "H323\tSignalling reactor thread started");
+
+  static const int MaxEvents = 64;
+  struct epoll_event events[MaxEvents];
+  PSimpleTimer timeoutCheck(0, 1);
+
+  while (m_running) {
+    int count = epoll_wait(m_epollFd, events, MaxEvents, 1000);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, "H323\tSignalling reactor epoll_wait failed: " << strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.u64 != 0)
+        Dispatch(events[i].data.u64);
+      else {
+        uint64_t dummy;
+        if (read(m_wakeFd, &dummy, sizeof(dummy)) < 0) {
+          PTRACE(5, "H323\tSignalling reactor wake up read: " << strerror(errno));
+        }
+      }
+    }
+
+    /* As we do not have the socket read timeout of the thread per channel
+       model, which is used for monitoring the call, check for it here. */
+    if (timeoutCheck.HasExpired()) {
+      timeoutCheck.SetInterval(0, 1);
+      CheckTimeouts();
+    }
+  }
+
+  PTRACE(4, "H323\tSignalling reactor thread ended");
+}
+
+
+void H323SignallingReactor::Worker::Dispatch(PUInt64 id)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  EntryByIdMap::iterator it = m_entriesById.find(id);
+  if (it == m_entriesById.end())
+    return; // Was removed while waiting for epoll
+
+  Entry & entry = *it->second;
+  if (entry.m_held)
+    return; // Stays disarmed until resumed
+
+  Read(entry);
+
+  if (!entry.m_held)
+    Arm(entry);
+}
+
+
+void H323SignallingReactor::Worker::Read(Entry & entry)
+{
+  PChannel * channel = entry.m_transport->GetChannel();
+  if (channel == NULL || channel->GetHandle() != entry.m_fd) {
+    Fail(entry, PChannel::NotOpen, 0);
+    return;
+  }
+
+  // Limit how long we spend on one socket, so others are not starved
+  static const unsigned MaxReadsPerEvent = 4;
+  for (unsigned i = 0; i < MaxReadsPerEvent; ++i) {
+    ssize_t count = recv(entry.m_fd, m_readBuffer.GetPointer(), m_readBuffer.GetSize(), MSG_DONTWAIT);
+    if (count == 0) {
+      PTRACE(4, "H323\tRemote closed " << entry.m_channel << ' ' << *entry.m_transport);
+      Fail(entry, PChannel::NotOpen, 0);
+      return;
+    }
+
+    if (count < 0) {
+      switch (errno) {
+        case EAGAIN :
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK :
+#endif
+          return;
+
+        case EINTR :
+          continue;
+
+        default :
+          PTRACE(1, "H323\tRead error (" << errno << ") on " << entry.m_channel << ' ' << *entry.m_transport << ": " << strerror(errno));
+          Fail(entry, PChannel::Miscellaneous, errno);
+          return;
+      }
+    }
+
+    entry.m_lastRead = PTimer::Tick();
+
+    bool ok;
+    if (entry.m_partial.IsEmpty())
+      ok = Extract(entry, m_readBuffer, count);
+    else {
+      PINDEX have = entry.m_partial.GetSize();
+      memcpy(entry.m_partial.GetPointer(have+count)+have, m_readBuffer, count);
+      PBYTEArray data = entry.m_partial;
+      entry.m_partial.SetSize(0);
+      ok = Extract(entry, data, data.GetSize());
+    }
+
+    if (!ok || entry.m_held || count < m_readBuffer.GetSize())
+      return;
+  }
+}
+
+
+bool H323SignallingReactor::Worker::Extract(Entry & entry, const BYTE * data, PINDEX length)
+{
+  PINDEX used = 0;
+  while (!entry.m_held && length - used >= 4) {
+    const BYTE * tpkt = data + used;
+
+    // Make sure is a RFC1006 TPKT version 3
+    if (tpkt[0] != 3) {
+      PTRACE(2, "H323\tNot a TPKT on " << entry.m_channel << ' ' << *entry.m_transport);
+      Fail(entry, PChannel::ProtocolFailure, 0x80000000);
+      return false;
+    }
+
+    PINDEX packetLength = (tpkt[2] << 8) | tpkt[3];
+    if (packetLength < 4) {
+      PTRACE(2, "H323\tDwarf TPKT received (length " << packetLength << ')');
+      Fail(entry, PChannel::ProtocolFailure, 0);
+      return false;
+    }
+
+    if (length - used < packetLength)
+      break;
+
+    // An empty TPKT is a keep alive
+    if (packetLength > 4)
+      Queue(entry, H323SignallingWork::PDUReceived, PBYTEArray(tpkt+4, packetLength-4));
+
+    used += packetLength;
+  }
+
+  if (used < length)
+    entry.m_partial = PBYTEArray(data+used, length-used);
+  return true;
+}
+
+
+void H323SignallingReactor::Worker::Arm(Entry & entry)
+{
+  struct epoll_event ev;
+  ev.events = EPOLLIN|EPOLLONESHOT;
+  ev.data.u64 = entry.m_id;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_MOD, entry.m_fd, &ev) < 0) {
+    PTRACE(2, "H323\tCould not rearm fd " << entry.m_fd << " in signalling reactor: " << strerror(errno));
+    Fail(entry, PChannel::NotOpen, errno);
+  }
+}
+
+
+void H323SignallingReactor::Worker::Fail(Entry & entry, PChannel::Errors error, int osError)
+{
+  // Held until removed by the thread pool, so only one failure is reported
+  entry.m_failed = true;
+
+  PChannel * channel = entry.m_transport->GetChannel();
+  if (channel != NULL)
+    channel->SetErrorValues(error, osError, PChannel::LastReadError);
+
+  Queue(entry, H323SignallingWork::ReadError);
+}
+
+
+void H323SignallingReactor::Worker::CheckTimeouts()
+{
+  PWaitAndSignal lock(m_mutex);
+
+  PTimeInterval now = PTimer::Tick();
+  for (EntryMap::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+    Entry & entry = *it->second;
+    if (entry.m_held)
+      continue;
+
+    if (!entry.m_transport->IsOpen()) {
+      Fail(entry, PChannel::NotOpen, 0);
+      continue;
+    }
+
+    PTimeInterval timeout = entry.m_transport->GetChannel()->GetReadTimeout();
+    if (timeout == PMaxTimeInterval || now - entry.m_lastRead < timeout)
+      continue;
+
+    entry.m_lastRead = now;
+
+    // Waiting for SETUP is a one off, monitoring the call is periodic
+    if (entry.m_channel == IncomingChannel || entry.m_channel == MaintainedChannel)
+      entry.m_failed = true;
+
+    entry.m_transport->GetChannel()->SetErrorValues(PChannel::Timeout, ETIMEDOUT, PChannel::LastReadError);
+    Queue(entry, H323SignallingWork::ReadTimeout);
+  }
+}
+
+
+void H323SignallingReactor::Worker::Queue(Entry & entry, H323SignallingWork::Events event, const PBYTEArray & pdu)
+{
+  /* As the next PDU on a new or maintained channel is for a different token
+     to this one, wait for it to be handled before reading any more. */
+  if (entry.m_failed || (event == H323SignallingWork::PDUReceived && (entry.m_channel == IncomingChannel || entry.m_channel == MaintainedChannel)))
+    entry.m_held = true;
+
+  m_endpoint.GetThreadPool().AddWork(new H323SignallingWork(m_endpoint, entry.m_token, *entry.m_transport, entry.m_channel, event, pdu), entry.m_token);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+H323SignallingReactor::H323SignallingReactor(H323EndPoint & endpoint, unsigned threadCount)
+  : m_endpoint(endpoint)
+{
+  if (threadCount == 0)
+    threadCount = std::max(1U, PThread::GetNumProcessors());
+
+  for (unsigned i = 0; i < threadCount; ++i) {
+    Worker * worker = new Worker(endpoint, i+1);
+    if (worker->IsOpen())
+      m_workers.push_back(worker);
+    else
+      delete worker;
+  }
+
+  PTRACE(3, "H323\tSignalling reactor started with " << m_workers.size() << " I/O threads");
+}
+
+
+H323SignallingReactor::~H323SignallingReactor()
+{
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    delete m_workers[i];
+  PTRACE(4, "H323\tSignalling reactor stopped");
+}
+
+
+void H323SignallingReactor::Close()
+{
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    m_workers[i]->Close();
+  PTRACE(4, "H323\tSignalling reactor I/O threads stopped");
+}
+
+
+bool H323SignallingReactor::Add(OpalTransport & transport, Channels channel, const PString & token, bool hold)
+{
+  if (m_workers.empty())
+    return false;
+
+  // Already have it, e.g. signalling channel being maintained after call
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    switch (m_workers[i]->Change(transport, NULL, channel, token, hold)) {
+      case Worker::Changed :
+        PTRACE(4, "H323\tChanged to " << channel << " in signalling reactor: " << transport);
+        return true;
+      case Worker::Failed :
+        return false;
+      default :
+        break;
+    }
+  }
+
+  // Only plain TCP, anything else, e.g. TLS, may have data buffered above the socket
+  PTCPSocket * socket = dynamic_cast<PTCPSocket *>(transport.GetChannel());
+  if (socket == NULL || !socket->IsOpen()) {
+    PTRACE(4, "H323\tCannot use signalling reactor for " << channel << ' ' << transport);
+    return false;
+  }
+
+  // Least loaded worker gets the new channel
+  Worker * best = m_workers[0];
+  size_t bestCount = best->GetCount();
+  for (size_t i = 1; i < m_workers.size(); ++i) {
+    size_t count = m_workers[i]->GetCount();
+    if (count < bestCount) {
+      best = m_workers[i];
+      bestCount = count;
+    }
+  }
+
+  if (!best->Add(transport, socket->GetHandle(), channel, token, hold))
+    return false;
+
+  PTRACE(4, "H323\tAdded " << channel << " to signalling reactor: " << transport);
+  return true;
+}
+
+
+bool H323SignallingReactor::Resume(OpalTransport & transport, const PString & heldToken, Channels channel, const PString & token)
+{
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    switch (m_workers[i]->Change(transport, &heldToken, channel, token, false)) {
+      case Worker::Changed :
+        return true;
+      case Worker::Failed :
+        return false;
+      default :
+        break;
+    }
+  }
+  return false;
+}
+
+
+void H323SignallingReactor::QueueStartControlChannel(OpalTransport & transport, const PString & token)
+{
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    m_workers[i]->Queue(transport, token, H323SignallingWork::StartControl);
+}
+
+
+bool H323SignallingReactor::Remove(OpalTransport & transport, const PString & token)
+{
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    if (m_workers[i]->Remove(transport, token)) {
+      PTRACE(4, "H323\tRemoved from signalling reactor: " << transport);
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif // OPAL_H323_REACTOR
+
 #endif // OPAL_H323
@@ -1141,6 +1141,12 @@ PBoolean H323SignalPDU::Read(H323Transport & transport)
     return false;
   }
 
+  return ProcessReadData(rawData);
+}
+
+
+bool H323SignalPDU::ProcessReadData(const PBYTEArray & rawData)
+{
   if (!q931pdu.Decode(rawData)) {
     PTRACE(1, "H225\tParse error of Q931 PDU:\n" << hex << setfill('0')
                                                  << setprecision(2) << rawData
@@ -691,6 +691,28 @@ H323Transaction::~H323Transaction()
 }
 
 
+/* Work item for the endpoint RAS thread pool, to handle a request that needs
+   a Request In Progress sent and so too slow for the transactor thread. */
+class H323TransactionWork : public H323WorkItem
+{
+    PCLASSINFO(H323TransactionWork, H323WorkItem);
+  public:
+    H323TransactionWork(H323Transaction & transaction)
+      : H323WorkItem(transaction.GetTransactor().GetEndPoint(), PString::Empty())
+      , m_transaction(transaction)
+    {
+    }
+
+    virtual void Work()
+    {
+      m_transaction.SlowHandler();
+    }
+
+  protected:
+    H323Transaction & m_transaction;
+};
+
+
 PBoolean H323Transaction::HandlePDU()
 {
   int response = OnHandlePDU();
@@ -720,26 +742,24 @@ PBoolean H323Transaction::HandlePDU()
 
   if (fastResponseRequired) {
     fastResponseRequired = false;
-    PThread::Create(PCREATE_NOTIFIER(SlowHandler), 0,
-                                     PThread::AutoDeleteThread,
-                                     PThread::NormalPriority,
-                                     "Transaction");
+    // No group, so slow transactions do not wait on each other
+    transactor.GetEndPoint().GetRasThreadPool().AddWork(new H323TransactionWork(*this));
   }
 
   return true;
 }
 
 
-void H323Transaction::SlowHandler(PThread &, P_INT_PTR)
+void H323Transaction::SlowHandler()
 {
-  PTRACE(4, "Trans\tStarted slow PDU handler thread.");
+  PTRACE(4, "Trans\tStarted slow PDU handler.");
 
   while (HandlePDU())
     ;
 
   delete this;
 
-  PTRACE(4, "Trans\tEnded slow PDU handler thread.");
+  PTRACE(4, "Trans\tEnded slow PDU handler.");
 }
 
 
@@ -1045,8 +1045,17 @@ void OpalConnection::OnPatchMediaStream(PBoolean isSource, OpalMediaPatch & patc
 
 #if OPAL_AEC
       if (echoCanceler) {
+        /* The raw format has no useful frames per packet, it is the codec on
+           the other side of the patch that sets how much the captured audio
+           is read in, and that is the only side whose frames need state. */
+        if (isSource) {
+          OpalMediaStreamPtr sink = patch.GetSink();
+          echoCanceler->SetMediaFormat(sink != NULL && sink->GetMediaFormat().IsTransportable()
+                                                  ? sink->GetMediaFormat() : mediaFormat, mediaFormat.GetClockRate());
+        }
+        else
+          echoCanceler->SetClockRate(mediaFormat.GetClockRate());
         echoCanceler->SetParameters(endpoint.GetManager().GetEchoCancelParams());
-        echoCanceler->SetClockRate(mediaFormat.GetClockRate());
         patch.AddFilter(isSource ? echoCanceler->GetReceiveHandler()
                                  : echoCanceler->GetSendHandler(), mediaFormat);
         PTRACE(4, "Added echo canceler filter on connection " << *this << ", patch " << patch);
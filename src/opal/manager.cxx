@@ -41,6 +41,7 @@
 #include <opal/endpoint.h>
 #include <opal/call.h>
 #include <opal/patch.h>
+#include <opal/timerwheel.h>
 #include <opal/mediastrm.h>
 #include <codec/g711codec.h>
 #include <codec/vidcodec.h>
@@ -311,6 +312,13 @@ OpalManager::OpalManager()
   , defaultDisplayName(defaultUserName)
   , rtpPayloadSizeMax(1400) // RFC879 recommends 576 bytes, but that is ancient history, 99.999% of the time 1400+ bytes is used.
   , rtpPacketSizeMax(10*1024)
+  , m_mediaThreadingModel(MediaThreadPerChannel)
+#if OPAL_MEDIA_REACTOR
+  , m_mediaTransportReactor(NULL)
+#endif
+  , m_mediaPatchThreadingModel(MediaPatchThreadPerPatch)
+  , m_mediaPatchScheduler(NULL)
+  , m_timerWheel(new OpalTimerWheel)
   , mediaFormatOrder(PARRAYSIZE(DefaultMediaFormatOrder), DefaultMediaFormatOrder)
   , mediaFormatMask(PARRAYSIZE(DefaultMediaFormatMask), DefaultMediaFormatMask)
   , disableDetectInBandDTMF(false)
@@ -418,11 +426,35 @@ OpalManager::~OpalManager()
   // Clean up any calls that the cleaner thread missed on the way out
   GarbageCollection();
 
+#if OPAL_MEDIA_REACTOR
+  // All media transports are gone now, so can stop the I/O threads
+  delete m_mediaTransportReactor;
+#endif
+
+  // Likewise all media patches
+  delete m_mediaPatchScheduler;
+
+  // And all the RTP sessions and SIP transactions using timers
+#if PTRACING
+  OpalTimerWheel::LagHistogram timerLag;
+  m_timerWheel->GetLagHistogram(timerLag);
+  PTRACE(4, "Timer wheel lag: " << timerLag);
+#endif
+  delete m_timerWheel;
+
 #if OPAL_PTLIB_NAT
   PInterfaceMonitor::GetInstance().RemoveNotifier(m_onInterfaceChange);
   delete m_natMethods;
 #endif
 
+  // Pooled transcoders may be from plug ins, so must go before they are unloaded
+#if PTRACING
+  OpalTranscoder::PoolStatistics transcoderPool;
+  OpalTranscoder::GetPoolStatistics(transcoderPool);
+  PTRACE(4, "Transcoder pool: " << transcoderPool);
+#endif
+  OpalTranscoder::ClearPool();
+
   PTRACE(4, "Deleted manager.");
 }
 
@@ -2172,6 +2204,71 @@ void OpalManager::SetAudioJitterDelay(unsigned minDelay, unsigned maxDelay)
 }
 
 
+bool OpalManager::SetMediaThreadingModel(MediaThreadingModel model, unsigned threadCount)
+{
+#if OPAL_MEDIA_REACTOR
+  if (model == MediaThreadReactor) {
+    PWaitAndSignal mutex(m_mediaTransportReactorMutex);
+    if (m_mediaTransportReactor == NULL)
+      m_mediaTransportReactor = new OpalMediaTransportReactor(threadCount);
+    else if (threadCount != 0 && threadCount != m_mediaTransportReactor->GetThreadCount()) {
+      PTRACE(2, "Cannot change media reactor thread count from " << m_mediaTransportReactor->GetThreadCount());
+    }
+
+    if (m_mediaTransportReactor->GetThreadCount() == 0) {
+      PTRACE(2, "Media reactor has no I/O threads, using thread per channel");
+      return false;
+    }
+  }
+#else
+  if (model == MediaThreadReactor) {
+    PTRACE(2, "Media reactor not supported on this platform");
+    return false;
+  }
+#endif
+
+  /* Note, if going back to thread per channel, we keep the reactor until
+     destruction as existing transports may still be using it. */
+  m_mediaThreadingModel = model;
+  PTRACE(3, "Media threading model set to " << model);
+  return true;
+}
+
+
+#if OPAL_MEDIA_REACTOR
+OpalMediaTransportReactor * OpalManager::GetMediaTransportReactor() const
+{
+  PWaitAndSignal mutex(m_mediaTransportReactorMutex);
+  return m_mediaThreadingModel == MediaThreadReactor ? m_mediaTransportReactor : NULL;
+}
+#endif
+
+
+void OpalManager::SetMediaPatchThreadingModel(MediaPatchThreadingModel model, unsigned threadCount)
+{
+  if (model == MediaPatchScheduled) {
+    PWaitAndSignal mutex(m_mediaPatchSchedulerMutex);
+    if (m_mediaPatchScheduler == NULL)
+      m_mediaPatchScheduler = new OpalMediaPatchScheduler(threadCount);
+    else if (threadCount != 0 && threadCount != m_mediaPatchScheduler->GetThreadCount()) {
+      PTRACE(2, "Cannot change media patch scheduler thread count from " << m_mediaPatchScheduler->GetThreadCount());
+    }
+  }
+
+  /* Note, if going back to thread per patch, we keep the scheduler until
+     destruction as existing patches may still be using it. */
+  m_mediaPatchThreadingModel = model;
+  PTRACE(3, "Media patch threading model set to " << model);
+}
+
+
+OpalMediaPatchScheduler * OpalManager::GetMediaPatchScheduler() const
+{
+  PWaitAndSignal mutex(m_mediaPatchSchedulerMutex);
+  return m_mediaPatchThreadingModel == MediaPatchScheduled ? m_mediaPatchScheduler : NULL;
+}
+
+
 void OpalManager::SetMediaFormatOrder(const PStringArray & order)
 {
   mediaFormatOrder = order;
@@ -106,17 +106,238 @@ const OpalAudioFormat & GetOpalPCM16(unsigned clockRate, unsigned channels)
 }
 
 
-static OpalMediaFormatList & GetMediaFormatsList()
-{
-  static class OpalMediaFormatListMaster : public OpalMediaFormatList
-  {
-    public:
-      OpalMediaFormatListMaster()
-      {
-        DisallowDeleteObjects();
+/* Immutable, hash indexed, snapshot of the registered media formats.
+
+   Lookups of the registered formats vastly outnumber changes to them, so
+   readers use the current snapshot without taking the registry mutex. Any
+   change, made with the mutex held, discards the snapshot and the next
+   reader builds a new one. A discarded snapshot is deleted when no reader
+   is active, so one may still be in use by a reader that fetched it just
+   before the change. */
+class OpalMediaFormatRegistry
+{
+  public:
+    OpalMediaFormatRegistry(const OpalMediaFormatList & registeredFormats);
+
+    const OpalMediaFormatList & GetFormats() const { return m_formats; }
+
+    /// Find exact, case insensitive, name match
+    const OpalMediaFormat * FindByName(const PString & name) const;
+
+    /// As for OpalMediaFormatList::FindFormat() from the beginning of the list
+    const OpalMediaFormat * FindFormat(
+      RTP_DataFrame::PayloadTypes pt,
+      unsigned clockRate,
+      const char * name,
+      const char * protocol
+    ) const;
+
+  protected:
+    static unsigned HashName(const char * name);
+    size_t FindSlot(const std::vector<size_t> & table, const char * key, bool byName) const;
+    const char * GetKey(size_t index, bool byName) const;
+
+    static const size_t NoEntry = (size_t)-1;
+
+    struct Entry {
+      const OpalMediaFormat * m_format;
+      PString                 m_name;
+      PString                 m_encodingName;
+      size_t                  m_nextSameEncoding;
+      size_t                  m_nextSamePayloadType;
+    };
+
+    OpalMediaFormatList m_formats;
+    std::vector<Entry>  m_entries;
+    std::vector<size_t> m_byName;      // Open addressed, index into m_entries
+    std::vector<size_t> m_byEncoding;  // Open addressed, head of m_nextSameEncoding chain
+    size_t              m_byPayloadType[RTP_DataFrame::IllegalPayloadType+1]; // Head of m_nextSamePayloadType chain
+};
+
+const size_t OpalMediaFormatRegistry::NoEntry;
+
+
+OpalMediaFormatRegistry::OpalMediaFormatRegistry(const OpalMediaFormatList & registeredFormats)
+{
+  for (OpalMediaFormatList::const_iterator format = registeredFormats.begin(); format != registeredFormats.end(); ++format)
+    m_formats.OpalMediaFormatBaseList::Append(format->Clone());
+
+  size_t tableSize = 16;
+  while (tableSize < (size_t)m_formats.GetSize()*2)
+    tableSize *= 2;
+  m_byName.resize(tableSize, NoEntry);
+  m_byEncoding.resize(tableSize, NoEntry);
+  std::vector<size_t> encodingTails(tableSize, NoEntry);
+  m_entries.reserve(m_formats.GetSize());
+
+  size_t payloadTypeTails[PARRAYSIZE(m_byPayloadType)];
+  for (PINDEX i = 0; i < PARRAYSIZE(m_byPayloadType); ++i)
+    m_byPayloadType[i] = payloadTypeTails[i] = NoEntry;
+
+  // Chains are built in list order, so searches find the same format as a linear scan would
+  for (OpalMediaFormatList::const_iterator format = m_formats.begin(); format != m_formats.end(); ++format) {
+    size_t index = m_entries.size();
+    Entry entry = { &*format, format->GetName(), format->GetEncodingName(), NoEntry, NoEntry };
+    m_entries.push_back(entry);
+
+    size_t slot = FindSlot(m_byName, entry.m_name, true);
+    if (m_byName[slot] == NoEntry)
+      m_byName[slot] = index;
+
+    if (!entry.m_encodingName.IsEmpty()) {
+      slot = FindSlot(m_byEncoding, entry.m_encodingName, false);
+      if (m_byEncoding[slot] == NoEntry)
+        m_byEncoding[slot] = index;
+      else
+        m_entries[encodingTails[slot]].m_nextSameEncoding = index;
+      encodingTails[slot] = index;
+    }
+
+    RTP_DataFrame::PayloadTypes pt = format->GetPayloadType();
+    if (pt >= 0 && (PINDEX)pt < PARRAYSIZE(m_byPayloadType)) {
+      if (m_byPayloadType[pt] == NoEntry)
+        m_byPayloadType[pt] = index;
+      else
+        m_entries[payloadTypeTails[pt]].m_nextSamePayloadType = index;
+      payloadTypeTails[pt] = index;
+    }
+  }
+}
+
+
+unsigned OpalMediaFormatRegistry::HashName(const char * name)
+{
+  // FNV-1a, case insensitive
+  unsigned hash = 2166136261U;
+  while (*name != '\0')
+    hash = (hash ^ (unsigned)tolower((unsigned char)*name++)) * 16777619U;
+  return hash;
+}
+
+
+const char * OpalMediaFormatRegistry::GetKey(size_t index, bool byName) const
+{
+  return byName ? m_entries[index].m_name : m_entries[index].m_encodingName;
+}
+
+
+size_t OpalMediaFormatRegistry::FindSlot(const std::vector<size_t> & table, const char * key, bool byName) const
+{
+  // Returns slot with matching key, or the empty slot where it would go
+  size_t mask = table.size()-1;
+  size_t slot = HashName(key) & mask;
+  while (table[slot] != NoEntry && strcasecmp(GetKey(table[slot], byName), key) != 0)
+    slot = (slot+1) & mask;
+  return slot;
+}
+
+
+const OpalMediaFormat * OpalMediaFormatRegistry::FindByName(const PString & name) const
+{
+  size_t index = m_byName[FindSlot(m_byName, name, true)];
+  return index != NoEntry ? m_entries[index].m_format : NULL;
+}
+
+
+const OpalMediaFormat * OpalMediaFormatRegistry::FindFormat(RTP_DataFrame::PayloadTypes pt,
+                                                            unsigned clockRate,
+                                                            const char * name,
+                                                            const char * protocol) const
+{
+  // First look for a matching encoding name, then known payload type, see OpalMediaFormatList::FindFormat()
+  if (name != NULL && *name != '\0') {
+    for (size_t index = m_byEncoding[FindSlot(m_byEncoding, name, false)]; index != NoEntry; index = m_entries[index].m_nextSameEncoding) {
+      const OpalMediaFormat & format = *m_entries[index].m_format;
+      if ((clockRate == 0    || clockRate == format.GetClockRate()) &&
+          (protocol  == NULL || format.IsValidForProtocol(protocol)))
+        return &format;
+    }
+  }
+
+  if (pt >= 0 && pt < RTP_DataFrame::LastKnownPayloadType) {
+    for (size_t index = m_byPayloadType[pt]; index != NoEntry; index = m_entries[index].m_nextSamePayloadType) {
+      const OpalMediaFormat & format = *m_entries[index].m_format;
+      if ((clockRate == 0    || clockRate == format.GetClockRate()) &&
+          (protocol  == NULL || format.IsValidForProtocol(protocol)))
+        return &format;
+    }
+  }
+
+  return NULL;
+}
+
+
+class OpalMediaFormatListMaster : public OpalMediaFormatList
+{
+  public:
+    /* Readers are counted in several cache line sized stripes, chosen by
+       thread, so concurrent lookups do not all hit the same atomic. */
+    enum { NumReaderStripes = 16 };
+    struct ReaderStripe {
+      ReaderStripe() : m_count(0) { }
+      atomic<unsigned> m_count;
+      char             m_padding[64-sizeof(atomic<unsigned>)];
+    };
+
+    OpalMediaFormatListMaster()
+      : m_registry(NULL)
+      , m_hasRetired(false)
+    {
+      DisallowDeleteObjects();
+    }
+
+    ~OpalMediaFormatListMaster()
+    {
+      delete (const OpalMediaFormatRegistry *)m_registry;
+      for (std::vector<const OpalMediaFormatRegistry *>::iterator it = m_retired.begin(); it != m_retired.end(); ++it)
+        delete *it;
+    }
+
+    // Called with GetMediaFormatsListMutex() held after any change to the list
+    void OnChanged()
+    {
+      const OpalMediaFormatRegistry * registry = m_registry;
+      if (registry != NULL) {
+        m_retired.push_back(registry);
+        m_registry = NULL;
+        m_hasRetired = true;
+      }
+      ReclaimRetired();
+    }
+
+    // Called with GetMediaFormatsListMutex() held
+    void ReclaimRetired()
+    {
+      /* A reader counts itself before fetching m_registry, and we cleared
+         m_registry before looking here, so if all are zero no reader can be
+         using a retired snapshot. Otherwise, the last to leave reclaims. */
+      for (int i = 0; i < NumReaderStripes; ++i) {
+        if (m_readers[i].m_count != 0)
+          return;
       }
-  } registeredFormats;
 
+      m_hasRetired = false;
+      for (std::vector<const OpalMediaFormatRegistry *>::iterator it = m_retired.begin(); it != m_retired.end(); ++it)
+        delete *it;
+      m_retired.clear();
+    }
+
+    ReaderStripe & GetReaderStripe()
+    {
+      size_t id = (size_t)PThread::GetCurrentThreadId();
+      return m_readers[((id >> 4) ^ (id >> 12)) % NumReaderStripes];
+    }
+
+    atomic<const OpalMediaFormatRegistry *> m_registry;
+    atomic<bool>                            m_hasRetired;
+    ReaderStripe                            m_readers[NumReaderStripes];
+    std::vector<const OpalMediaFormatRegistry *> m_retired;
+};
+
+
+static OpalMediaFormatListMaster & GetMediaFormatsList()
+{
+  static OpalMediaFormatListMaster registeredFormats;
   return registeredFormats;
 }
 
@@ -128,6 +349,48 @@ static PMutex & GetMediaFormatsListMutex()
 }
 
 
+/* Read access to the registered media formats without the registry mutex.
+   The snapshot, and any OpalMediaFormat in it, is only valid while this
+   object exists. */
+class OpalMediaFormatRegistryReader
+{
+  public:
+    OpalMediaFormatRegistryReader()
+      : m_master(GetMediaFormatsList())
+      , m_stripe(m_master.GetReaderStripe())
+    {
+      // Must count ourselves before fetching the snapshot, see ReclaimRetired()
+      ++m_stripe.m_count;
+
+      m_registry = m_master.m_registry;
+      if (m_registry == NULL) {
+        PWaitAndSignal mutex(GetMediaFormatsListMutex());
+        m_registry = m_master.m_registry;
+        if (m_registry == NULL) {
+          m_registry = new OpalMediaFormatRegistry(m_master);
+          m_master.m_registry = m_registry;
+        }
+      }
+    }
+
+    ~OpalMediaFormatRegistryReader()
+    {
+      // Only take the mutex if there is something to free, which is rare
+      if (--m_stripe.m_count == 0 && m_master.m_hasRetired) {
+        PWaitAndSignal mutex(GetMediaFormatsListMutex());
+        m_master.ReclaimRetired();
+      }
+    }
+
+    const OpalMediaFormatRegistry * operator->() const { return m_registry; }
+
+  protected:
+    OpalMediaFormatListMaster               & m_master;
+    OpalMediaFormatListMaster::ReaderStripe & m_stripe;
+    const OpalMediaFormatRegistry           * m_registry;
+};
+
+
 static void Clamp(OpalMediaFormatInternal & fmt1, const OpalMediaFormatInternal & fmt2, const PString & variableOption, const PString & minOption, const PString & maxOption)
 {
   if (fmt1.FindOption(variableOption) == NULL)
@@ -776,11 +1039,9 @@ OpalMediaFormat::OpalMediaFormat(OpalMediaFormatInternal * info)
 OpalMediaFormat::OpalMediaFormat(RTP_DataFrame::PayloadTypes pt, unsigned clockRate, const char * name, const char * protocol)
   : m_info(NULL)
 {
-  PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  const OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
-
-  OpalMediaFormatList::const_iterator fmt = registeredFormats.FindFormat(pt, clockRate, name, protocol);
-  if (fmt != registeredFormats.end())
+  OpalMediaFormatRegistryReader registry;
+  const OpalMediaFormat * fmt = registry->FindFormat(pt, clockRate, name, protocol);
+  if (fmt != NULL)
     *this = *fmt;
 }
 
@@ -842,7 +1103,7 @@ void OpalMediaFormat::Construct(OpalMediaFormatInternal * info)
     return;
 
   PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
+  OpalMediaFormatListMaster & registeredFormats = GetMediaFormatsList();
 
   OpalMediaFormatList::const_iterator fmt = registeredFormats.FindFormat(info->formatName);
   if (fmt != registeredFormats.end()) {
@@ -852,6 +1113,7 @@ void OpalMediaFormat::Construct(OpalMediaFormatInternal * info)
   else {
     m_info = info;
     registeredFormats.OpalMediaFormatBaseList::Append(this);
+    registeredFormats.OnChanged();
   }
 }
 
@@ -860,13 +1122,11 @@ OpalMediaFormat & OpalMediaFormat::operator=(RTP_DataFrame::PayloadTypes pt)
 {
   PWaitAndSignal m(m_mutex);
 
-  PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  const OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
-
-  OpalMediaFormatList::const_iterator fmt = registeredFormats.FindFormat(pt);
-  if (fmt == registeredFormats.end())
+  OpalMediaFormatRegistryReader registry;
+  const OpalMediaFormat * fmt = registry->FindFormat(pt, 0, NULL, NULL);
+  if (fmt == NULL)
     *this = OpalMediaFormat();
-  else if (this != &*fmt)
+  else
     *this = *fmt;
 
   return *this;
@@ -883,11 +1143,17 @@ OpalMediaFormat & OpalMediaFormat::operator=(const char * wildcard)
 OpalMediaFormat & OpalMediaFormat::operator=(const PString & wildcard)
 {
   PWaitAndSignal m(m_mutex);
-  PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  const OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
 
-  OpalMediaFormatList::const_iterator fmt = registeredFormats.FindFormat(wildcard);
-  if (fmt == registeredFormats.end())
+  OpalMediaFormatRegistryReader registry;
+  const OpalMediaFormat * fmt;
+  if (wildcard.FindOneOf("*@!") == P_MAX_INDEX)
+    fmt = registry->FindByName(wildcard);
+  else {
+    OpalMediaFormatList::const_iterator it = registry->GetFormats().FindFormat(wildcard);
+    fmt = it != registry->GetFormats().end() ? &*it : NULL;
+  }
+
+  if (fmt == NULL)
     *this = OpalMediaFormat();
   else
     *this = *fmt;
@@ -1104,8 +1370,8 @@ OpalMediaFormatList OpalMediaFormat::GetAllRegisteredMediaFormats()
 
 void OpalMediaFormat::GetAllRegisteredMediaFormats(OpalMediaFormatList & copy)
 {
-  PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  const OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
+  OpalMediaFormatRegistryReader registry;
+  const OpalMediaFormatList & registeredFormats = registry->GetFormats();
 
   for (OpalMediaFormatList::const_iterator format = registeredFormats.begin(); format != registeredFormats.end(); ++format)
     copy += *format;
@@ -1175,7 +1441,7 @@ bool OpalMediaFormat::RegisterKnownMediaFormats(const PString & name)
 bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaFormat)
 {
   PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
+  OpalMediaFormatListMaster & registeredFormats = GetMediaFormatsList();
 
   for (OpalMediaFormatList::iterator format = registeredFormats.begin(); format != registeredFormats.end(); ++format) {
     if (*format == mediaFormat) {
@@ -1184,6 +1450,7 @@ bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaForm
          is really happening is the above only compares the name, and below
          copies all of the attributes (OpalMediaFormatOtions) across. */
       *format = mediaFormat;
+      registeredFormats.OnChanged();
       return true;
     }
   }
@@ -1195,11 +1462,12 @@ bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaForm
 bool OpalMediaFormat::RemoveRegisteredMediaFormat(const OpalMediaFormat & mediaFormat)
 {
   PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
+  OpalMediaFormatListMaster & registeredFormats = GetMediaFormatsList();
 
   for (OpalMediaFormatList::iterator format = registeredFormats.begin(); format != registeredFormats.end(); ++format) {
     if (*format == mediaFormat) {
       registeredFormats.erase(format);
+      registeredFormats.OnChanged();
       return true;
     }
   }
@@ -1264,7 +1532,7 @@ OpalMediaFormatInternal::OpalMediaFormatInternal(const char * fullName,
   }
 
   PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
+  OpalMediaFormatListMaster & registeredFormats = GetMediaFormatsList();
 
   OpalMediaFormat * conflictingFormat = NULL;
 
@@ -1315,6 +1583,7 @@ OpalMediaFormatInternal::OpalMediaFormatInternal(const char * fullName,
            << *conflictingFormat << " moved to " << nextUnused
            << " as " << fullName << " requires " << rtpPayloadType);
     conflictingFormat->SetPayloadType((RTP_DataFrame::PayloadTypes)nextUnused);
+    registeredFormats.OnChanged();
   }
 }
 
@@ -2022,9 +2291,16 @@ OpalMediaFormatList & OpalMediaFormatList::operator+=(const PString & wildcard)
 {
   MakeUnique();
 
-  PWaitAndSignal mutex(GetMediaFormatsListMutex());
-  OpalMediaFormatList & registeredFormats = GetMediaFormatsList();
+  OpalMediaFormatRegistryReader registry;
+
+  if (wildcard.FindOneOf("*@!") == P_MAX_INDEX) {
+    const OpalMediaFormat * fmt = registry->FindByName(wildcard);
+    if (fmt != NULL && !HasFormat(*fmt))
+      OpalMediaFormatBaseList::Append(fmt->Clone());
+    return *this;
+  }
 
+  const OpalMediaFormatList & registeredFormats = registry->GetFormats();
   OpalMediaFormatList::const_iterator fmt;
   while ((fmt = registeredFormats.FindFormat(wildcard, fmt)) != registeredFormats.end()) {
     if (!HasFormat(*fmt))
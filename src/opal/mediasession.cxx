@@ -40,6 +40,7 @@
 #include <opal/connection.h>
 #include <opal/endpoint.h>
 #include <opal/manager.h>
+#include <rtp/rtp.h>
 //#include <h323/h323caps.h>
 #include <sdp/sdp.h>
 
@@ -47,6 +48,13 @@
 #include <ptclib/cypher.h>
 #include <ptclib/pstunsrvr.h>
 
+#if OPAL_MEDIA_REACTOR
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/socket.h>
+  #include <netinet/in.h>
+#endif
+
 
 #define PTraceModule() "Media"
 #define new PNEW
@@ -79,6 +87,8 @@ OpalNetworkStatistics::OpalNetworkStatistics()
   , m_lastReportTime(0)
   , m_targetBitRate(0)
   , m_targetFrameRate(0)
+  , m_framePoolHits(0)
+  , m_framePoolMisses(0)
 {
 }
 
@@ -219,6 +229,8 @@ void OpalMediaStatistics::PreUpdate()
   m_updateInfo.m_previousFrames = m_totalFrames;
 #endif
 
+  RTP_DataFramePool::GetStatistics(m_framePoolHits, m_framePoolMisses);
+
   if (m_threadIdentifier != PNullThreadIdentifier) {
     PThread::Times times;
     PThread::GetTimes(m_threadIdentifier, times);
@@ -370,6 +382,9 @@ void OpalMediaStatistics::PrintOn(ostream & strm) const
   if (m_roundTripTime >= 0)
     strm << setw(indent) <<       "Round Trip Time" << " = " << m_roundTripTime << '\n';
 
+  if (m_framePoolHits > 0 || m_framePoolMisses > 0)
+    strm << setw(indent) <<      "Frame pool usage" << " = " << m_framePoolHits << " hits, " << m_framePoolMisses << " misses\n";
+
   if (m_mediaType == OpalMediaType::Audio()) {
     strm << setw(indent) <<       "Packet overruns" << " = " << m_packetOverruns << '\n';
     if (m_averageJitter >= 0 || m_maximumJitter >= 0)
@@ -514,6 +529,7 @@ OpalMediaTransport::OpalMediaTransport(const PString & name)
   , m_maxNoTransmitTime(0, 10)    // Sending data for 10 seconds, ICMP says still not there
   , m_opened(false)
   , m_started(false)
+  , m_reactor(NULL)
 {
 }
 
@@ -642,24 +658,47 @@ OpalMediaTransport::Transport::Transport(OpalMediaTransport * owner, SubChannels
   , m_subchannel(subchannel)
   , m_channel(chan)
   , m_thread(NULL)
+  , m_reactor(NULL)
+  , m_onStartCalled(false)
   , m_consecutiveUnavailableErrors(0)
 {
 }
 
 
+/* Reuse the read buffer if nothing kept a reference to it after the last
+   packet was dispatched, otherwise take another from the frame pool. Either
+   way, whoever ends up holding the last reference returns it to the pool,
+   the RTP_DataFrame destructor does so for packets held by the jitter buffer. */
+static BYTE * GetReadBuffer(PBYTEArray & buffer, PINDEX size)
+{
+  if (!buffer.IsUnique())
+    buffer = PBYTEArray();
+
+  if (buffer.GetSize() != size && (!buffer.IsEmpty() || !RTP_DataFramePool::Allocate(buffer, size)))
+    buffer.SetSize(size);
+
+  return buffer.GetPointer();
+}
+
+
 void OpalMediaTransport::Transport::ThreadMain()
 {
   PTRACE(4, m_owner, *m_owner << m_subchannel << " media transport read thread starting");
 
-  m_owner->InternalOnStart(m_subchannel);
+  // May have already been done if we failed to add to the reactor
+  if (!m_onStartCalled) {
+    m_onStartCalled = true;
+    m_owner->InternalOnStart(m_subchannel);
+  }
 
+  PBYTEArray data;
   while (m_channel->IsOpen()) {
-    PBYTEArray data(m_owner->m_packetSize);
+    BYTE * buffer = GetReadBuffer(data, m_owner->m_packetSize);
 
     PTRACE(m_throttleReadPacket, m_owner, *m_owner << m_subchannel <<
            " read packet: sz=" << data.GetSize() << " timeout=" << m_channel->GetReadTimeout());
 
-    if (m_channel->Read(data.GetPointer(), data.GetSize())) {
+    if (m_channel->Read(buffer, data.GetSize())) {
       data.SetSize(m_channel->GetLastReadCount());
       m_owner->InternalRxData(m_subchannel, data);
     }
@@ -704,6 +743,7 @@ void OpalMediaTransport::Transport::ThreadMain()
     }
   }
 
+  RTP_DataFramePool::Release(data);
   m_owner->InternalRxData(m_subchannel, PBYTEArray());
   PTRACE(4, m_owner, *m_owner << m_subchannel << " media transport read thread ended");
 }
@@ -732,6 +772,32 @@ bool OpalMediaTransport::Transport::HandleUnavailableError()
 
 void OpalMediaTransport::InternalClose()
 {
+#if OPAL_MEDIA_REACTOR
+  /* Must remove from reactor before closing the socket, and without holding
+     our lock, as the reactor may be dispatching read data to us right now. */
+  std::vector<SubChannels> removedFromReactor;
+  if (LockReadOnly()) {
+    std::vector<std::pair<OpalMediaTransportReactor *, SubChannels> > inReactor;
+    for (vector<Transport>::iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it) {
+      if (it->m_reactor != NULL)
+        inReactor.push_back(std::make_pair(it->m_reactor, it->m_subchannel));
+    }
+    UnlockReadOnly();
+
+    for (size_t i = 0; i < inReactor.size(); ++i) {
+      if (inReactor[i].first->Remove(*this, inReactor[i].second))
+        removedFromReactor.push_back(inReactor[i].second);
+    }
+
+    // So a later close does not try again, InternalStop() still waits for any dispatch
+    if (!removedFromReactor.empty() && LockReadWrite()) {
+      for (size_t i = 0; i < removedFromReactor.size(); ++i)
+        m_subchannels[removedFromReactor[i]].m_reactor = NULL;
+      UnlockReadWrite();
+    }
+  }
+#endif
+
   if (!LockReadOnly())
     return;
 
@@ -752,6 +818,20 @@ void OpalMediaTransport::InternalClose()
   }
 
   UnlockReadOnly();
+
+#if OPAL_MEDIA_REACTOR
+  // Same as end of Transport::ThreadMain(), indicate to notifiers we are closed
+  for (size_t i = 0; i < removedFromReactor.size(); ++i) {
+    InternalRxData(removedFromReactor[i], PBYTEArray());
+    PTRACE(4, *this << removedFromReactor[i] << " media transport removed from reactor");
+  }
+#endif
+}
+
+
+bool OpalMediaTransport::InternalCanUseReactor(SubChannels) const
+{
+  return false;
 }
 
 
@@ -787,6 +867,19 @@ void OpalMediaTransport::Start()
   PTRACE(4, *this << "starting read theads, " << m_subchannels.size() << " sub-channels");
   for (size_t subchannel = 0; subchannel < m_subchannels.size(); ++subchannel) {
     if (m_subchannels[subchannel].m_channel != NULL && m_subchannels[subchannel].m_thread == NULL) {
+#if OPAL_MEDIA_REACTOR
+      if (m_reactor != NULL && InternalCanUseReactor((SubChannels)subchannel)) {
+        // Set first, as the reactor may dispatch to us before Add() returns
+        m_subchannels[subchannel].m_reactor = m_reactor;
+        m_subchannels[subchannel].m_onStartCalled = true;
+        InternalOnStart((SubChannels)subchannel);
+        if (m_reactor->Add(*this, (SubChannels)subchannel))
+          continue;
+        m_subchannels[subchannel].m_reactor = NULL;
+        PTRACE(2, *this << (SubChannels)subchannel << " could not be added to media reactor, using thread");
+      }
+#endif
+
       PStringStream threadName;
       threadName << m_name;
       if (m_subchannels.size() > 1)
@@ -812,6 +905,15 @@ void OpalMediaTransport::InternalStop()
   for (vector<Transport>::iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it)
     PThread::WaitAndDelete(it->m_thread);
 
+#if OPAL_MEDIA_REACTOR
+  /* A reactor thread may have closed us, removing us from another reactor
+     thread that is still reading, so wait for that before deleting channels. */
+  if (m_reactor != NULL) {
+    for (size_t subchannel = 0; subchannel < m_subchannels.size(); ++subchannel)
+      m_reactor->WaitForDispatch(*this, (SubChannels)subchannel);
+  }
+#endif
+
   LockReadWrite();
   for (vector<Transport>::iterator it = m_subchannels.begin(); it != m_subchannels.end(); ++it)
     delete it->m_channel;
@@ -910,13 +1012,24 @@ bool OpalUDPMediaTransport::SetRemoteAddress(const OpalTransportAddress & remote
 }
 
 
+bool OpalUDPMediaTransport::InternalCanUseReactor(SubChannels subchannel) const
+{
+  // Only if not wrapped in some other channel, we read the raw socket directly
+  PChannel * channel = GetChannel(subchannel);
+  return channel != NULL && dynamic_cast<PUDPSocket *>(channel) == channel->GetBaseReadChannel();
+}
+
+
 void OpalUDPMediaTransport::InternalRxData(SubChannels subchannel, const PBYTEArray & data)
 {
   if (m_remoteBehindNAT) {
     // If remote address never set from higher levels, then try and figure
     // it out from the first packet received.
     PIPAddressAndPort ap;
-    GetSubChannelAsSocket(subchannel)->GetLastReceiveAddress(ap);
+    if (m_subchannels[subchannel].m_reactor != NULL)
+      ap = m_subchannels[subchannel].m_reactorReceiveAddress;
+    else
+      GetSubChannelAsSocket(subchannel)->GetLastReceiveAddress(ap);
     InternalSetRemoteAddress(ap, subchannel, true PTRACE_PARAM(, "first PDU"));
   }
 
@@ -1051,6 +1164,9 @@ bool OpalUDPMediaTransport::Open(OpalMediaSession & session,
   OpalManager & manager = session.GetConnection().GetEndPoint().GetManager();
 
   m_packetSize = manager.GetMaxRtpPacketSize();
+#if OPAL_MEDIA_REACTOR
+  m_reactor = manager.GetMediaTransportReactor();
+#endif
   if (session.IsRemoteBehindNAT())
     SetRemoteBehindNAT();
   m_mediaTimeout = session.GetStringOptions().GetVar(OPAL_OPT_MEDIA_RX_TIMEOUT, manager.GetNoMediaTimeout());
@@ -1205,6 +1321,409 @@ PUDPSocket * OpalUDPMediaTransport::GetSubChannelAsSocket(SubChannels subchannel
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+
+#if OPAL_MEDIA_REACTOR
+
+class OpalMediaTransportReactor::Worker : public PObject
+{
+    PCLASSINFO(OpalMediaTransportReactor::Worker, PObject);
+  public:
+    Worker(unsigned index, unsigned batchSize);
+    ~Worker();
+
+    bool IsOpen() const { return m_thread != NULL; }
+    bool Add(OpalMediaTransport::Transport & transport);
+    bool Remove(OpalMediaTransport::Transport & transport, bool waitForDispatch);
+    void WaitForDispatch(OpalMediaTransport::Transport & transport);
+    size_t GetCount() const;
+    bool IsWorkerThread() const { return m_thread != NULL && PThread::Current() == m_thread; }
+
+  protected:
+    void ThreadMain();
+    void Dispatch(OpalMediaTransport::Transport * transport, bool timedOut);
+    void ReadBatch(OpalMediaTransport::Transport & transport);
+
+    typedef std::map<OpalMediaTransport::Transport *, int> TransportMap;
+    TransportMap                    m_transports;
+    OpalMediaTransport::Transport * m_dispatching;
+    PDECLARE_MUTEX(m_mutex);
+    PSemaphore                      m_dispatchDone;
+    unsigned                        m_dispatchWaiters;
+
+    int           m_epollFd;
+    int           m_wakeFd;
+    atomic<bool>  m_running;
+    PThread     * m_thread;
+
+    // Scatter/gather structures for recvmmsg
+    std::vector<PBYTEArray>       m_buffers;
+    std::vector<struct iovec>     m_iovecs;
+    std::vector<struct mmsghdr>   m_messages;
+    std::vector<sockaddr_storage> m_addresses;
+};
+
+
+OpalMediaTransportReactor::Worker::Worker(unsigned index, unsigned batchSize)
+  : m_dispatching(NULL)
+  , m_dispatchDone(0, INT_MAX)
+  , m_dispatchWaiters(0)
+  , m_epollFd(epoll_create1(EPOLL_CLOEXEC))
+  , m_wakeFd(eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC))
+  , m_running(true)
+  , m_thread(NULL)
+  , m_buffers(batchSize)
+  , m_iovecs(batchSize)
+  , m_messages(batchSize)
+  , m_addresses(batchSize)
+{
+  if (m_epollFd < 0 || m_wakeFd < 0) {
+    PTRACE(1, "Could not create epoll/eventfd for media reactor: " << strerror(errno));
+    return;
+  }
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL; // Indicates wake up event
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) < 0) {
+    PTRACE(1, "Could not add eventfd to media reactor: " << strerror(errno));
+    return;
+  }
+
+  m_thread = new PThreadObj<Worker>(*this, &Worker::ThreadMain, false, PSTRSTRM("MediaIO:" << index), PThread::HighPriority);
+}
+
+
+OpalMediaTransportReactor::Worker::~Worker()
+{
+  m_running = false;
+
+  if (m_thread != NULL) {
+    static const uint64_t wake = 1;
+    if (write(m_wakeFd, &wake, sizeof(wake)) < 0) {
+      PTRACE(2, "Could not wake media reactor thread: " << strerror(errno));
+    }
+    PThread::WaitAndDelete(m_thread);
+  }
+
+  for (size_t i = 0; i < m_buffers.size(); ++i)
+    RTP_DataFramePool::Release(m_buffers[i]);
+
+  if (m_wakeFd >= 0)
+    close(m_wakeFd);
+  if (m_epollFd >= 0)
+    close(m_epollFd);
+
+  PAssert(m_transports.empty(), "Media reactor deleted with active transports");
+}
+
+
+bool OpalMediaTransportReactor::Worker::Add(OpalMediaTransport::Transport & transport)
+{
+  int fd = transport.m_channel->GetHandle();
+
+  PWaitAndSignal lock(m_mutex);
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = &transport;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    PTRACE(2, "Could not add fd " << fd << " to media reactor: " << strerror(errno));
+    return false;
+  }
+
+  m_transports[&transport] = fd;
+  return true;
+}
+
+
+bool OpalMediaTransportReactor::Worker::Remove(OpalMediaTransport::Transport & transport, bool waitForDispatch)
+{
+  m_mutex.Wait();
+
+  TransportMap::iterator it = m_transports.find(&transport);
+  if (it == m_transports.end()) {
+    m_mutex.Signal();
+    return false;
+  }
+
+  epoll_ctl(m_epollFd, EPOLL_CTL_DEL, it->second, NULL);
+  m_transports.erase(it);
+  m_mutex.Signal();
+
+  // Make sure we are not in the middle of delivering data to it
+  if (waitForDispatch)
+    WaitForDispatch(transport);
+  return true;
+}
+
+
+void OpalMediaTransportReactor::Worker::WaitForDispatch(OpalMediaTransport::Transport & transport)
+{
+  // Cannot wait for ourselves, we are further up the stack
+  if (IsWorkerThread())
+    return;
+
+  m_mutex.Wait();
+  while (m_dispatching == &transport) {
+    ++m_dispatchWaiters;
+    m_mutex.Signal();
+    m_dispatchDone.Wait();
+    m_mutex.Wait();
+  }
+  m_mutex.Signal();
+}
+
+
+size_t OpalMediaTransportReactor::Worker::GetCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_transports.size();
+}
+
+
+void OpalMediaTransportReactor::Worker::ThreadMain()
+{
+  PTRACE(4, "Media reactor thread started");
+
+  static const int MaxEvents = 64;
+  struct epoll_event events[MaxEvents];
+  PSimpleTimer timeoutCheck(0, 1);
+
+  while (m_running) {
+    int count = epoll_wait(m_epollFd, events, MaxEvents, 1000);
+    if (count < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, "Media reactor epoll_wait failed: " << strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.ptr != NULL)
+        Dispatch((OpalMediaTransport::Transport *)events[i].data.ptr, false);
+      else {
+        uint64_t dummy;
+        if (read(m_wakeFd, &dummy, sizeof(dummy)) < 0) {
+          PTRACE(5, "Media reactor wake up read: " << strerror(errno));
+        }
+      }
+    }
+
+    /* As we do not have the socket read timeout of the thread per channel
+       model, check for no media received here. */
+    if (timeoutCheck.HasExpired()) {
+      timeoutCheck.SetInterval(0, 1);
+
+      std::vector<OpalMediaTransport::Transport *> expired;
+      m_mutex.Wait();
+      for (TransportMap::iterator it = m_transports.begin(); it != m_transports.end(); ++it) {
+        if (!it->first->m_owner->m_mediaTimer.IsRunning())
+          expired.push_back(it->first);
+      }
+      m_mutex.Signal();
+
+      for (size_t i = 0; i < expired.size(); ++i)
+        Dispatch(expired[i], true);
+    }
+  }
+
+  PTRACE(4, "Media reactor thread ended");
+}
+
+
+void OpalMediaTransportReactor::Worker::Dispatch(OpalMediaTransport::Transport * transport, bool timedOut)
+{
+  m_mutex.Wait();
+  if (m_transports.find(transport) == m_transports.end()) {
+    m_mutex.Signal();
+    return; // Was removed while waiting for epoll
+  }
+  m_dispatching = transport;
+  m_mutex.Signal();
+
+  if (!timedOut)
+    ReadBatch(*transport);
+  else {
+    OpalMediaTransport & owner = *transport->m_owner;
+    PTRACE(1, &owner, owner << transport->m_subchannel << " timed out (" << owner.m_mediaTimeout << "s), closing");
+    owner.InternalClose();
+  }
+
+  m_mutex.Wait();
+  m_dispatching = NULL;
+  while (m_dispatchWaiters > 0) {
+    --m_dispatchWaiters;
+    m_dispatchDone.Signal();
+  }
+  m_mutex.Signal();
+}
+
+
+void OpalMediaTransportReactor::Worker::ReadBatch(OpalMediaTransport::Transport & transport)
+{
+  OpalMediaTransport & owner = *transport.m_owner;
+  int fd = transport.m_channel->GetHandle();
+  PINDEX packetSize = owner.m_packetSize;
+  unsigned batchSize = m_messages.size();
+
+  // Limit how long we spend on one socket, so others are not starved
+  static const unsigned MaxBatchesPerEvent = 4;
+  for (unsigned batch = 0; batch < MaxBatchesPerEvent; ++batch) {
+    for (unsigned i = 0; i < batchSize; ++i) {
+      m_iovecs[i].iov_base = GetReadBuffer(m_buffers[i], packetSize);
+      m_iovecs[i].iov_len = packetSize;
+      memset(&m_messages[i], 0, sizeof(struct mmsghdr));
+      m_messages[i].msg_hdr.msg_iov = &m_iovecs[i];
+      m_messages[i].msg_hdr.msg_iovlen = 1;
+      m_messages[i].msg_hdr.msg_name = &m_addresses[i];
+      m_messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+    }
+
+    int count = recvmmsg(fd, m_messages.data(), batchSize, MSG_DONTWAIT, NULL);
+    if (count < 0) {
+      switch (errno) {
+        case EAGAIN :
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK :
+#endif
+        case EINTR :
+          return;
+
+        case ECONNREFUSED :
+          // ICMP port unreachable, same as PChannel::Unavailable in thread model
+          if (transport.HandleUnavailableError())
+            continue;
+          return;
+
+        default :
+          PTRACE(1, &owner, owner << transport.m_subchannel << " read error (" << errno << "): " << strerror(errno));
+          owner.InternalClose();
+          return;
+      }
+    }
+
+    PTRACE(transport.m_throttleReadPacket, &owner, owner << transport.m_subchannel << " read batch: count=" << count);
+
+    for (int i = 0; i < count; ++i) {
+      struct msghdr & hdr = m_messages[i].msg_hdr;
+      if ((hdr.msg_flags & MSG_TRUNC) != 0) {
+        PTRACE(2, &owner, owner << transport.m_subchannel << " read packet too large for buffer of " << packetSize << " bytes.");
+        continue;
+      }
+
+      if (m_messages[i].msg_len == 0) {
+        PTRACE(3, &owner, owner << transport.m_subchannel << " received UDP packet with no payload.");
+        continue;
+      }
+
+      struct sockaddr * sa = (struct sockaddr *)hdr.msg_name;
+      WORD port = ntohs(sa->sa_family == AF_INET ? ((struct sockaddr_in *)sa)->sin_port
+                                                 : ((struct sockaddr_in6 *)sa)->sin6_port);
+      transport.m_reactorReceiveAddress = PIPSocketAddressAndPort(PIPSocket::Address(sa->sa_family, hdr.msg_namelen, sa), port);
+
+      m_buffers[i].SetSize(m_messages[i].msg_len);
+      owner.InternalRxData(transport.m_subchannel, m_buffers[i]);
+    }
+
+    if (count < (int)batchSize)
+      return; // Drained socket
+  }
+}
+
+
+OpalMediaTransportReactor::OpalMediaTransportReactor(unsigned threadCount, unsigned batchSize)
+{
+  if (threadCount == 0)
+    threadCount = std::max(1U, PThread::GetNumProcessors());
+  if (batchSize == 0)
+    batchSize = 1;
+
+  for (unsigned i = 0; i < threadCount; ++i) {
+    Worker * worker = new Worker(i+1, batchSize);
+    if (worker->IsOpen())
+      m_workers.push_back(worker);
+    else
+      delete worker;
+  }
+
+  PTRACE(3, "Media reactor started with " << m_workers.size() << " I/O threads, batch size " << batchSize);
+}
+
+
+OpalMediaTransportReactor::~OpalMediaTransportReactor()
+{
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    delete m_workers[i];
+  PTRACE(4, "Media reactor stopped");
+}
+
+
+bool OpalMediaTransportReactor::Add(OpalMediaTransport & transport, SubChannels subchannel)
+{
+  if (m_workers.empty() || (size_t)subchannel >= transport.m_subchannels.size())
+    return false;
+
+  // Least loaded worker gets the new subchannel
+  Worker * best = m_workers[0];
+  size_t bestCount = best->GetCount();
+  for (size_t i = 1; i < m_workers.size(); ++i) {
+    size_t count = m_workers[i]->GetCount();
+    if (count < bestCount) {
+      best = m_workers[i];
+      bestCount = count;
+    }
+  }
+
+  if (!best->Add(transport.m_subchannels[subchannel]))
+    return false;
+
+  PTRACE(4, &transport, transport << subchannel << " added to media reactor");
+  return true;
+}
+
+
+bool OpalMediaTransportReactor::Remove(OpalMediaTransport & transport, SubChannels subchannel)
+{
+  if ((size_t)subchannel >= transport.m_subchannels.size())
+    return false;
+
+  /* If we are being called from a reactor thread, it cannot be deleting the
+     transport, so no need to wait for any other dispatches to finish, and
+     waiting could deadlock if another reactor thread is doing the same. */
+  bool waitForDispatch = !IsReactorThread();
+
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    if (m_workers[i]->Remove(transport.m_subchannels[subchannel], waitForDispatch))
+      return true;
+  }
+
+  return false;
+}
+
+
+void OpalMediaTransportReactor::WaitForDispatch(OpalMediaTransport & transport, SubChannels subchannel)
+{
+  if ((size_t)subchannel >= transport.m_subchannels.size())
+    return;
+
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    m_workers[i]->WaitForDispatch(transport.m_subchannels[subchannel]);
+}
+
+
+bool OpalMediaTransportReactor::IsReactorThread() const
+{
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    if (m_workers[i]->IsWorkerThread())
+      return true;
+  }
+  return false;
+}
+
+#endif // OPAL_MEDIA_REACTOR
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalMediaSession::OpalMediaSession(const Init & init)
@@ -455,6 +455,12 @@ bool OpalMediaStream::InternalSetJitterBuffer(const OpalJitterBuffer::Init &)
 }
 
 
+OpalMediaStream::ScheduledReadMode OpalMediaStream::EnableScheduledRead(bool)
+{
+  return e_ScheduledReadBlocks;
+}
+
+
 bool OpalMediaStream::InternalSetPaused(bool pause, bool fromUser, bool fromPatch)
 {
   // We make referenced copy of pointer so can't be deleted out from under us
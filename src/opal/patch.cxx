@@ -48,11 +48,66 @@
 #include <codec/vidcodec.h>
 #endif
 
+#include <queue>
+
 #define PTraceModule() "Patch"
 
 #define new PNEW
 
 
+class OpalMediaPatchScheduler::Worker : public PObject
+{
+    PCLASSINFO(OpalMediaPatchScheduler::Worker, PObject);
+  public:
+    Worker(unsigned index);
+    ~Worker();
+
+    bool Add(OpalMediaPatch & patch);
+    bool Remove(OpalMediaPatch & patch, bool waitForService);
+    bool Contains(const OpalMediaPatch & patch) const;
+    void QueueReady(OpalMediaPatch & patch);
+    unsigned TakeReady(OpalMediaPatch & patch, unsigned maximum);
+    size_t GetCount() const;
+    bool IsWorkerThread() const { return m_thread != NULL && PThread::Current() == m_thread; }
+
+  protected:
+    void ThreadMain();
+
+    struct Tick {
+      Tick(PInt64 due, OpalMediaPatch * patch, unsigned serial) : m_due(due), m_patch(patch), m_serial(serial) { }
+      bool operator>(const Tick & other) const { return m_due > other.m_due; }
+
+      PInt64           m_due;
+      OpalMediaPatch * m_patch;
+      unsigned         m_serial;
+    };
+
+    /* The serial number allows for stale entries in the tick and ready
+       queues, from removed patches, to be ignored. The reference keeps the
+       patch from being deleted while it is scheduled, or being serviced. */
+    struct Entry {
+      Entry() : m_serial(0) { }
+      unsigned          m_serial;
+      OpalMediaPatchPtr m_patch;
+    };
+    typedef std::map<const OpalMediaPatch *, Entry> PatchMap;
+    typedef std::pair<OpalMediaPatch *, unsigned> ReadyEntry;
+
+    PatchMap                m_patches;
+    std::priority_queue<Tick, std::vector<Tick>, std::greater<Tick> > m_ticks;
+    std::deque<ReadyEntry>  m_ready;
+    unsigned                m_lastSerial;
+    OpalMediaPatch        * m_servicing;
+    PDECLARE_MUTEX(m_mutex);
+    PSemaphore              m_serviceDone;
+    unsigned                m_serviceWaiters;
+
+    PSyncPoint    m_wakeUp;
+    atomic<bool>  m_running;
+    PThread     * m_thread;
+};
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalMediaPatch::OpalMediaPatch(OpalMediaStream & src)
@@ -63,6 +118,13 @@ OpalMediaPatch::OpalMediaPatch(OpalMediaStream & src)
 #if OPAL_STATISTICS
   , m_patchThreadId(PNullThreadIdentifier)
 #endif
+  , m_scheduler(NULL)
+  , m_schedulerWorker(NULL)
+  , m_scheduledState(e_ScheduleIdle)
+  , m_scheduledReadMode(OpalMediaStream::e_ScheduledReadBlocks)
+  , m_scheduledFrame(0)
+  , m_readReadyCount(0)
+  , m_readReadyQueued(false)
   , m_transcoderChanged(false)
 {
   PTRACE_CONTEXT_ID_FROM(src);
@@ -151,6 +213,18 @@ bool OpalMediaPatch::CanStart() const
 }
 
 
+bool OpalMediaPatch::CanSchedule()
+{
+  // A sink that blocks, e.g. a sound card, would hold up the worker thread
+  for (PList<Sink>::const_iterator s = m_sinks.begin(); s != m_sinks.end(); ++s) {
+    if (s->m_stream->IsSynchronous())
+      return false;
+  }
+
+  return m_source.EnableScheduledRead(true) != OpalMediaStream::e_ScheduledReadBlocks;
+}
+
+
 void OpalMediaPatch::Start()
 {
   PWaitAndSignal m(m_patchThreadMutex);
@@ -160,10 +234,27 @@ void OpalMediaPatch::Start()
     return;
   }
 
+  if (m_scheduler != NULL && m_schedulerWorker->Contains(*this)) {
+    PTRACE(5, "Already scheduled " << *this);
+    return;
+  }
+
   delete m_patchThread;
   m_patchThread = NULL;
+  m_scheduler = NULL;
 
   if (CanStart()) {
+    OpalMediaPatchScheduler * scheduler = m_source.GetConnection().GetEndPoint().GetManager().GetMediaPatchScheduler();
+    if (scheduler != NULL && CanSchedule()) {
+      m_scheduledState = e_ScheduleIdle;
+      if (scheduler->Add(*this)) {
+        m_scheduler = scheduler;
+        PTRACE(4, "Scheduled " << *this);
+        return;
+      }
+      m_source.EnableScheduledRead(false);
+    }
+
     PString threadName = m_source.GetPatchThreadName();
     if (threadName.IsEmpty() && !m_sinks.empty())
       threadName = m_sinks.front().m_stream->GetPatchThreadName();
@@ -179,6 +270,16 @@ void OpalMediaPatch::Start()
 
 void OpalMediaPatch::StopThread()
 {
+  m_patchThreadMutex.Wait();
+  OpalMediaPatchScheduler * scheduler = m_scheduler;
+  m_scheduler = NULL;
+  m_patchThreadMutex.Signal();
+
+  // If still scheduled, the patch has not ended on its own, so do it here
+  if (scheduler != NULL && scheduler->Remove(*this) && InternalEndScheduled()) {
+    PTRACE(4, "Scheduled service stopped for " << *this);
+  }
+
   PThread::WaitAndDelete(m_patchThread, 10000, &m_patchThreadMutex);
 }
 
@@ -273,9 +374,9 @@ static bool SetStreamDataSize(OpalMediaStream & stream, OpalTranscoder & codec)
 
 bool OpalMediaPatch::Sink::CreateTranscoders()
 {
-  delete m_primaryCodec;
+  OpalTranscoder::Release(m_primaryCodec);
   m_primaryCodec = NULL;
-  delete m_secondaryCodec;
+  OpalTranscoder::Release(m_secondaryCodec);
   m_secondaryCodec = NULL;
 
   // Find the media formats than can be used to get from source to sink
@@ -304,7 +405,7 @@ bool OpalMediaPatch::Sink::CreateTranscoders()
   }
 
   PString id = m_stream->GetID();
-  m_primaryCodec = OpalTranscoder::Create(sourceFormat, destinationFormat, (const BYTE *)id, id.GetLength());
+  m_primaryCodec = OpalTranscoder::Acquire(sourceFormat, destinationFormat, (const BYTE *)id, id.GetLength());
   if (m_primaryCodec != NULL) {
     PTRACE_CONTEXT_ID_TO(m_primaryCodec);
     PTRACE(4, "Created primary codec " << sourceFormat << "->" << destinationFormat << " with ID " << id);
@@ -349,8 +450,8 @@ bool OpalMediaPatch::Sink::CreateTranscoders()
                                   true);
   }
 
-  m_primaryCodec = OpalTranscoder::Create(sourceFormat, intermediateFormat, (const BYTE *)id, id.GetLength());
-  m_secondaryCodec = OpalTranscoder::Create(intermediateFormat, destinationFormat, (const BYTE *)id, id.GetLength());
+  m_primaryCodec = OpalTranscoder::Acquire(sourceFormat, intermediateFormat, (const BYTE *)id, id.GetLength());
+  m_secondaryCodec = OpalTranscoder::Acquire(intermediateFormat, destinationFormat, (const BYTE *)id, id.GetLength());
   if (m_primaryCodec == NULL || m_secondaryCodec == NULL)
     return false;
 
@@ -524,8 +625,8 @@ OpalMediaPatch::Sink::Sink(OpalMediaPatch & p, const OpalMediaStreamPtr & s)
 
 OpalMediaPatch::Sink::~Sink()
 {
-  delete m_primaryCodec;
-  delete m_secondaryCodec;
+  OpalTranscoder::Release(m_primaryCodec);
+  OpalTranscoder::Release(m_secondaryCodec);
 #if OPAL_VIDEO
   delete m_rateController;
 #endif
@@ -803,6 +904,14 @@ void OpalMediaPatch::Main()
     }
   }
 
+  InternalPatchEnded();
+
+  PTRACE(4, "Thread ended for " << *this);
+}
+
+
+void OpalMediaPatch::InternalPatchEnded()
+{
   m_source.OnStopMediaPatch(*this);
 
   if (m_sinks.IsEmpty()) {
@@ -811,8 +920,134 @@ void OpalMediaPatch::Main()
                 new PSafeWorkArg1<OpalConnection, OpalMediaStreamPtr, bool>(&m_source.GetConnection(),
                                                         &m_source, &OpalConnection::CloseMediaStream));
   }
+}
 
-  PTRACE(4, "Thread ended for " << *this);
+
+void OpalMediaPatch::OnReadReady()
+{
+  if (m_schedulerWorker != NULL)
+    m_schedulerWorker->QueueReady(*this);
+}
+
+
+static PTimeInterval GetScheduledPeriod(const OpalMediaFormat & mediaFormat)
+{
+  // Use the packet time, but never slower than the dedicated thread pacing
+  static const unsigned MaxPeriod = 10;
+
+  unsigned timeUnits = mediaFormat.GetTimeUnits();
+  if (timeUnits == 0)
+    return MaxPeriod;
+
+  unsigned frames = mediaFormat.GetOptionInteger(OpalAudioFormat::RxFramesPerPacketOption(), 1);
+  unsigned period = mediaFormat.GetFrameTime()*frames/timeUnits;
+  return period > 0 && period < MaxPeriod ? period : MaxPeriod;
+}
+
+
+bool OpalMediaPatch::OnScheduledService(bool onTick, PTimeInterval & nextTick)
+{
+  int state = e_ScheduleIdle;
+  if (m_scheduledState.compare_exchange_strong(state, e_ScheduleRunning)) {
+    PTRACE(4, "Scheduled service started for " << *this);
+#if OPAL_STATISTICS
+    m_patchThreadId = PThread::GetCurrentThreadId();
+#endif
+    m_scheduledReadMode = OpalMediaStream::e_ScheduledReadBlocks;
+    m_scheduledPeriod = 1000;
+    OnStartMediaPatch();
+  }
+  else if (state == e_ScheduleEnded)
+    return false; // Stopped before we got here
+
+  if (InternalScheduledRead(onTick)) {
+    nextTick = m_source.IsPaused() ? 100 : m_scheduledPeriod;
+    return true;
+  }
+
+  InternalEndScheduled();
+  return false;
+}
+
+
+bool OpalMediaPatch::InternalEndScheduled()
+{
+  // Only one of StopThread() or the service can end it, and only once
+  int state = e_ScheduleRunning;
+  if (!m_scheduledState.compare_exchange_strong(state, e_ScheduleEnded)) {
+    if (state == e_ScheduleIdle)
+      m_scheduledState.compare_exchange_strong(state, e_ScheduleEnded); // Never start
+    return false;
+  }
+
+  m_source.EnableScheduledRead(false);
+  InternalPatchEnded();
+  return true;
+}
+
+
+bool OpalMediaPatch::InternalScheduledRead(bool onTick)
+{
+  // Bound the work done for one patch before others get a turn
+  static const unsigned MaxReadsPerService = 32;
+
+  if (!m_source.IsOpen() || m_sinks.IsEmpty()) {
+    PTRACE(4, "Scheduled service ended because source closed or no sinks on " << *this);
+    return false;
+  }
+
+  if (m_source.IsPaused())
+    return true;
+
+  // Jitter buffer may be changed, e.g. by OnStartMediaPatch(), so check mode on housekeeping ticks
+  if (onTick && m_scheduledReadMode != OpalMediaStream::e_ScheduledReadOnTick) {
+    OpalMediaStream::ScheduledReadMode mode = m_source.EnableScheduledRead(true);
+    if (m_scheduledReadMode != mode) {
+      PTRACE(4, "Scheduled read mode " << mode << " for " << *this);
+      m_scheduledReadMode = mode;
+      m_scheduledPeriod = mode == OpalMediaStream::e_ScheduledReadOnTick ? GetScheduledPeriod(m_source.GetMediaFormat()) : 1000;
+    }
+  }
+
+  unsigned reads = 0;
+  unsigned drain = 0;
+  switch (m_scheduledReadMode) {
+    case OpalMediaStream::e_ScheduledReadOnTick :
+      reads = onTick ? 1 : 0;
+      break;
+
+    case OpalMediaStream::e_ScheduledReadOnReady :
+      reads = m_schedulerWorker->TakeReady(*this, MaxReadsPerService);
+      // Housekeeping tick picks up any packets that arrived before being scheduled
+      if (onTick)
+        drain = MaxReadsPerService;
+      break;
+
+    default :
+      break; // Source cannot be read without blocking, e.g. pass through, wait for it to change
+  }
+
+  while (reads > 0 || drain > 0) {
+    if (!m_source.ReadPacket(m_scheduledFrame)) {
+      PTRACE(4, "Scheduled service ended because source read failed on " << *this);
+      return false;
+    }
+
+    if (reads > 0)
+      --reads;
+    else {
+      if (m_scheduledFrame.GetPayloadSize() == 0)
+        break;
+      --drain;
+    }
+
+    if (!DispatchFrame(m_scheduledFrame)) {
+      PTRACE(4, "Scheduled service ended because all sink writes failed on " << *this);
+      return false;
+    }
+  }
+
+  return true;
 }
 
 
@@ -1176,3 +1411,268 @@ void OpalPassiveMediaPatch::Close()
     m_source.OnStopMediaPatch(*this);
   }
 }
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalMediaPatchScheduler::Worker::Worker(unsigned index)
+  : m_lastSerial(0)
+  , m_servicing(NULL)
+  , m_serviceDone(0, INT_MAX)
+  , m_serviceWaiters(0)
+  , m_running(true)
+{
+  m_thread = new PThreadObj<Worker>(*this, &Worker::ThreadMain, false, PSTRSTRM("MediaPatch:" << index), PThread::HighPriority);
+}
+
+
+OpalMediaPatchScheduler::Worker::~Worker()
+{
+  m_running = false;
+  m_wakeUp.Signal();
+  PThread::WaitAndDelete(m_thread);
+
+  PAssert(m_patches.empty(), "Media patch scheduler deleted with active patches");
+}
+
+
+bool OpalMediaPatchScheduler::Worker::Add(OpalMediaPatch & patch)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  Entry & entry = m_patches[&patch];
+  entry.m_serial = ++m_lastSerial;
+  entry.m_patch = OpalMediaPatchPtr(&patch, PSafeReference);
+  unsigned serial = entry.m_serial;
+
+  patch.m_schedulerWorker = this;
+  patch.m_readReadyCount = 0;
+  patch.m_readReadyQueued = false;
+
+  // First tick is immediate, so patch gets started
+  m_ticks.push(Tick(PTimer::Tick().GetMilliSeconds(), &patch, serial));
+  m_wakeUp.Signal();
+  return true;
+}
+
+
+bool OpalMediaPatchScheduler::Worker::Remove(OpalMediaPatch & patch, bool waitForService)
+{
+  m_mutex.Wait();
+
+  PatchMap::iterator it = m_patches.find(&patch);
+  if (it == m_patches.end()) {
+    m_mutex.Signal();
+    return false;
+  }
+
+  // Release reference outside of mutex, though caller should have one too
+  OpalMediaPatchPtr reference = it->second.m_patch;
+  m_patches.erase(it);
+
+  /* Make sure we are not in the middle of servicing it. If we cannot wait,
+     ThreadMain() holds its own reference until the service is done. */
+  while (waitForService && m_servicing == &patch && !IsWorkerThread()) {
+    ++m_serviceWaiters;
+    m_mutex.Signal();
+    m_serviceDone.Wait();
+    m_mutex.Wait();
+  }
+
+  m_mutex.Signal();
+  return true;
+}
+
+
+bool OpalMediaPatchScheduler::Worker::Contains(const OpalMediaPatch & patch) const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_patches.find(&patch) != m_patches.end();
+}
+
+
+void OpalMediaPatchScheduler::Worker::QueueReady(OpalMediaPatch & patch)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  PatchMap::iterator it = m_patches.find(&patch);
+  if (it == m_patches.end())
+    return;
+
+  ++patch.m_readReadyCount;
+  if (patch.m_readReadyQueued)
+    return;
+
+  patch.m_readReadyQueued = true;
+  m_ready.push_back(ReadyEntry(&patch, it->second.m_serial));
+  m_wakeUp.Signal();
+}
+
+
+unsigned OpalMediaPatchScheduler::Worker::TakeReady(OpalMediaPatch & patch, unsigned maximum)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  unsigned count = std::min(patch.m_readReadyCount, maximum);
+  patch.m_readReadyCount -= count;
+
+  // Go to the back of the queue if there is still more to do
+  patch.m_readReadyQueued = patch.m_readReadyCount > 0;
+  if (patch.m_readReadyQueued) {
+    PatchMap::iterator it = m_patches.find(&patch);
+    if (it != m_patches.end())
+      m_ready.push_back(ReadyEntry(&patch, it->second.m_serial));
+  }
+
+  return count;
+}
+
+
+size_t OpalMediaPatchScheduler::Worker::GetCount() const
+{
+  PWaitAndSignal lock(m_mutex);
+  return m_patches.size();
+}
+
+
+void OpalMediaPatchScheduler::Worker::ThreadMain()
+{
+  PTRACE(4, "Media patch worker thread started");
+
+  while (m_running) {
+    OpalMediaPatch * patch = NULL;
+    OpalMediaPatchPtr reference;
+    unsigned serial = 0;
+    bool onTick = false;
+    PInt64 due = 0;
+    PInt64 waitTime = 1000;
+
+    m_mutex.Wait();
+
+    // Ticks that are due take precedence over ready sources, so pacing is kept
+    PInt64 now = PTimer::Tick().GetMilliSeconds();
+    if (!m_ticks.empty() && m_ticks.top().m_due <= now) {
+      Tick tick = m_ticks.top();
+      m_ticks.pop();
+      patch = tick.m_patch;
+      serial = tick.m_serial;
+      due = tick.m_due;
+      onTick = true;
+    }
+    else if (!m_ready.empty()) {
+      patch = m_ready.front().first;
+      serial = m_ready.front().second;
+      m_ready.pop_front();
+    }
+    else if (!m_ticks.empty())
+      waitTime = m_ticks.top().m_due - now;
+
+    if (patch != NULL) {
+      PatchMap::iterator it = m_patches.find(patch);
+      if (it == m_patches.end() || it->second.m_serial != serial) {
+        m_mutex.Signal();
+        continue; // Stale entry for a removed patch
+      }
+      reference = it->second.m_patch;
+    }
+
+    m_servicing = patch;
+    m_mutex.Signal();
+
+    if (patch == NULL) {
+      m_wakeUp.Wait(PTimeInterval(waitTime));
+      continue;
+    }
+
+    PTimeInterval nextTick = PMaxTimeInterval;
+    bool running = patch->OnScheduledService(onTick, nextTick);
+
+    m_mutex.Wait();
+
+    PatchMap::iterator it = m_patches.find(patch);
+    if (it != m_patches.end() && it->second.m_serial == serial) {
+      if (!running)
+        m_patches.erase(it);
+      else if (onTick && nextTick != PMaxTimeInterval) {
+        // Keep to the original cadence, unless we have fallen behind
+        now = PTimer::Tick().GetMilliSeconds();
+        due += nextTick.GetMilliSeconds();
+        m_ticks.push(Tick(due > now ? due : now, patch, serial));
+      }
+    }
+
+    m_servicing = NULL;
+    while (m_serviceWaiters > 0) {
+      --m_serviceWaiters;
+      m_serviceDone.Signal();
+    }
+    m_mutex.Signal();
+
+    // May delete the patch if it was removed while being serviced
+    reference.SetNULL();
+  }
+
+  PTRACE(4, "Media patch worker thread ended");
+}
+
+
+OpalMediaPatchScheduler::OpalMediaPatchScheduler(unsigned threadCount)
+{
+  if (threadCount == 0)
+    threadCount = std::max(1U, PThread::GetNumProcessors());
+
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_workers.push_back(new Worker(i+1));
+
+  PTRACE(3, "Media patch scheduler started with " << m_workers.size() << " worker threads");
+}
+
+
+OpalMediaPatchScheduler::~OpalMediaPatchScheduler()
+{
+  for (size_t i = 0; i < m_workers.size(); ++i)
+    delete m_workers[i];
+  PTRACE(4, "Media patch scheduler stopped");
+}
+
+
+bool OpalMediaPatchScheduler::Add(OpalMediaPatch & patch)
+{
+  if (m_workers.empty())
+    return false;
+
+  // Least loaded worker gets the new patch
+  Worker * best = m_workers[0];
+  size_t bestCount = best->GetCount();
+  for (size_t i = 1; i < m_workers.size(); ++i) {
+    size_t count = m_workers[i]->GetCount();
+    if (count < bestCount) {
+      best = m_workers[i];
+      bestCount = count;
+    }
+  }
+
+  return best->Add(patch);
+}
+
+
+bool OpalMediaPatchScheduler::Remove(OpalMediaPatch & patch)
+{
+  if (patch.m_schedulerWorker == NULL)
+    return false;
+
+  /* If we are being called from a worker thread, e.g. a sink closing another
+     patch, waiting could deadlock if another worker is doing the same. */
+  return patch.m_schedulerWorker->Remove(patch, !IsWorkerThread());
+}
+
+
+bool OpalMediaPatchScheduler::IsWorkerThread() const
+{
+  for (size_t i = 0; i < m_workers.size(); ++i) {
+    if (m_workers[i]->IsWorkerThread())
+      return true;
+  }
+  return false;
+}
+
@@ -0,0 +1,473 @@
+/*
+ * timerwheel.cxx
+ *
+ * Hierarchical timer wheel
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (c) 2016 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ * $Revision$
+ * $Author$
+ * $Date$
+ */
+
+#include <ptlib.h>
+
+#ifdef P_USE_PRAGMA
+#pragma implementation "timerwheel.h"
+#endif
+
+#include <opal_config.h>
+
+#include <opal/timerwheel.h>
+
+
+#define PTraceModule() "TimerWheel"
+#define new PNEW
+
+
+/* Each shard is a four level hashed wheel of 64 slots per level, which at
+   the default 10ms resolution covers about 46 hours before a timer has to
+   be re-cascaded from the top level. */
+class OpalTimerWheel::Shard : public PObject
+{
+    PCLASSINFO(OpalTimerWheel::Shard, PObject);
+  public:
+    Shard(unsigned index, unsigned resolution);
+    ~Shard();
+
+    void Start(OpalWheelTimer & timer, const PTimeInterval & interval, bool continuous);
+    void Stop(OpalWheelTimer & timer, bool wait);
+    bool IsRunning(const OpalWheelTimer & timer) const;
+    void GetLagHistogram(LagHistogram & histogram) const;
+
+  protected:
+    void ThreadMain();
+    void Insert(OpalWheelTimer & timer, bool allowCurrent = false);
+    void Cascade(Link & slot);
+    void Expire(Link & slot, PInt64 now);
+
+    enum {
+      Levels = 4,
+      SlotBits = 6,
+      SlotsPerLevel = 1 << SlotBits,
+      SlotMask = SlotsPerLevel - 1
+    };
+    Link             m_slots[Levels][SlotsPerLevel];
+    unsigned         m_resolution;
+    PInt64           m_epoch;       // Real time in ms of tick zero
+    PInt64           m_currentTick; // Last tick processed
+    unsigned         m_count;       // Timers in the wheel
+    OpalWheelTimer * m_firing;
+    PSemaphore       m_firingDone;
+    unsigned         m_firingWaiters;
+    LagHistogram     m_lag;
+    PDECLARE_MUTEX(m_mutex);
+
+    PSyncPoint       m_wakeUp;
+    atomic<bool>     m_running;
+    PThread        * m_thread;
+};
+
+
+static PInt64 GetNowMS()
+{
+  return PTimer::Tick().GetMilliSeconds();
+}
+
+
+OpalTimerWheel::Shard::Shard(unsigned index, unsigned resolution)
+  : m_resolution(resolution)
+  , m_epoch(GetNowMS())
+  , m_currentTick(0)
+  , m_count(0)
+  , m_firing(NULL)
+  , m_firingDone(0, INT_MAX)
+  , m_firingWaiters(0)
+  , m_running(true)
+{
+  m_thread = new PThreadObj<Shard>(*this, &Shard::ThreadMain, false, PSTRSTRM("TimerWheel:" << index), PThread::HighPriority);
+}
+
+
+OpalTimerWheel::Shard::~Shard()
+{
+  m_running = false;
+  m_wakeUp.Signal();
+  PThread::WaitAndDelete(m_thread);
+
+  PAssert(m_count == 0, "Timer wheel deleted with active timers");
+}
+
+
+void OpalTimerWheel::Shard::Start(OpalWheelTimer & timer, const PTimeInterval & interval, bool continuous)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  if (timer.IsLinked()) {
+    timer.Unlink();
+    --m_count;
+  }
+
+  ++timer.m_generation;
+  timer.m_resetTime = interval;
+  timer.m_continuous = continuous;
+
+  if (interval <= 0)
+    return;
+
+  PInt64 now = GetNowMS();
+
+  // If nothing in wheel, can safely jump forward without processing every tick
+  if (m_count == 0)
+    m_currentTick = (now - m_epoch)/m_resolution;
+
+  timer.m_dueTick = (now - m_epoch + interval.GetMilliSeconds() + m_resolution - 1)/m_resolution;
+  Insert(timer);
+
+  if (++m_count == 1)
+    m_wakeUp.Signal();
+}
+
+
+void OpalTimerWheel::Shard::Stop(OpalWheelTimer & timer, bool wait)
+{
+  m_mutex.Wait();
+
+  if (timer.IsLinked()) {
+    timer.Unlink();
+    --m_count;
+  }
+
+  ++timer.m_generation;
+  timer.m_continuous = false;
+
+  if (m_firing == &timer) {
+    if (PThread::Current() == m_thread)
+      m_firing = NULL; // Stopped from its own notifier, so do not touch it again after return
+    else {
+      while (wait && m_firing == &timer) {
+        ++m_firingWaiters;
+        m_mutex.Signal();
+        m_firingDone.Wait();
+        m_mutex.Wait();
+      }
+    }
+  }
+
+  m_mutex.Signal();
+}
+
+
+bool OpalTimerWheel::Shard::IsRunning(const OpalWheelTimer & timer) const
+{
+  PWaitAndSignal lock(m_mutex);
+  return timer.IsLinked() || (m_firing == &timer && timer.m_continuous);
+}
+
+
+void OpalTimerWheel::Shard::GetLagHistogram(LagHistogram & histogram) const
+{
+  PWaitAndSignal lock(m_mutex);
+  histogram.Merge(m_lag);
+}
+
+
+void OpalTimerWheel::Shard::Insert(OpalWheelTimer & timer, bool allowCurrent)
+{
+  // Only a cascade, which happens before the current slot is expired, may use the current tick
+  PInt64 earliest = allowCurrent ? m_currentTick : m_currentTick + 1;
+  if (timer.m_dueTick < earliest)
+    timer.m_dueTick = earliest;
+
+  PInt64 delta = timer.m_dueTick - m_currentTick;
+  PInt64 slotTick = timer.m_dueTick;
+
+  unsigned level = 0;
+  while (level < Levels-1 && delta >= (PInt64(1) << (SlotBits*(level+1))))
+    ++level;
+
+  // Beyond the top level, park it in the furthest slot, it is re-inserted when cascaded
+  if (delta >= (PInt64(1) << (SlotBits*Levels)))
+    slotTick = m_currentTick + (PInt64(1) << (SlotBits*Levels)) - 1;
+
+  timer.InsertBefore(m_slots[level][(slotTick >> (SlotBits*level)) & SlotMask]);
+}
+
+
+void OpalTimerWheel::Shard::Cascade(Link & slot)
+{
+  Link pending;
+  while (slot.IsLinked()) {
+    Link * link = slot.m_next;
+    link->Unlink();
+    link->InsertBefore(pending);
+  }
+
+  while (pending.IsLinked()) {
+    OpalWheelTimer & timer = *static_cast<OpalWheelTimer *>(pending.m_next);
+    timer.Unlink();
+    Insert(timer, true);
+  }
+}
+
+
+void OpalTimerWheel::Shard::Expire(Link & slot, PInt64 now)
+{
+  /* Move to a local list first, so a notifier that restarts its timer with
+     a very short interval cannot end up being fired again in this pass. */
+  Link expired;
+  while (slot.IsLinked()) {
+    Link * link = slot.m_next;
+    link->Unlink();
+    link->InsertBefore(expired);
+  }
+
+  while (expired.IsLinked()) {
+    OpalWheelTimer & timer = *static_cast<OpalWheelTimer *>(expired.m_next);
+    timer.Unlink();
+    --m_count;
+
+    PInt64 lag = now - (m_epoch + timer.m_dueTick*m_resolution);
+    m_lag.Add(lag > 0 ? (unsigned)lag : 0);
+
+    unsigned generation = timer.m_generation;
+    m_firing = &timer;
+
+    m_mutex.Signal();
+    timer.OnTimeout();
+    m_mutex.Wait();
+
+    // Release any Stop() waiting for this notifier to return
+    while (m_firingWaiters > 0) {
+      --m_firingWaiters;
+      m_firingDone.Signal();
+    }
+
+    if (m_firing != &timer)
+      continue; // Stopped, and possibly deleted, during the notifier
+
+    m_firing = NULL;
+
+    if (timer.m_generation == generation && timer.m_continuous) {
+      // Keep to the original cadence, Insert() will catch up if we fell behind
+      timer.m_dueTick += (timer.m_resetTime.GetMilliSeconds() + m_resolution - 1)/m_resolution;
+      Insert(timer);
+      ++m_count;
+    }
+  }
+}
+
+
+void OpalTimerWheel::Shard::ThreadMain()
+{
+  PTRACE(4, "Timer wheel thread started");
+
+  while (m_running) {
+    PInt64 now = GetNowMS();
+    PInt64 targetTick = (now - m_epoch)/m_resolution;
+
+    m_mutex.Wait();
+
+    while (m_currentTick < targetTick) {
+      if (m_count == 0) {
+        m_currentTick = targetTick;
+        break;
+      }
+
+      PInt64 tick = ++m_currentTick;
+
+      // When a level wraps, move the timers in the next slot of the level above down
+      for (unsigned level = 1; level < Levels && (tick & ((PInt64(1) << (SlotBits*level)) - 1)) == 0; ++level)
+        Cascade(m_slots[level][(tick >> (SlotBits*level)) & SlotMask]);
+
+      Expire(m_slots[0][tick & SlotMask], now);
+    }
+
+    unsigned count = m_count;
+
+    m_mutex.Signal();
+
+    if (count == 0)
+      m_wakeUp.Wait();
+    else {
+      PInt64 nextTickTime = m_epoch + (targetTick+1)*m_resolution;
+      now = GetNowMS();
+      if (nextTickTime > now)
+        m_wakeUp.Wait(PTimeInterval(nextTickTime - now));
+    }
+  }
+
+  PTRACE(4, "Timer wheel thread ended");
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+const unsigned OpalTimerWheel::LagHistogram::BucketLimits[OpalTimerWheel::LagHistogram::NumBuckets-1] = {
+  1, 2, 5, 10, 20, 50, 100
+};
+
+
+OpalTimerWheel::LagHistogram::LagHistogram()
+  : m_total(0)
+  , m_maximum(0)
+{
+  memset(m_buckets, 0, sizeof(m_buckets));
+}
+
+
+void OpalTimerWheel::LagHistogram::Merge(const LagHistogram & other)
+{
+  for (PINDEX i = 0; i < NumBuckets; ++i)
+    m_buckets[i] += other.m_buckets[i];
+  m_total += other.m_total;
+  if (m_maximum < other.m_maximum)
+    m_maximum = other.m_maximum;
+}
+
+
+void OpalTimerWheel::LagHistogram::Add(unsigned lag)
+{
+  PINDEX bucket = 0;
+  while (bucket < NumBuckets-1 && lag >= BucketLimits[bucket])
+    ++bucket;
+  ++m_buckets[bucket];
+  ++m_total;
+  if (m_maximum < lag)
+    m_maximum = lag;
+}
+
+
+void OpalTimerWheel::LagHistogram::PrintOn(ostream & strm) const
+{
+  strm << "total=" << m_total << " max=" << m_maximum << "ms";
+  for (PINDEX i = 0; i < NumBuckets; ++i) {
+    strm << ' ';
+    if (i < NumBuckets-1)
+      strm << '<' << BucketLimits[i];
+    else
+      strm << ">=" << BucketLimits[i-1];
+    strm << "ms=" << m_buckets[i];
+  }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalTimerWheel::OpalTimerWheel(unsigned threadCount, unsigned resolution)
+  : m_resolution(std::max(1U, resolution))
+  , m_nextShard(0)
+{
+  if (threadCount == 0)
+    threadCount = std::max(1U, PThread::GetNumProcessors());
+
+  for (unsigned i = 0; i < threadCount; ++i)
+    m_shards.push_back(new Shard(i+1, m_resolution));
+
+  PTRACE(3, "Timer wheel started with " << m_shards.size() << " threads, resolution " << m_resolution << "ms");
+}
+
+
+OpalTimerWheel::~OpalTimerWheel()
+{
+  for (size_t i = 0; i < m_shards.size(); ++i)
+    delete m_shards[i];
+  PTRACE(4, "Timer wheel stopped");
+}
+
+
+void OpalTimerWheel::GetLagHistogram(LagHistogram & histogram) const
+{
+  for (size_t i = 0; i < m_shards.size(); ++i)
+    m_shards[i]->GetLagHistogram(histogram);
+}
+
+
+OpalTimerWheel::Shard & OpalTimerWheel::SelectShard()
+{
+  return *m_shards[m_nextShard++ % m_shards.size()];
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalWheelTimer::OpalWheelTimer(OpalTimerWheel & wheel, const PNotifier & notifier)
+  : m_wheel(wheel)
+  , m_shard(&wheel.SelectShard())
+  , m_notifier(notifier)
+  , m_continuous(false)
+  , m_dueTick(0)
+  , m_generation(0)
+{
+}
+
+
+OpalWheelTimer::~OpalWheelTimer()
+{
+  m_shard->Stop(*this, true);
+}
+
+
+void OpalWheelTimer::PrintOn(ostream & strm) const
+{
+  strm << m_resetTime;
+}
+
+
+void OpalWheelTimer::OnTimeout()
+{
+  if (!m_notifier.IsNULL())
+    m_notifier(*this, 0);
+}
+
+
+void OpalWheelTimer::SetNotifier(const PNotifier & notifier)
+{
+  Stop();
+  m_notifier = notifier;
+}
+
+
+void OpalWheelTimer::SetInterval(const PTimeInterval & interval)
+{
+  m_shard->Start(*this, interval, false);
+}
+
+
+void OpalWheelTimer::RunContinuous(const PTimeInterval & interval)
+{
+  m_shard->Start(*this, interval, true);
+}
+
+
+void OpalWheelTimer::Stop(bool wait)
+{
+  m_shard->Stop(*this, wait);
+}
+
+
+bool OpalWheelTimer::IsRunning() const
+{
+  return m_shard->IsRunning(*this);
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
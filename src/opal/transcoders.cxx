@@ -261,6 +261,236 @@ OpalTranscoder * OpalTranscoder::Create(const OpalMediaFormat & srcFormat,
 }
 
 
+struct OpalTranscoderPool
+{
+  typedef std::vector<OpalTranscoder *> Instances;
+  typedef std::map<PString, Instances> InstanceMap;
+
+  OpalTranscoderPool()
+    : m_pooled(0)
+    , m_maxPerKey(4)
+    , m_maxTotal(64)
+  {
+  }
+
+  ~OpalTranscoderPool()
+  {
+    Instances instances;
+    Trim(0, 0, instances);
+    for (Instances::iterator it = instances.begin(); it != instances.end(); ++it)
+      delete *it;
+  }
+
+  // Remove instances over the limits, must be deleted by caller outside of lock
+  void Trim(unsigned maxPerKey, unsigned maxTotal, Instances & removed)
+  {
+    for (InstanceMap::iterator it = m_instances.begin(); it != m_instances.end(); ++it) {
+      while (!it->second.empty() && (it->second.size() > maxPerKey || m_pooled > maxTotal)) {
+        removed.push_back(it->second.back());
+        it->second.pop_back();
+        --m_pooled;
+      }
+    }
+  }
+
+  PDECLARE_MUTEX(m_mutex);
+  InstanceMap m_instances;
+  unsigned    m_pooled;
+  unsigned    m_maxPerKey;
+  unsigned    m_maxTotal;
+  OpalTranscoder::PoolStatistics m_statistics;
+};
+
+static OpalTranscoderPool & GetTranscoderPool()
+{
+  static OpalTranscoderPool pool;
+  return pool;
+}
+
+
+static void HashTranscoderFormat(uint64_t & hash, const OpalMediaFormat & format)
+{
+  for (PINDEX i = 0; i < format.GetOptionCount(); ++i) {
+    const OpalMediaOption & option = format.GetOption(i);
+    PString str = option.GetName() + '=' + option.AsString();
+    for (const char * ptr = str; *ptr != '\0'; ++ptr) {
+      hash ^= (BYTE)*ptr;
+      hash *= 1099511628211ULL; // FNV-1a
+    }
+  }
+}
+
+
+static PString GetTranscoderPoolKey(const OpalMediaFormat & srcFormat, const OpalMediaFormat & destFormat)
+{
+  /* The options hash only selects a warm instance with the same configuration,
+     Acquire() still applies the actual formats so a collision is harmless. */
+  uint64_t hash = 14695981039346656037ULL;
+  HashTranscoderFormat(hash, srcFormat);
+  HashTranscoderFormat(hash, destFormat);
+
+  PStringStream key;
+  key << srcFormat.GetName() << '\t' << destFormat.GetName() << '\t' << hex << hash;
+  return key;
+}
+
+
+OpalTranscoder * OpalTranscoder::Acquire(const OpalMediaFormat & srcFormat,
+                                         const OpalMediaFormat & destFormat,
+                                                    const BYTE * instance,
+                                                        unsigned instanceLen)
+{
+  OpalTranscoderPool & pool = GetTranscoderPool();
+  PString key = GetTranscoderPoolKey(srcFormat, destFormat);
+
+  OpalTranscoder * transcoder = NULL;
+  {
+    PWaitAndSignal lock(pool.m_mutex);
+    OpalTranscoderPool::InstanceMap::iterator it = pool.m_instances.find(key);
+    if (it != pool.m_instances.end() && !it->second.empty()) {
+      transcoder = it->second.back();
+      it->second.pop_back();
+      --pool.m_pooled;
+      ++pool.m_statistics.m_hits;
+    }
+    else
+      ++pool.m_statistics.m_misses;
+  }
+
+  if (transcoder != NULL) {
+    transcoder->SetInstanceID(instance, instanceLen);
+    transcoder->inputMediaFormat = srcFormat;
+    transcoder->outputMediaFormat = destFormat;
+    if (transcoder->UpdateMediaFormats(srcFormat, destFormat)) {
+      PTRACE2(4, transcoder, "Re-using pooled transcoder instance from " << srcFormat << " to " << destFormat);
+      return transcoder;
+    }
+
+    PTRACE2(2, transcoder, "Could not re-use pooled transcoder instance from " << srcFormat << " to " << destFormat);
+    delete transcoder;
+  }
+
+  transcoder = Create(srcFormat, destFormat, instance, instanceLen);
+  if (transcoder != NULL)
+    transcoder->m_poolKey = key;
+  return transcoder;
+}
+
+
+void OpalTranscoder::Release(OpalTranscoder * transcoder)
+{
+  if (transcoder == NULL)
+    return;
+
+  OpalTranscoderPool & pool = GetTranscoderPool();
+
+  if (transcoder->m_poolKey.IsEmpty())
+    transcoder->m_poolKey = GetTranscoderPoolKey(transcoder->inputMediaFormat, transcoder->outputMediaFormat);
+
+  // Detach from the previous user
+  transcoder->commandNotifier = PNotifier();
+  transcoder->m_sessionID = 0;
+  transcoder->m_lastPayloadType = RTP_DataFrame::IllegalPayloadType;
+  transcoder->m_consecutivePayloadTypeMismatches = 0;
+
+  bool room;
+  {
+    PWaitAndSignal lock(pool.m_mutex);
+    room = pool.m_pooled < pool.m_maxTotal && pool.m_instances[transcoder->m_poolKey].size() < pool.m_maxPerKey;
+  }
+
+  // Reset outside the lock, it may take a while for some codecs
+  if (room && transcoder->Reset()) {
+    PWaitAndSignal lock(pool.m_mutex);
+    OpalTranscoderPool::Instances & instances = pool.m_instances[transcoder->m_poolKey];
+    if (pool.m_pooled < pool.m_maxTotal && instances.size() < pool.m_maxPerKey) {
+      instances.push_back(transcoder);
+      ++pool.m_pooled;
+      ++pool.m_statistics.m_returned;
+      return;
+    }
+  }
+
+  {
+    PWaitAndSignal lock(pool.m_mutex);
+    ++pool.m_statistics.m_discarded;
+  }
+
+  delete transcoder;
+}
+
+
+OpalTranscoder::PoolStatistics::PoolStatistics()
+  : m_hits(0)
+  , m_misses(0)
+  , m_returned(0)
+  , m_discarded(0)
+  , m_pooled(0)
+  , m_maxPerKey(0)
+  , m_maxTotal(0)
+{
+}
+
+
+ostream & operator<<(ostream & strm, const OpalTranscoder::PoolStatistics & stats)
+{
+  return strm << "hits=" << stats.m_hits
+              << " misses=" << stats.m_misses
+              << " returned=" << stats.m_returned
+              << " discarded=" << stats.m_discarded
+              << " pooled=" << stats.m_pooled << '/' << stats.m_maxTotal
+              << " per-key=" << stats.m_maxPerKey;
+}
+
+
+void OpalTranscoder::GetPoolStatistics(PoolStatistics & statistics)
+{
+  OpalTranscoderPool & pool = GetTranscoderPool();
+  PWaitAndSignal lock(pool.m_mutex);
+  statistics = pool.m_statistics;
+  statistics.m_pooled = pool.m_pooled;
+  statistics.m_maxPerKey = pool.m_maxPerKey;
+  statistics.m_maxTotal = pool.m_maxTotal;
+}
+
+
+void OpalTranscoder::SetPoolLimits(unsigned maxPerKey, unsigned maxTotal)
+{
+  OpalTranscoderPool & pool = GetTranscoderPool();
+  OpalTranscoderPool::Instances removed;
+  {
+    PWaitAndSignal lock(pool.m_mutex);
+    pool.m_maxPerKey = maxPerKey;
+    pool.m_maxTotal = maxTotal;
+    pool.Trim(maxPerKey, maxTotal, removed);
+  }
+
+  for (OpalTranscoderPool::Instances::iterator it = removed.begin(); it != removed.end(); ++it)
+    delete *it;
+}
+
+
+void OpalTranscoder::ClearPool()
+{
+  OpalTranscoderPool & pool = GetTranscoderPool();
+  OpalTranscoderPool::Instances removed;
+  {
+    PWaitAndSignal lock(pool.m_mutex);
+    pool.Trim(0, 0, removed);
+  }
+
+  PTRACE_IF(4, !removed.empty(), "Cleared " << removed.size() << " pooled transcoders");
+  for (OpalTranscoderPool::Instances::iterator it = removed.begin(); it != removed.end(); ++it)
+    delete *it;
+}
+
+
+bool OpalTranscoder::Reset()
+{
+  return false;
+}
+
+
 static bool MergeFormats(const OpalMediaFormatList & masterFormats,
                          const OpalMediaFormat & srcCapability,
                          const OpalMediaFormat & dstCapability,
@@ -693,6 +923,9 @@ PBoolean OpalStreamedTranscoder::Convert(const RTP_DataFrame & input,
   BYTE * outputBytes = output.GetPayloadPtr();
   short * outputWords = (short *)outputBytes;
 
+  if (ConvertBlock(inputBytes, outputBytes, samples))
+    return true;
+
   switch (inputBitsPerSample) {
     case 16 :
       switch (outputBitsPerSample) {
@@ -856,8 +1089,34 @@ PBoolean OpalStreamedTranscoder::Convert(const RTP_DataFrame & input,
 }
 
 
+bool OpalStreamedTranscoder::ConvertBlock(const BYTE *, BYTE *, PINDEX) const
+{
+  return false;
+}
+
+
+bool OpalStreamedTranscoder::Reset()
+{
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
+static void SwapLinear16Block(const BYTE * input, BYTE * output, PINDEX samples)
+{
+#if PBYTE_ORDER==PLITTLE_ENDIAN
+  // Simple enough loop for the compiler to vectorise
+  const uint16_t * in = (const uint16_t *)input;
+  uint16_t * out = (uint16_t *)output;
+  for (PINDEX i = 0; i < samples; ++i)
+    out[i] = (uint16_t)((in[i] >> 8) | (in[i] << 8));
+#else
+  memmove(output, input, samples*2);
+#endif
+}
+
+
 Opal_Linear16Mono_PCM::Opal_Linear16Mono_PCM()
   : OpalStreamedTranscoder(OpalL16_MONO_8KHZ, OpalPCM16, 16, 16)
 {
@@ -875,6 +1134,13 @@ int Opal_Linear16Mono_PCM::ConvertOne(int sample) const
 }
 
 
+bool Opal_Linear16Mono_PCM::ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const
+{
+  SwapLinear16Block(input, output, samples);
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 Opal_PCM_Linear16Mono::Opal_PCM_Linear16Mono()
@@ -895,4 +1161,11 @@ int Opal_PCM_Linear16Mono::ConvertOne(int sample) const
 }
 
 
+bool Opal_PCM_Linear16Mono::ConvertBlock(const BYTE * input, BYTE * output, PINDEX samples) const
+{
+  SwapLinear16Block(input, output, samples);
+  return true;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
@@ -218,6 +218,13 @@ OpalDTLSMediaTransport::DTLSChannel * OpalDTLSMediaTransport::CreateDTLSChannel(
 }
 
 
+bool OpalDTLSMediaTransport::InternalCanUseReactor(SubChannels) const
+{
+  // Handshake in InternalOnStart() blocks, so needs own thread
+  return false;
+}
+
+
 void OpalDTLSMediaTransport::InternalOnStart(SubChannels subchannel)
 {
   OpalDTLSMediaTransportParent::InternalOnStart(subchannel);
@@ -52,7 +52,7 @@ const unsigned MaxConsecutiveOverflows = 10;
 
 #define ANALYSER_TRACE_LEVEL     5
 
-#define COMMON_TRACE_INFO ": ts=" << requiredTimestamp << " (" << playOutTimestamp << "), dT=" << removalDelta << ", size=" << m_frames.size()
+#define COMMON_TRACE_INFO ": ts=" << requiredTimestamp << " (" << playOutTimestamp << "), dT=" << removalDelta << ", size=" << m_frames.GetSize()
 #define COMMON_TRACE_DELAY " delay=" << m_currentJitterDelay << " (" << (m_currentJitterDelay/m_timeUnits) << "ms)"
 
 
@@ -66,7 +66,7 @@ const unsigned MaxConsecutiveOverflows = 10;
 
   #define ANALYSE(inout, time, extra) \
     if (PTrace::CanTrace(ANALYSER_TRACE_LEVEL)) \
-      m_analyser->inout(tick, time, m_frames.size(), extra)
+      m_analyser->inout(tick, time, m_frames.GetSize(), extra)
 
   class OpalJitterBuffer::Analyser : public PObject
   {
@@ -330,7 +330,7 @@ void OpalAudioJitterBuffer::Restart()
 void OpalAudioJitterBuffer::PrintOn(ostream & strm) const
 {
   strm << "this=" << (void *)this
-       << " packets=" << m_frames.size()
+       << " packets=" << m_frames.GetSize()
        <<   " rate=" << m_timeUnits << "kHz"
        <<  " delay=" << (m_minJitterDelay/m_timeUnits) << '-'
                      << (m_currentJitterDelay/m_timeUnits) << '-'
@@ -388,7 +388,7 @@ void OpalAudioJitterBuffer::InternalReset()
 
   m_synchronisationState = e_SynchronisationStart;
 
-  m_frames.clear();
+  m_frames.RemoveAll();
 }
 
 
@@ -484,7 +484,7 @@ PBoolean OpalAudioJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTi
           AdjustCurrentJitterDelay(0);
           PTRACE(std::min(sm_EveryPacketLogLevel,4U), "Frame time set  :"
                  " ts=" << timestamp << ","
-                 " size=" << m_frames.size() << ","
+                 " size=" << m_frames.GetSize() << ","
                  " time=" << newFrameTime << " (" << (newFrameTime/m_timeUnits) << "ms),"
                  COMMON_TRACE_DELAY);
         }
@@ -503,14 +503,13 @@ PBoolean OpalAudioJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTi
   /* Fail safe for infinite queueing, for example, if other thread is not
      taking stuff out.  Also checks for abrupt changes in timestamp values, can
      happen when remote is swapping media sources */
-  FrameMap::iterator oldestFrame = m_frames.begin();
-  if (oldestFrame != m_frames.end()) {
-    RTP_Timestamp delta = timestamp - oldestFrame->second.GetTimestamp();
+  if (!m_frames.IsEmpty()) {
+    RTP_Timestamp delta = timestamp - m_frames.GetOldestTimestamp();
     if (delta < (m_maxJitterDelay > 0 ? (m_maxJitterDelay*2) : (m_timeUnits*1000)))
       m_consecutiveOverflows = 0;
     else {
       ANALYSE(In, timestamp, "Overflow");
-      PTRACE(std::min(sm_EveryPacketLogLevel,4U), "Buffer overflow : ts=" << timestamp << ", delta=" << delta << ", size=" << m_frames.size());
+      PTRACE(std::min(sm_EveryPacketLogLevel,4U), "Buffer overflow : ts=" << timestamp << ", delta=" << delta << ", size=" << m_frames.GetSize());
       if (++m_consecutiveOverflows > (m_packetTime == 0 ? AverageFrameTimePackets : MaxConsecutiveOverflows)) {
         PTRACE(2, "Consecutive overflow packets, resynching");
         InternalReset();
@@ -521,19 +520,32 @@ PBoolean OpalAudioJitterBuffer::WriteData(const RTP_DataFrame & frame, const PTi
 
 
   // Add to buffer
-  pair<FrameMap::iterator,bool> result = m_frames.insert(FrameMap::value_type(timestamp, frame));
-  if (result.second) {
-    ANALYSE(In, timestamp, m_synchronisationState != e_SynchronisationDone ? "PreBuf" : "");
-    PTRACE_IF(sm_EveryPacketLogLevel, m_maxJitterDelay > 0, "Inserted packet :"
-           " ts=" << timestamp << ","
-           " dT=" << (tick - m_lastInsertTick) << ","
-           " payload=" << frame.GetPayloadSize() << ","
-           " size=" << m_frames.size());
-    m_lastInsertTick = tick;
-    m_frameCount.Signal();
-  }
-  else {
-    PTRACE(2, "Attempt to insert two RTP packets with same timestamp: " << timestamp);
+  switch (m_frames.Insert(frame)) {
+    case FrameRing::e_Inserted :
+      ANALYSE(In, timestamp, m_synchronisationState != e_SynchronisationDone ? "PreBuf" : "");
+      PTRACE_IF(sm_EveryPacketLogLevel, m_maxJitterDelay > 0, "Inserted packet :"
+             " ts=" << timestamp << ","
+             " dT=" << (tick - m_lastInsertTick) << ","
+             " payload=" << frame.GetPayloadSize() << ","
+             " size=" << m_frames.GetSize());
+      m_lastInsertTick = tick;
+      m_frameCount.Signal();
+      break;
+
+    case FrameRing::e_Duplicate :
+      PTRACE(2, "Attempt to insert two RTP packets with same sequence number: " << currentSequenceNum);
+      break;
+
+    case FrameRing::e_TooOld :
+      PTRACE(std::min(sm_EveryPacketLogLevel,4U), "Packet too old  : ts=" << timestamp << ", sn=" << currentSequenceNum);
+      ++m_packetsTooLate;
+      break;
+
+    case FrameRing::e_TooNew :
+      ANALYSE(In, timestamp, "Overflow");
+      PTRACE(std::min(sm_EveryPacketLogLevel,4U), "Buffer overflow : ts=" << timestamp << ", sn=" << currentSequenceNum << ", size=" << m_frames.GetSize());
+      ++m_bufferOverruns;
+      break;
   }
 
   return true;
@@ -567,7 +579,7 @@ bool OpalAudioJitterBuffer::AdjustCurrentJitterDelay(int delta)
 }
 
 
-PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval & PTRACE_PARAM(, const PTimeInterval& tick))
+PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInterval & timeout PTRACE_PARAM(, const PTimeInterval& tick))
 {
   // Default response is an empty frame, ie silence with possible comfort noise
   frame.SetPayloadType(RTP_DataFrame::CN);
@@ -575,18 +587,16 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
 
   if (m_maxJitterDelay == 0) {
     m_currentJitterDelay = 0;
-    m_frameCount.Wait(); // Go synchronous
+    if (!m_frameCount.Wait(timeout)) // Go synchronous
+      return !m_closed;
     PWaitAndSignal mutex(m_bufferMutex);
-    if (m_frames.empty()) {
+    if (m_frames.IsEmpty()) {
         // Must have been reset, clear the semaphore.
         while (m_frameCount.Wait(0))
             ;
     }
-    else {
-      FrameMap::iterator oldestFrame = m_frames.begin();
-      frame = oldestFrame->second;
-      m_frames.erase(oldestFrame);
-    }
+    else
+      m_frames.RemoveOldest(&frame);
     return !m_closed;
   }
 
@@ -607,7 +617,7 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
   RTP_Timestamp playOutTimestamp = frame.GetTimestamp();
   RTP_Timestamp requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
 
-  if (m_frames.empty()) {
+  if (m_frames.IsEmpty()) {
     /*We ran the buffer down to empty, so have no data to play, play silence.
       This happens if packet is too late or completely missing. A too late
       packet will be picked up by later code.
@@ -639,7 +649,7 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
     if (maxFramesInBuffer < 2)
       maxFramesInBuffer = 2;
 
-    int currentFramesInBuffer = m_frames.size(); // Must be signed int for later abs()
+    int currentFramesInBuffer = m_frames.GetSize(); // Must be signed int for later abs()
 
     /* Check for buffer low (one packet) for prologed period, then that generally
        means we have a sample clock drift problem, that is we have a clock of 8.01kHz and
@@ -673,26 +683,25 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
   }
 
   // Get the oldest packet
-  FrameMap::iterator oldestFrame = m_frames.begin();
-  PAssert(oldestFrame != m_frames.end(), PLogicError);
+  RTP_Timestamp oldestTimestamp = m_frames.GetOldestTimestamp();
 
   // Check current buffer state and act accordingly
   switch (m_synchronisationState) {
     case e_SynchronisationStart :
       /* First packet of talk burst, re-calculate the timestamp delta */
-      m_timestampDelta = oldestFrame->first - playOutTimestamp;
+      m_timestampDelta = oldestTimestamp - playOutTimestamp;
       requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
       m_synchronisationState = e_SynchronisationFill;
-      PTRACE(std::min(sm_EveryPacketLogLevel,5U), "Synchronising   " COMMON_TRACE_INFO << ", oldest=" << oldestFrame->first);
-      ANALYSE(Out, oldestFrame->first, "PreBuf");
+      PTRACE(std::min(sm_EveryPacketLogLevel,5U), "Synchronising   " COMMON_TRACE_INFO << ", oldest=" << oldestTimestamp);
+      ANALYSE(Out, oldestTimestamp, "PreBuf");
       return true;
 
     case e_SynchronisationFill :
       /* Now see if we have buffered enough yet */
-      if (requiredTimestamp < oldestFrame->first) {
-        PTRACE(sm_EveryPacketLogLevel, "Pre-buffering   " COMMON_TRACE_INFO << ", oldest=" << oldestFrame->first);
+      if (requiredTimestamp < oldestTimestamp) {
+        PTRACE(sm_EveryPacketLogLevel, "Pre-buffering   " COMMON_TRACE_INFO << ", oldest=" << oldestTimestamp);
         /* Nope, play out some silence */
-        ANALYSE(Out, oldestFrame->first, "PreBuf");
+        ANALYSE(Out, oldestTimestamp, "PreBuf");
         return true;
       }
 
@@ -706,7 +715,7 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
 
     case e_SynchronisationDone :
       // Get rid of all the frames that are too late
-      while (requiredTimestamp >= oldestFrame->first + m_packetTime) {
+      while (requiredTimestamp >= oldestTimestamp + m_packetTime) {
         if (++m_consecutiveLatePackets > 10) {
           PTRACE(std::min(sm_EveryPacketLogLevel,3U), "Too many late   " COMMON_TRACE_INFO);
           InternalReset();
@@ -716,14 +725,14 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
         // Packets late, need a bigger jitter buffer
         PTRACE_PARAM(bool adjusted =) AdjustCurrentJitterDelay(m_jitterGrowTime);
         PTRACE(std::min(sm_EveryPacketLogLevel,4U), "Packet too late " COMMON_TRACE_INFO
-                  << ", oldest=" << oldestFrame->first << ", "
+                  << ", oldest=" << oldestTimestamp << ", "
                   << (adjusted ? "increasing" : "cannot increase") << COMMON_TRACE_DELAY);
-        ANALYSE(Out, oldestFrame->first, "Late");
+        ANALYSE(Out, oldestTimestamp, "Late");
         m_bufferStaticTime = playOutTimestamp;
-        m_frames.erase(oldestFrame);
+        m_frames.RemoveOldest();
         ++m_packetsTooLate;
 
-        if (m_frames.empty()) {
+        if (m_frames.IsEmpty()) {
           PTRACE(sm_EveryPacketLogLevel, "Buffer emptied  " COMMON_TRACE_INFO);
           ANALYSE(Out, requiredTimestamp, "Emptied");
           return true;
@@ -731,15 +740,14 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
 
         requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
 
-        oldestFrame = m_frames.begin();
-        PAssert(oldestFrame != m_frames.end(), PLogicError);
+        oldestTimestamp = m_frames.GetOldestTimestamp();
       }
 
       /* Check for buffer overfull due to clock mismatch. It is possible for the remote
          to have a clock of 8.01kHz and the receiver 7.99kHz so gradually the remote
          sends more data than we take out over time, gradually building up in the
          jitter buffer. So, drop a frame every now and then. */
-      if (m_frames.size() <= maxFramesInBuffer*m_overrunFactor)
+      if ((size_t)m_frames.GetSize() <= maxFramesInBuffer*m_overrunFactor)
         break;
 
       PTRACE(m_overrunFactor < 10 ? std::min(sm_EveryPacketLogLevel,4U) : 2,
@@ -751,19 +759,19 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
     case e_SynchronisationShrink :
       m_synchronisationState = e_SynchronisationDone;
       requiredTimestamp = CalculateRequiredTimestamp(playOutTimestamp);
-      while (requiredTimestamp >= oldestFrame->first + m_packetTime) {
-        ANALYSE(Out, oldestFrame->first, "Shrink");
-        PTRACE(sm_EveryPacketLogLevel, "Dropping packet " COMMON_TRACE_INFO << ", actual-ts=" << oldestFrame->first);
-        m_frames.erase(oldestFrame);
+      while (requiredTimestamp >= oldestTimestamp + m_packetTime) {
+        ANALYSE(Out, oldestTimestamp, "Shrink");
+        PTRACE(sm_EveryPacketLogLevel, "Dropping packet " COMMON_TRACE_INFO << ", actual-ts=" << oldestTimestamp);
+        m_frames.RemoveOldest();
         ++m_bufferOverruns;
 
-        if (m_frames.empty()) {
+        if (m_frames.IsEmpty()) {
           PTRACE(sm_EveryPacketLogLevel, "Buffer emptied  " COMMON_TRACE_INFO);
           ANALYSE(Out, requiredTimestamp, "Emptied");
           return true;
         }
 
-        oldestFrame = m_frames.begin();
+        oldestTimestamp = m_frames.GetOldestTimestamp();
       }
       break;
   }
@@ -772,30 +780,100 @@ PBoolean OpalAudioJitterBuffer::ReadData(RTP_DataFrame & frame, const PTimeInter
      packet (not arrived yet) in buffer. Can't wait for it, return no data.
      If the packet subsequently DOES arrive, it will get picked up by the
      too late section above. */
-  if (requiredTimestamp < oldestFrame->first) {
-    if (oldestFrame->first - requiredTimestamp > m_timeUnits*1000) {
+  if (requiredTimestamp < oldestTimestamp) {
+    if (oldestTimestamp - requiredTimestamp > m_timeUnits*1000) {
       PTRACE(std::min(sm_EveryPacketLogLevel,3U), "Too far in ahead" COMMON_TRACE_INFO);
       InternalReset();
     }
     else {
-      PTRACE(sm_EveryPacketLogLevel, "Packet not ready" COMMON_TRACE_INFO << ", oldest=" << oldestFrame->first);
+      PTRACE(sm_EveryPacketLogLevel, "Packet not ready" COMMON_TRACE_INFO << ", oldest=" << oldestTimestamp);
       ANALYSE(Out, requiredTimestamp, "Wait");
     }
     return true;
   }
 
   // Finally can return the frame we have
-  ANALYSE(Out, oldestFrame->first, "");
-  frame = oldestFrame->second;
+  ANALYSE(Out, oldestTimestamp, "");
+  m_frames.RemoveOldest(&frame);
   PTRACE(sm_EveryPacketLogLevel, "Delivered packet" COMMON_TRACE_INFO
          << ", payload=" << frame.GetPayloadSize() << ", actual-ts=" << frame.GetTimestamp());
-  m_frames.erase(oldestFrame);
   frame.SetTimestamp(playOutTimestamp);
   m_consecutiveLatePackets = 0;
   return true;
 }
 
 
+OpalAudioJitterBuffer::FrameRing::FrameRing()
+  : m_slots(Capacity)
+  , m_oldest(0)
+  , m_newest(0)
+  , m_count(0)
+{
+  for (std::vector<Slot>::iterator it = m_slots.begin(); it != m_slots.end(); ++it)
+    it->m_frame = m_emptyFrame;
+}
+
+
+OpalAudioJitterBuffer::FrameRing::InsertResult OpalAudioJitterBuffer::FrameRing::Insert(const RTP_DataFrame & frame)
+{
+  RTP_SequenceNumber sequenceNumber = frame.GetSequenceNumber();
+
+  if (m_count == 0)
+    m_oldest = m_newest = sequenceNumber;
+  else {
+    int16_t ahead = (int16_t)(sequenceNumber - m_oldest);
+    if (ahead < 0) {
+      if ((RTP_SequenceNumber)(m_newest - sequenceNumber) >= Capacity)
+        return e_TooOld;
+    }
+    else if (ahead >= Capacity)
+      return e_TooNew;
+  }
+
+  Slot & slot = m_slots[sequenceNumber & (Capacity-1)];
+  if (slot.m_used)
+    return e_Duplicate;
+
+  if ((int16_t)(sequenceNumber - m_oldest) < 0)
+    m_oldest = sequenceNumber;
+  else if ((int16_t)(sequenceNumber - m_newest) > 0)
+    m_newest = sequenceNumber;
+
+  slot.m_frame = frame;
+  slot.m_timestamp = frame.GetTimestamp();
+  slot.m_used = true;
+  ++m_count;
+  return e_Inserted;
+}
+
+
+void OpalAudioJitterBuffer::FrameRing::RemoveOldest(RTP_DataFrame * frame)
+{
+  Slot & slot = m_slots[m_oldest & (Capacity-1)];
+  PAssert(slot.m_used, PLogicError);
+
+  if (frame != NULL)
+    *frame = slot.m_frame;
+  slot.m_frame = m_emptyFrame;
+  slot.m_used = false;
+
+  if (--m_count == 0)
+    return;
+
+  // Skip over missing packets to next oldest, guaranteed to find one as m_count > 0
+  do {
+    ++m_oldest;
+  } while (!m_slots[m_oldest & (Capacity-1)].m_used);
+}
+
+
+void OpalAudioJitterBuffer::FrameRing::RemoveAll()
+{
+  while (m_count > 0)
+    RemoveOldest();
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalNonJitterBuffer::OpalNonJitterBuffer(const Init & init)
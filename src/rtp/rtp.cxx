@@ -56,13 +56,18 @@
 /////////////////////////////////////////////////////////////////////////////
 
 RTP_DataFrame::RTP_DataFrame(PINDEX payloadSz, PINDEX bufferSz)
-  : PBYTEArray(max(bufferSz, MinHeaderSize+payloadSz))
-  , m_headerSize(MinHeaderSize)
+  : m_headerSize(MinHeaderSize)
   , m_payloadSize(payloadSz)
   , m_paddingSize(0)
   , m_absoluteTime(0)
   , m_discontinuity(0)
 {
+  /* A frame with no payload or buffer size is usually about to be assigned
+     from another frame, so don't bother taking a buffer from the pool. */
+  PINDEX size = max(bufferSz, MinHeaderSize+payloadSz);
+  if (size <= MinHeaderSize || !RTP_DataFramePool::Allocate(*this, size))
+    SetSize(size);
+
   theArray[0] = '\x80'; // Default to version 2
   theArray[1] = '\x7f'; // Default to MaxPayloadType
 }
@@ -80,6 +85,24 @@ RTP_DataFrame::RTP_DataFrame(const BYTE * data, PINDEX len, bool dynamic)
 }
 
 
+RTP_DataFrame::RTP_DataFrame(const PBYTEArray & data)
+  : PBYTEArray(data)
+  , m_headerSize(MinHeaderSize)
+  , m_payloadSize(0)
+  , m_paddingSize(0)
+  , m_absoluteTime(0)
+  , m_discontinuity(0)
+{
+}
+
+
+RTP_DataFrame::~RTP_DataFrame()
+{
+  if (allocatedDynamically)
+    RTP_DataFramePool::Release(*this);
+}
+
+
 bool RTP_DataFrame::SetPacketSize(PINDEX sz)
 {
   m_discontinuity = 0;
@@ -632,6 +655,128 @@ void RTP_SourceDescription::PrintOn(ostream & strm) const
 #endif // PTRACING
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+static bool RTP_DataFramePoolDestroyed = false;
+
+RTP_DataFramePool::RTP_DataFramePool()
+{
+}
+
+
+RTP_DataFramePool::~RTP_DataFramePool()
+{
+  // Frames with static storage may be destroyed after us
+  RTP_DataFramePoolDestroyed = true;
+}
+
+
+RTP_DataFramePool * RTP_DataFramePool::GetInstance()
+{
+  if (RTP_DataFramePoolDestroyed)
+    return NULL;
+
+  static RTP_DataFramePool pool;
+  return &pool;
+}
+
+
+int RTP_DataFramePool::GetSizeClass(PINDEX size)
+{
+  PINDEX classSize = MinClassSize;
+  for (int sizeClass = 0; sizeClass < NumSizeClasses; ++sizeClass) {
+    if (size <= classSize)
+      return sizeClass;
+    classSize *= 2;
+  }
+  return -1;
+}
+
+
+RTP_DataFramePool::Shard & RTP_DataFramePool::GetShard()
+{
+  size_t id = (size_t)PThread::GetCurrentThreadId();
+  return m_shards[((id >> 4) ^ (id >> 12)) % NumShards];
+}
+
+
+bool RTP_DataFramePool::Allocate(PBYTEArray & buffer, PINDEX size)
+{
+  int sizeClass = GetSizeClass(size);
+  if (sizeClass < 0)
+    return false;
+
+  RTP_DataFramePool * pool = GetInstance();
+  if (pool == NULL)
+    return false;
+
+  Shard & shard = pool->GetShard();
+  shard.m_mutex.Wait();
+  std::vector<PBYTEArray> & freeList = shard.m_free[sizeClass];
+  if (freeList.empty()) {
+    ++shard.m_misses;
+    shard.m_mutex.Signal();
+    buffer.SetSize(size); // Fresh memory is zeroed
+    return true;
+  }
+
+  /* Most streams use the same few sizes, so look for an exact match, most
+     recently released first, otherwise adjust one from the same class. */
+  std::vector<PBYTEArray>::iterator it = freeList.end();
+  do {
+    --it;
+  } while (it != freeList.begin() && it->GetSize() != size);
+  if (it->GetSize() != size)
+    it = freeList.end() - 1;
+
+  buffer = *it;
+  freeList.erase(it);
+  ++shard.m_hits;
+  shard.m_mutex.Signal();
+
+  // The whole logical buffer is being reused, so the whole of it is cleared
+  if (buffer.GetSize() != size)
+    buffer.SetSize(size);
+  memset(buffer.GetPointer(), 0, size);
+  return true;
+}
+
+
+void RTP_DataFramePool::Release(PBYTEArray & buffer)
+{
+  PINDEX size = buffer.GetSize();
+  int sizeClass = GetSizeClass(size);
+  if (sizeClass < 0 || size == 0 || !buffer.IsUnique())
+    return;
+
+  RTP_DataFramePool * pool = GetInstance();
+  if (pool == NULL)
+    return;
+
+  Shard & shard = pool->GetShard();
+  PWaitAndSignal lock(shard.m_mutex);
+  std::vector<PBYTEArray> & freeList = shard.m_free[sizeClass];
+  if (freeList.size() < MaxFreePerClass)
+    freeList.push_back(buffer);
+}
+
+
+void RTP_DataFramePool::GetStatistics(uint64_t & hits, uint64_t & misses)
+{
+  hits = misses = 0;
+
+  RTP_DataFramePool * pool = GetInstance();
+  if (pool == NULL)
+    return;
+
+  for (int i = 0; i < NumShards; ++i) {
+    PWaitAndSignal lock(pool->m_shards[i].m_mutex);
+    hits += pool->m_shards[i].m_hits;
+    misses += pool->m_shards[i].m_misses;
+  }
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 RTP_ControlFrame::RTP_ControlFrame(PINDEX sz)
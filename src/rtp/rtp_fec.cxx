@@ -57,14 +57,20 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantFra
   PINDEX redPayloadSize = 0;
   for (RTP_DataFrameList::iterator it = redundancies.begin(); it != redundancies.end(); ++it) {
     PINDEX size = it->GetPayloadSize();
+    if (size > 0x3ff) {
+      PTRACE(m_throttleTxRED, &m_session, m_session << "redundant block too large for RFC 2198: " << size << " bytes");
+      continue;
+    }
 
     if (!red.SetPayloadSize(redPayloadSize + size + 4))
       return e_AbortTransport;
 
+    // Timestamp offset is 14 bits, block length is 10 bits
+    unsigned offset = frame.GetTimestamp() - it->GetTimestamp();
     BYTE * payload = red.GetPayloadPtr() + redPayloadSize;
     *payload++ = (BYTE)(it->GetPayloadType() | 0x80);
-    *payload++ = (BYTE)(it->GetTimestamp() >> 6);
-    *payload++ = (BYTE)(((it->GetTimestamp() & 0x3f) << 2) | (size >> 8));
+    *payload++ = (BYTE)(offset >> 6);
+    *payload++ = (BYTE)(((offset & 0x3f) << 2) | (size >> 8));
     *payload++ = (BYTE)size;
     memcpy(payload, it->GetPayloadPtr(), size);
 
@@ -90,8 +96,6 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantDat
     return e_ProcessPacket; // No redundancies, add primary data and return
 
   FecData fec;
-  fec.m_level.resize(m_session.m_ulpFecSendLevel);
-
   switch (OnSendFEC(primary, fec)) {
     case e_AbortTransport :
       return e_AbortTransport;
@@ -159,9 +163,81 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendRedundantDat
 }
 
 
-OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendFEC(RTP_DataFrame & /*primary*/, FecData & /*fec*/)
+static void XorFecBlock(PBYTEArray & block, const BYTE * data, PINDEX size)
 {
-  return e_IgnorePacket;
+  if (block.GetSize() < size)
+    block.SetSize(size); // Extra is zero filled, which is the required padding
+
+  BYTE * ptr = block.GetPointer();
+  for (PINDEX i = 0; i < size; ++i)
+    ptr[i] ^= data[i];
+}
+
+
+static bool IsInFecMask(const PBYTEArray & mask, unsigned bit)
+{
+  return bit < (unsigned)mask.GetSize()*8 && (mask[bit/8] & (0x80 >> (bit%8))) != 0;
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendFEC(RTP_DataFrame & primary, FecData & fec)
+{
+  unsigned groupSize = std::min(m_session.m_ulpFecGroupSize, 48U);
+  unsigned level = std::min(m_session.m_ulpFecSendLevel, groupSize);
+  if (level == 0)
+    return e_IgnorePacket;
+
+  /* Parity blocks from a completed group go out on the packets following it,
+     so losing the last packet of a group does not also lose its protection. */
+  SendReceiveStatus status = e_IgnorePacket;
+  if (!m_fecPending.empty()) {
+    fec = m_fecPending.front();
+    m_fecPending.pop_front();
+    status = e_ProcessPacket;
+  }
+
+  RTP_SequenceNumber sequenceNumber = primary.GetSequenceNumber();
+  if (m_fecGroupCount > 0 && sequenceNumber != (RTP_SequenceNumber)(m_fecGroupBase + m_fecGroupCount)) {
+    PTRACE(4, &m_session, *this << "ULP-FEC group restarted at sn=" << sequenceNumber);
+    m_fecGroupCount = 0;
+  }
+
+  if (m_fecGroupCount == 0) {
+    m_fecGroupBase = sequenceNumber;
+    m_fecAccumulators.assign(level, FecData());
+  }
+
+  /* Packets are interleaved across the parity blocks, so block N protects
+     every level'th packet, and a burst of up to level losses is recoverable. */
+  FecData & acc = m_fecAccumulators[m_fecGroupCount % level];
+  if (acc.m_level.empty()) {
+    acc.m_timestamp = primary.GetTimestamp();
+    acc.m_snBase = sequenceNumber;
+    acc.m_level.resize(1);
+    acc.m_level[0].m_mask.SetSize(groupSize > 16 ? 6 : 2);
+  }
+
+  const BYTE * packet = primary;
+  acc.m_pRecovery ^= (packet[0] & 0x20) != 0;
+  acc.m_xRecovery ^= (packet[0] & 0x10) != 0;
+  acc.m_ccRecovery ^= packet[0] & 0x0f;
+  acc.m_mRecovery ^= (packet[1] & 0x80) != 0;
+  acc.m_ptRecovery ^= packet[1] & 0x7f;
+  acc.m_tsRecovery ^= primary.GetTimestamp();
+
+  PINDEX length = primary.GetPacketSize() - RTP_DataFrame::MinHeaderSize;
+  acc.m_lenRecovery ^= length;
+
+  unsigned bit = (RTP_SequenceNumber)(sequenceNumber - acc.m_snBase);
+  acc.m_level[0].m_mask[bit/8] |= (BYTE)(0x80 >> (bit%8));
+  XorFecBlock(acc.m_level[0].m_data, packet + RTP_DataFrame::MinHeaderSize, length);
+
+  if (++m_fecGroupCount >= groupSize) {
+    m_fecPending.insert(m_fecPending.end(), m_fecAccumulators.begin(), m_fecAccumulators.end());
+    m_fecGroupCount = 0;
+  }
+
+  return status;
 }
 
 
@@ -195,6 +271,9 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
   PTRACE(m_throttleRxRED, &m_session, m_session << "redundant packet " << frame.GetPayloadType()
          << " primary block extracted: " << primary.GetPayloadType() << ", sz=" << size);
 
+  if (m_session.m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType)
+    AddFecHistory(primary);
+
   // Then go through the redundant entries again
   payload = frame.GetPayloadPtr();
   size = frame.GetPayloadSize();
@@ -238,7 +317,7 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
 
   FecData fec;
   fec.m_timestamp = timestamp;
-  bool maskSize = (*data & 0x40) != 0 ? 6 : 2;
+  PINDEX maskSize = (*data & 0x40) != 0 ? 6 : 2;
   fec.m_pRecovery = (*data & 0x20) != 0;
   fec.m_xRecovery = (*data & 0x10) != 0;
   fec.m_ccRecovery = (*data & 0xf);
@@ -256,13 +335,19 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
 
   PINDEX hdrLen = 2 + maskSize;
   while (size >= hdrLen) {
+    PINDEX len = *(PUInt16b *)data;
+    if (size < hdrLen + len) {
+      PTRACE(2, &m_session, m_session << "redundant ULP-FEC level truncated: " << size << " bytes, expecting " << hdrLen + len);
+      return e_IgnorePacket;
+    }
+
     FecLevel level;
     level.m_mask = PBYTEArray(data+2, maskSize, false);
-    level.m_data = PBYTEArray(data+hdrLen, *(PUInt16b *)data, false);
+    level.m_data = PBYTEArray(data+hdrLen, len, false);
     fec.m_level.push_back(level);
 
-    data += hdrLen;
-    size -= hdrLen;
+    data += hdrLen + len;
+    size -= hdrLen + len;
   }
 
   PTRACE(5, &m_session, m_session << "redundant ULP-FEC:"
@@ -271,16 +356,158 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveRedundant
 }
 
 
-OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveFEC(RTP_DataFrame & /*primary*/, const FecData & /*fec*/)
+const RTP_DataFrame * OpalRTPSession::SyncSource::FindFecHistory(RTP_SequenceNumber sequenceNumber) const
 {
-  /* If there is something in m_pendingPackets, then there was a missing
-     packet(s). From the primary data packet and the FEC info, it should be
-     possible to calculate the missing packet and insert it into the correct
-     position of m_pendingPackets. It will then be fed out as though it was
-     just an out of order packet.
-   */
+  for (RTP_DataFrameList::const_iterator it = m_fecHistory.begin(); it != m_fecHistory.end(); ++it) {
+    if (it->GetSequenceNumber() == sequenceNumber)
+      return &*it;
+  }
+  return NULL;
+}
 
-  return e_ProcessPacket;
+
+void OpalRTPSession::SyncSource::AddFecHistory(const RTP_DataFrame & frame)
+{
+  // Enough for the group being received, plus the one before it whose parity may still be arriving
+  PINDEX maxHistory = 2*std::min(m_session.m_ulpFecGroupSize, 48U) + m_session.m_ulpFecSendLevel;
+  while (!m_fecHistory.empty() && m_fecHistory.GetSize() >= maxHistory)
+    m_fecHistory.pop_front();
+
+  // Received frames may reference the transport buffer, so must take a copy
+  m_fecHistory.push_back(frame);
+  m_fecHistory.back().MakeUnique();
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveFEC(RTP_DataFrame & primary, const FecData & fec)
+{
+  if (fec.m_level.empty() || m_fecHistory.empty())
+    return e_ProcessPacket;
+
+  /* XOR parity can only recover exactly one missing packet out of those
+     protected, and all the others must still be in the history. */
+  const PBYTEArray & mask = fec.m_level[0].m_mask;
+  std::vector<const RTP_DataFrame *> present;
+  RTP_SequenceNumber missing = 0;
+  unsigned missingCount = 0;
+  for (unsigned bit = 0; bit < (unsigned)mask.GetSize()*8; ++bit) {
+    if (IsInFecMask(mask, bit)) {
+      RTP_SequenceNumber sn = (RTP_SequenceNumber)(fec.m_snBase + bit);
+      const RTP_DataFrame * frame = FindFecHistory(sn);
+      if (frame != NULL)
+        present.push_back(frame);
+      else {
+        missing = sn;
+        ++missingCount;
+      }
+    }
+  }
+
+  if (missingCount != 1)
+    return e_ProcessPacket; // Nothing lost, or too much lost
+
+  // If older than anything in history, may have been received and discarded
+  if ((RTP_SequenceNumber)(missing - m_fecHistory.front().GetSequenceNumber()) >= 0x8000)
+    return e_ProcessPacket;
+
+  // Recover the header fields and length
+  BYTE header0 = (BYTE)((fec.m_pRecovery ? 0x20 : 0) | (fec.m_xRecovery ? 0x10 : 0) | (fec.m_ccRecovery & 0x0f));
+  BYTE header1 = (BYTE)((fec.m_mRecovery ? 0x80 : 0) | (fec.m_ptRecovery & 0x7f));
+  unsigned timestamp = fec.m_tsRecovery;
+  unsigned length = fec.m_lenRecovery;
+  for (std::vector<const RTP_DataFrame *>::iterator it = present.begin(); it != present.end(); ++it) {
+    const BYTE * packet = **it;
+    header0 ^= packet[0];
+    header1 ^= packet[1];
+    timestamp ^= (*it)->GetTimestamp();
+    length ^= (*it)->GetPacketSize() - RTP_DataFrame::MinHeaderSize;
+  }
+  length &= 0xffff;
+
+  // Recover the data, each level protects the next range of bytes
+  PBYTEArray data;
+  PINDEX offset = 0;
+  for (vector<FecLevel>::const_iterator level = fec.m_level.begin(); level != fec.m_level.end() && offset < (PINDEX)length; ++level) {
+    unsigned missingBit = (RTP_SequenceNumber)(missing - fec.m_snBase);
+    if (!IsInFecMask(level->m_mask, missingBit))
+      break;
+
+    PBYTEArray block = level->m_data;
+    block.MakeUnique();
+    for (unsigned bit = 0; bit < (unsigned)level->m_mask.GetSize()*8; ++bit) {
+      if (bit != missingBit && IsInFecMask(level->m_mask, bit)) {
+        const RTP_DataFrame * frame = FindFecHistory((RTP_SequenceNumber)(fec.m_snBase + bit));
+        if (frame == NULL)
+          return e_ProcessPacket; // Higher level mask not a subset of level 0, cannot recover
+
+        PINDEX available = frame->GetPacketSize() - RTP_DataFrame::MinHeaderSize - offset;
+        if (available > 0)
+          XorFecBlock(block, (const BYTE *)*frame + RTP_DataFrame::MinHeaderSize + offset, std::min(available, block.GetSize()));
+      }
+    }
+
+    data.Concatenate(block);
+    offset += block.GetSize();
+  }
+
+  if (offset < (PINDEX)length) {
+    PTRACE(3, &m_session, *this << "ULP-FEC protection insufficient to recover sn=" << missing
+           << ", need " << length << " bytes, have " << offset);
+    return e_ProcessPacket;
+  }
+
+  RTP_DataFrame recovered(0, RTP_DataFrame::MinHeaderSize + length);
+  BYTE * packet = recovered.GetPointer(RTP_DataFrame::MinHeaderSize + length);
+  packet[0] = (BYTE)(0x80 | (header0 & 0x3f)); // Version 2
+  packet[1] = header1;
+  memcpy(packet + RTP_DataFrame::MinHeaderSize, data, length);
+  recovered.SetSequenceNumber(missing);
+  recovered.SetTimestamp(timestamp);
+  recovered.SetSyncSource(primary.GetSyncSource());
+  if (!recovered.SetPacketSize(RTP_DataFrame::MinHeaderSize + length)) {
+    PTRACE(2, &m_session, *this << "ULP-FEC recovered invalid packet sn=" << missing);
+    return e_ProcessPacket;
+  }
+
+  PTRACE(4, &m_session, *this << "ULP-FEC recovered packet: " << setw(1) << recovered);
+  return OnRecoveredFEC(recovered);
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnRecoveredFEC(RTP_DataFrame & frame)
+{
+  ++m_fecRecovered;
+  AddFecHistory(frame);
+  frame.SetLipSyncId(m_mediaStreamId);
+
+  /* If still waiting for it while resequencing, put it with the other out of
+     order packets and it will be fed out as though it had just arrived. */
+  RTP_SequenceNumber sequenceNumber = frame.GetSequenceNumber();
+  if ((RTP_SequenceNumber)(sequenceNumber - m_lastSequenceNumber - 1) < 0x8000) {
+    RTP_DataFrameList::iterator it;
+    for (it = m_pendingPackets.begin(); it != m_pendingPackets.end(); ++it) {
+      if (sequenceNumber > it->GetSequenceNumber())
+        break;
+    }
+    m_pendingPackets.insert(it, frame);
+
+    // It may have been the one the queue was stalled on, so drain it now
+    return HandlePendingFrames() ? e_ProcessPacket : e_AbortTransport;
+  }
+
+  // Already counted as lost, so un-count it and pass straight up to the jitter buffer
+  if (m_packetsLost > 0)
+    --m_packetsLost;
+  if (m_packetsLostSinceLastRR > 0)
+    --m_packetsLostSinceLastRR;
+
+  /* Already through any decryption as part of the FEC packet, so explicitly
+     use the base class and not a virtual that would, for example, unprotect
+     it again in SRTP. */
+  SendReceiveStatus status = m_session.OpalRTPSession::OnReceiveData(frame);
+  if (status == e_ProcessPacket)
+    status = NotifyReceivedData(frame);
+  return status == e_AbortTransport ? e_AbortTransport : e_ProcessPacket;
 }
 
 #endif // OPAL_RTP_FEC
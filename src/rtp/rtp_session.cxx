@@ -116,12 +116,13 @@ OpalRTPSession::OpalRTPSession(const Init & init)
   , m_redundencyPayloadType(RTP_DataFrame::IllegalPayloadType)
   , m_ulpFecPayloadType(RTP_DataFrame::IllegalPayloadType)
   , m_ulpFecSendLevel(2)
+  , m_ulpFecGroupSize(8)
 #endif
   , m_dummySyncSource(*this, 0, e_Receiver, "-")
   , m_rtcpPacketsSent(0)
   , m_rtcpPacketsReceived(0)
   , m_roundTripTime(-1)
-  , m_reportTimer(0, 12)  // Seconds
+  , m_reportTimer(m_manager.GetTimerWheel())
   , m_qos(m_manager.GetMediaQoS(init.m_mediaType))
   , m_packetOverhead(0)
   , m_remoteControlPort(0)
@@ -131,6 +132,7 @@ OpalRTPSession::OpalRTPSession(const Init & init)
 {
   PTRACE_CONTEXT_ID_TO(m_reportTimer);
   m_reportTimer.SetNotifier(PCREATE_NOTIFIER(TimedSendReport));
+  m_reportTimer.RunContinuous(PTimeInterval(0, 12)); // Seconds
   m_reportTimer.Stop();
 }
 
@@ -140,6 +142,7 @@ OpalRTPSession::OpalRTPSession(const OpalRTPSession & other)
   , m_endpoint(other.m_endpoint)
   , m_manager(other.m_manager)
   , m_dummySyncSource(*this, 0, e_Receiver, NULL)
+  , m_reportTimer(m_manager.GetTimerWheel())
 {
 }
 
@@ -337,6 +340,11 @@ OpalRTPSession::SyncSource::SyncSource(OpalRTPSession & session, RTP_SyncSourceI
   , m_referenceReportTime(0)
   , m_referenceReportNTP(0)
   , m_statisticsCount(0)
+#if OPAL_RTP_FEC
+  , m_fecGroupCount(0)
+  , m_fecGroupBase(0)
+  , m_fecRecovered(0)
+#endif
 #if OPAL_RTCP_XR
   , m_metrics(NULL)
 #endif
@@ -646,8 +654,12 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveData(RTP_
   SendReceiveStatus status = m_session.OnReceiveData(frame);
 
 #if OPAL_RTP_FEC
-  if (status == e_ProcessPacket && frame.GetPayloadType() == m_session.m_redundencyPayloadType)
-    status = OnReceiveRedundantFrame(frame);
+  if (status == e_ProcessPacket) {
+    if (frame.GetPayloadType() == m_session.m_redundencyPayloadType)
+      status = OnReceiveRedundantFrame(frame);
+    else if (m_session.m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType)
+      AddFecHistory(frame);
+  }
 #endif
 
   CalculateStatistics(frame);
@@ -656,6 +668,12 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnReceiveData(RTP_
   if (status != e_ProcessPacket)
     return status;
 
+  return NotifyReceivedData(frame);
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::NotifyReceivedData(RTP_DataFrame & frame)
+{
   Data data(frame);
   for (NotifierMap::iterator it = m_notifiers.begin(); it != m_notifiers.end(); ++it) {
     it->second(m_session, data);
@@ -1347,7 +1365,7 @@ bool OpalRTPSession::SyncSource::IsStaleReceiver() const
 }
 
 
-void OpalRTPSession::TimedSendReport(PTimer&, P_INT_PTR)
+void OpalRTPSession::TimedSendReport(OpalWheelTimer&, P_INT_PTR)
 {
   PTRACE_CONTEXT_ID_PUSH_THREAD(*this);
   PTRACE(5, *this << "sending periodic report");
@@ -2501,15 +2519,14 @@ void OpalRTPSession::OnRxDataPacket(OpalMediaTransport &, PBYTEArray data)
   }
 
   // Check for single port operation, incoming RTCP on RTP
-  RTP_ControlFrame control(data, data.GetSize(), false);
-  unsigned type = control.GetPayloadType();
-  if (type >= RTP_ControlFrame::e_FirstValidPayloadType && type <= RTP_ControlFrame::e_LastValidPayloadType) {
+  if (RTP_ControlFrame::IsControlPacket(data, data.GetSize())) {
+    RTP_ControlFrame control(data, data.GetSize(), false);
     if (OnReceiveControl(control) == e_AbortTransport)
       CheckMediaFailed(e_Control);
   }
   else {
-    RTP_DataFrame frame;
-    frame.PBYTEArray::operator=(data);
+    // Frame references the transport read buffer, which is passed on without copy
+    RTP_DataFrame frame(data);
     if (OnReceiveData(frame, data.GetSize()) == e_AbortTransport)
       CheckMediaFailed(e_Data);
   }
@@ -64,6 +64,7 @@ OpalRTPMediaStream::OpalRTPMediaStream(OpalRTPConnection & conn,
   , m_notifierPriority(100)
   , m_jitterBuffer(NULL)
   , m_readTimeout(PMaxTimeInterval)
+  , m_readReadyNotify(false)
 #if OPAL_VIDEO
   , m_forceIntraFrameFlag(false)
   , m_videoUpdateThrottleTime(-1)
@@ -288,8 +289,14 @@ bool OpalRTPMediaStream::InternalExecuteCommand(const OpalMediaCommand & command
 void OpalRTPMediaStream::OnReceivedPacket(OpalRTPSession &, OpalRTPSession::Data & data)
 {
   if (m_passThruStream == NULL) {
-    if (m_jitterBuffer != NULL)
+    if (m_jitterBuffer != NULL) {
       m_jitterBuffer->WriteData(data.m_frame);
+      if (m_readReadyNotify) {
+        OpalMediaPatchPtr patch = m_mediaPatch;
+        if (patch != NULL)
+          patch->OnReadReady();
+      }
+    }
     return;
   }
 
@@ -442,6 +449,22 @@ PBoolean OpalRTPMediaStream::RequiresPatchThread() const
 }
 
 
+OpalMediaStream::ScheduledReadMode OpalRTPMediaStream::EnableScheduledRead(bool enab)
+{
+  if (!enab || IsSink() || m_jitterBuffer == NULL || m_passThruStream != NULL) {
+    m_readReadyNotify = false;
+    SetReadTimeout(PMaxTimeInterval);
+    return e_ScheduledReadBlocks;
+  }
+
+  SetReadTimeout(0);
+
+  // With a jitter buffer delay, we need to be read at a regular rate
+  m_readReadyNotify = m_jitterBuffer->GetMaxJitterDelay() == 0;
+  return m_readReadyNotify ? e_ScheduledReadOnReady : e_ScheduledReadOnTick;
+}
+
+
 bool OpalRTPMediaStream::InternalSetJitterBuffer(const OpalJitterBuffer::Init & init)
 {
   if (!IsOpen() || IsSink() || !RequiresPatchThread() || m_jitterBuffer == NULL)
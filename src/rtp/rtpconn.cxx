@@ -338,8 +338,13 @@ OpalMediaFormatList OpalRTPConnection::NegotiateFECMediaFormats(OpalMediaSession
 
           if (fmt->GetName().NumCompare(OPAL_REDUNDANT_PREFIX) == EqualTo)
             rtpSession->SetRedundencyPayloadType(fmt->GetPayloadType());
-          else if (fmt->GetName().NumCompare(OPAL_ULP_FEC_PREFIX) == EqualTo)
+          else if (fmt->GetName().NumCompare(OPAL_ULP_FEC_PREFIX) == EqualTo) {
             rtpSession->SetUlpFecPayloadType(fmt->GetPayloadType());
+            rtpSession->SetUlpFecGroupSize(std::min(it->GetOptionInteger(OpalFEC::GroupSizeOption(), 8),
+                                                    fmt->GetOptionInteger(OpalFEC::GroupSizeOption(), 8)));
+            rtpSession->SetUlpFecSendLevel(std::min(it->GetOptionInteger(OpalFEC::ProtectionLevelOption(), 2),
+                                                    fmt->GetOptionInteger(OpalFEC::ProtectionLevelOption(), 2)));
+          }
 
           PTRACE(4, "Accepted redundant format " << *fmt << ", pt=" << fmt->GetPayloadType());
         }
@@ -73,6 +73,20 @@ namespace OpalFEC
   }
 
 
+  const PString & GroupSizeOption()
+  {
+    static const PConstCaselessString s("Group Size");
+    return s;
+  }
+
+
+  const PString & ProtectionLevelOption()
+  {
+    static const PConstCaselessString s("Protection Level");
+    return s;
+  }
+
+
   class BaseMediaFormat : public OpalMediaFormat
   {
     PCLASSINFO(BaseMediaFormat, OpalMediaFormat)
@@ -112,6 +126,15 @@ namespace OpalFEC
     UlpFecMediaFormat(const char * name, const OpalMediaType & mediaType, unsigned clockRate)
       : BaseMediaFormat(name, mediaType, clockRate, "ulpfec", "RFC 5109 ULP Forward Error Correction for ")
     {
+      /* Not in RFC 5109, but lets two OPAL's agree on the overhead, the
+         smaller of each side is used. Other implementations ignore them. */
+      OpalMediaOption * option = new OpalMediaOptionUnsigned(GroupSizeOption(), false, OpalMediaOption::MinMerge, 8, 1, 48);
+      option->SetFMTP("group-size", "8");
+      AddOption(option);
+
+      option = new OpalMediaOptionUnsigned(ProtectionLevelOption(), false, OpalMediaOption::MinMerge, 2, 1, 16);
+      option->SetFMTP("protection-level", "2");
+      AddOption(option);
     }
   };
 
@@ -96,6 +96,13 @@ bool OpalICEMediaTransport::IsEstablished() const
 }
 
 
+bool OpalICEMediaTransport::InternalCanUseReactor(SubChannels) const
+{
+  // ICE wraps the socket with STUN processing on read, so needs own thread
+  return false;
+}
+
+
 void OpalICEMediaTransport::InternalRxData(SubChannels subchannel, const PBYTEArray & data)
 {
   if (m_state == e_Disabled)
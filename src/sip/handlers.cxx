@@ -279,6 +279,10 @@ PBoolean SIPHandler::SendRequest(SIPHandler::State newState)
 
   m_expireTimer.Stop(false); // Stop automatic retry
 
+  // AOR may now resolve differently, e.g. DNS changed since last time
+  if (newState == Subscribing || newState == Refreshing)
+    ResetResolvedAOR();
+
   SetState(newState);
 
   SIP_PDU::StatusCodes reason = StartTransaction(PCREATE_NOTIFIER(WriteTransaction));
@@ -863,6 +867,9 @@ void SIPRegisterHandler::UpdateParameters(const SIPRegister::Params & params)
   if (!params.m_password.IsEmpty())
     m_password = m_parameters.m_password = params.m_password; // Adjust the password if required 
 
+  if (!params.m_authID.IsEmpty() || !params.m_realm.IsEmpty() || !params.m_password.IsEmpty())
+    GetEndPoint().UpdateHandlerIndexes(this);
+
   if (params.m_expire > 0)
     SetExpire(m_parameters.m_expire = params.m_expire);
 
@@ -997,6 +1004,9 @@ void SIPSubscribeHandler::UpdateParameters(const SIPSubscribe::Params & params)
   if (!params.m_password.IsEmpty())
     m_password = params.m_password; // Adjust the password if required 
 
+  if (!params.m_authID.IsEmpty() || !params.m_realm.IsEmpty() || !params.m_password.IsEmpty())
+    GetEndPoint().UpdateHandlerIndexes(this);
+
   m_parameters.m_contactAddress = params.m_contactAddress;
   m_parameters.m_onSubcribeStatus = params.m_onSubcribeStatus;
   m_parameters.m_onNotify = params.m_onNotify;
@@ -2397,6 +2407,25 @@ static PString MakeUrlKey(const PString & aor, SIP_PDU::Methods method, const PS
 }
 
 
+static PString MakeDomainKey(const PString & domain, SIP_PDU::Methods method)
+{
+  return PString((unsigned)method) + '\n' + domain.ToLower();
+}
+
+
+static const PTimeInterval ResolvedAORTimeToLive(0, 0, 5); // Five minutes
+
+
+static OpalTransportAddress ResolveForDomain(const OpalTransportAddress & address)
+{
+  PIPSocket::Address ip;
+  WORD port = 65535;
+  if (!address.GetIpAndPort(ip, port))
+    return OpalTransportAddress();
+  return OpalTransportAddress(ip, port, address.GetProto());
+}
+
+
 /**
   * called when a handler is added
   */
@@ -2419,11 +2448,24 @@ void SIPHandlersList::Append(SIPHandler * newHandler)
   handler->m_byAorAndPackage = m_byAorAndPackage.insert(IndexMap::value_type(key, handler));
   PTRACE_IF(1, !handler->m_byAorAndPackage.second, "Duplicate handler for Method/AOR/Package=\"" << key << '"');
 
+  // add entry to method/domain map
+  if (!handler->m_byDomain.second) {
+    key = MakeDomainKey(handler->GetAddressOfRecord().GetHostName(), handler->GetMethod());
+    handler->m_byDomain.first = m_byDomain.insert(IndexMultiMap::value_type(key, handler));
+    handler->m_byDomain.second = true;
+  }
+
   // add entry to username/realm map
   PString realm = handler->GetRealm();
   if (realm.IsEmpty())
     return;
 
+  // add entry to realm map, if have credentials to offer other handlers
+  if (!handler->m_byRealm.second && !handler->GetAuthID().IsEmpty() && !handler->GetPassword().IsEmpty()) {
+    handler->m_byRealm.first = m_byRealm.insert(IndexMultiMap::value_type(realm, handler));
+    handler->m_byRealm.second = true;
+  }
+
   PString username = handler->GetAuthID();
   if (!username.IsEmpty()) {
     handler->m_byAuthIdAndRealm = m_byAuthIdAndRealm.insert(IndexMap::value_type(username + '\n' + realm, handler));
@@ -2460,6 +2502,7 @@ void SIPHandlersList::Update(SIPHandler * handler)
 
   PWaitAndSignal mutex(m_handlersList.GetMutex());
 
+  handler->ResetResolvedAOR();
   RemoveIndexes(handler);
   Append(handler);
 }
@@ -2467,6 +2510,16 @@ void SIPHandlersList::Update(SIPHandler * handler)
 
 void SIPHandlersList::RemoveIndexes(SIPHandler * handler)
 {
+  if (handler->m_byDomain.second) {
+    m_byDomain.erase(handler->m_byDomain.first);
+    handler->m_byDomain.second = false;
+  }
+
+  if (handler->m_byRealm.second) {
+    m_byRealm.erase(handler->m_byRealm.first);
+    handler->m_byRealm.second = false;
+  }
+
   if (handler->m_byAorUserAndRealm.second)
     m_byAorUserAndRealm.erase(handler->m_byAorUserAndRealm.first);
 
@@ -2506,6 +2559,25 @@ PSafePtr<SIPHandler> SIPHandlersList::FindBy(IndexMap & by, const PString & key,
 }
 
 
+PSafePtr<SIPHandler> SIPHandlersList::FindFirstBy(IndexMultiMap & by, const PString & key, PSafetyMode mode, bool skipUnsubscribed)
+{
+  PSafePtr<SIPHandler> ptr;
+  {
+    PWaitAndSignal mutex(m_handlersList.GetMutex());
+
+    std::pair<IndexMultiMap::iterator, IndexMultiMap::iterator> range = by.equal_range(key);
+    for (IndexMultiMap::iterator it = range.first; it != range.second; ++it) {
+      ptr = it->second;
+      if (ptr != NULL && (!skipUnsubscribed || ptr->GetState() != SIPHandler::Unsubscribed))
+        break;
+      ptr.SetNULL();
+    }
+  }
+
+  return ptr != NULL && ptr.SetSafetyMode(mode) ? ptr : NULL;
+}
+
+
 PSafePtr<SIPHandler> SIPHandlersList::FindFirstHandler(SIP_PDU::Methods meth, PSafetyMode mode) const
 {
   PSafePtr<SIPHandler> handler(m_handlersList, PSafeReference);
@@ -2536,21 +2608,16 @@ PSafePtr<SIPHandler> SIPHandlersList::FindSIPHandlerByUrl(const PString & aor, S
 
 PSafePtr<SIPHandler> SIPHandlersList::FindSIPHandlerByAuthRealm(const PString & authRealm, PSafetyMode mode)
 {
-  // look for a match to realm without users
-  for (PSafePtr<SIPHandler> handler(m_handlersList, PSafeReference); handler != NULL; ++handler) {
-    if (  handler->GetRealm() == authRealm &&
-          handler.SetSafetyMode(PSafeReadOnly) &&
-         !handler->GetAuthID().IsEmpty() &&
-         !handler->GetPassword().IsEmpty() &&
-          handler.SetSafetyMode(mode)) {
-      PTRACE(3, "Located existing credentials for realm \"" << authRealm << "\" "
-             << handler->GetMethod() << " of aor=" << handler->GetAddressOfRecord() << ", id=" << handler->GetCallID());
-      return handler;
-    }
+  // look for a match to realm without users, unsubscribed handlers can still lend credentials
+  PSafePtr<SIPHandler> handler = FindFirstBy(m_byRealm, authRealm, mode, false);
+  if (handler == NULL) {
+    PTRACE(4, "No existing credentials for realm \"" << authRealm << '"');
+    return NULL;
   }
 
-  PTRACE(4, "No existing credentials for realm \"" << authRealm << '"');
-  return NULL;
+  PTRACE(3, "Located existing credentials for realm \"" << authRealm << "\" "
+         << handler->GetMethod() << " of aor=" << handler->GetAddressOfRecord() << ", id=" << handler->GetCallID());
+  return handler;
 }
 
 
@@ -2578,12 +2645,34 @@ PSafePtr<SIPHandler> SIPHandlersList::FindSIPHandlerByAuthRealm(const PString &
  */
 PSafePtr<SIPHandler> SIPHandlersList::FindSIPHandlerByDomain(const PString & name, SIP_PDU::Methods meth, PSafetyMode mode)
 {
+  PSafePtr<SIPHandler> handler = FindFirstBy(m_byDomain, MakeDomainKey(name, meth), mode, true);
+  if (handler != NULL)
+    return handler;
+
+  /* Not the host name in the AOR, but may still resolve to the same address.
+     Resolve the name once, and each handler's AOR only when it has not been
+     successfully resolved recently, so the scan does not do a DNS lookup per
+     handler. Failures are not remembered, they are retried next time. */
+  OpalTransportAddress wanted = ResolveForDomain(name);
+  if (wanted.IsEmpty())
+    return NULL;
+
   for (PSafePtr<SIPHandler> handler(m_handlersList, PSafeReference); handler != NULL; ++handler) {
-    if ( handler->GetMethod() == meth &&
-         handler->GetState() != SIPHandler::Unsubscribed &&
-        (handler->GetAddressOfRecord().GetHostName() == name ||
-         handler->GetAddressOfRecord().GetTransportAddress().IsEquivalent(name)) &&
-         handler.SetSafetyMode(mode))
+    if (handler->GetMethod() != meth || handler->GetState() == SIPHandler::Unsubscribed)
+      continue;
+
+    OpalTransportAddress aor;
+    {
+      PWaitAndSignal lock(handler->m_resolvedAORMutex);
+      if (!handler->m_resolvedAORTimer.IsRunning()) {
+        handler->m_resolvedAOR = ResolveForDomain(handler->GetAddressOfRecord().GetTransportAddress());
+        if (!handler->m_resolvedAOR.IsEmpty())
+          handler->m_resolvedAORTimer = ResolvedAORTimeToLive;
+      }
+      aor = handler->m_resolvedAOR;
+    }
+
+    if (aor.IsEquivalent(wanted) && handler.SetSafetyMode(mode))
       return handler;
   }
   return NULL;
@@ -3153,7 +3153,7 @@ void SIPConnection::OnInviteResponseRetry()
     timeout = GetEndPoint().GetRetryTimeoutMax();
   m_responseRetryTimer = timeout;
 
-  m_responsePackets.front().Send();
+  m_responsePackets.front().Resend();
 }
 
 
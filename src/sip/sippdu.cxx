@@ -1009,13 +1009,34 @@ void SIPMIMEInfo::SetVia(const PString & v)
 }
 
 
-bool SIPMIMEInfo::GetViaList(PStringList & viaList) const
+// Called with m_viaCache.m_mutex held
+void SIPMIMEInfo::InternalUpdateViaCache() const
 {
   PString s = GetVia();
+  if ((const char *)m_viaCache.m_raw == (const char *)s)
+    return;
+
+  m_viaCache.m_raw = s;
+
   if (s.FindOneOf("\r\n") != P_MAX_INDEX)
-    viaList = s.Lines();
+    m_viaCache.m_list = s.Lines();
   else
-    viaList = s.Tokenise(",", false);
+    m_viaCache.m_list = s.Tokenise(",", false);
+
+  m_viaCache.m_first = s;
+  m_viaCache.m_first.Delete(s.FindOneOf("\r\n"), P_MAX_INDEX);
+}
+
+
+bool SIPMIMEInfo::GetViaList(PStringList & viaList) const
+{
+  PWaitAndSignal lock(m_viaCache.m_mutex);
+  InternalUpdateViaCache();
+
+  // PStringList assignment shares the list, so copy the entries
+  viaList.RemoveAll();
+  for (PStringList::const_iterator via = m_viaCache.m_list.begin(); via != m_viaCache.m_list.end(); ++via)
+    viaList.AppendString(*via);
 
   return !viaList.IsEmpty();
 }
@@ -1035,10 +1056,9 @@ void SIPMIMEInfo::SetViaList(const PStringList & v)
 
 PString SIPMIMEInfo::GetFirstVia() const
 {
-  // Get first via
-  PString via = GetVia();
-  via.Delete(via.FindOneOf("\r\n"), P_MAX_INDEX);
-  return via;
+  PWaitAndSignal lock(m_viaCache.m_mutex);
+  InternalUpdateViaCache();
+  return m_viaCache.m_first;
 }
 
 OpalTransportAddress SIPMIMEInfo::GetViaReceivedAddress() const
@@ -1887,6 +1907,7 @@ SIP_PDU & SIP_PDU::operator=(const SIP_PDU & pdu)
   m_mime = pdu.m_mime;
   m_entityBody = pdu.m_entityBody;
   m_transactionID = pdu.m_transactionID;
+  m_wireBuffer.MakeEmpty();
   SetTransport(pdu.GetTransport());
 
   delete m_SDP;
@@ -2180,9 +2201,7 @@ SIP_PDU::StatusCodes SIP_PDU::Read()
     truncated = true;
   }
 
-  PStringStream datagram;
-  datagram = PString(pdu);
-  status = Parse(datagram, truncated);
+  status = Parse((const char *)pdu.GetPointer(), pdu.GetSize(), truncated);
 
 #if PTRACING
   if (status == Local_TransportLost && PTrace::CanTrace(2)) {
@@ -2239,14 +2258,19 @@ SIP_PDU::StatusCodes SIP_PDU::Read()
 }
 
 
-SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
-{
 #if PTRACING
-  PStringStream transportName;
-  if (m_transport != NULL)
-    transportName << " from " << m_transport->GetLastReceivedAddress() << " on " << *m_transport;
+static PString ReceivedFrom(const OpalTransportPtr & transport)
+{
+  PStringStream str;
+  if (transport != NULL)
+    str << " from " << transport->GetLastReceivedAddress() << " on " << *transport;
+  return str;
+}
 #endif
 
+
+SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
+{
   stream.clear();
 
   // get the message from transport/datagram into cmd and parse MIME
@@ -2263,17 +2287,17 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
 
     // Two CRLF's in a row is "ping"
     if (cmd.IsEmpty()) {
-      PTRACE(5, "Probable keep-alive ping" << transportName);
+      PTRACE(5, "Probable keep-alive ping" << ReceivedFrom(m_transport));
       return Local_KeepAlive;
     }
 
     // Got here, is probably pong to our ping
-    PTRACE(5, "Probable keep-alive pong" << transportName);
+    PTRACE(5, "Probable keep-alive pong" << ReceivedFrom(m_transport));
   }
 
   stream >> m_mime;
   if (stream.bad()) {
-    PTRACE(1, "Invalid message from" << transportName
+    PTRACE(1, "Invalid message from" << ReceivedFrom(m_transport)
            << ", request \"" << cmd << "\", mime:\n" << m_mime);
     return stream.bad() ? SIP_PDU::Failure_BadRequest : SIP_PDU::Failure_MessageTooLarge;
   }
@@ -2283,11 +2307,255 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
     return SIP_PDU::Failure_MessageTooLarge;
   }
 
+  StatusCodes status = InternalParseStartLine(cmd);
+  if (status != SIP_PDU::Successful_OK)
+    return status;
+
+  int contentLength;
+  bool contentLengthPresent = InternalGetContentLength(contentLength);
+
+  // Don't worry about body if was truncated packet
+  if (!truncated) {
+    if (contentLengthPresent) {
+      if (contentLength > 0) {
+        stream.read(m_entityBody.GetPointerAndSetLength(contentLength), contentLength);
+        if (stream.gcount() != (std::streamsize)contentLength)
+          truncated = true;
+      }
+    }
+    else {
+      contentLength = 0;
+      int c;
+      while ((c = stream.get()) != EOF) {
+        m_entityBody.SetMinSize((++contentLength/1000+1)*1000);
+        m_entityBody += (char)c;
+      }
+    }
+
+    m_entityBody[contentLength] = '\0';
+  }
+
+  return InternalParseComplete(cmd, truncated, contentLength);
+}
+
+
+/* Canonical header names, shared by all parsed PDUs so that the dictionary
+   keys are reference counted copies rather than new strings every time.
+   Must include all the full names in the CompactForms table.
+ */
+static const char * const CanonicalHeaderNames[] = {
+  "Via", "From", "To", "Call-ID", "CSeq", "Contact", "Max-Forwards",
+  "Content-Length", "Content-Type", "Content-Encoding", "Content-Disposition",
+  "Route", "Record-Route", "User-Agent", "Server", "Allow", "Allow-Events",
+  "Supported", "Require", "Proxy-Require", "Unsupported", "Accept", "Expires",
+  "Min-Expires", "Event", "Subscription-State", "Subject", "Refer-To", "Referred-By",
+  "Authorization", "Proxy-Authorization", "WWW-Authenticate", "Proxy-Authenticate",
+  "Session-Expires", "Min-SE", "P-Asserted-Identity", "Privacy", "Date", "Timestamp"
+};
+
+class SIPCanonicalHeaders
+{
+  public:
+    SIPCanonicalHeaders()
+      : m_names(CanonicalHeaderNames, CanonicalHeaderNames+PARRAYSIZE(CanonicalHeaderNames))
+    {
+      for (size_t i = 0; i < m_names.size(); ++i) {
+        PINDEX len = m_names[i].GetLength();
+        if (len >= (PINDEX)m_byLength.size())
+          m_byLength.resize(len+1);
+        m_byLength[len].push_back(i);
+      }
+
+      memset(m_compact, 0, sizeof(m_compact));
+      for (PINDEX i = 0; i < PARRAYSIZE(CompactForms); ++i) {
+        const PCaselessString * name = Find(CompactForms[i].full, strlen(CompactForms[i].full));
+        PAssert(name != NULL, PLogicError);
+        m_compact[CompactForms[i].compact - 'a'] = name;
+      }
+    }
+
+    const PCaselessString * Find(const char * name, PINDEX length) const
+    {
+      if (length == 1) {
+        char compact = (char)tolower(*name & 0x7f);
+        return compact >= 'a' && compact <= 'z' ? m_compact[compact - 'a'] : NULL;
+      }
+
+      if (length >= (PINDEX)m_byLength.size())
+        return NULL;
+
+      const std::vector<size_t> & bucket = m_byLength[length];
+      for (std::vector<size_t>::const_iterator it = bucket.begin(); it != bucket.end(); ++it) {
+        if (m_names[*it].NumCompare(name, length) == PObject::EqualTo)
+          return &m_names[*it];
+      }
+      return NULL;
+    }
+
+  protected:
+    std::vector<PCaselessString>       m_names;
+    std::vector< std::vector<size_t> > m_byLength;
+    const PCaselessString            * m_compact[26];
+};
+
+
+static bool GetDatagramLine(const char * & ptr, const char * end, const char * & lineStart, const char * & lineEnd)
+{
+  lineStart = ptr;
+  const char * eol = (const char *)memchr(ptr, '\n', end - ptr);
+  if (eol == NULL) {
+    lineEnd = ptr = end;
+    return false;
+  }
+
+  ptr = eol+1;
+  lineEnd = eol > lineStart && eol[-1] == '\r' ? eol-1 : eol;
+  return true;
+}
+
+
+static void TrimDatagramField(const char * & start, const char * & end)
+{
+  while (start < end && isspace((unsigned char)*start))
+    ++start;
+  while (end > start && isspace((unsigned char)end[-1]))
+    --end;
+}
+
+
+SIP_PDU::StatusCodes SIP_PDU::Parse(const char * data, PINDEX length, bool truncated)
+{
+  static SIPCanonicalHeaders const CanonicalHeaders;
+
+  const char * ptr = data;
+  const char * end = data + length;
+  const char * lineStart;
+  const char * lineEnd;
+
+  // get the start line, skipping a leading CRLF, which is probably a keep-alive pong
+  if (!GetDatagramLine(ptr, end, lineStart, lineEnd))
+    return Local_TransportLost;
+
+  if (lineStart == lineEnd) {
+    if (!GetDatagramLine(ptr, end, lineStart, lineEnd))
+      return Local_TransportLost;
+
+    // Two CRLF's in a row is "ping"
+    if (lineStart == lineEnd) {
+      PTRACE(5, "Probable keep-alive ping" << ReceivedFrom(m_transport));
+      return Local_KeepAlive;
+    }
+
+    PTRACE(5, "Probable keep-alive pong" << ReceivedFrom(m_transport));
+  }
+
+  PString cmd(lineStart, lineEnd - lineStart);
+
+  /* Single pass over the header lines, in place. Each header only costs the
+     value string, continuation lines being the only case needing a join. */
+  m_mime.RemoveAll();
+
+  const char * nameStart = NULL;
+  const char * nameEnd = NULL;
+  const char * valueStart = NULL;
+  const char * valueEnd = NULL;
+  PString folded;
+  bool isFolded = false;
+  bool truncatedMIME = false;
+
+  for (;;) {
+    bool terminated = GetDatagramLine(ptr, end, lineStart, lineEnd);
+    if (lineStart == lineEnd) {
+      // Blank line ends headers, running out of data before it is truncation
+      truncatedMIME = !terminated;
+      break;
+    }
+
+    if (*lineStart == ' ' || *lineStart == '\t') {
+      if (nameStart != NULL) {
+        if (!isFolded) {
+          folded = PString(valueStart, valueEnd - valueStart);
+          isFolded = true;
+        }
+        folded += PString(lineStart, lineEnd - lineStart);
+      }
+    }
+    else {
+      if (nameStart != NULL)
+        InternalAddHeader(CanonicalHeaders.Find(nameStart, nameEnd - nameStart),
+                          nameStart, nameEnd, valueStart, valueEnd, isFolded ? &folded : NULL);
+
+      const char * colon = (const char *)memchr(lineStart, ':', lineEnd - lineStart);
+      if (colon == NULL)
+        nameStart = NULL; // Ignore malformed line, same as PMIMEInfo
+      else {
+        nameStart = lineStart;
+        nameEnd = colon;
+        TrimDatagramField(nameStart, nameEnd);
+        valueStart = colon+1;
+        valueEnd = lineEnd;
+        TrimDatagramField(valueStart, valueEnd);
+        isFolded = false;
+      }
+    }
+
+    if (!terminated)
+      break;
+  }
+
+  if (nameStart != NULL)
+    InternalAddHeader(CanonicalHeaders.Find(nameStart, nameEnd - nameStart),
+                      nameStart, nameEnd, valueStart, valueEnd, isFolded ? &folded : NULL);
+
+  if (truncatedMIME) {
+    PTRACE(3, "Truncated MIME:\n" << cmd << '\n' << m_mime);
+    return SIP_PDU::Failure_MessageTooLarge;
+  }
+
+  StatusCodes status = InternalParseStartLine(cmd);
+  if (status != SIP_PDU::Successful_OK)
+    return status;
+
+  int contentLength;
+  bool contentLengthPresent = InternalGetContentLength(contentLength);
+
+  // Don't worry about body if was truncated packet
+  if (!truncated) {
+    PINDEX remaining = end - ptr;
+    if (!contentLengthPresent)
+      contentLength = remaining;
+    else if (contentLength > remaining)
+      truncated = true;
+
+    if (contentLength > 0)
+      memcpy(m_entityBody.GetPointerAndSetLength(contentLength), ptr, std::min((PINDEX)contentLength, remaining));
+    m_entityBody[contentLength] = '\0';
+  }
+
+  return InternalParseComplete(cmd, truncated, contentLength);
+}
+
+
+void SIP_PDU::InternalAddHeader(const PCaselessString * canonical,
+                                const char * nameStart, const char * nameEnd,
+                                const char * valueStart, const char * valueEnd,
+                                const PString * folded)
+{
+  PString value = folded != NULL ? folded->Trim() : PString(valueStart, valueEnd - valueStart);
+  if (canonical != NULL)
+    m_mime.InternalAddMIME(*canonical, value);
+  else
+    m_mime.InternalAddMIME(PCaselessString(nameStart, nameEnd - nameStart), value);
+}
+
+
+SIP_PDU::StatusCodes SIP_PDU::InternalParseStartLine(const PString & cmd)
+{
   if (cmd.Left(4) *= "SIP/") {
     // parse Response version, code & reason (ie: "SIP/2.0 200 OK")
     PINDEX space = cmd.Find(' ');
     if (space == P_MAX_INDEX) {
-      PTRACE(2, "Bad Status-Line \"" << cmd << "\" received" << transportName);
+      PTRACE(2, "Bad Status-Line \"" << cmd << "\" received" << ReceivedFrom(m_transport));
       return SIP_PDU::Failure_BadRequest;
     }
 
@@ -2301,7 +2569,7 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
     // parse the method, URI and version
     PStringArray cmds = cmd.Tokenise( ' ', false);
     if (cmds.GetSize() < 3) {
-      PTRACE(2, "Bad Request-Line \"" << cmd << "\" received" << transportName);
+      PTRACE(2, "Bad Request-Line \"" << cmd << "\" received" << ReceivedFrom(m_transport));
       return SIP_PDU::Failure_BadRequest;
     }
 
@@ -2309,7 +2577,7 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
     while (!(cmds[0] *= MethodNames[i])) {
       i++;
       if (i >= NumMethods) {
-        PTRACE(2, "Unknown method name " << cmds[0] << " received" << transportName);
+        PTRACE(2, "Unknown method name " << cmds[0] << " received" << ReceivedFrom(m_transport));
         return SIP_PDU::Failure_BadRequest;
       }
     }
@@ -2322,50 +2590,43 @@ SIP_PDU::StatusCodes SIP_PDU::Parse(istream & stream, bool truncated)
   }
 
   if (m_versionMajor < 2) {
-    PTRACE(2, "Invalid version (" << m_versionMajor << ") received" << transportName);
+    PTRACE(2, "Invalid version (" << m_versionMajor << ") received" << ReceivedFrom(m_transport));
     return SIP_PDU::Failure_BadRequest;
   }
 
+  return SIP_PDU::Successful_OK;
+}
+
+
+bool SIP_PDU::InternalGetContentLength(int & contentLength) const
+{
   // get the SDP content body
   // if a content length is specified, read that length
   // if no content length is specified (which is not the same as zero length)
   // then read until end of datagram or stream
-  int contentLength = m_mime.GetContentLength();
-  bool contentLengthPresent = m_mime.IsContentLengthPresent();
+  contentLength = m_mime.GetContentLength();
 
-  if (!contentLengthPresent) {
-    PTRACE(2, "No Content-Length present" << transportName << ", reading till end of datagram/stream.");
+  if (!m_mime.IsContentLengthPresent()) {
+    PTRACE(2, "No Content-Length present" << ReceivedFrom(m_transport) << ", reading till end of datagram/stream.");
+    return false;
   }
-  else if (contentLength < 0) {
-    PTRACE(2, "Impossible negative Content-Length" << transportName << ", reading till end of datagram/stream.");
-    contentLengthPresent = false;
+
+  if (contentLength < 0) {
+    PTRACE(2, "Impossible negative Content-Length" << ReceivedFrom(m_transport) << ", reading till end of datagram/stream.");
+    return false;
   }
-  else if (contentLength > 65535) {
-    PTRACE(2, "Implausibly long Content-Length " << contentLength << " received" << transportName << ", reading to end of datagram/stream.");
-    contentLengthPresent = false;
+
+  if (contentLength > 65535) {
+    PTRACE(2, "Implausibly long Content-Length " << contentLength << " received" << ReceivedFrom(m_transport) << ", reading to end of datagram/stream.");
+    return false;
   }
 
-  // Don't worry about body if was truncated packet
-  if (!truncated) {
-    if (contentLengthPresent) {
-      if (contentLength > 0) {
-        stream.read(m_entityBody.GetPointerAndSetLength(contentLength), contentLength);
-        if (stream.gcount() != (std::streamsize)contentLength)
-          truncated = true;
-      }
-    }
-    else {
-      contentLength = 0;
-      int c;
-      while ((c = stream.get()) != EOF) {
-        m_entityBody.SetMinSize((++contentLength/1000+1)*1000);
-        m_entityBody += (char)c;
-      }
-    }
+  return true;
+}
 
-    m_entityBody[contentLength] = '\0';
-  }
 
+SIP_PDU::StatusCodes SIP_PDU::InternalParseComplete(const PString & cmd, bool truncated, int contentLength)
+{
 #if PTRACING
   if (PTrace::CanTrace(3)) {
     ostream & trace = PTRACE_BEGIN(3);
@@ -2440,6 +2701,42 @@ bool SIP_PDU::Send()
 }
 
 
+bool SIP_PDU::Resend()
+{
+  if (PAssertNULL(m_transport) == NULL)
+    return false;
+
+  PSafeLockReadWrite mutex(*m_transport);
+  return InternalResend() == Successful_OK;
+}
+
+
+SIP_PDU::StatusCodes SIP_PDU::InternalResend()
+{
+  if (m_wireBuffer.IsEmpty())
+    return InternalSend(false);
+
+  if (!m_transport->IsOpen()) {
+    PTRACE(1, "Attempt to rewrite PDU to closed transport " << *m_transport);
+    return Local_TransportError;
+  }
+
+  if (!m_transport->IsReliable() && !m_viaAddress.IsEmpty())
+    m_transport->SetRemoteAddress(m_viaAddress);
+
+  PTRACE(4, "Resending PDU " << *this << " (" << m_wireBuffer.GetLength() << " bytes) to: "
+            "rem=" << m_transport->GetRemoteAddress() << ","
+            "local=" << m_transport->GetLocalAddress() << ","
+            "if=" << m_transport->GetInterface());
+
+  if (m_transport->Write((const char *)m_wireBuffer, m_wireBuffer.GetLength()))
+    return Successful_OK;
+
+  PTRACE(1, "PDU Write failed: " << m_transport->GetErrorText(PChannel::LastWriteError));
+  return Local_TransportError;
+}
+
+
 SIP_PDU::StatusCodes SIP_PDU::InternalSend(bool canDoTCP)
 {
   if (!m_transport->IsOpen()) {
@@ -2505,8 +2802,10 @@ SIP_PDU::StatusCodes SIP_PDU::InternalSend(bool canDoTCP)
   }
 #endif
 
-  if (m_transport->Write((const char *)pduStr, pduLen))
+  if (m_transport->Write((const char *)pduStr, pduLen)) {
+    m_wireBuffer = pduStr;
     return Successful_OK;
+  }
 
   PTRACE(1, "PDU Write failed: " << m_transport->GetErrorText(PChannel::LastWriteError));
   return Local_TransportError;
@@ -3161,8 +3460,8 @@ SIPTransaction::SIPTransaction(Methods method,
   , m_retryTimeoutMax(GetEndPoint().GetRetryTimeoutMax())
   , m_state(NotStarted)
   , m_retry(1)
-  , m_retryTimer(GetEndPoint().GetThreadPool(), GetEndPoint(), GetTransactionID(), &SIPTransaction::OnRetry)
-  , m_completionTimer(GetEndPoint().GetThreadPool(), GetEndPoint(), GetTransactionID(), &SIPTransaction::OnTimeout)
+  , m_retryTimer(GetEndPoint().GetManager().GetTimerWheel(), GetEndPoint().GetThreadPool(), GetEndPoint(), GetTransactionID(), &SIPTransaction::OnRetry)
+  , m_completionTimer(GetEndPoint().GetManager().GetTimerWheel(), GetEndPoint().GetThreadPool(), GetEndPoint(), GetTransactionID(), &SIPTransaction::OnTimeout)
   , m_pduSizeOK(true)
 {
   PTRACE_CONTEXT_ID_FROM(m_owner->m_object);
@@ -3490,7 +3789,7 @@ void SIPTransaction::OnRetry()
     ResendCANCEL();
   else if (PAssertNULL(m_transport)->LockReadWrite()) {
     m_transport->SetInterface(m_localInterface);
-    InternalSend(false);
+    InternalResend();
     m_transport->UnlockReadWrite();
   }
 }